@@ -60,7 +60,7 @@ class PrinterService {
         _recentPrinterLogs.insert(0, '[Android] $msg');
         if (_recentPrinterLogs.length > 200) _recentPrinterLogs.removeLast();
       });
-    } else if (Platform.isWindows) {
+    } else if (WindowsPrinterService.isSupportedPlatform) {
       await _windowsService.initialize();
       _windowsService.logStream.listen((msg) {
         if (_printerLogEnabled) _printerLogController.add(msg);
@@ -30,7 +30,7 @@ extension PrinterServiceDiscovery on PrinterService {
             await DatabaseService.instance.savePrinter(iminPrinter);
           }
         }
-      } else if (Platform.isWindows) {
+      } else if (WindowsPrinterService.isSupportedPlatform) {
         final windowsPrinters = await _windowsService.discoverPrinters();
         for (final discovered in windowsPrinters) {
           if (!allPrinters.any((p) => p.id == discovered.id)) allPrinters.add(discovered);
@@ -63,7 +63,7 @@ extension PrinterServiceDiscovery on PrinterService {
 
   Future<List<Printer>> discoverUsbPrinters() async {
     if (Platform.isAndroid) return await _androidService.discoverUsbPrinters();
-    if (Platform.isWindows) return await _windowsService.discoverUsbPrinters();
+    if (WindowsPrinterService.isSupportedPlatform) return await _windowsService.discoverUsbPrinters();
     return [];
   }
 
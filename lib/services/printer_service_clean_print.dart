@@ -7,7 +7,7 @@ extension PrinterServicePrint on PrinterService {
   ) async {
     return await _synchronized(() async {
       if (Platform.isAndroid) return await _androidService.printOrder(printer, orderData);
-      if (Platform.isWindows) return await _windowsService.printOrder(printer, orderData);
+      if (WindowsPrinterService.isSupportedPlatform) return await _windowsService.printOrder(printer, orderData);
       return false;
     });
   }
@@ -60,7 +60,7 @@ extension PrinterServicePrint on PrinterService {
           developer.log('Android printer error: $e');
           return false;
         }
-      } else if (Platform.isWindows) {
+      } else if (WindowsPrinterService.isSupportedPlatform) {
         try {
           return await _windowsService.printReceipt(printer, receiptPayload);
         } catch (e) {
@@ -75,7 +75,7 @@ extension PrinterServicePrint on PrinterService {
   Future<bool> testPrint(Printer printer) async {
     return await _synchronized(() async {
       if (Platform.isAndroid) return await _androidService.testPrint(printer);
-      if (Platform.isWindows) return await _windowsService.testPrint(printer);
+      if (WindowsPrinterService.isSupportedPlatform) return await _windowsService.testPrint(printer);
       return false;
     });
   }
@@ -202,7 +202,7 @@ extension PrinterServicePrint on PrinterService {
         if (Platform.isAndroid) {
           return await _androidService.printReceipt(printer, receiptData);
         }
-        if (Platform.isWindows) {
+        if (WindowsPrinterService.isSupportedPlatform) {
           return await _windowsService.printReceipt(printer, receiptData);
         }
         return false;
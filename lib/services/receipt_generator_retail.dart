@@ -202,3 +202,70 @@ String generateReceiptTextWithSettings({
 
   return buffer.toString();
 }
+
+/// The receipt [generateReceiptTextWithSettings] lays out, as the fields
+/// `ReceiptBlob.encode` takes plus the `headerLines` and `footerLines` the
+/// desktop runners print around it, so the runner can encode it natively.
+/// Returns null when an item quantity is not a whole non-zero number, which
+/// the blob's integer quantities cannot carry; send the text instead.
+Map<String, dynamic>? structuredReceiptWithSettings({
+  required Map<String, dynamic> data,
+  required ReceiptSettings settings,
+  ReceiptType receiptType = ReceiptType.customer,
+}) {
+  final items = <Map<String, dynamic>>[];
+  for (final item in data['items'] as List<dynamic>? ?? const []) {
+    final qty = item['qty'] as num? ?? 1;
+    if (qty == 0 || qty != qty.roundToDouble()) return null;
+    final amt = (item['amt'] as num? ?? 0).toDouble();
+    items.add({
+      'name': item['name']?.toString() ?? '',
+      'quantity': qty.toInt(),
+      'price': amt / qty,
+    });
+  }
+
+  final header = <String>[];
+  if (receiptType == ReceiptType.merchant) {
+    if (settings.headerText.isNotEmpty) header.add(settings.headerText);
+    if (data['store_name'] != null) header.add(data['store_name'].toString());
+    for (final line in data['address'] as List<dynamic>? ?? const []) {
+      header.add(line.toString());
+    }
+    if (settings.showDateTime && data['date'] != null) {
+      header.add('Date: ${data['date']}, Time: ${data['time']}');
+    }
+    if (data['customer'] != null) header.add('Customer: ${data['customer']}');
+    if (settings.showOrderNumber && data['bill_no'] != null) {
+      header.add('Bill No: ${data['bill_no']}');
+    }
+  } else {
+    if (data['store_name'] != null) header.add(data['store_name'].toString());
+    if (settings.showDateTime && data['date'] != null) header.add('Date: ${data['date']}');
+    if (settings.showOrderNumber && data['bill_no'] != null) {
+      header.add('Receipt #: ${data['bill_no']}');
+    }
+  }
+
+  final footer = <String>[];
+  if (receiptType == ReceiptType.customer) {
+    if (settings.showThankYouMessage) footer.add(settings.thankYouMessage);
+    footer.addAll(['Thank You!', 'Please Come Again']);
+  }
+
+  // Tax and service charge stay out: the text receipt has no lines for them,
+  // only the total that includes them.
+  return {
+    'currency': data['currency'] ?? 'Rs',
+    'title': receiptType == ReceiptType.merchant
+        ? (data['title'] ?? 'RECEIPT')
+        : (data['title'] ?? 'CUSTOMER RECEIPT'),
+    'items': items,
+    if (data['sub_total_amt'] is num) 'subtotal': data['sub_total_amt'],
+    'total': data['total'] as num? ?? 0.0,
+    if (data['barcode'] != null) 'barcode': data['barcode'],
+    if (data['qr_data'] != null) 'qr_data': data['qr_data'],
+    'headerLines': header,
+    'footerLines': footer,
+  };
+}
@@ -80,6 +80,12 @@ class ThermalReceiptGenerator {
     ];
   }
 
+  /// The logo block [generateReceipt] would emit for [logoPath]; exposed so
+  /// tool/logo_raster_benchmark.dart can time it against the native path.
+  @visibleForTesting
+  static List<int> logoCommands(String logoPath, PaperSize paperSize) =>
+      _addLogo(logoPath, paperSize == PaperSize.mm80 ? _mm80MaxChars : _mm58MaxChars);
+
   /// Add logo to receipt
   /// Converts image to monochrome bitmap and sends as ESC/POS raster image
   static List<int> _addLogo(String logoPath, int maxChars) {
@@ -0,0 +1,394 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+
+import 'package:extropos/services/utils/receipt_blob.dart';
+
+/// Synchronous bindings to the native receipt encoder, text layout and logo
+/// rasterizer through the C ABI of libprinter_core_ffi
+/// (native/printer_core/ffi/printer_core_ffi.h).
+///
+/// Unlike the printer method channel these calls do not go through the
+/// platform thread, so receipt preview and other encode-only paths can run
+/// them on a background isolate. Each isolate loads its own [PrinterCoreFfi].
+///
+/// Pure Dart — dart:ffi only, no Flutter imports.
+final class PrinterCoreFfi {
+  static const int abiVersion = 1;
+
+  PrinterCoreFfi._(DynamicLibrary lib)
+    : _encoderNew = lib.lookupFunction<Pointer<Void> Function(Int32), Pointer<Void> Function(int)>(
+        'pc_encoder_new',
+        isLeaf: true,
+      ),
+      _encoderFree = lib.lookup<NativeFinalizerFunction>('pc_encoder_free'),
+      _setCharsPerLine = lib.lookupFunction<_SetIntNative, _SetIntDart>(
+        'pc_encoder_set_chars_per_line',
+        isLeaf: true,
+      ),
+      _setProfile = lib.lookupFunction<_SetProfileNative, _SetProfileDart>(
+        'pc_encoder_set_profile',
+        isLeaf: true,
+      ),
+      _setStore = lib.lookupFunction<_SetStoreNative, _SetStoreDart>(
+        'pc_encoder_set_store',
+        isLeaf: true,
+      ),
+      _encodeReceipt = lib.lookupFunction<_EncodeNative, _EncodeDart>(
+        'pc_encode_receipt',
+        isLeaf: true,
+      ),
+      _encodeText = lib.lookupFunction<_EncodeTextNative, _EncodeTextDart>(
+        'pc_encode_text',
+        isLeaf: true,
+      ),
+      _encodeRows = lib.lookupFunction<_EncodeRowsNative, _EncodeRowsDart>(
+        'pc_encode_rows',
+        isLeaf: true,
+      ),
+      _encoderData = lib.lookupFunction<_DataFn, _DataFn>('pc_encoder_data', isLeaf: true),
+      _encoderSize = lib.lookupFunction<_SizeNative, _SizeDart>('pc_encoder_size', isLeaf: true),
+      _encoderTake = lib.lookupFunction<_HandleFn, _HandleFn>('pc_encoder_take', isLeaf: true),
+      _bufferNew = lib.lookupFunction<Pointer<Void> Function(Size), Pointer<Void> Function(int)>(
+        'pc_buffer_new',
+        isLeaf: true,
+      ),
+      _bufferData = lib.lookupFunction<_DataFn, _DataFn>('pc_buffer_data', isLeaf: true),
+      _bufferSize = lib.lookupFunction<_SizeNative, _SizeDart>('pc_buffer_size', isLeaf: true),
+      _bufferFree = lib.lookup<NativeFinalizerFunction>('pc_buffer_free'),
+      _displayWidth = lib.lookupFunction<_DisplayWidthNative, _DisplayWidthDart>(
+        'pc_display_width',
+        isLeaf: true,
+      ),
+      _rasterizeLogo = lib.lookupFunction<_RasterizeNative, _RasterizeDart>(
+        'pc_rasterize_logo',
+        isLeaf: true,
+      ) {
+    _encoderFinalizer = NativeFinalizer(_encoderFree);
+    _bufferFinalizer = NativeFinalizer(_bufferFree);
+    _freeEncoder = _encoderFree.asFunction<void Function(Pointer<Void>)>(isLeaf: true);
+    _freeBuffer = _bufferFree.asFunction<void Function(Pointer<Void>)>(isLeaf: true);
+    _scratch = _NativeScratch(this);
+  }
+
+  /// Loads the library from [path], by default from the `lib` directory
+  /// next to the executable, where the Linux bundle installs it. Null when
+  /// it is missing or built for another ABI version.
+  static PrinterCoreFfi? load([String? path]) {
+    try {
+      final lib = DynamicLibrary.open(path ?? _defaultPath());
+      final version = lib.lookupFunction<Int32 Function(), int Function()>('pc_abi_version');
+      if (version() != abiVersion) return null;
+      return PrinterCoreFfi._(lib);
+    } on ArgumentError {
+      return null;
+    }
+  }
+
+  static String _defaultPath() {
+    final bundle = File(Platform.resolvedExecutable).parent.path;
+    final bundled = '$bundle/lib/libprinter_core_ffi.so';
+    return File(bundled).existsSync() ? bundled : 'libprinter_core_ffi.so';
+  }
+
+  final Pointer<Void> Function(int) _encoderNew;
+  final Pointer<NativeFinalizerFunction> _encoderFree;
+  final _SetIntDart _setCharsPerLine;
+  final _SetProfileDart _setProfile;
+  final _SetStoreDart _setStore;
+  final _EncodeDart _encodeReceipt;
+  final _EncodeTextDart _encodeText;
+  final _EncodeRowsDart _encodeRows;
+  final _DataFn _encoderData;
+  final _SizeDart _encoderSize;
+  final _HandleFn _encoderTake;
+  final Pointer<Void> Function(int) _bufferNew;
+  final _DataFn _bufferData;
+  final _SizeDart _bufferSize;
+  final Pointer<NativeFinalizerFunction> _bufferFree;
+  final _DisplayWidthDart _displayWidth;
+  final _RasterizeDart _rasterizeLogo;
+  late final NativeFinalizer _encoderFinalizer;
+  late final NativeFinalizer _bufferFinalizer;
+  late final void Function(Pointer<Void>) _freeEncoder;
+  late final void Function(Pointer<Void>) _freeBuffer;
+  late final _NativeScratch _scratch;
+
+  /// Printer columns [text] takes; wide characters take 2 with a Chinese
+  /// code page and 1 otherwise.
+  int displayWidth(String text, {bool chineseCodePage = true}) {
+    final bytes = utf8.encode(text);
+    return _displayWidth(_scratch.copy(bytes), bytes.length, chineseCodePage ? 2 : 1);
+  }
+
+  /// Decoded RGBA pixels as a centred GS v 0 raster block [printWidth] dots
+  /// wide. [dither] is `threshold`, `ordered` or `floyd_steinberg`. The
+  /// bytes stay in native memory, freed with the returned list.
+  Uint8List rasterizeLogo(
+    Uint8List rgba,
+    int width,
+    int height, {
+    int printWidth = 384,
+    String dither = 'threshold',
+  }) {
+    final mode = const ['threshold', 'ordered', 'floyd_steinberg'].indexOf(dither);
+    if (mode < 0 || rgba.length < width * height * 4) {
+      throw ArgumentError('invalid logo pixels or dither mode');
+    }
+    final pixels = _scratch.copy(rgba);
+    final buffer = _rasterizeLogo(pixels, width, height, width * 4, 0, printWidth, mode);
+    if (buffer == nullptr) throw ArgumentError('invalid logo size');
+    return _adopt(buffer);
+  }
+
+  /// A list over the bytes of [buffer] that frees it when collected.
+  Uint8List _adopt(Pointer<Void> buffer) {
+    final size = _bufferSize(buffer);
+    if (size == 0) {
+      _freeBuffer(buffer);
+      return Uint8List(0);
+    }
+    return _bufferData(buffer).asTypedList(size, finalizer: _bufferFree, token: buffer);
+  }
+}
+
+/// Native memory calls read their input from: one buffer per library,
+/// grown as needed and reused.
+final class _NativeScratch implements Finalizable {
+  _NativeScratch(this._ffi);
+
+  final PrinterCoreFfi _ffi;
+  Pointer<Void> _buffer = nullptr;
+  int _capacity = 0;
+
+  /// [size] bytes of native memory, valid until the next call.
+  Pointer<Uint8> reserve(int size) {
+    if (size > _capacity) {
+      if (_buffer != nullptr) {
+        _ffi._bufferFinalizer.detach(this);
+        _ffi._freeBuffer(_buffer);
+      }
+      _capacity = size < 4096 ? 4096 : size * 2;
+      _buffer = _ffi._bufferNew(_capacity);
+      _ffi._bufferFinalizer.attach(this, _buffer, detach: this);
+    }
+    return _ffi._bufferData(_buffer);
+  }
+
+  Pointer<Uint8> copy(List<int> bytes) {
+    final data = reserve(bytes.length);
+    data.asTypedList(bytes.length).setAll(0, bytes);
+    return data;
+  }
+}
+
+/// One laid-out row for [NativeReceiptEncoder.encodeRows]: [left] wraps,
+/// or is cut when [truncate] is set, and [right] sits on the right margin.
+/// A [divider] character makes the row a full-width line of it.
+class NativeRow {
+  const NativeRow(
+    this.left, [
+    this.right = '',
+    this.align = NativeRowAlign.left,
+    this.truncate = false,
+  ]) : divider = '';
+  const NativeRow.divider([this.divider = '-'])
+    : left = '',
+      right = '',
+      align = NativeRowAlign.left,
+      truncate = false;
+
+  final String left;
+  final String right;
+  final NativeRowAlign align;
+  final bool truncate;
+  final String divider;
+}
+
+enum NativeRowAlign { left, center, right }
+
+/// An EscPosEncoder on the native side. Encodes return a view of the
+/// encoder's own buffer, valid until the next encode, [takeBytes] or
+/// [dispose]; [takeBytes] hands the bytes over to a list that frees them.
+///
+/// Use one encoder per isolate.
+final class NativeReceiptEncoder implements Finalizable {
+  NativeReceiptEncoder(this._ffi, {int charsPerLine = 48})
+    : _handle = _ffi._encoderNew(charsPerLine) {
+    if (_handle == nullptr) throw ArgumentError.value(charsPerLine, 'charsPerLine');
+    _ffi._encoderFinalizer.attach(this, _handle, detach: this);
+  }
+
+  static const Map<String, int> _codePages = {
+    'none': 0,
+    'cp437': 1,
+    'cp858': 2,
+    'cp1252': 3,
+    'gb18030': 4,
+    'big5': 5,
+  };
+
+  final PrinterCoreFfi _ffi;
+  Pointer<Void> _handle;
+
+  set charsPerLine(int columns) => _check(_ffi._setCharsPerLine(_handle, columns));
+
+  /// The receiptData profile fields: whether the printer draws QR codes and
+  /// Code128 itself, its width in dots and its code pages.
+  void setProfile({
+    bool nativeQr = true,
+    bool nativeBarcode = true,
+    int dotsPerLine = 576,
+    String codePage = 'cp437',
+    String chineseCodePage = 'none',
+  }) {
+    final profile = _ffi._scratch.reserve(sizeOf<_PcProfile>()).cast<_PcProfile>();
+    profile.ref
+      ..nativeQr = nativeQr ? 1 : 0
+      ..nativeCode128 = nativeBarcode ? 1 : 0
+      ..dotsPerLine = dotsPerLine
+      ..codePage = _codePages[codePage] ?? -1
+      ..chineseCodePage = _codePages[chineseCodePage] ?? -1;
+    _check(_ffi._setProfile(_handle, profile));
+  }
+
+  /// Store lines printed centred under the title and under the totals.
+  void setStore({List<String> headerLines = const [], List<String> footerLines = const []}) {
+    final header = utf8.encode(headerLines.join('\n'));
+    final footer = utf8.encode(footerLines.join('\n'));
+    final data = _ffi._scratch.copy([...header, ...footer]);
+    final footerData = Pointer<Uint8>.fromAddress(data.address + header.length);
+    _check(_ffi._setStore(_handle, data, header.length, footerData, footer.length));
+  }
+
+  /// Encodes structured receiptData, the fields [ReceiptBlob.encode] takes.
+  Uint8List encodeReceipt(Map<String, dynamic> data) =>
+      encodeReceiptBlob(ReceiptBlob.encode(data));
+
+  /// Encodes a receipt already written by [ReceiptBlob.encode].
+  Uint8List encodeReceiptBlob(Uint8List blob) {
+    _check(_ffi._encodeReceipt(_handle, _ffi._scratch.copy(blob), blob.length));
+    return _output();
+  }
+
+  /// Encodes free-form text: lines with a price marker left aligned, the
+  /// rest centred.
+  Uint8List encodeText(String text, {bool alignBlankLines = true, bool feedBeforeCut = true}) {
+    final bytes = utf8.encode(text);
+    final flags = (alignBlankLines ? 1 : 0) | (feedBeforeCut ? 2 : 0);
+    _check(_ffi._encodeText(_handle, _ffi._scratch.copy(bytes), bytes.length, flags));
+    return _output();
+  }
+
+  /// Encodes rows laid out by display width at the encoder's width.
+  Uint8List encodeRows(List<NativeRow> rows) {
+    final rowSize = sizeOf<_PcRow>();
+    final texts = [
+      for (final row in rows) ...[utf8.encode(row.left), utf8.encode(row.right)],
+    ];
+    final textSize = texts.fold<int>(0, (sum, bytes) => sum + bytes.length);
+    final base = _ffi._scratch.reserve(rows.length * rowSize + textSize);
+    final structs = base.cast<_PcRow>();
+    final memory = base.asTypedList(rows.length * rowSize + textSize);
+    var offset = rows.length * rowSize;
+    Pointer<Uint8> put(Uint8List bytes) {
+      memory.setAll(offset, bytes);
+      final at = Pointer<Uint8>.fromAddress(base.address + offset);
+      offset += bytes.length;
+      return at;
+    }
+
+    for (var i = 0; i < rows.length; i++) {
+      final left = texts[2 * i];
+      final right = texts[2 * i + 1];
+      final divider = rows[i].divider;
+      structs[i]
+        ..left = put(left)
+        ..leftSize = left.length
+        ..right = put(right)
+        ..rightSize = right.length
+        ..align = rows[i].align.index
+        ..truncate = rows[i].truncate ? 1 : 0
+        ..divider = divider.isEmpty ? 0 : divider.codeUnitAt(0)
+        ..reserved = 0;
+    }
+    _check(_ffi._encodeRows(_handle, structs, rows.length));
+    return _output();
+  }
+
+  /// The last encode's bytes, owned by the returned list from now on.
+  Uint8List takeBytes() => _ffi._adopt(_ffi._encoderTake(_handle));
+
+  /// Frees the encoder now instead of when it is collected.
+  void dispose() {
+    if (_handle == nullptr) return;
+    _ffi._encoderFinalizer.detach(this);
+    _ffi._freeEncoder(_handle);
+    _handle = nullptr;
+  }
+
+  Uint8List _output() {
+    final size = _ffi._encoderSize(_handle);
+    if (size == 0) return Uint8List(0);
+    return _ffi._encoderData(_handle).asTypedList(size);
+  }
+
+  static void _check(int status) {
+    if (status == -2) throw const FormatException('malformed receipt blob');
+    if (status != 0) throw ArgumentError('printer_core_ffi rejected the arguments');
+  }
+}
+
+final class _PcProfile extends Struct {
+  @Int32()
+  external int nativeQr;
+  @Int32()
+  external int nativeCode128;
+  @Int32()
+  external int dotsPerLine;
+  @Int32()
+  external int codePage;
+  @Int32()
+  external int chineseCodePage;
+}
+
+final class _PcRow extends Struct {
+  external Pointer<Uint8> left;
+  @Size()
+  external int leftSize;
+  external Pointer<Uint8> right;
+  @Size()
+  external int rightSize;
+  @Int32()
+  external int align;
+  @Int32()
+  external int truncate;
+  @Int32()
+  external int divider;
+  @Int32()
+  external int reserved;
+}
+
+typedef _HandleFn = Pointer<Void> Function(Pointer<Void>);
+typedef _DataFn = Pointer<Uint8> Function(Pointer<Void>);
+typedef _SizeNative = Size Function(Pointer<Void>);
+typedef _SizeDart = int Function(Pointer<Void>);
+typedef _SetIntNative = Int32 Function(Pointer<Void>, Int32);
+typedef _SetIntDart = int Function(Pointer<Void>, int);
+typedef _SetProfileNative = Int32 Function(Pointer<Void>, Pointer<_PcProfile>);
+typedef _SetProfileDart = int Function(Pointer<Void>, Pointer<_PcProfile>);
+typedef _SetStoreNative =
+    Int32 Function(Pointer<Void>, Pointer<Uint8>, Size, Pointer<Uint8>, Size);
+typedef _SetStoreDart = int Function(Pointer<Void>, Pointer<Uint8>, int, Pointer<Uint8>, int);
+typedef _EncodeNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Size);
+typedef _EncodeDart = int Function(Pointer<Void>, Pointer<Uint8>, int);
+typedef _EncodeTextNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Size, Int32);
+typedef _EncodeTextDart = int Function(Pointer<Void>, Pointer<Uint8>, int, int);
+typedef _EncodeRowsNative = Int32 Function(Pointer<Void>, Pointer<_PcRow>, Size);
+typedef _EncodeRowsDart = int Function(Pointer<Void>, Pointer<_PcRow>, int);
+typedef _DisplayWidthNative = Int32 Function(Pointer<Uint8>, Size, Int32);
+typedef _DisplayWidthDart = int Function(Pointer<Uint8>, int, int);
+typedef _RasterizeNative =
+    Pointer<Void> Function(Pointer<Uint8>, Int32, Int32, Size, Int32, Int32, Int32);
+typedef _RasterizeDart = Pointer<Void> Function(Pointer<Uint8>, int, int, int, int, int, int);
@@ -0,0 +1,81 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+/// Structured receipt data as the flat little-endian blob the desktop
+/// runners read (native/printer_core/receipt_blob.h).
+///
+/// Sent as `receiptData['receiptBlob']`, it replaces the nested map of item
+/// maps: the runner reads fixed-size records instead of looking up every
+/// field by name. Runners fall back to the map fields when it is absent.
+///
+/// Pure Dart — no Flutter imports.
+abstract final class ReceiptBlob {
+  static const int version = 1;
+  static const int headerSize = 88;
+  static const int itemSize = 24;
+
+  static const int _titleFlag = 1 << 0;
+  static const int _subtotalFlag = 1 << 1;
+  static const int _taxFlag = 1 << 2;
+  static const int _serviceChargeFlag = 1 << 3;
+  static const int _totalFlag = 1 << 4;
+
+  /// Encodes the fields the runners decode from receiptData: `currency`,
+  /// `title`, `items` (maps of `name`, `quantity`, `price`), `subtotal`,
+  /// `tax`, `serviceCharge`, `total`, `barcode` and `qr_data`.
+  static Uint8List encode(Map<String, dynamic> data) {
+    final items = (data['items'] as List?) ?? const [];
+    final fixed = ByteData(headerSize + items.length * itemSize);
+    final strings = BytesBuilder(copy: false);
+
+    void putString(int offset, Object? value) {
+      final bytes = utf8.encode(value?.toString() ?? '');
+      fixed.setUint32(offset, strings.length, Endian.little);
+      fixed.setUint32(offset + 4, bytes.length, Endian.little);
+      strings.add(bytes);
+    }
+
+    var flags = 0;
+    void putMoney(int flag, int offset, Object? value) {
+      if (value is! num) return;
+      flags |= flag;
+      fixed.setFloat64(offset, value.toDouble(), Endian.little);
+    }
+
+    const magic = [0x45, 0x58, 0x52, 0x42]; // "EXRB"
+    for (var i = 0; i < magic.length; i++) {
+      fixed.setUint8(i, magic[i]);
+    }
+    fixed.setUint16(4, version, Endian.little);
+    fixed.setUint16(6, headerSize, Endian.little);
+    putString(24, data['currency'] ?? 'RM');
+    if (data.containsKey('title')) flags |= _titleFlag;
+    putString(32, data['title']);
+    putString(40, data['barcode']);
+    putString(48, data['qr_data']);
+    putMoney(_subtotalFlag, 56, data['subtotal']);
+    putMoney(_taxFlag, 64, data['tax']);
+    putMoney(_serviceChargeFlag, 72, data['serviceCharge']);
+    putMoney(_totalFlag, 80, data['total']);
+    fixed.setUint32(8, flags, Endian.little);
+    fixed.setUint32(12, items.length, Endian.little);
+    fixed.setUint32(16, itemSize, Endian.little);
+
+    var record = headerSize;
+    for (final item in items) {
+      final map = item is Map ? item : const {};
+      putString(record, map['name']);
+      final quantity = map['quantity'];
+      final price = map['price'];
+      fixed.setInt32(record + 8, quantity is num ? quantity.toInt() : 1, Endian.little);
+      fixed.setFloat64(record + 16, price is num ? price.toDouble() : 0.0, Endian.little);
+      record += itemSize;
+    }
+    fixed.setUint32(20, strings.length, Endian.little);
+
+    return (BytesBuilder(copy: false)
+          ..add(fixed.buffer.asUint8List())
+          ..add(strings.takeBytes()))
+        .takeBytes();
+  }
+}
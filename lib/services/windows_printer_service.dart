@@ -1,10 +1,13 @@
 import 'dart:async';
 import 'dart:developer' as developer;
+import 'dart:typed_data';
 
+import 'package:extropos/models/business_info_model.dart';
 import 'package:extropos/models/printer_model.dart';
 import 'package:extropos/services/database_service.dart';
 import 'package:extropos/services/qr_code_generator.dart';
 import 'package:extropos/services/receipt_generator.dart';
+import 'package:extropos/services/utils/receipt_blob.dart';
 import 'package:flutter/services.dart';
 import 'package:universal_io/io.dart';
 
@@ -18,10 +21,24 @@ class WindowsPrinterService {
   static const MethodChannel _runnerChannel = MethodChannel(
     'com.extrotarget.extropos/printer',
   );
+  // Status changes and job outcomes pushed by the runner plugin
+  static const EventChannel _eventChannel = EventChannel(
+    'com.extrotarget.extropos/printer_events',
+  );
+  // Native log levels as package:logging values for developer.log
+  static const Map<String, int> _logLevelValues = {
+    'DEBUG': 500,
+    'INFO': 800,
+    'WARNING': 900,
+    'ERROR': 1000,
+  };
 
   // Singleton pattern
   static final WindowsPrinterService _instance =
       WindowsPrinterService._internal();
+
+  /// Platforms whose runner serves the printer channel: Windows and Linux.
+  static bool get isSupportedPlatform => Platform.isWindows || Platform.isLinux;
   factory WindowsPrinterService() => _instance;
   WindowsPrinterService._internal();
 
@@ -29,12 +46,37 @@ class WindowsPrinterService {
   MethodChannel? _activeChannel;
   final StreamController<String> _logController = StreamController<String>.broadcast();
   Stream<String> get logStream => _logController.stream;
+  final StreamController<Map<String, dynamic>> _jobController =
+      StreamController<Map<String, dynamic>>.broadcast();
+
+  /// Completions of jobs submitted with `async: true`; each event carries
+  /// `jobId`, `success`, `bytesWritten` and `error`.
+  Stream<Map<String, dynamic>> get jobEvents => _jobController.stream;
+  final StreamController<Printer> _networkFoundController =
+      StreamController<Printer>.broadcast();
+
+  /// Network printers as the runner's subnet scan finds them, ahead of the
+  /// list returned by [discoverNetworkPrinters].
+  Stream<Printer> get networkPrinterFound => _networkFoundController.stream;
+  final StreamController<Map<String, dynamic>> _printerEventController =
+      StreamController<Map<String, dynamic>>.broadcast();
+  StreamSubscription<dynamic>? _eventSubscription;
+  // Last 'status' event per network printer, keyed "ip:port"
+  final Map<String, Map<String, dynamic>> _statusCache = {};
+
+  /// Events pushed by the runner as they happen, each with a `type` and the
+  /// `printer` it concerns ("ip:port" for network printers):
+  /// - `status`: a polled or printed-to network printer went online/offline
+  ///   or changed paper, cover or error state; same fields as
+  ///   [getPrinterStatusDetails] plus `host` and `port`.
+  /// - `jobFinished` / `jobFailed`: `jobId`, `bytesWritten` and `error`.
+  Stream<Map<String, dynamic>> get printerEvents => _printerEventController.stream;
 
   /// Initialize the Windows printer service
   Future<void> initialize() async {
-    if (!Platform.isWindows) {
+    if (!isSupportedPlatform) {
       developer.log(
-        'WindowsPrinterService: Not on Windows platform, skipping initialization',
+        'WindowsPrinterService: No runner printer plugin on this platform, skipping initialization',
       );
       return;
     }
@@ -43,6 +85,20 @@ class WindowsPrinterService {
       return;
     }
 
+    // On Linux net.nfet.printing belongs to the printing package, so talk to
+    // the runner plugin directly.
+    if (Platform.isLinux) {
+      _runnerChannel.setMethodCallHandler(_handleMethodCall);
+      await _runnerChannel.invokeMethod('initialize');
+      _activeChannel = _runnerChannel;
+      _isInitialized = true;
+      _listenForPrinterEvents();
+      try {
+        await _runnerChannel.invokeMethod('setDebugEnabled', {'enabled': true});
+      } catch (_) {}
+      return;
+    }
+
     try {
       // Debug logging: set method handler for primary channel
       developer.log(
@@ -91,6 +147,7 @@ class WindowsPrinterService {
       try {
         await _runnerChannel.invokeMethod('setDebugEnabled', {'enabled': true});
       } catch (_) {}
+      _listenForPrinterEvents();
       developer.log('WindowsPrinterService: Initialized successfully, active channel: ${_activeChannel == _channel ? 'net.nfet.printing' : 'com.extrotarget.extropos/printer'}');
     } catch (e) {
       developer.log('WindowsPrinterService: Failed to initialize: $e');
@@ -100,7 +157,7 @@ class WindowsPrinterService {
 
   /// Discover USB printers on Windows
   Future<List<Printer>> discoverUsbPrinters() async {
-    if (!Platform.isWindows) {
+    if (!isSupportedPlatform) {
       return [];
     }
 
@@ -133,17 +190,20 @@ class WindowsPrinterService {
     }
   }
 
-  /// Discover network printers on Windows
-  Future<List<Printer>> discoverNetworkPrinters() async {
-    if (!Platform.isWindows) {
+  /// Discover network printers by scanning [cidr] (for example
+  /// `192.168.1.0/24`; defaults to the local /24s) on ports 9100, 515 and 631.
+  /// Printers also arrive one by one on [networkPrinterFound].
+  Future<List<Printer>> discoverNetworkPrinters({String? cidr}) async {
+    if (!isSupportedPlatform) {
       return [];
     }
 
+    final args = {if (cidr != null) 'cidr': cidr};
     try {
       await initialize();
       final MethodChannel callChannel = _activeChannel ?? _channel;
       try {
-        final result = await callChannel.invokeMethod('discoverNetworkPrinters');
+        final result = await callChannel.invokeMethod('discoverNetworkPrinters', args);
         final printers = _parsePrintersList(result);
         developer.log(
           'WindowsPrinterService: Discovered ${printers.length} network printers',
@@ -152,7 +212,7 @@ class WindowsPrinterService {
       } catch (e) {
         developer.log('WindowsPrinterService: Primary channel network discovery failed: $e');
         try {
-          final fallback = await _runnerChannel.invokeMethod('discoverNetworkPrinters');
+          final fallback = await _runnerChannel.invokeMethod('discoverNetworkPrinters', args);
           final printers = _parsePrintersList(fallback);
           developer.log('WindowsPrinterService: Runner fallback discovered ${printers.length} network printers');
           return printers;
@@ -169,7 +229,7 @@ class WindowsPrinterService {
 
   /// Discover all local Windows printers
   Future<List<Printer>> discoverLocalPrinters() async {
-    if (!Platform.isWindows) {
+    if (!isSupportedPlatform) {
       return [];
     }
 
@@ -205,7 +265,7 @@ class WindowsPrinterService {
 
   /// Discover all printers on Windows (USB, Network, Local)
   Future<List<Printer>> discoverPrinters() async {
-    if (!Platform.isWindows) return [];
+    if (!isSupportedPlatform) return [];
 
     try {
       final List<Printer> allPrinters = [];
@@ -239,7 +299,7 @@ class WindowsPrinterService {
     Map<String, dynamic> receiptData, {
     ReceiptType receiptType = ReceiptType.customer,
   }) async {
-    if (!Platform.isWindows) return false;
+    if (!isSupportedPlatform) return false;
 
     try {
       // Format the receipt data into text using the receipt generator
@@ -261,6 +321,14 @@ class WindowsPrinterService {
         'content': receiptText,
       };
 
+      // The runner rasterizes the logo itself and caches it per file, width
+      // and dither mode, so only the path crosses the channel.
+      final logo = BusinessInfo.instance.logo;
+      if (settings.showLogo && logo != null && logo.isNotEmpty) {
+        outgoingData['logoPath'] = logo;
+        outgoingData['logoDither'] = 'floyd_steinberg';
+      }
+
       // Generate QR image if e-wallet QR present
       if (receiptData['ewallet_qr'] != null) {
         try {
@@ -283,6 +351,25 @@ class WindowsPrinterService {
         'paperSize': printer.paperSize?.name,
         'receiptData': outgoingData,
       };
+      // The runner plugin encodes the same receipt natively from the flat
+      // blob; the text stays for net.nfet.printing and as the runner's
+      // fallback when the blob cannot be read.
+      final structured = structuredReceiptWithSettings(
+        data: receiptData,
+        settings: settings,
+        receiptType: receiptType,
+      );
+      final runnerPrintData = structured == null
+          ? printData
+          : {
+              ...printData,
+              'receiptData': {
+                ...outgoingData,
+                'receiptBlob': ReceiptBlob.encode(structured),
+                'headerLines': structured['headerLines'],
+                'footerLines': structured['footerLines'],
+              },
+            };
       final connPreviewOrder = printData['connectionDetails'] as Map<String, dynamic>?;
       if (connPreviewOrder != null) {
         developer.log('Windows printOrder connectionDetails: $connPreviewOrder');
@@ -297,7 +384,10 @@ class WindowsPrinterService {
       }
 
       final MethodChannel callChannel = _activeChannel ?? _channel;
-      final result = await callChannel.invokeMethod('printReceipt', printData);
+      final result = await callChannel.invokeMethod(
+        'printReceipt',
+        callChannel == _runnerChannel ? runnerPrintData : printData,
+      );
       if (result == true) return true;
 
       // Fallback: if the chosen plugin failed and we have ip/usb details, try the runner plugin
@@ -306,7 +396,7 @@ class WindowsPrinterService {
         if (conn != null && ((conn['ipAddress'] != null && (conn['ipAddress'] as String).isNotEmpty) || (conn['usbDeviceId'] != null && (conn['usbDeviceId'] as String).isNotEmpty))) {
           developer.log('Windows printReceipt: primary plugin failed, trying runner channel fallback');
           _logController.add('[Windows] printReceipt: primary plugin printing failed, invoking runner fallback');
-          final fallbackResult = await _runnerChannel.invokeMethod('printReceipt', printData);
+          final fallbackResult = await _runnerChannel.invokeMethod('printReceipt', runnerPrintData);
           developer.log('Windows printReceipt: runner fallback result: $fallbackResult');
           if (fallbackResult == true) return true;
         }
@@ -325,7 +415,7 @@ class WindowsPrinterService {
     Printer printer,
     Map<String, dynamic> orderData,
   ) async {
-    if (!Platform.isWindows) return false;
+    if (!isSupportedPlatform) return false;
 
     try {
       final printData = {
@@ -359,9 +449,33 @@ class WindowsPrinterService {
     }
   }
 
+  /// Sends complete ESC/POS bytes (for example from
+  /// `ThermalReceiptGenerator.generateReceipt`) to the printer exactly as
+  /// given. They cross the runner channel as one Uint8List and are queued
+  /// without being re-split, re-aligned or optimized.
+  Future<bool> printRaw(Printer printer, List<int> bytes) async {
+    if (!isSupportedPlatform) return false;
+
+    try {
+      final rawData = {
+        'printerId': printer.id,
+        'printerType': printer.connectionType.name,
+        'connectionDetails': _buildConnectionDetails(printer),
+        'paperSize': printer.paperSize?.name,
+        'data': bytes is Uint8List ? bytes : Uint8List.fromList(bytes),
+      };
+      // Only the runner plugin implements printRaw
+      final result = await _runnerChannel.invokeMethod('printRaw', rawData);
+      return result == true;
+    } catch (e) {
+      developer.log('Windows printRaw error: $e');
+      return false;
+    }
+  }
+
   /// Test print using Windows printer
   Future<bool> testPrint(Printer printer) async {
-    if (!Platform.isWindows) return false;
+    if (!isSupportedPlatform) return false;
 
     try {
       final testData = {
@@ -404,7 +518,7 @@ class WindowsPrinterService {
   Future<Map<String, dynamic>?> getPrinterCapabilities(
     String printerName,
   ) async {
-    if (!Platform.isWindows) {
+    if (!isSupportedPlatform) {
       return null;
     }
 
@@ -468,6 +582,21 @@ class WindowsPrinterService {
           )
         : ThermalPaperSize.mm80;
 
+    if (data['connectionType'] == 'network' && data['ipAddress'] != null) {
+      return Printer.network(
+        id: data['id'] ?? 'net_${data['ipAddress']}',
+        name: data['name'] ?? 'Network Printer',
+        type: type,
+        ipAddress: data['ipAddress'] as String,
+        port: data['port'] as int? ?? 9100,
+        status: data['status'] == 'online'
+            ? PrinterStatus.online
+            : PrinterStatus.offline,
+        modelName: data['modelName'],
+        paperSize: paperSize,
+      );
+    }
+
     // For Windows, most printers are accessed via POSMAC or direct Windows printing
     return Printer.posmac(
       id: data['id'] ?? 'win_printer_${DateTime.now().millisecondsSinceEpoch}',
@@ -505,6 +634,32 @@ class WindowsPrinterService {
     return details;
   }
 
+  void _listenForPrinterEvents() {
+    _eventSubscription ??= _eventChannel.receiveBroadcastStream().listen(
+      _handlePrinterEvent,
+      onError: (Object e) {
+        developer.log('WindowsPrinterService: printer event stream error: $e');
+      },
+    );
+  }
+
+  void _handlePrinterEvent(dynamic raw) {
+    if (raw is! Map) return;
+    final event = Map<String, dynamic>.from(raw);
+    final printer = event['printer'] as String?;
+    if (event['type'] == 'status' && printer != null) {
+      _statusCache[printer] = event;
+      developer.log('WindowsPrinterService: Printer $printer is ${event['status']}');
+    }
+    _printerEventController.add(event);
+  }
+
+  // Latest pushed status of a network printer, or null before the first event
+  Map<String, dynamic>? _cachedStatus(String? host, int? port) {
+    if (host == null || host.isEmpty) return null;
+    return _statusCache['$host:${port ?? 9100}'];
+  }
+
   /// Handle method calls from native Windows code
   Future<dynamic> _handleMethodCall(MethodCall call) async {
     switch (call.method) {
@@ -515,6 +670,33 @@ class WindowsPrinterService {
           _logController.add('[Windows] $message');
         }
         break;
+      case 'printerLogBatch':
+        // Native logs arrive batched a few times a second, oldest first
+        final entries = call.arguments['entries'] as List? ?? const [];
+        for (final entry in entries) {
+          final map = entry as Map;
+          final line = '${map['category']}: ${map['message']}';
+          developer.log(
+            'WindowsPrinterService: $line',
+            time: DateTime.fromMicrosecondsSinceEpoch(map['time'] as int),
+            level: _logLevelValues[map['level']] ?? 800,
+          );
+          _logController.add('[Windows] $line');
+        }
+        break;
+      case 'printJobCompleted':
+        final event = Map<String, dynamic>.from(call.arguments as Map);
+        developer.log(
+          'WindowsPrinterService: job ${event['jobId']} finished, success=${event['success']}',
+        );
+        _jobController.add(event);
+        break;
+      case 'networkPrinterFound':
+        final printer = _parsePrinterFromMap(
+          Map<String, dynamic>.from(call.arguments as Map),
+        );
+        _networkFoundController.add(printer);
+        break;
       case 'printerStatusChanged':
         final printerName = call.arguments['printerName'] as String?;
         final status = call.arguments['status'] as String?;
@@ -531,11 +713,124 @@ class WindowsPrinterService {
     }
   }
 
+  /// Print several already-formatted receipts or tickets in one call, e.g.
+  /// merchant and customer copies or end-of-shift summaries. Each job is a
+  /// printer, the same `receiptData` map printReceipt sends (`content` text
+  /// and/or structured `items`) and an optional `priority` (drawer, receipt,
+  /// kitchen, report). Jobs for the same
+  /// printer share one connection. Returns one result map per job, in order,
+  /// with jobId, success, bytesWritten and error.
+  Future<List<Map<String, dynamic>>> printBatch(
+    List<({Printer printer, Map<String, dynamic> receiptData, String? priority})> jobs,
+  ) async {
+    if (!isSupportedPlatform || jobs.isEmpty) return const [];
+    try {
+      await initialize();
+      final payload = [
+        for (final job in jobs)
+          {
+            'printerId': job.printer.id,
+            'printerType': job.printer.connectionType.name,
+            'connectionDetails': _buildConnectionDetails(job.printer),
+            'paperSize': job.printer.paperSize?.name,
+            'receiptData': job.receiptData,
+            if (job.priority != null) 'priority': job.priority,
+          },
+      ];
+      final result = await _runnerChannel.invokeMethod('printBatch', {'jobs': payload});
+      if (result is List) {
+        return [for (final r in result) Map<String, dynamic>.from(r as Map)];
+      }
+    } catch (e) {
+      developer.log('WindowsPrinterService: printBatch failed: $e');
+      _logController.add('[Windows] printBatch failed: $e');
+    }
+    return [
+      for (var i = 0; i < jobs.length; i++)
+        {'jobId': 0, 'success': false, 'bytesWritten': 0, 'error': 'printBatch unavailable'},
+    ];
+  }
+
+  /// Kick the cash drawer attached to [printer]. Runs ahead of any queued
+  /// receipts, tickets or reports on that printer.
+  Future<bool> openCashDrawer(Printer printer, {int pin = 2}) async {
+    if (!isSupportedPlatform) return false;
+    try {
+      await initialize();
+      final result = await _runnerChannel.invokeMethod('openCashDrawer', {
+        'printerType': printer.connectionType.name,
+        'connectionDetails': _buildConnectionDetails(printer),
+        'pin': pin,
+      });
+      return result == true;
+    } catch (e) {
+      developer.log('WindowsPrinterService: openCashDrawer failed: $e');
+      return false;
+    }
+  }
+
+  /// Print queue depth and wait times per priority class (drawer, receipt,
+  /// kitchen, report), each a map of depth, started, avgWaitUs, maxWaitUs and
+  /// preemptions.
+  Future<Map<String, Map<String, int>>> getPrintQueueStats() async {
+    if (!isSupportedPlatform) return const {};
+    try {
+      await initialize();
+      final result = await _runnerChannel.invokeMethod('getPrintQueueStats');
+      if (result is Map) {
+        return result.map((k, v) => MapEntry(
+              k.toString(),
+              (v as Map).map((f, n) => MapEntry(f.toString(), (n as num).toInt())),
+            ));
+      }
+    } catch (e) {
+      developer.log('WindowsPrinterService: getPrintQueueStats failed: $e');
+    }
+    return const {};
+  }
+
+  /// Network connection pool counters (hits, misses, reconnects, reaped,
+  /// healthFailures, idle) from the runner plugin; empty if unavailable.
+  Future<Map<String, int>> getConnectionPoolStats() async {
+    if (!isSupportedPlatform) return const {};
+    try {
+      await initialize();
+      final result = await _runnerChannel.invokeMethod('getConnectionPoolStats');
+      if (result is Map) {
+        return result.map((k, v) => MapEntry(k.toString(), (v as num).toInt()));
+      }
+    } catch (e) {
+      developer.log('WindowsPrinterService: getConnectionPoolStats failed: $e');
+    }
+    return const {};
+  }
+
+  /// Chrome trace event JSON of a print job's timeline (the `traceId` of its
+  /// printJobCompleted result), or of every job the runner still holds when
+  /// [traceId] is null. Open it in chrome://tracing or Perfetto.
+  Future<String?> exportPrintTrace({int? traceId}) async {
+    if (!isSupportedPlatform) return null;
+    try {
+      await initialize();
+      final result = await _runnerChannel.invokeMethod('exportPrintTrace', {
+        if (traceId != null) 'traceId': traceId,
+      });
+      if (result is String) return result;
+    } catch (e) {
+      developer.log('WindowsPrinterService: exportPrintTrace failed: $e');
+    }
+    return null;
+  }
+
   /// Check printer status for a saved printer via the plugin
   Future<String> checkPrinterStatus(Printer printer) async {
-    if (!Platform.isWindows) return 'unsupported';
+    if (!isSupportedPlatform) return 'unsupported';
     try {
       await initialize();
+      if (printer.connectionType == PrinterConnectionType.network) {
+        final cached = _cachedStatus(printer.ipAddress, printer.port);
+        if (cached != null) return cached['status'] as String? ?? 'unknown';
+      }
       final args = {
         'printerId': printer.id,
         'printerType': printer.connectionType.name,
@@ -563,14 +858,75 @@ class WindowsPrinterService {
     }
   }
 
-  /// Check if a printer is available/online
+  /// Cached status of a network printer from the runner's background poller:
+  /// `status` (online, offline, paper_near_end, paper_out, cover_open, error
+  /// or unknown), the `coverOpen`/`paperNearEnd`/`paperOut`/`error` flags
+  /// and `ageMs`. Answers without touching the network.
+  Future<Map<String, dynamic>> getPrinterStatusDetails(Printer printer) async {
+    if (!isSupportedPlatform) return const {};
+    try {
+      await initialize();
+      final cached = _cachedStatus(printer.ipAddress, printer.port);
+      if (printer.connectionType == PrinterConnectionType.network && cached != null) {
+        return cached;
+      }
+      final result = await _runnerChannel.invokeMethod('getPrinterStatus', {
+        'printerType': printer.connectionType.name,
+        'connectionDetails': _buildConnectionDetails(printer),
+      });
+      return result is Map ? Map<String, dynamic>.from(result) : const {};
+    } catch (e) {
+      developer.log('WindowsPrinterService: getPrinterStatus failed: $e');
+      return const {};
+    }
+  }
+
+  /// Keep [printer] polled so its `status` events keep arriving on
+  /// [printerEvents] while nothing prints to it, until [unwatchPrinter].
+  /// Network printers only.
+  Future<bool> watchPrinter(Printer printer) => _setWatched(printer, true);
+
+  Future<bool> unwatchPrinter(Printer printer) => _setWatched(printer, false);
+
+  Future<bool> _setWatched(Printer printer, bool watch) async {
+    if (!isSupportedPlatform || printer.connectionType != PrinterConnectionType.network) {
+      return false;
+    }
+    try {
+      await initialize();
+      final result = await _runnerChannel.invokeMethod(
+        watch ? 'watchPrinterStatus' : 'unwatchPrinterStatus',
+        {
+          'printerType': printer.connectionType.name,
+          'connectionDetails': _buildConnectionDetails(printer),
+        },
+      );
+      return result == true;
+    } catch (e) {
+      developer.log('WindowsPrinterService: watchPrinterStatus failed: $e');
+      return false;
+    }
+  }
+
+  /// Check if a printer is available/online. Network printers named "ip" or
+  /// "ip:port" are answered from [printerEvents] once one has arrived.
   Future<bool> isPrinterOnline(String printerName) async {
-    if (!Platform.isWindows) {
+    if (!isSupportedPlatform) {
       return false;
     }
 
     try {
       await initialize();
+      final separator = printerName.lastIndexOf(':');
+      final cached = separator < 0
+          ? _cachedStatus(printerName, null)
+          : _cachedStatus(
+              printerName.substring(0, separator),
+              int.tryParse(printerName.substring(separator + 1)),
+            );
+      if (cached != null) {
+        return cached['reachable'] == true && cached['offline'] != true;
+      }
       final MethodChannel callChannel = _activeChannel ?? _channel;
       try {
         final result = await callChannel.invokeMethod('isPrinterOnline', {
@@ -0,0 +1,1417 @@
+#include "printer_plugin.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_CUPS
+#include <cups/cups.h>
+#endif
+
+#include "connection_pool.h"
+#include "device_discovery.h"
+#include "escpos_encoder.h"
+#include "escpos_optimizer.h"
+#include "job_trace.h"
+#include "logger.h"
+#include "logo_raster.h"
+#include "network_scanner.h"
+#include "nv_logo.h"
+#include "print_job_queue.h"
+#include "print_spool.h"
+#include "receipt_blob.h"
+#include "status_monitor.h"
+
+namespace {
+
+constexpr char kChannelName[] = "com.extrotarget.extropos/printer";
+constexpr char kEventChannelName[] = "com.extrotarget.extropos/printer_events";
+// platformSpecificId prefix for printers reached through a CUPS raw queue
+constexpr char kCupsPrefix[] = "cups:";
+
+// C++ state behind the GObject; owned by the plugin instance.
+struct PluginState {
+  // First in, so it is destroyed last and everything below can still log
+  std::unique_ptr<printer_core::Logger> logger;
+  printer_core::ConnectionPool pool;
+  // Background DLE EOT / GS a poller over pooled connections; status calls
+  // read its cache
+  std::unique_ptr<printer_core::StatusMonitor> monitor;
+  // Which printers keep the logo in NV memory and which version they hold;
+  // job callbacks report uploads to it, so it outlives the queue.
+  std::unique_ptr<printer_core::NvLogoStore> nv_logos;
+  // Journal of jobs not yet printed, replayed after a crash or power cut;
+  // null if it could not be opened. Outlives the queue's workers.
+  std::unique_ptr<printer_core::PrintSpool> spool;
+  // Per-job span timelines; the queue's workers record into it, so it
+  // outlives the queue.
+  std::unique_ptr<printer_core::JobTracer> tracer;
+  std::unique_ptr<printer_core::PrintJobQueue> queue;
+  printer_core::EscPosEncoder encoder;
+  printer_core::ReceiptDocument receipt_doc;
+  std::vector<printer_core::ReceiptRow> receipt_rows;
+  // Rasterized receipt logos, so only the first receipt pays for decoding
+  printer_core::LogoCache logos;
+  bool network_online = false;
+  bool debug_enabled = false;
+  // One network scan at a time; scan_running is only touched on the main loop
+  std::thread scan_thread;
+  std::atomic<bool> scan_cancel{false};
+  bool scan_running = false;
+};
+
+#ifdef HAVE_CUPS
+// Streams a job into a CUPS queue as a single raw document, so the queue's
+// driver passes the ESC/POS bytes through untouched.
+class CupsTransport : public printer_core::PrinterTransport {
+ public:
+  CupsTransport(std::string queue, int job_id)
+      : queue_(std::move(queue)), job_id_(job_id) {}
+
+  ~CupsTransport() override {
+    if (cupsFinishDocument(CUPS_HTTP_DEFAULT, queue_.c_str()) != IPP_STATUS_OK) {
+      g_warning("CUPS job %d on %s failed: %s", job_id_, queue_.c_str(),
+                cupsLastErrorString());
+    }
+  }
+
+  static std::unique_ptr<printer_core::PrinterTransport> Open(
+      const std::string& queue, std::string* error) {
+    const int job_id = cupsCreateJob(CUPS_HTTP_DEFAULT, queue.c_str(),
+                                     "ExtroPOS receipt", 0, nullptr);
+    if (job_id == 0 ||
+        cupsStartDocument(CUPS_HTTP_DEFAULT, queue.c_str(), job_id, "receipt",
+                          CUPS_FORMAT_RAW, 1) != HTTP_STATUS_CONTINUE) {
+      if (error) *error = std::string("CUPS: ") + cupsLastErrorString();
+      return nullptr;
+    }
+    return std::make_unique<CupsTransport>(queue, job_id);
+  }
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    if (cupsWriteRequestData(CUPS_HTTP_DEFAULT,
+                             reinterpret_cast<const char*>(data),
+                             size) != HTTP_STATUS_CONTINUE) {
+      if (error) *error = std::string("CUPS: ") + cupsLastErrorString();
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  std::string queue_;
+  int job_id_;
+};
+#endif
+
+// Reply shape for a finished job.
+enum class ReplyKind {
+  // bool success (printReceipt, printOrder, testPrint, openCashDrawer)
+  kBool,
+  // "online"/"offline" (checkPrinterStatus)
+  kStatus,
+  // Already answered with the job id; report via printJobCompleted
+  kEvent,
+};
+
+}  // namespace
+
+struct _PrinterPlugin {
+  GObject parent_instance;
+  FlMethodChannel* channel;
+  // Status changes and job outcomes; sent only while Dart listens
+  FlEventChannel* event_channel;
+  gboolean listening;
+  PluginState* state;
+};
+
+G_DEFINE_TYPE(PrinterPlugin, printer_plugin, g_object_get_type())
+
+namespace {
+
+// --- FlValue helpers ---
+
+FlValue* Lookup(FlValue* map, const char* key) {
+  if (map == nullptr || fl_value_get_type(map) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  return fl_value_lookup_string(map, key);
+}
+
+const gchar* LookupString(FlValue* map, const char* key) {
+  FlValue* value = Lookup(map, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_STRING
+             ? fl_value_get_string(value)
+             : nullptr;
+}
+
+FlValue* LookupMap(FlValue* map, const char* key) {
+  FlValue* value = Lookup(map, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_MAP
+             ? value
+             : nullptr;
+}
+
+bool LookupInt(FlValue* map, const char* key, int64_t* out) {
+  FlValue* value = Lookup(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return false;
+  }
+  *out = fl_value_get_int(value);
+  return true;
+}
+
+bool LookupBool(FlValue* map, const char* key) {
+  FlValue* value = Lookup(map, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_BOOL &&
+         fl_value_get_bool(value);
+}
+
+double ToDouble(FlValue* value) {
+  if (value == nullptr) return 0.0;
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_FLOAT:
+      return fl_value_get_float(value);
+    case FL_VALUE_TYPE_INT:
+      return static_cast<double>(fl_value_get_int(value));
+    default:
+      return 0.0;
+  }
+}
+
+void SetInt(FlValue* map, const char* key, int64_t value) {
+  fl_value_set_string_take(map, key, fl_value_new_int(value));
+}
+
+// Explicit "charsPerLine" (32, 42, 48 or 64), else approximate chars per line
+// from paper size if available (default 48)
+int CharsPerLine(FlValue* args) {
+  int64_t columns = 0;
+  if (LookupInt(args, "charsPerLine", &columns) &&
+      (columns == 32 || columns == 42 || columns == 48 || columns == 64)) {
+    return static_cast<int>(columns);
+  }
+  const gchar* paper_size = LookupString(args, "paperSize");
+  if (paper_size != nullptr && strcmp(paper_size, "mm58") == 0) return 32;
+  return 48;
+}
+
+// Optional "priority" argument: drawer, receipt, kitchen or report.
+printer_core::JobPriority Priority(FlValue* args,
+                                   printer_core::JobPriority fallback) {
+  const gchar* name = LookupString(args, "priority");
+  if (name == nullptr) return fallback;
+  if (strcmp(name, "drawer") == 0 || strcmp(name, "beeper") == 0) {
+    return printer_core::JobPriority::kDrawer;
+  }
+  if (strcmp(name, "receipt") == 0) return printer_core::JobPriority::kReceipt;
+  if (strcmp(name, "kitchen") == 0) return printer_core::JobPriority::kKitchen;
+  if (strcmp(name, "report") == 0) return printer_core::JobPriority::kReport;
+  return fallback;
+}
+
+// Decode the receipt map into |doc|. String fields point into |map|, so the
+// document is only valid while the method call arguments are alive.
+void DecodeReceiptDocument(FlValue* map, printer_core::ReceiptDocument* doc) {
+  *doc = printer_core::ReceiptDocument();
+  if (const gchar* currency = LookupString(map, "currency")) {
+    doc->currency = currency;
+  }
+  if (Lookup(map, "title") != nullptr) {
+    const gchar* title = LookupString(map, "title");
+    doc->title = title != nullptr ? std::string_view(title) : std::string_view();
+  }
+  FlValue* items = Lookup(map, "items");
+  if (items != nullptr && fl_value_get_type(items) == FL_VALUE_TYPE_LIST) {
+    const size_t count = fl_value_get_length(items);
+    doc->items.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      FlValue* entry = fl_value_get_list_value(items, i);
+      if (fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) continue;
+      printer_core::ReceiptItem item;
+      if (const gchar* name = LookupString(entry, "name")) item.name = name;
+      if (FlValue* quantity = Lookup(entry, "quantity")) {
+        item.quantity = static_cast<int>(ToDouble(quantity));
+      }
+      if (FlValue* price = Lookup(entry, "price")) item.price = ToDouble(price);
+      doc->items.push_back(item);
+    }
+  }
+  if (FlValue* v = Lookup(map, "subtotal")) doc->subtotal = ToDouble(v);
+  if (FlValue* v = Lookup(map, "tax")) doc->tax = ToDouble(v);
+  if (FlValue* v = Lookup(map, "serviceCharge")) doc->service_charge = ToDouble(v);
+  if (FlValue* v = Lookup(map, "total")) doc->total = ToDouble(v);
+  if (const gchar* barcode = LookupString(map, "barcode")) doc->barcode = barcode;
+  if (const gchar* qr = LookupString(map, "qr_data")) doc->qr_data = qr;
+}
+
+// Reads receiptData "receiptBlob" (see receipt_blob.h) into |doc|; false if
+// it is absent or malformed, in which case the map fields apply.
+bool DecodeReceiptBlob(FlValue* map, printer_core::ReceiptDocument* doc) {
+  FlValue* blob = Lookup(map, "receiptBlob");
+  if (blob == nullptr || fl_value_get_type(blob) != FL_VALUE_TYPE_UINT8_LIST) return false;
+  return printer_core::ReadReceiptBlob(fl_value_get_uint8_list(blob), fl_value_get_length(blob),
+                                       doc);
+}
+
+// Rows laid out natively by display width: maps with "left", "right",
+// "align" ("left", "center" or "right"), "truncate" and "divider" (a
+// one-character string).
+void DecodeReceiptRows(FlValue* list, std::vector<printer_core::ReceiptRow>* rows) {
+  rows->clear();
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) return;
+  const size_t count = fl_value_get_length(list);
+  rows->reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) continue;
+    printer_core::ReceiptRow row;
+    if (const gchar* left = LookupString(entry, "left")) row.left = left;
+    if (const gchar* right = LookupString(entry, "right")) row.right = right;
+    if (const gchar* align = LookupString(entry, "align")) {
+      if (strcmp(align, "center") == 0) row.align = printer_core::RowAlign::kCenter;
+      if (strcmp(align, "right") == 0) row.align = printer_core::RowAlign::kRight;
+    }
+    row.truncate = LookupBool(entry, "truncate");
+    if (const gchar* divider = LookupString(entry, "divider")) row.divider = divider[0];
+    rows->push_back(row);
+  }
+}
+
+// What the printer prints natively, from receiptData "nativeQr" and
+// "nativeBarcode" (both true when absent). Printers that ignore GS ( k or
+// GS k get the symbol as raster instead.
+printer_core::PrinterProfile DecodePrinterProfile(FlValue* map, int chars_per_line) {
+  printer_core::PrinterProfile profile;
+  if (Lookup(map, "nativeQr") != nullptr) profile.native_qr = LookupBool(map, "nativeQr");
+  if (Lookup(map, "nativeBarcode") != nullptr) {
+    profile.native_code128 = LookupBool(map, "nativeBarcode");
+  }
+  profile.dots_per_line = chars_per_line >= 42 ? 576 : 384;
+  // Unknown names keep the default (CP437, no Chinese encoding).
+  const gchar* code_page = LookupString(map, "codePage");
+  if (code_page != nullptr) printer_core::ParseCodePage(code_page, &profile.code_page);
+  const gchar* chinese = LookupString(map, "chineseCodePage");
+  if (chinese != nullptr) printer_core::ParseCodePage(chinese, &profile.chinese_code_page);
+  return profile;
+}
+
+// Store lines from receiptData "headerLines" and "footerLines" (lists of
+// strings, empty when absent). The encoder only recompiles its receipt
+// template when they change.
+printer_core::StoreSettings DecodeStoreSettings(FlValue* map) {
+  printer_core::StoreSettings store;
+  auto lines = [map](const char* key, std::vector<std::string>* out) {
+    FlValue* list = Lookup(map, key);
+    if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) return;
+    for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+      FlValue* line = fl_value_get_list_value(list, i);
+      if (fl_value_get_type(line) == FL_VALUE_TYPE_STRING) {
+        out->push_back(fl_value_get_string(line));
+      }
+    }
+  };
+  lines("headerLines", &store.header_lines);
+  lines("footerLines", &store.footer_lines);
+  return store;
+}
+
+// --- Logging ---
+
+// Queues |message| for the next log batch; callable from any thread and never
+// waits.
+void PostLog(PrinterPlugin* self, const std::string& tag, const std::string& message,
+             printer_core::LogLevel level = printer_core::LogLevel::kInfo) {
+  if (self->state == nullptr) return;
+  self->state->logger->Log(level, tag, message);
+}
+
+// A batch of log lines built on the flusher thread, waiting to go out as one
+// printerLogBatch call
+struct PluginLogBatch {
+  PrinterPlugin* self;
+  FlValue* args;
+
+  ~PluginLogBatch() {
+    fl_value_unref(args);
+    g_object_unref(self);
+  }
+};
+
+gboolean DeliverLogBatch(gpointer data) {
+  PluginLogBatch* pending = static_cast<PluginLogBatch*>(data);
+  PrinterPlugin* self = pending->self;
+  if (self->channel == nullptr) return G_SOURCE_REMOVE;
+  fl_method_channel_invoke_method(self->channel, "printerLogBatch", pending->args, nullptr,
+                                  nullptr, nullptr);
+  return G_SOURCE_REMOVE;
+}
+
+void FreeLogBatch(gpointer data) { delete static_cast<PluginLogBatch*>(data); }
+
+// {"entries": [{"time": us since the epoch, "level", "category", "message"}]}
+FlValue* LogBatchToMap(const std::vector<printer_core::LogEntry>& batch) {
+  FlValue* entries = fl_value_new_list();
+  for (const printer_core::LogEntry& entry : batch) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "time", fl_value_new_int(entry.time_us));
+    fl_value_set_string_take(map, "level",
+                             fl_value_new_string(printer_core::LogLevelName(entry.level)));
+    fl_value_set_string_take(map, "category", fl_value_new_string(entry.category.c_str()));
+    fl_value_set_string_take(map, "message", fl_value_new_string(entry.message.c_str()));
+    fl_value_append_take(entries, map);
+  }
+  FlValue* args = fl_value_new_map();
+  fl_value_set_string_take(args, "entries", entries);
+  return args;
+}
+
+// --- Events ---
+
+// An event built off the main loop, waiting to go out on event_channel
+struct PluginEvent {
+  PrinterPlugin* self;
+  FlValue* event;
+
+  ~PluginEvent() {
+    fl_value_unref(event);
+    g_object_unref(self);
+  }
+};
+
+gboolean DeliverEvent(gpointer data) {
+  PluginEvent* pending = static_cast<PluginEvent*>(data);
+  PrinterPlugin* self = pending->self;
+  if (self->event_channel == nullptr || !self->listening) return G_SOURCE_REMOVE;
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(self->event_channel, pending->event, nullptr, &error)) {
+    g_warning("Failed to send printer event: %s", error->message);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+void FreeEvent(gpointer data) { delete static_cast<PluginEvent*>(data); }
+
+// Sends |event| (taking ownership) on the main loop; callable from any thread.
+void PostEvent(PrinterPlugin* self, FlValue* event) {
+  g_main_context_invoke_full(
+      nullptr, G_PRIORITY_DEFAULT, DeliverEvent,
+      new PluginEvent{EXTROPOS_PRINTER_PLUGIN(g_object_ref(self)), event}, FreeEvent);
+}
+
+FlMethodErrorResponse* ListenCb(FlEventChannel* channel, FlValue* args,
+                                gpointer user_data) {
+  EXTROPOS_PRINTER_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+FlMethodErrorResponse* CancelCb(FlEventChannel* channel, FlValue* args,
+                                gpointer user_data) {
+  EXTROPOS_PRINTER_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+// --- Targets and transports ---
+
+// Reads printerType/connectionDetails. Network printers go over TCP; USB and
+// POSMAC printers use a CUPS queue ("cups:<queue>"), an explicit device path,
+// or the first /dev/usb/lp* node.
+bool ResolveTarget(FlValue* args, printer_core::PrinterTarget* target,
+                   std::string* tag) {
+  const gchar* printer_type = LookupString(args, "printerType");
+  FlValue* details = LookupMap(args, "connectionDetails");
+  if (printer_type == nullptr || details == nullptr) return false;
+
+  if (strcmp(printer_type, "network") == 0) {
+    const gchar* ip = LookupString(details, "ipAddress");
+    int64_t port = 0;
+    if (ip == nullptr || ip[0] == '\0' || !LookupInt(details, "port", &port) ||
+        port <= 0 || port > 65535) {
+      return false;
+    }
+    *target = printer_core::PrinterTarget::Network(ip, static_cast<uint16_t>(port));
+    *tag = "NETWORK";
+    return true;
+  }
+
+  if (strcmp(printer_type, "usb") == 0 || strcmp(printer_type, "posmac") == 0) {
+    const gchar* platform_id = LookupString(details, "platformSpecificId");
+    if (platform_id != nullptr && g_str_has_prefix(platform_id, kCupsPrefix)) {
+      *target = printer_core::PrinterTarget::Custom(platform_id);
+      *tag = "CUPS";
+      return true;
+    }
+    std::string device;
+    for (const char* key : {"usbDeviceId", "platformSpecificId"}) {
+      const gchar* id = LookupString(details, key);
+      if (id != nullptr && id[0] == '/') {
+        device = id;
+        break;
+      }
+    }
+    if (device.empty()) {
+      const std::vector<std::string> devices = printer_core::ListLinePrinterDevices();
+      if (devices.empty()) return false;
+      device = devices.front();
+    }
+    *target = printer_core::PrinterTarget::Device(device);
+    *tag = "USB";
+    return true;
+  }
+  return false;
+}
+
+std::unique_ptr<printer_core::PrinterTransport> OpenTransport(
+    PluginState* state, const printer_core::PrinterTarget& target,
+    std::string* error) {
+  if (target.kind == printer_core::PrinterTarget::Kind::kCustom &&
+      g_str_has_prefix(target.device.c_str(), kCupsPrefix)) {
+#ifdef HAVE_CUPS
+    return CupsTransport::Open(target.device.substr(strlen(kCupsPrefix)), error);
+#else
+    if (error) *error = "built without CUPS support";
+    return nullptr;
+#endif
+  }
+  return state->pool.Acquire(target, error);
+}
+
+// --- Job submission ---
+
+// Holds references for a call whose reply waits on a worker; released on
+// whichever thread drops the last copy.
+struct PendingReply {
+  PrinterPlugin* self;
+  FlMethodCall* call;  // null for kEvent replies
+  ReplyKind kind;
+  std::string tag;
+  // Target key, for job events
+  std::string printer;
+  bool network;
+
+  ~PendingReply() {
+    if (call != nullptr) g_object_unref(call);
+    g_object_unref(self);
+  }
+};
+
+struct Completion {
+  std::shared_ptr<PendingReply> reply;
+  printer_core::PrintJobResult result;
+  // TraceNow() on the worker, for the span of the hop to the main loop
+  int64_t posted_us;
+};
+
+FlValue* JobResultToMap(const printer_core::PrintJobResult& r) {
+  FlValue* map = fl_value_new_map();
+  SetInt(map, "jobId", static_cast<int64_t>(r.job_id));
+  fl_value_set_string_take(map, "success", fl_value_new_bool(r.success));
+  SetInt(map, "bytesWritten", static_cast<int64_t>(r.bytes_written));
+  fl_value_set_string_take(map, "error", fl_value_new_string(r.error.c_str()));
+  // For exportPrintTrace
+  if (r.trace_id != 0) SetInt(map, "traceId", static_cast<int64_t>(r.trace_id));
+  return map;
+}
+
+// Runs on the main loop; the only place job results touch Flutter.
+gboolean DeliverCompletion(gpointer data) {
+  Completion* completion = static_cast<Completion*>(data);
+  PendingReply* reply = completion->reply.get();
+  const printer_core::PrintJobResult& r = completion->result;
+  PrinterPlugin* self = reply->self;
+  printer_core::JobTracer* tracer = self->state->tracer.get();
+  tracer->Record(r.trace_id, "deliver", completion->posted_us, printer_core::TraceNow());
+
+  if (reply->network) self->state->network_online = r.success;
+  if (r.success) {
+    PostLog(self, reply->tag, "Job " + std::to_string(r.job_id) +
+                                  " printed, bytes: " +
+                                  std::to_string(r.bytes_written));
+  } else {
+    PostLog(self, reply->tag, "Job " + std::to_string(r.job_id) + " failed: " + r.error,
+            printer_core::LogLevel::kError);
+  }
+  FlValue* job_event = JobResultToMap(r);
+  fl_value_set_string_take(job_event, "type",
+                           fl_value_new_string(r.success ? "jobFinished" : "jobFailed"));
+  fl_value_set_string_take(job_event, "printer", fl_value_new_string(reply->printer.c_str()));
+  PostEvent(self, job_event);
+
+  if (reply->kind == ReplyKind::kEvent) {
+    g_autoptr(FlValue) event = JobResultToMap(r);
+    fl_method_channel_invoke_method(self->channel, "printJobCompleted", event,
+                                    nullptr, nullptr, nullptr);
+  } else {
+    g_autoptr(FlValue) value =
+        reply->kind == ReplyKind::kStatus
+            ? fl_value_new_string(r.success ? "online" : "offline")
+            : fl_value_new_bool(r.success);
+    g_autoptr(GError) error = nullptr;
+    if (!fl_method_call_respond_success(reply->call, value, &error)) {
+      g_warning("Failed to send printer reply: %s", error->message);
+    }
+  }
+  // The reply is out; a slow job's timeline is saved from here
+  tracer->FinishJob(r.trace_id);
+  return G_SOURCE_REMOVE;
+}
+
+void FreeCompletion(gpointer data) { delete static_cast<Completion*>(data); }
+
+// Queues |job|. Calls carrying "async": true get the job id back at once and
+// a printJobCompleted call later; others are answered when the job ends.
+// |on_done| runs on the worker thread with the outcome.
+void SubmitJob(PrinterPlugin* self, FlMethodCall* method_call,
+               printer_core::PrintJob job, const std::string& tag,
+               ReplyKind kind, printer_core::PrintJobCallback on_done = nullptr) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const bool async = kind == ReplyKind::kBool && LookupBool(args, "async");
+  auto reply = std::make_shared<PendingReply>();
+  reply->self = EXTROPOS_PRINTER_PLUGIN(g_object_ref(self));
+  reply->call = async ? nullptr : FL_METHOD_CALL(g_object_ref(method_call));
+  reply->kind = async ? ReplyKind::kEvent : kind;
+  reply->tag = tag;
+  reply->printer = job.target.Key();
+  reply->network = job.target.kind == printer_core::PrinterTarget::Kind::kNetwork;
+  // Jobs not started by a receipt handler are timed from here
+  printer_core::JobTracer* tracer = self->state->tracer.get();
+  if (job.trace_id == 0) job.trace_id = tracer->BeginJob();
+  const uint64_t trace_id = job.trace_id;
+
+  // Every network job doubles as a reachability sample for the status cache
+  printer_core::StatusMonitor* monitor = reply->network ? self->state->monitor.get() : nullptr;
+  const printer_core::PrinterTarget status_target = job.target;
+  // Journaled before it is queued so a crash from here on cannot lose it
+  printer_core::PrintSpool* spool = self->state->spool.get();
+  const uint64_t spool_id =
+      spool != nullptr && printer_core::ShouldSpool(job) ? spool->Append(job) : 0;
+  const uint64_t job_id = self->state->queue->Submit(
+      std::move(job), [reply, monitor, status_target, spool, spool_id, on_done, tracer](
+                          const printer_core::PrintJobResult& r) {
+        if (spool_id != 0) spool->Complete(spool_id);
+        if (on_done) on_done(r);
+        if (monitor != nullptr) {
+          printer_core::ScopedTraceSpan status(tracer, r.trace_id, "status");
+          monitor->ReportJobResult(status_target, r.success, r.error);
+        }
+        g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, DeliverCompletion,
+                                   new Completion{reply, r, printer_core::TraceNow()},
+                                   FreeCompletion);
+      });
+  if (job_id == 0) {
+    if (spool_id != 0) spool->Complete(spool_id);
+    if (on_done) on_done(printer_core::PrintJobResult{});
+    tracer->FinishJob(trace_id);
+    PostLog(self, tag, "Print queue is shut down; job rejected", printer_core::LogLevel::kError);
+    g_autoptr(FlValue) value = kind == ReplyKind::kStatus
+                                   ? fl_value_new_string("offline")
+                                   : fl_value_new_bool(FALSE);
+    fl_method_call_respond_success(method_call, value, nullptr);
+    return;
+  }
+  if (async) {
+    g_autoptr(FlValue) value = fl_value_new_int(static_cast<int64_t>(job_id));
+    fl_method_call_respond_success(method_call, value, nullptr);
+  }
+}
+
+// $XDG_DATA_HOME/extropos/|name|, creating the folder if needed.
+std::string DataFile(const char* name) {
+  g_autofree gchar* dir = g_build_filename(g_get_user_data_dir(), "extropos", nullptr);
+  g_mkdir_with_parents(dir, 0700);
+  g_autofree gchar* path = g_build_filename(dir, name, nullptr);
+  return path;
+}
+
+// Opens the spool under $XDG_DATA_HOME/extropos and requeues the jobs the
+// last run left unprinted; their outcomes arrive as printJobCompleted calls.
+void OpenSpool(PrinterPlugin* self) {
+  PluginState* state = self->state;
+  const std::string path = DataFile("print_spool.bin");
+  std::string error;
+  state->spool = printer_core::PrintSpool::Open(path, printer_core::PrintSpoolOptions(), &error);
+  if (!state->spool) {
+    PostLog(self, "SPOOL", "Cannot open " + path + ": " + error, printer_core::LogLevel::kError);
+    return;
+  }
+  std::vector<printer_core::SpooledJob> recovered = state->spool->TakeRecovered();
+  if (recovered.empty()) return;
+  PostLog(self, "SPOOL", "Reprinting " + std::to_string(recovered.size()) +
+                             " job(s) left unprinted by the last run");
+  printer_core::PrintSpool* spool = state->spool.get();
+  for (printer_core::SpooledJob& spooled : recovered) {
+    auto reply = std::make_shared<PendingReply>();
+    reply->self = EXTROPOS_PRINTER_PLUGIN(g_object_ref(self));
+    reply->call = nullptr;
+    reply->kind = ReplyKind::kEvent;
+    reply->tag = "SPOOL";
+    reply->printer = spooled.job.target.Key();
+    reply->network = spooled.job.target.kind == printer_core::PrinterTarget::Kind::kNetwork;
+    const uint64_t spool_id = spooled.id;
+    const uint64_t job_id = state->queue->Submit(
+        std::move(spooled.job), [reply, spool, spool_id](const printer_core::PrintJobResult& r) {
+          spool->Complete(spool_id);
+          g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, DeliverCompletion,
+                                     new Completion{reply, r, 0}, FreeCompletion);
+        });
+    if (job_id == 0) spool->Complete(spool_id);
+  }
+}
+
+// Loads which printers hold the receipt logo in NV memory.
+void LoadNvLogos(PrinterPlugin* self) {
+  std::string error;
+  if (!self->state->nv_logos->Load(&error)) {
+    PostLog(self, "LOGO", error + "; logos will be uploaded again",
+            printer_core::LogLevel::kWarning);
+  }
+}
+
+void RespondBool(FlMethodCall* method_call, bool value) {
+  g_autoptr(FlValue) result = fl_value_new_bool(value);
+  fl_method_call_respond_success(method_call, result, nullptr);
+}
+
+// --- Discovery ---
+
+FlValue* DiscoverUsbPrinters() {
+  FlValue* printers = fl_value_new_list();
+  for (const std::string& device : printer_core::ListLinePrinterDevices()) {
+    FlValue* printer = fl_value_new_map();
+    fl_value_set_string_take(printer, "id", fl_value_new_string(device.c_str()));
+    fl_value_set_string_take(printer, "name",
+                             fl_value_new_string(("USB Thermal Printer (" + device + ")").c_str()));
+    fl_value_set_string_take(printer, "connectionType", fl_value_new_string("usb"));
+    fl_value_set_string_take(printer, "usbDeviceId", fl_value_new_string(device.c_str()));
+    fl_value_set_string_take(printer, "platformSpecificId", fl_value_new_string(device.c_str()));
+    fl_value_set_string_take(printer, "printerType", fl_value_new_string("receipt"));
+    fl_value_set_string_take(
+        printer, "status",
+        fl_value_new_string(printer_core::IsDeviceWritable(device) ? "online" : "offline"));
+    fl_value_set_string_take(printer, "modelName", fl_value_new_string("USB Thermal Printer"));
+    fl_value_append_take(printers, printer);
+  }
+  return printers;
+}
+
+FlValue* DiscoverCupsPrinters() {
+  FlValue* printers = fl_value_new_list();
+#ifdef HAVE_CUPS
+  cups_dest_t* dests = nullptr;
+  const int count = cupsGetDests2(CUPS_HTTP_DEFAULT, &dests);
+  for (int i = 0; i < count; ++i) {
+    const std::string id = std::string(kCupsPrefix) + dests[i].name;
+    const char* info = cupsGetOption("printer-info", dests[i].num_options,
+                                     dests[i].options);
+    FlValue* printer = fl_value_new_map();
+    fl_value_set_string_take(printer, "id", fl_value_new_string(id.c_str()));
+    fl_value_set_string_take(printer, "name", fl_value_new_string(dests[i].name));
+    fl_value_set_string_take(printer, "connectionType", fl_value_new_string("posmac"));
+    fl_value_set_string_take(printer, "platformSpecificId", fl_value_new_string(id.c_str()));
+    fl_value_set_string_take(printer, "printerType", fl_value_new_string("receipt"));
+    fl_value_set_string_take(printer, "status", fl_value_new_string("online"));
+    fl_value_set_string_take(printer, "modelName",
+                             fl_value_new_string(info != nullptr ? info : dests[i].name));
+    fl_value_append_take(printers, printer);
+  }
+  cupsFreeDests(count, dests);
+#endif
+  return printers;
+}
+
+// --- Network scan ---
+
+// Shared by the scan thread and the main-loop events it posts. The last copy
+// must not be dropped on the scan thread, where dispose could end up
+// joining it.
+struct ScanReply {
+  PrinterPlugin* self;
+  FlMethodCall* call;
+  FlValue* found;
+
+  ~ScanReply() {
+    fl_value_unref(found);
+    g_object_unref(call);
+    g_object_unref(self);
+  }
+};
+
+struct ScanEvent {
+  std::shared_ptr<ScanReply> reply;
+  bool done;
+  printer_core::ScanHit hit;
+  bool ok;
+  std::string error;
+};
+
+FlValue* NetworkPrinterToMap(const printer_core::ScanHit& hit) {
+  const std::string endpoint = hit.host + ":" + std::to_string(hit.port);
+  const char* protocol = hit.port == 515 ? "LPD" : hit.port == 631 ? "IPP" : "Raw TCP";
+  FlValue* printer = fl_value_new_map();
+  fl_value_set_string_take(printer, "id", fl_value_new_string(("net_" + endpoint).c_str()));
+  fl_value_set_string_take(printer, "name",
+                           fl_value_new_string(("Network Printer (" + endpoint + ")").c_str()));
+  fl_value_set_string_take(printer, "connectionType", fl_value_new_string("network"));
+  fl_value_set_string_take(printer, "ipAddress", fl_value_new_string(hit.host.c_str()));
+  SetInt(printer, "port", hit.port);
+  fl_value_set_string_take(printer, "printerType", fl_value_new_string("receipt"));
+  fl_value_set_string_take(printer, "status", fl_value_new_string("online"));
+  fl_value_set_string_take(printer, "modelName",
+                           fl_value_new_string((std::string(protocol) + " printer").c_str()));
+  return printer;
+}
+
+gboolean DeliverScanEvent(gpointer data) {
+  ScanEvent* event = static_cast<ScanEvent*>(data);
+  ScanReply* reply = event->reply.get();
+  PrinterPlugin* self = reply->self;
+  if (!event->done) {
+    FlValue* printer = NetworkPrinterToMap(event->hit);
+    fl_value_append(reply->found, printer);
+    fl_method_channel_invoke_method(self->channel, "networkPrinterFound", printer,
+                                    nullptr, nullptr, nullptr);
+    fl_value_unref(printer);
+    return G_SOURCE_REMOVE;
+  }
+  // Posted after every hit, so |found| is complete here
+  if (self->state != nullptr) self->state->scan_running = false;
+  PostLog(self, "NETWORK",
+          event->ok ? "Network scan found " +
+                          std::to_string(fl_value_get_length(reply->found)) +
+                          " printer port(s)"
+                    : "Network scan failed: " + event->error,
+          event->ok ? printer_core::LogLevel::kInfo : printer_core::LogLevel::kWarning);
+  fl_method_call_respond_success(reply->call, reply->found, nullptr);
+  return G_SOURCE_REMOVE;
+}
+
+void FreeScanEvent(gpointer data) { delete static_cast<ScanEvent*>(data); }
+
+void PostScanEvent(ScanEvent* event) {
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, DeliverScanEvent, event,
+                             FreeScanEvent);
+}
+
+// discoverNetworkPrinters: scans the "cidr" argument (default: the local
+// /24s) on a background thread. Each printer found is sent right away as a
+// networkPrinterFound call; the reply carries the full list at the end.
+void HandleDiscoverNetworkPrinters(PrinterPlugin* self, FlMethodCall* method_call) {
+  PluginState* state = self->state;
+  if (state->scan_running) {
+    fl_method_call_respond_error(method_call, "SCAN_IN_PROGRESS",
+                                 "A network scan is already running", nullptr, nullptr);
+    return;
+  }
+
+  FlValue* args = fl_method_call_get_args(method_call);
+  std::vector<printer_core::Ipv4Range> ranges;
+  printer_core::ScanOptions options;
+  if (Lookup(args, "cidr") != nullptr) {
+    const gchar* cidr = LookupString(args, "cidr");
+    printer_core::Ipv4Range range;
+    std::string error;
+    if (cidr == nullptr || !printer_core::ParseCidr(cidr, &range, &error)) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                   cidr ? error.c_str() : "cidr must be a string",
+                                   nullptr, nullptr);
+      return;
+    }
+    ranges.push_back(range);
+  }
+  FlValue* ports = Lookup(args, "ports");
+  if (ports != nullptr && fl_value_get_type(ports) == FL_VALUE_TYPE_LIST) {
+    options.ports.clear();
+    for (size_t i = 0; i < fl_value_get_length(ports); ++i) {
+      FlValue* port = fl_value_get_list_value(ports, i);
+      if (fl_value_get_type(port) != FL_VALUE_TYPE_INT) continue;
+      const int64_t value = fl_value_get_int(port);
+      if (value > 0 && value <= 65535) options.ports.push_back(static_cast<uint16_t>(value));
+    }
+  }
+  int64_t timeout_ms = 0;
+  if (LookupInt(args, "timeoutMs", &timeout_ms) && timeout_ms > 0) {
+    options.timeout_ms = static_cast<int>(timeout_ms);
+  }
+  if (ranges.empty()) ranges = printer_core::LocalSubnets();
+
+  if (state->scan_thread.joinable()) state->scan_thread.join();
+  state->scan_running = true;
+  state->scan_cancel = false;
+  options.cancel = &state->scan_cancel;
+  PostLog(self, "NETWORK",
+          "Scanning " + std::to_string(ranges.size()) + " subnet(s) for printers");
+
+  auto reply = std::make_shared<ScanReply>();
+  reply->self = EXTROPOS_PRINTER_PLUGIN(g_object_ref(self));
+  reply->call = FL_METHOD_CALL(g_object_ref(method_call));
+  reply->found = fl_value_new_list();
+  state->scan_thread = std::thread([reply, ranges, options]() mutable {
+    std::string error;
+    bool ok;
+    {
+      auto on_found = [reply](const printer_core::ScanHit& hit) {
+        PostScanEvent(new ScanEvent{reply, false, hit, true, std::string()});
+      };
+      ok = printer_core::ScanNetwork(ranges, options, on_found, &error);
+    }
+    PostScanEvent(new ScanEvent{std::move(reply), true, {}, ok, error});
+  });
+}
+
+// Decodes an image file held in memory with gdk-pixbuf.
+bool DecodeImage(const gchar* contents, gsize length, printer_core::GrayImage* image) {
+  g_autoptr(GdkPixbufLoader) loader = gdk_pixbuf_loader_new();
+  if (!gdk_pixbuf_loader_write(loader, reinterpret_cast<const guchar*>(contents), length,
+                               nullptr) ||
+      !gdk_pixbuf_loader_close(loader, nullptr)) {
+    return false;
+  }
+  GdkPixbuf* pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  if (pixbuf == nullptr || gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) return false;
+  const int channels = gdk_pixbuf_get_n_channels(pixbuf);
+  if (channels != 3 && channels != 4) return false;
+  *image = printer_core::GrayFromPixels(
+      gdk_pixbuf_read_pixels(pixbuf), gdk_pixbuf_get_width(pixbuf),
+      gdk_pixbuf_get_height(pixbuf), gdk_pixbuf_get_rowstride(pixbuf),
+      channels == 4 ? printer_core::PixelLayout::kRgba : printer_core::PixelLayout::kRgb);
+  return !image->pixels.empty();
+}
+
+// Puts the image at receiptData "logoPath" on top of |data|. "logoDither"
+// picks the dither mode and "logoWidth" the width in dots (by default 384 on
+// 80 mm paper, 256 on 58 mm). "logoStorage" says how |target| keeps logos
+// (see ParseLogoStorage); by default network printers are probed for NV
+// graphics. A logo that cannot be read is logged and left off so the receipt
+// still prints. Returns the callback that records an NV upload once the job
+// is done, or null when the job carries none.
+printer_core::PrintJobCallback AddLogo(PrinterPlugin* self, FlValue* receipt,
+                                       int chars_per_line,
+                                       const printer_core::PrinterTarget& target,
+                                       const std::string& tag, std::vector<uint8_t>* data) {
+  const gchar* path = LookupString(receipt, "logoPath");
+  if (path == nullptr || *path == '\0') return nullptr;
+  printer_core::DitherMode mode = printer_core::DitherMode::kThreshold;
+  const gchar* dither = LookupString(receipt, "logoDither");
+  if (dither != nullptr && !printer_core::ParseDitherMode(dither, &mode)) {
+    PostLog(self, tag, std::string("Unknown logo dither mode ") + dither + ", using threshold",
+            printer_core::LogLevel::kWarning);
+  }
+  int64_t width = chars_per_line >= 42 ? printer_core::kLogoWidth80mm
+                                       : printer_core::kLogoWidth58mm;
+  int64_t requested = 0;
+  if (LookupInt(receipt, "logoWidth", &requested) && requested > 0 &&
+      requested <= printer_core::kLogoWidthFull80mm) {
+    width = requested;
+  }
+
+  g_autofree gchar* contents = nullptr;
+  gsize length = 0;
+  if (!g_file_get_contents(path, &contents, &length, nullptr)) {
+    PostLog(self, tag, std::string("Cannot read logo ") + path, printer_core::LogLevel::kWarning);
+    return nullptr;
+  }
+  auto logo = self->state->logos.Get(
+      reinterpret_cast<const uint8_t*>(contents), length, static_cast<int>(width), mode,
+      [&](printer_core::GrayImage* image) { return DecodeImage(contents, length, image); });
+  if (!logo) {
+    PostLog(self, tag, std::string("Cannot decode logo ") + path,
+            printer_core::LogLevel::kWarning);
+    return nullptr;
+  }
+
+  printer_core::NvLogoStore* nv_logos = self->state->nv_logos.get();
+  const std::string printer = target.Key();
+  const gchar* storage_name = LookupString(receipt, "logoStorage");
+  printer_core::NvLogoSupport storage = printer_core::NvLogoSupport::kUnknown;
+  if (storage_name != nullptr && !printer_core::ParseLogoStorage(storage_name, &storage)) {
+    PostLog(self, tag, std::string("Unknown logo storage ") + storage_name,
+            printer_core::LogLevel::kWarning);
+  }
+  if (storage != printer_core::NvLogoSupport::kUnknown) {
+    nv_logos->SetSupport(printer, storage);
+  } else if (target.kind == printer_core::PrinterTarget::Kind::kNetwork) {
+    // Raster this time; later receipts use what the probe finds
+    nv_logos->Probe(target, 1000);
+  }
+  bool upload = false;
+  printer_core::PrependLogo(nv_logos->Block(printer, *logo, &upload), data);
+  if (!upload) return nullptr;
+  PostLog(self, tag, "Storing logo in printer NV memory");
+  const printer_core::LogoKey key = logo->key;
+  return [nv_logos, printer, key](const printer_core::PrintJobResult& r) {
+    nv_logos->FinishUpload(printer, key, r.success);
+  };
+}
+
+// --- Method calls ---
+
+void HandlePrintReceipt(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  FlValue* receipt = LookupMap(args, "receiptData");
+  const gchar* content = LookupString(receipt, "content");
+  if (!ResolveTarget(args, &target, &tag) || content == nullptr) {
+    RespondBool(method_call, false);
+    return;
+  }
+
+  PluginState* state = self->state;
+  printer_core::JobTracer* tracer = state->tracer.get();
+  const uint64_t trace_id = tracer->BeginJob();
+  printer_core::ScopedTraceSpan receive(tracer, trace_id, "receive");
+
+  // A structured receipt (flat blob, or items in the map) or laid-out rows
+  // when present, otherwise the preformatted text as-is
+  bool structured = false;
+  bool rows = false;
+  {
+    printer_core::ScopedTraceSpan decode(tracer, trace_id, "decode");
+    state->encoder.set_chars_per_line(CharsPerLine(args));
+    state->encoder.set_profile(DecodePrinterProfile(receipt, CharsPerLine(args)));
+    const bool blob = DecodeReceiptBlob(receipt, &state->receipt_doc);
+    structured = blob || Lookup(receipt, "items") != nullptr;
+    rows = !structured && Lookup(receipt, "rows") != nullptr;
+    if (structured) {
+      if (!blob) DecodeReceiptDocument(receipt, &state->receipt_doc);
+      state->encoder.set_store(DecodeStoreSettings(receipt));
+    } else if (rows) {
+      DecodeReceiptRows(Lookup(receipt, "rows"), &state->receipt_rows);
+    }
+  }
+
+  std::vector<uint8_t> data;
+  printer_core::PrintJobCallback on_done;
+  {
+    printer_core::ScopedTraceSpan encode(tracer, trace_id, "encode");
+    if (structured) {
+      state->encoder.EncodeReceipt(state->receipt_doc);
+      PostLog(self, tag, "Using structured receipt content for printing");
+    } else if (rows) {
+      state->encoder.EncodeRows(state->receipt_rows);
+    } else {
+      state->encoder.EncodeRawText(content);
+    }
+    data = state->encoder.TakeBuffer();
+    on_done = AddLogo(self, receipt, CharsPerLine(args), target, tag, &data);
+    // Drop repeated alignment and settings, merge feeds
+    printer_core::OptimizeEscPos(&data);
+    encode.set_arg("bytes", static_cast<int64_t>(data.size()));
+  }
+  printer_core::PrintJob job{std::move(target), std::move(data)};
+  job.priority = Priority(args, printer_core::JobPriority::kReceipt);
+  job.trace_id = trace_id;
+  printer_core::SetPreemptPoints(&job);
+  SubmitJob(self, method_call, std::move(job), tag, ReplyKind::kBool, std::move(on_done));
+}
+
+void HandlePrintOrder(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  // Order data arrives as preformatted text, or as a map carrying "content"
+  const gchar* order = LookupString(args, "orderData");
+  if (order == nullptr) order = LookupString(LookupMap(args, "orderData"), "content");
+  if (!ResolveTarget(args, &target, &tag) || order == nullptr) {
+    RespondBool(method_call, false);
+    return;
+  }
+  printer_core::PrintJob job{std::move(target),
+                             std::vector<uint8_t>(order, order + strlen(order))};
+  job.priority = Priority(args, printer_core::JobPriority::kKitchen);
+  printer_core::SetPreemptPoints(&job);
+  SubmitJob(self, method_call, std::move(job), tag, ReplyKind::kBool);
+}
+
+gboolean UnrefValue(gpointer value) {
+  fl_value_unref(static_cast<FlValue*>(value));
+  return G_SOURCE_REMOVE;
+}
+
+// FlValue reference counts are not atomic, so a reference released on a
+// worker thread is dropped on the main loop.
+void UnrefValueOnMainLoop(FlValue* value) {
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, UnrefValue, value, nullptr);
+}
+
+// Pre-encoded ESC/POS ("data", a Uint8List) queued exactly as given: no
+// optimizer pass, no logo. The job holds a reference on the decoded FlValue
+// and writes its bytes in place.
+void HandlePrintRaw(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  FlValue* data = Lookup(args, "data");
+  if (!ResolveTarget(args, &target, &tag) || data == nullptr ||
+      fl_value_get_type(data) != FL_VALUE_TYPE_UINT8_LIST) {
+    RespondBool(method_call, false);
+    return;
+  }
+  printer_core::PrintJob job;
+  job.target = std::move(target);
+  job.borrowed_data = fl_value_get_uint8_list(data);
+  job.borrowed_size = fl_value_get_length(data);
+  job.borrowed_owner = std::shared_ptr<const void>(fl_value_ref(data), UnrefValueOnMainLoop);
+  job.priority = Priority(args, printer_core::JobPriority::kReceipt);
+  SubmitJob(self, method_call, std::move(job), tag, ReplyKind::kBool);
+}
+
+void HandleTestPrint(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  if (!ResolveTarget(args, &target, &tag)) {
+    RespondBool(method_call, false);
+    return;
+  }
+  // Initialize, center, print text, feed paper
+  static const char kTestData[] =
+      "\x1B\x40\x1B\x61\x01Hello POSMAC Printer\x0A\x0A\x1B\x64\x03";
+  printer_core::PrintJob job{
+      std::move(target),
+      std::vector<uint8_t>(kTestData, kTestData + sizeof(kTestData) - 1)};
+  SubmitJob(self, method_call, std::move(job), tag, ReplyKind::kBool);
+}
+
+void HandleCheckPrinterStatus(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  const char* status = "unknown";
+  if (ResolveTarget(args, &target, &tag)) {
+    if (target.kind == printer_core::PrinterTarget::Kind::kNetwork) {
+      // Cached answer from the status poller when it has reached this printer
+      const printer_core::PrinterStatus cached = self->state->monitor->Get(target);
+      if (cached.known) {
+        g_autoptr(FlValue) result = fl_value_new_string(cached.Summary());
+        fl_method_call_respond_success(method_call, result, nullptr);
+        return;
+      }
+      // First ask for this printer: a job without data only connects, with a
+      // short timeout for status checks
+      target.connect_timeout_ms = 2000;
+      printer_core::PrintJob probe{std::move(target), {}};
+      probe.priority = printer_core::JobPriority::kDrawer;
+      SubmitJob(self, method_call, std::move(probe), tag, ReplyKind::kStatus);
+      return;
+    }
+    if (target.kind == printer_core::PrinterTarget::Kind::kDevice) {
+      status = printer_core::IsDeviceWritable(target.device) ? "online" : "offline";
+    }
+  } else if (LookupString(args, "printerType") != nullptr) {
+    status = "offline";
+  }
+  g_autoptr(FlValue) result = fl_value_new_string(status);
+  fl_method_call_respond_success(method_call, result, nullptr);
+}
+
+void HandleOpenCashDrawer(PrinterPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  if (!ResolveTarget(args, &target, &tag)) {
+    RespondBool(method_call, false);
+    return;
+  }
+  // ESC p m t1 t2: pulse drawer pin 2 (m=0) or pin 5 (m=1) for 50ms on / 500ms off
+  int64_t pin = 2;
+  LookupInt(args, "pin", &pin);
+  printer_core::PrintJob job{std::move(target),
+                             {0x1B, 0x70, static_cast<uint8_t>(pin == 5 ? 1 : 0), 25, 250}};
+  job.priority = printer_core::JobPriority::kDrawer;
+  SubmitJob(self, method_call, std::move(job), tag, ReplyKind::kBool);
+}
+
+FlValue* PrintQueueStats(PluginState* state) {
+  static const char* const kClassNames[printer_core::kJobPriorityCount] = {
+      "drawer", "receipt", "kitchen", "report"};
+  const printer_core::PrintQueueStats stats = state->queue->stats();
+  FlValue* classes = fl_value_new_map();
+  for (size_t i = 0; i < printer_core::kJobPriorityCount; ++i) {
+    const printer_core::PriorityClassStats& c = stats[i];
+    FlValue* m = fl_value_new_map();
+    SetInt(m, "depth", static_cast<int64_t>(c.depth));
+    SetInt(m, "started", static_cast<int64_t>(c.started));
+    SetInt(m, "avgWaitUs",
+           c.started ? c.total_wait.count() / static_cast<int64_t>(c.started) : 0);
+    SetInt(m, "maxWaitUs", c.max_wait.count());
+    SetInt(m, "preemptions", static_cast<int64_t>(c.preemptions));
+    fl_value_set_string_take(classes, kClassNames[i], m);
+  }
+  return classes;
+}
+
+FlValue* ConnectionPoolStats(PluginState* state) {
+  const printer_core::ConnectionPoolStats stats = state->pool.stats();
+  FlValue* m = fl_value_new_map();
+  SetInt(m, "hits", static_cast<int64_t>(stats.hits));
+  SetInt(m, "misses", static_cast<int64_t>(stats.misses));
+  SetInt(m, "reconnects", static_cast<int64_t>(stats.reconnects));
+  SetInt(m, "reaped", static_cast<int64_t>(stats.reaped));
+  SetInt(m, "healthFailures", static_cast<int64_t>(stats.health_failures));
+  SetInt(m, "idle", static_cast<int64_t>(stats.idle));
+  return m;
+}
+
+// Shape of a cached printer status as seen by Dart (getPrinterStatus)
+FlValue* StatusToMap(const printer_core::PrinterStatus& status) {
+  FlValue* m = fl_value_new_map();
+  fl_value_set_string_take(m, "status", fl_value_new_string(status.Summary()));
+  fl_value_set_string_take(m, "reachable", fl_value_new_bool(status.reachable));
+  fl_value_set_string_take(m, "reported", fl_value_new_bool(status.reported));
+  fl_value_set_string_take(m, "offline", fl_value_new_bool(status.offline));
+  fl_value_set_string_take(m, "coverOpen", fl_value_new_bool(status.cover_open));
+  fl_value_set_string_take(m, "paperNearEnd", fl_value_new_bool(status.paper_near_end));
+  fl_value_set_string_take(m, "paperOut", fl_value_new_bool(status.paper_out));
+  fl_value_set_string_take(m, "error", fl_value_new_bool(status.error));
+  fl_value_set_string_take(m, "lastError", fl_value_new_string(status.last_error.c_str()));
+  const auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - status.updated);
+  SetInt(m, "ageMs", status.known ? age.count() : -1);
+  return m;
+}
+
+// Network printers named "ip" or "ip:port" are answered from the status
+// cache; anything else falls back to the last job's outcome or any lp node.
+bool IsPrinterOnline(PluginState* state, FlValue* args) {
+  bool online = state->network_online || !printer_core::ListLinePrinterDevices().empty();
+  const gchar* name = LookupString(args, "printerName");
+  if (name == nullptr) return online;
+  const std::string printer_name(name);
+  const size_t colon = printer_name.find(':');
+  const std::string host = printer_name.substr(0, colon);
+  const int port = colon == std::string::npos ? 9100 : std::atoi(name + colon + 1);
+  printer_core::Ipv4Range single;
+  if (port > 0 && port <= 65535 && printer_core::ParseCidr(host, &single, nullptr)) {
+    const printer_core::PrinterStatus status = state->monitor->Get(
+        printer_core::PrinterTarget::Network(host, static_cast<uint16_t>(port)));
+    if (status.known) online = status.reachable && !status.offline;
+  }
+  return online;
+}
+
+void HandleMethodCall(PrinterPlugin* self, FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "printReceipt") == 0) {
+    HandlePrintReceipt(self, method_call);
+    return;
+  }
+  if (strcmp(method, "printOrder") == 0) {
+    HandlePrintOrder(self, method_call);
+    return;
+  }
+  if (strcmp(method, "printRaw") == 0) {
+    HandlePrintRaw(self, method_call);
+    return;
+  }
+  if (strcmp(method, "testPrint") == 0) {
+    HandleTestPrint(self, method_call);
+    return;
+  }
+  if (strcmp(method, "checkPrinterStatus") == 0) {
+    HandleCheckPrinterStatus(self, method_call);
+    return;
+  }
+  if (strcmp(method, "openCashDrawer") == 0) {
+    HandleOpenCashDrawer(self, method_call);
+    return;
+  }
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, "initialize") == 0) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(TRUE)));
+  } else if (strcmp(method, "getPluginName") == 0) {
+    response = FL_METHOD_RESPONSE(
+        fl_method_success_response_new(fl_value_new_string("LinuxPrinterPlugin")));
+  } else if (strcmp(method, "setDebugEnabled") == 0) {
+    self->state->debug_enabled = LookupBool(args, "enabled");
+    self->state->logger->set_min_level(self->state->debug_enabled
+                                           ? printer_core::LogLevel::kDebug
+                                           : printer_core::LogLevel::kInfo);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(TRUE)));
+  } else if (strcmp(method, "isPrinterOnline") == 0) {
+    response = FL_METHOD_RESPONSE(
+        fl_method_success_response_new(fl_value_new_bool(IsPrinterOnline(self->state, args))));
+  } else if (strcmp(method, "getPrinterStatus") == 0) {
+    // Detailed cached status (paper, cover, error bits) of a network printer
+    printer_core::PrinterTarget target;
+    std::string tag;
+    const printer_core::PrinterStatus status =
+        ResolveTarget(args, &target, &tag) &&
+                target.kind == printer_core::PrinterTarget::Kind::kNetwork
+            ? self->state->monitor->Get(target)
+            : printer_core::PrinterStatus();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(StatusToMap(status)));
+  } else if (strcmp(method, "watchPrinterStatus") == 0 ||
+             strcmp(method, "unwatchPrinterStatus") == 0) {
+    // Keeps a network printer polled (or stops) so its status events keep
+    // coming while nothing prints to it
+    printer_core::PrinterTarget target;
+    std::string tag;
+    const bool ok = ResolveTarget(args, &target, &tag) &&
+                    target.kind == printer_core::PrinterTarget::Kind::kNetwork;
+    if (ok && strcmp(method, "watchPrinterStatus") == 0) {
+      self->state->monitor->Watch(target);
+    } else if (ok) {
+      self->state->monitor->Unwatch(target);
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(ok)));
+  } else if (strcmp(method, "discoverPrinters") == 0 ||
+             strcmp(method, "discoverUsbPrinters") == 0) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(DiscoverUsbPrinters()));
+  } else if (strcmp(method, "discoverNetworkPrinters") == 0) {
+    HandleDiscoverNetworkPrinters(self, method_call);
+    return;
+  } else if (strcmp(method, "discoverLocalPrinters") == 0) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(DiscoverCupsPrinters()));
+  } else if (strcmp(method, "getPrintQueueStats") == 0) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(PrintQueueStats(self->state)));
+  } else if (strcmp(method, "getConnectionPoolStats") == 0) {
+    response = FL_METHOD_RESPONSE(
+        fl_method_success_response_new(ConnectionPoolStats(self->state)));
+  } else if (strcmp(method, "exportPrintTrace") == 0) {
+    // Chrome trace JSON for the job result's "traceId", or every job still
+    // held when it is absent
+    int64_t trace_id = 0;
+    LookupInt(args, "traceId", &trace_id);
+    const std::string json = self->state->tracer->Export(static_cast<uint64_t>(trace_id));
+    response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(json.c_str())));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+  fl_method_call_respond(method_call, response, nullptr);
+}
+
+void MethodCallCb(FlMethodChannel* channel, FlMethodCall* method_call,
+                  gpointer user_data) {
+  HandleMethodCall(EXTROPOS_PRINTER_PLUGIN(user_data), method_call);
+}
+
+}  // namespace
+
+static void printer_plugin_dispose(GObject* object) {
+  PrinterPlugin* self = EXTROPOS_PRINTER_PLUGIN(object);
+  if (self->state != nullptr) {
+    self->state->scan_cancel = true;
+    if (self->state->scan_thread.joinable()) self->state->scan_thread.join();
+    // Finish queued jobs before the pool their transports borrow from goes
+    self->state->queue->Shutdown();
+    // No listener calls after this; jobs and the poller are both stopped
+    self->state->monitor->Shutdown();
+    // The pool's maintenance thread outlives the monitor
+    self->state->pool.set_unsolicited_listener(nullptr);
+    // Sends what is still queued while the channel is up
+    self->state->logger->Shutdown();
+    delete self->state;
+    self->state = nullptr;
+  }
+  g_clear_object(&self->channel);
+  g_clear_object(&self->event_channel);
+  G_OBJECT_CLASS(printer_plugin_parent_class)->dispose(object);
+}
+
+static void printer_plugin_class_init(PrinterPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = printer_plugin_dispose;
+}
+
+static void printer_plugin_init(PrinterPlugin* self) {
+  PluginState* state = new PluginState();
+  // Batched to Dart four times a second and kept in a rotating file, so a
+  // burst of job or status lines costs one channel call, not one each
+  printer_core::LoggerOptions log_options;
+  log_options.file_path = DataFile("printer.log");
+  log_options.default_max_per_second = 50;
+  state->logger = std::make_unique<printer_core::Logger>(
+      log_options, [self](const std::vector<printer_core::LogEntry>& batch) {
+        g_main_context_invoke_full(
+            nullptr, G_PRIORITY_DEFAULT, DeliverLogBatch,
+            new PluginLogBatch{EXTROPOS_PRINTER_PLUGIN(g_object_ref(self)),
+                               LogBatchToMap(batch)},
+            FreeLogBatch);
+      });
+  // A printer that runs out of paper or drops off the network shows up in
+  // Dart within about a second
+  printer_core::StatusMonitorOptions status_options;
+  status_options.poll_interval_ms = 1000;
+  state->monitor = std::make_unique<printer_core::StatusMonitor>(
+      [state](const printer_core::PrinterTarget& target, std::string* error) {
+        return state->pool.Acquire(target, error);
+      },
+      status_options);
+  // Called on the poller or a job worker
+  state->monitor->set_listener([self](const printer_core::PrinterTarget& target,
+                                      const printer_core::PrinterStatus& status) {
+    FlValue* event = StatusToMap(status);
+    fl_value_set_string_take(event, "type", fl_value_new_string("status"));
+    fl_value_set_string_take(event, "printer", fl_value_new_string(target.Key().c_str()));
+    fl_value_set_string_take(event, "host", fl_value_new_string(target.host.c_str()));
+    SetInt(event, "port", target.port);
+    PostEvent(self, event);
+  });
+  state->nv_logos = std::make_unique<printer_core::NvLogoStore>(
+      DataFile("nv_logos.txt"),
+      [state](const printer_core::PrinterTarget& target, std::string* error) {
+        return state->pool.Acquire(target, error);
+      });
+  state->queue = std::make_unique<printer_core::PrintJobQueue>(
+      2, [state](const printer_core::PrinterTarget& target, std::string* error) {
+        return OpenTransport(state, target, error);
+      });
+  // A receipt that takes more than two seconds from the method call to the
+  // reply leaves its timeline for chrome://tracing or Perfetto
+  printer_core::JobTracerOptions trace_options;
+  trace_options.slow_job_us = 2000000;
+  trace_options.on_slow_job = [self](uint64_t trace_id, int64_t duration_us,
+                                     const std::string& json) {
+    const std::string path = DataFile("slow_print_trace.json");
+    g_file_set_contents(path.c_str(), json.data(), static_cast<gssize>(json.size()), nullptr);
+    PostLog(self, "TRACE",
+            "Job trace " + std::to_string(trace_id) + " took " +
+                std::to_string(duration_us / 1000) + " ms; timeline saved to " + path,
+            printer_core::LogLevel::kWarning);
+  };
+  state->tracer = std::make_unique<printer_core::JobTracer>(std::move(trace_options));
+  state->queue->set_tracer(state->tracer.get());
+  // No second connection while a job holds the printer's; GS a blocks the
+  // printer pushes between polls reach the cache
+  state->monitor->set_busy_check([state](const printer_core::PrinterTarget& target) {
+    return state->queue->IsBusy(target);
+  });
+  state->pool.set_unsolicited_listener(
+      [state](const std::string& key, const uint8_t* data, size_t size) {
+        state->monitor->FeedUnsolicited(key, data, size);
+      });
+  self->state = state;
+}
+
+void printer_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  PrinterPlugin* plugin =
+      EXTROPOS_PRINTER_PLUGIN(g_object_new(printer_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  plugin->channel = fl_method_channel_new(
+      fl_plugin_registrar_get_messenger(registrar), kChannelName,
+      FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(plugin->channel, MethodCallCb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+  plugin->event_channel = fl_event_channel_new(
+      fl_plugin_registrar_get_messenger(registrar), kEventChannelName,
+      FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->event_channel, ListenCb, CancelCb,
+                                       plugin, nullptr);
+  OpenSpool(plugin);
+  LoadNvLogos(plugin);
+  PostLog(plugin, "RUNNER", "PrinterPlugin: Registered with registrar");
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,20 @@
+#ifndef RUNNER_PRINTER_PLUGIN_H_
+#define RUNNER_PRINTER_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_BEGIN_DECLS
+
+// Native ESC/POS printing for the Linux runner. Serves the same
+// com.extrotarget.extropos/printer methods as the Windows runner plugin and
+// sends raw bytes over TCP (port 9100), to /dev/usb/lp* device nodes or to
+// CUPS raw queues. Printer status changes and job outcomes are pushed on the
+// com.extrotarget.extropos/printer_events event channel.
+G_DECLARE_FINAL_TYPE(PrinterPlugin, printer_plugin, EXTROPOS, PRINTER_PLUGIN,
+                     GObject)
+
+void printer_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+G_END_DECLS
+
+#endif  // RUNNER_PRINTER_PLUGIN_H_
@@ -0,0 +1,62 @@
+#include "batch_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace printer_core {
+
+namespace {
+
+// Below this many documents per thread the encode is cheaper than the
+// thread start-up.
+constexpr size_t kDocumentsPerThread = 8;
+
+}  // namespace
+
+const std::vector<uint8_t>& EncodeDocument(EscPosEncoder* encoder,
+                                           const BatchDocument& document) {
+  encoder->set_chars_per_line(document.chars_per_line);
+  encoder->set_profile(document.profile);
+  if (document.receipt) {
+    encoder->set_store(document.store);
+    return encoder->EncodeReceipt(*document.receipt);
+  }
+  if (document.rows) return encoder->EncodeRows(*document.rows);
+  switch (document.text_mode) {
+    case BatchText::kPreformatted:
+      return encoder->EncodeRawText(document.text);
+    case BatchText::kRaw:
+      return encoder->EncodeRaw(document.text);
+    case BatchText::kText:
+      break;
+  }
+  return encoder->EncodeText(document.text);
+}
+
+std::vector<std::vector<uint8_t>> EncodeBatch(
+    const std::vector<BatchDocument>& documents, size_t max_threads) {
+  std::vector<std::vector<uint8_t>> out(documents.size());
+  if (max_threads == 0) {
+    max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+  const size_t threads = std::min(
+      max_threads, (documents.size() + kDocumentsPerThread - 1) / kDocumentsPerThread);
+
+  std::atomic<size_t> next{0};
+  auto work = [&] {
+    EscPosEncoder encoder;
+    for (size_t i = next++; i < documents.size(); i = next++) {
+      EncodeDocument(&encoder, documents[i]);
+      out[i] = encoder.TakeBuffer();
+    }
+  };
+
+  std::vector<std::thread> helpers;
+  for (size_t i = 1; i < threads; ++i) helpers.emplace_back(work);
+  work();
+  for (std::thread& helper : helpers) helper.join();
+  return out;
+}
+
+}  // namespace printer_core
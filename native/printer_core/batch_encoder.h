@@ -0,0 +1,50 @@
+#ifndef PRINTER_CORE_BATCH_ENCODER_H_
+#define PRINTER_CORE_BATCH_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "escpos_encoder.h"
+
+namespace printer_core {
+
+// How BatchDocument::text is encoded.
+enum class BatchText {
+  kText,          // EncodeText: free-form receipt text
+  kPreformatted,  // EncodeRawText: preformatted UTF-8, transcoded
+  kRaw,           // EncodeRaw: bytes sent as-is (orders)
+};
+
+// One document of a batch, encoded the way printReceipt encodes it. Exactly
+// one of |receipt| (structured), |rows| (laid out by display width) or
+// |text| is used, in that order of preference. All pointers and views must
+// outlive EncodeBatch().
+struct BatchDocument {
+  const ReceiptDocument* receipt = nullptr;
+  const std::vector<ReceiptRow>* rows = nullptr;
+  std::string_view text;
+  BatchText text_mode = BatchText::kText;
+  int chars_per_line = 48;
+  // The target printer's code pages and native symbols.
+  PrinterProfile profile;
+  // Store header and footer around |receipt|.
+  StoreSettings store;
+};
+
+// Encodes |document| into |encoder|'s buffer with its width, profile and
+// store. The encoder keeps its compiled receipt template across calls.
+const std::vector<uint8_t>& EncodeDocument(EscPosEncoder* encoder,
+                                           const BatchDocument& document);
+
+// Encodes every document into its own buffer, spreading the work over up to
+// |max_threads| threads (0 = one per hardware thread). Small batches are
+// encoded on the calling thread, where starting threads would cost more than
+// the encode itself. Output order matches |documents|.
+std::vector<std::vector<uint8_t>> EncodeBatch(
+    const std::vector<BatchDocument>& documents, size_t max_threads = 0);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_BATCH_ENCODER_H_
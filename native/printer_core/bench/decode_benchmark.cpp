@@ -0,0 +1,169 @@
+// Method-channel decoding: the Windows runner's DecodeReceiptDocument over an
+// EncodableMap as the Dart side sends it, against the same lookups with keys
+// built once and the flat receipt blob. Every find(EncodableValue("...")) in
+// the runner builds a std::string. Time is per receipt.
+
+#include <benchmark/benchmark.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "encodable_value.h"
+#include "escpos_encoder.h"
+#include "receipt_blob.h"
+#include "sample_receipts.h"
+
+namespace printer_core {
+namespace bench {
+namespace {
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+
+// receiptData as PrinterService sends it: ints arrive as int32, money as
+// double.
+EncodableMap ReceiptMap(const BuffetReceipt& receipt) {
+  EncodableList items;
+  for (const ReceiptItem& item : receipt.doc().items) {
+    items.push_back(EncodableValue(EncodableMap{
+        {EncodableValue("name"), EncodableValue(std::string(item.name))},
+        {EncodableValue("quantity"), EncodableValue(static_cast<int32_t>(item.quantity))},
+        {EncodableValue("price"), EncodableValue(item.price)},
+    }));
+  }
+  const ReceiptDocument& doc = receipt.doc();
+  return EncodableMap{
+      {EncodableValue("content"), EncodableValue(std::string("preformatted text"))},
+      {EncodableValue("title"), EncodableValue(std::string(*doc.title))},
+      {EncodableValue("currency"), EncodableValue(std::string("RM"))},
+      {EncodableValue("items"), EncodableValue(std::move(items))},
+      {EncodableValue("subtotal"), EncodableValue(*doc.subtotal)},
+      {EncodableValue("tax"), EncodableValue(*doc.tax)},
+      {EncodableValue("serviceCharge"), EncodableValue(*doc.service_charge)},
+      {EncodableValue("total"), EncodableValue(*doc.total)},
+      {EncodableValue("barcode"), EncodableValue(std::string(doc.barcode))},
+      {EncodableValue("qr_data"), EncodableValue(std::string(doc.qr_data))},
+  };
+}
+
+double GetDouble(const EncodableValue& v) {
+  if (const double* d = std::get_if<double>(&v)) return *d;
+  if (const int64_t* i64 = std::get_if<int64_t>(&v)) return static_cast<double>(*i64);
+  if (const int32_t* i32 = std::get_if<int32_t>(&v)) return static_cast<double>(*i32);
+  return 0.0;
+}
+
+enum Field {
+  kCurrency, kTitle, kItems, kName, kQuantity, kPrice, kSubtotal, kTax, kServiceCharge, kTotal,
+  kBarcode, kQrData, kFieldCount
+};
+
+constexpr const char* kFieldNames[kFieldCount] = {
+    "currency", "title", "items", "name", "quantity", "price", "subtotal", "tax",
+    "serviceCharge", "total", "barcode", "qr_data"};
+
+// Reads every field into |doc| the way the runner does, finding each key
+// with |key(field)|.
+template <typename Key>
+void Decode(const EncodableMap& receipt_map, Key key, ReceiptDocument* doc) {
+  doc->items.clear();
+  auto text = [](const EncodableMap& map, const EncodableValue& k, std::string_view* out) {
+    auto it = map.find(k);
+    if (it == map.end()) return;
+    if (const auto* s = std::get_if<std::string>(&it->second)) *out = *s;
+  };
+  auto number = [](const EncodableMap& map, const EncodableValue& k, std::optional<double>* out) {
+    auto it = map.find(k);
+    if (it != map.end()) *out = GetDouble(it->second);
+  };
+  text(receipt_map, key(kCurrency), &doc->currency);
+  std::string_view title;
+  text(receipt_map, key(kTitle), &title);
+  doc->title = title;
+  auto items_it = receipt_map.find(key(kItems));
+  if (items_it != receipt_map.end()) {
+    if (const auto* items = std::get_if<EncodableList>(&items_it->second)) {
+      doc->items.reserve(items->size());
+      for (const EncodableValue& value : *items) {
+        const auto* item_map = std::get_if<EncodableMap>(&value);
+        if (item_map == nullptr) continue;
+        ReceiptItem item;
+        text(*item_map, key(kName), &item.name);
+        auto q = item_map->find(key(kQuantity));
+        if (q != item_map->end()) item.quantity = static_cast<int>(GetDouble(q->second));
+        auto p = item_map->find(key(kPrice));
+        if (p != item_map->end()) item.price = GetDouble(p->second);
+        doc->items.push_back(item);
+      }
+    }
+  }
+  number(receipt_map, key(kSubtotal), &doc->subtotal);
+  number(receipt_map, key(kTax), &doc->tax);
+  number(receipt_map, key(kServiceCharge), &doc->service_charge);
+  number(receipt_map, key(kTotal), &doc->total);
+  text(receipt_map, key(kBarcode), &doc->barcode);
+  text(receipt_map, key(kQrData), &doc->qr_data);
+}
+
+// As in the runner: a new EncodableValue (and std::string) per lookup
+void BM_DecodeReceiptMap(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  const EncodableMap map = ReceiptMap(receipt);
+  ReceiptDocument doc;
+  for (auto _ : state) {
+    Decode(map, [](Field field) { return EncodableValue(kFieldNames[field]); }, &doc);
+    benchmark::DoNotOptimize(doc.items.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// The same with every key built once
+void BM_DecodeReceiptMapStaticKeys(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  const EncodableMap map = ReceiptMap(receipt);
+  std::vector<EncodableValue> keys;
+  for (const char* name : kFieldNames) keys.emplace_back(name);
+  ReceiptDocument doc;
+  for (auto _ : state) {
+    Decode(map, [&keys](Field field) -> const EncodableValue& { return keys[field]; }, &doc);
+    benchmark::DoNotOptimize(doc.items.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReadReceiptBlob(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(receipt.doc(), &blob);
+  ReceiptDocument doc;
+  for (auto _ : state) {
+    ReadReceiptBlob(blob.data(), blob.size(), &doc);
+    benchmark::DoNotOptimize(doc.items.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * blob.size()));
+  state.counters["bytes/receipt"] = static_cast<double>(blob.size());
+}
+
+// Building the map stands in for the channel codec handing it over.
+void BM_BuildReceiptMap(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    EncodableMap map = ReceiptMap(receipt);
+    benchmark::DoNotOptimize(&map);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_DecodeReceiptMap)->Apply(ReceiptSizes);
+BENCHMARK(BM_DecodeReceiptMapStaticKeys)->Apply(ReceiptSizes);
+BENCHMARK(BM_ReadReceiptBlob)->Apply(ReceiptSizes);
+BENCHMARK(BM_BuildReceiptMap)->Apply(ReceiptSizes);
+
+}  // namespace
+}  // namespace bench
+}  // namespace printer_core
@@ -0,0 +1,42 @@
+#ifndef PRINTER_CORE_BENCH_ENCODABLE_VALUE_H_
+#define PRINTER_CORE_BENCH_ENCODABLE_VALUE_H_
+
+// Stand-in for flutter::EncodableValue (flutter/encodable_value.h): the same
+// variant, ordering and const char* constructor, so the Windows runner's
+// method-channel decoding can be timed on Linux without the Flutter engine.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace flutter {
+
+class EncodableValue;
+
+using EncodableList = std::vector<EncodableValue>;
+using EncodableMap = std::map<EncodableValue, EncodableValue>;
+
+using EncodableValueVariant =
+    std::variant<std::monostate, bool, int32_t, int64_t, double, std::string,
+                 std::vector<uint8_t>, std::vector<int32_t>, std::vector<int64_t>,
+                 std::vector<double>, EncodableList, EncodableMap, std::vector<float>>;
+
+class EncodableValue : public EncodableValueVariant {
+ public:
+  using EncodableValueVariant::EncodableValueVariant;
+
+  EncodableValue() = default;
+  // Like Flutter's: a string, not a bool.
+  explicit EncodableValue(const char* string) : EncodableValueVariant(std::string(string)) {}
+
+  friend bool operator<(const EncodableValue& a, const EncodableValue& b) {
+    return static_cast<const EncodableValueVariant&>(a) <
+           static_cast<const EncodableValueVariant&>(b);
+  }
+};
+
+}  // namespace flutter
+
+#endif  // PRINTER_CORE_BENCH_ENCODABLE_VALUE_H_
@@ -0,0 +1,96 @@
+// Receipt encoding: the encoder against the ostringstream code it replaced,
+// laid-out rows, the optimizer pass the runners apply, and the virtual
+// printer reading the result back. Time is per receipt.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "escpos_optimizer.h"
+#include "legacy_encoder.h"
+#include "sample_receipts.h"
+#include "virtual_printer.h"
+
+namespace printer_core {
+namespace bench {
+namespace {
+
+void SetReceiptCounters(benchmark::State& state, size_t bytes) {
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.counters["bytes/receipt"] = static_cast<double>(bytes);
+}
+
+void BM_EncodeReceipt(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  EscPosEncoder encoder(48);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::vector<uint8_t>& out = encoder.EncodeReceipt(receipt.doc());
+    benchmark::DoNotOptimize(out.data());
+    bytes = out.size();
+  }
+  SetReceiptCounters(state, bytes);
+}
+
+// PrinterPlugin::BuildStructuredEscPosBytes before the encoder
+void BM_LegacyEncodeReceipt(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::vector<uint8_t> out = testing::LegacyEncode(receipt.doc(), 48);
+    benchmark::DoNotOptimize(out.data());
+    bytes = out.size();
+  }
+  SetReceiptCounters(state, bytes);
+}
+
+void BM_EncodeRows(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  EscPosEncoder encoder(48);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::vector<uint8_t>& out = encoder.EncodeRows(receipt.rows());
+    benchmark::DoNotOptimize(out.data());
+    bytes = out.size();
+  }
+  SetReceiptCounters(state, bytes);
+}
+
+void BM_OptimizeEscPos(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  EscPosEncoder encoder(32);
+  const std::vector<uint8_t> encoded = encoder.EncodeReceipt(receipt.doc());
+  std::vector<uint8_t> data;
+  for (auto _ : state) {
+    // The copy stands in for the encoder's TakeBuffer().
+    data = encoded;
+    OptimizeEscPos(&data);
+    benchmark::DoNotOptimize(data.data());
+  }
+  SetReceiptCounters(state, encoded.size());
+  state.counters["optimized bytes/receipt"] = static_cast<double>(data.size());
+}
+
+void BM_InterpretEscPos(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  EscPosEncoder encoder(48);
+  const std::vector<uint8_t> encoded = encoder.EncodeReceipt(receipt.doc());
+  for (auto _ : state) {
+    Page page;
+    InterpretEscPos(encoded.data(), encoded.size(), VirtualPrinterOptions(), &page);
+    benchmark::DoNotOptimize(page.items.data());
+  }
+  SetReceiptCounters(state, encoded.size());
+}
+
+BENCHMARK(BM_EncodeReceipt)->Apply(ReceiptSizes);
+BENCHMARK(BM_LegacyEncodeReceipt)->Apply(ReceiptSizes);
+BENCHMARK(BM_EncodeRows)->Apply(ReceiptSizes);
+BENCHMARK(BM_OptimizeEscPos)->Apply(ReceiptSizes);
+BENCHMARK(BM_InterpretEscPos)->Apply(ReceiptSizes);
+
+}  // namespace
+}  // namespace bench
+}  // namespace printer_core
@@ -0,0 +1,189 @@
+// Getting encoded receipt bytes into Dart: through the C ABI of
+// libprinter_core_ffi, as a background isolate calls it, against a method
+// channel round trip. Time is per receipt, from the receipt blob the Dart
+// side wrote to bytes Dart can read.
+//
+// BM_FfiEncodeReceipt copies the blob into a native buffer, calls
+// pc_encode_receipt and views the output in place. BM_ChannelEncodeReceipt
+// does what the channel does with the same blob: StandardMessageCodec
+// framing of {"receiptBlob": Uint8List} on the Dart side, a hop to the
+// platform thread, decoding into a new vector, the encode, framing the
+// reply and a hop back, and the copy Dart's codec decodes the reply into.
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "ffi/printer_core_ffi.h"
+#include "receipt_blob.h"
+#include "sample_receipts.h"
+
+namespace printer_core {
+namespace bench {
+namespace {
+
+// StandardMessageCodec type tags and sizes, as far as this message needs.
+constexpr uint8_t kCodecString = 7;
+constexpr uint8_t kCodecUint8List = 8;
+constexpr uint8_t kCodecMap = 13;
+
+void WriteCodecSize(size_t size, std::vector<uint8_t>* out) {
+  if (size < 254) {
+    out->push_back(static_cast<uint8_t>(size));
+  } else if (size <= 0xFFFF) {
+    out->push_back(254);
+    out->push_back(static_cast<uint8_t>(size));
+    out->push_back(static_cast<uint8_t>(size >> 8));
+  } else {
+    out->push_back(255);
+    for (int i = 0; i < 4; ++i) out->push_back(static_cast<uint8_t>(size >> (8 * i)));
+  }
+}
+
+size_t ReadCodecSize(const uint8_t** p) {
+  const uint8_t first = *(*p)++;
+  if (first < 254) return first;
+  const int bytes = first == 254 ? 2 : 4;
+  size_t size = 0;
+  for (int i = 0; i < bytes; ++i) size |= static_cast<size_t>(*(*p)++) << (8 * i);
+  return size;
+}
+
+void WriteCodecBytes(const uint8_t* data, size_t size, std::vector<uint8_t>* out) {
+  out->push_back(kCodecUint8List);
+  WriteCodecSize(size, out);
+  out->insert(out->end(), data, data + size);
+}
+
+// Decodes a Uint8List at |p| into a new vector, as the codecs do.
+std::vector<uint8_t> ReadCodecBytes(const uint8_t** p) {
+  ++*p;  // kCodecUint8List
+  const size_t size = ReadCodecSize(p);
+  std::vector<uint8_t> bytes(*p, *p + size);
+  *p += size;
+  return bytes;
+}
+
+// Runs tasks on a thread of its own, the way the embedder posts channel
+// messages to the platform thread and replies back to the UI thread.
+class PlatformThread {
+ public:
+  PlatformThread() : thread_([this] { Run(); }) {}
+
+  ~PlatformThread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // Runs |task| on the thread and waits for it.
+  void Call(std::function<void()> task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = std::move(task);
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return !task_; });
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return stop_ || task_; });
+      if (stop_) return;
+      task_();
+      task_ = nullptr;
+      cv_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::function<void()> task_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+void SetEncodeCounters(benchmark::State& state, size_t bytes) {
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bytes/receipt"] = static_cast<double>(bytes);
+}
+
+void BM_FfiEncodeReceipt(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(receipt.doc(), &blob);
+  pc_encoder* encoder = pc_encoder_new(48);
+  pc_buffer* input = pc_buffer_new(blob.size());
+  size_t bytes = 0;
+  for (auto _ : state) {
+    // Dart writing the blob into native memory
+    std::memcpy(pc_buffer_data(input), blob.data(), blob.size());
+    if (pc_encode_receipt(encoder, pc_buffer_data(input), blob.size()) != PC_OK) {
+      state.SkipWithError("pc_encode_receipt failed");
+      break;
+    }
+    // asTypedList: a view, no copy
+    bytes = pc_encoder_size(encoder);
+    benchmark::DoNotOptimize(pc_encoder_data(encoder));
+  }
+  SetEncodeCounters(state, bytes);
+  pc_buffer_free(input);
+  pc_encoder_free(encoder);
+}
+
+void BM_ChannelEncodeReceipt(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(receipt.doc(), &blob);
+  constexpr std::string_view kKey = "receiptBlob";
+  PlatformThread platform;
+  EscPosEncoder encoder(48);
+  ReceiptDocument doc;
+  std::vector<uint8_t> message;
+  std::vector<uint8_t> reply;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    message.clear();
+    message.push_back(kCodecMap);
+    WriteCodecSize(1, &message);
+    message.push_back(kCodecString);
+    WriteCodecSize(kKey.size(), &message);
+    message.insert(message.end(), kKey.begin(), kKey.end());
+    WriteCodecBytes(blob.data(), blob.size(), &message);
+
+    platform.Call([&] {
+      // Past the map header and key
+      const uint8_t* p = message.data() + 4 + kKey.size();
+      const std::vector<uint8_t> received = ReadCodecBytes(&p);
+      ReadReceiptBlob(received.data(), received.size(), &doc);
+      const std::vector<uint8_t>& encoded = encoder.EncodeReceipt(doc);
+      reply.clear();
+      reply.push_back(0);  // success envelope
+      WriteCodecBytes(encoded.data(), encoded.size(), &reply);
+    });
+
+    const uint8_t* p = reply.data() + 1;
+    const std::vector<uint8_t> result = ReadCodecBytes(&p);
+    bytes = result.size();
+    benchmark::DoNotOptimize(result.data());
+  }
+  SetEncodeCounters(state, bytes);
+}
+
+BENCHMARK(BM_FfiEncodeReceipt)->Apply(ReceiptSizes)->UseRealTime();
+BENCHMARK(BM_ChannelEncodeReceipt)->Apply(ReceiptSizes)->UseRealTime();
+
+}  // namespace
+}  // namespace bench
+}  // namespace printer_core
@@ -0,0 +1,81 @@
+// Logo packing: dithering a scaled logo and turning the bitmap into GS v 0
+// bands, plain and compact, at both print widths. Time is per logo.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "logo_raster.h"
+
+namespace printer_core {
+namespace bench {
+namespace {
+
+// A shop logo stand-in: a diagonal gradient behind a solid frame, with
+// blank bands above and below like most exported PNGs.
+GrayImage SampleLogo(int width) {
+  GrayImage image;
+  image.width = width;
+  image.height = width / 3;
+  image.pixels.assign(static_cast<size_t>(image.width) * image.height, 255);
+  const int top = image.height / 5;
+  const int bottom = image.height - top;
+  for (int y = top; y < bottom; ++y) {
+    for (int x = width / 8; x < width - width / 8; ++x) {
+      const bool frame = y < top + 6 || y >= bottom - 6 || x < width / 8 + 6 ||
+                         x >= width - width / 8 - 6;
+      image.pixels[static_cast<size_t>(y) * width + x] =
+          frame ? 0 : static_cast<uint8_t>((x + y) * 255 / (width + image.height));
+    }
+  }
+  return image;
+}
+
+void BM_Dither(benchmark::State& state) {
+  const GrayImage image = SampleLogo(static_cast<int>(state.range(0)));
+  const DitherMode mode = static_cast<DitherMode>(state.range(1));
+  for (auto _ : state) {
+    MonoBitmap bitmap = Dither(image, mode);
+    benchmark::DoNotOptimize(bitmap.bits.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.pixels.size()));
+}
+
+void BM_RasterBlock(benchmark::State& state) {
+  const MonoBitmap bitmap =
+      Dither(SampleLogo(static_cast<int>(state.range(0))), DitherMode::kFloydSteinberg);
+  RasterOptions options;
+  options.compact = state.range(1) != 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::vector<uint8_t> block = RasterBlock(bitmap, options);
+    benchmark::DoNotOptimize(block.data());
+    bytes = block.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.counters["bytes/logo"] = static_cast<double>(bytes);
+}
+
+// Source image to raster block, as a cache miss costs
+void BM_RasterizeLogo(benchmark::State& state) {
+  const GrayImage image = SampleLogo(1024);
+  const int width = static_cast<int>(state.range(0));
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::vector<uint8_t> block = RasterizeLogo(image, width, DitherMode::kFloydSteinberg);
+    benchmark::DoNotOptimize(block.data());
+    bytes = block.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bytes/logo"] = static_cast<double>(bytes);
+}
+
+BENCHMARK(BM_Dither)->ArgsProduct({{kLogoWidth80mm, kLogoWidthFull80mm}, {0, 1, 2}});
+BENCHMARK(BM_RasterBlock)->ArgsProduct({{kLogoWidth80mm, kLogoWidthFull80mm}, {0, 1}});
+BENCHMARK(BM_RasterizeLogo)->Arg(kLogoWidth80mm)->Arg(kLogoWidthFull80mm);
+
+}  // namespace
+}  // namespace bench
+}  // namespace printer_core
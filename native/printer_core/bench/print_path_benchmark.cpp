@@ -0,0 +1,241 @@
+// Print paths end to end, through the job queue and connection pool to a
+// printer on a loopback socket. Time is per receipt, submit to completion.
+//
+// BM_PrintReceipt is printReceipt as the Linux runner takes it: encode, take
+// the buffer, optimize. BM_PrintRaw queues bytes the Dart side encoded,
+// starting from the buffer the codec decoded the Uint8List into, which the
+// runners hand to the job without a copy;
+// BM_PrintRawAsContent sends the same bytes the old way, as a receiptData
+// content string the runner re-encodes line by line. The "copies/receipt"
+// counter is how many writes reached the socket from a buffer other than
+// the one the codec produced.
+//
+// BM_PrintReceiptTraced is BM_PrintReceipt with a JobTracer timeline per
+// receipt (encode, queue, connect, write, job), as the runners record it;
+// BM_TraceRecord is the cost of one span.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "connection_pool.h"
+#include "escpos_encoder.h"
+#include "escpos_optimizer.h"
+#include "job_trace.h"
+#include "loopback_printer.h"
+#include "print_job_queue.h"
+#include "sample_receipts.h"
+
+namespace printer_core {
+namespace bench {
+namespace {
+
+// Where the codec left the bytes of the current job, and writes that came
+// from anywhere else.
+struct CopySpy {
+  std::atomic<const uint8_t*> begin{nullptr};
+  std::atomic<const uint8_t*> end{nullptr};
+  std::atomic<int64_t> copied_writes{0};
+
+  void Watch(const uint8_t* data, size_t size) {
+    begin = data;
+    end = data + size;
+  }
+};
+
+class SpyTransport : public PrinterTransport {
+ public:
+  SpyTransport(std::unique_ptr<PrinterTransport> inner, CopySpy* spy)
+      : inner_(std::move(inner)), spy_(spy) {}
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    if (data < spy_->begin.load() || data + size > spy_->end.load()) ++spy_->copied_writes;
+    return inner_->Write(data, size, error);
+  }
+
+  long Read(uint8_t* data, size_t size, int timeout_ms, std::string* error) override {
+    return inner_->Read(data, size, timeout_ms, error);
+  }
+
+ private:
+  std::unique_ptr<PrinterTransport> inner_;
+  CopySpy* spy_;
+};
+
+// A loopback printer behind a pooled job queue; Print() waits for the job.
+class LoopbackQueue {
+ public:
+  LoopbackQueue()
+      : pool_(PoolOptions()),
+        queue_(2, [this](const PrinterTarget& target, std::string* error)
+                      -> std::unique_ptr<PrinterTransport> {
+          std::unique_ptr<PrinterTransport> transport = pool_.Acquire(target, error);
+          if (!transport) return nullptr;
+          return std::make_unique<SpyTransport>(std::move(transport), &spy_);
+        }),
+        target_(PrinterTarget::Network("127.0.0.1", printer_.port())) {
+    printer_.set_recording(false);
+  }
+
+  ~LoopbackQueue() { queue_.Shutdown(); }
+
+  bool ok() const { return printer_.ok(); }
+  CopySpy& spy() { return spy_; }
+  void set_tracer(JobTracer* tracer) { queue_.set_tracer(tracer); }
+
+  bool Print(std::vector<uint8_t> data, std::string* error, uint64_t trace_id = 0) {
+    PrintJob job;
+    job.target = target_;
+    job.data = std::move(data);
+    job.trace_id = trace_id;
+    done_ = false;
+    queue_.Submit(std::move(job), [this](const PrintJobResult& r) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result_ = r;
+      done_ = true;
+      done_cv_.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return done_; });
+    *error = result_.error;
+    return result_.success;
+  }
+
+ private:
+  static ConnectionPoolOptions PoolOptions() {
+    ConnectionPoolOptions options;
+    options.maintenance_interval_ms = 0;
+    return options;
+  }
+
+  testing::LoopbackPrinter printer_;
+  CopySpy spy_;
+  ConnectionPool pool_;
+  PrintJobQueue queue_;
+  PrinterTarget target_;
+  std::mutex mutex_;
+  std::condition_variable done_cv_;
+  bool done_ = false;
+  PrintJobResult result_;
+};
+
+void SetPrintCounters(benchmark::State& state, size_t bytes, const CopySpy& spy) {
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.counters["bytes/receipt"] = static_cast<double>(bytes);
+  state.counters["copies/receipt"] = benchmark::Counter(
+      static_cast<double>(spy.copied_writes.load()), benchmark::Counter::kAvgIterations);
+}
+
+void PrintReceipt(benchmark::State& state, JobTracer* tracer) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  LoopbackQueue printer;
+  if (!printer.ok()) {
+    state.SkipWithError("cannot listen on loopback");
+    return;
+  }
+  printer.set_tracer(tracer);
+  EscPosEncoder encoder(48);
+  std::string error;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const uint64_t trace_id = tracer ? tracer->BeginJob() : 0;
+    std::vector<uint8_t> data;
+    {
+      ScopedTraceSpan span(tracer, trace_id, "encode");
+      encoder.EncodeReceipt(receipt.doc());
+      data = encoder.TakeBuffer();
+      OptimizeEscPos(&data);
+    }
+    bytes = data.size();
+    printer.spy().Watch(data.data(), data.size());
+    const bool ok = printer.Print(std::move(data), &error, trace_id);
+    if (tracer) tracer->FinishJob(trace_id);
+    if (!ok) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  SetPrintCounters(state, bytes, printer.spy());
+}
+
+void BM_PrintReceipt(benchmark::State& state) { PrintReceipt(state, nullptr); }
+
+void BM_PrintReceiptTraced(benchmark::State& state) {
+  JobTracer tracer;
+  PrintReceipt(state, &tracer);
+}
+
+void BM_TraceRecord(benchmark::State& state) {
+  JobTracer tracer;
+  const uint64_t trace_id = tracer.BeginJob();
+  for (auto _ : state) {
+    ScopedTraceSpan span(&tracer, trace_id, "write");
+    span.set_arg("bytes", 512);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_PrintRaw(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  LoopbackQueue printer;
+  if (!printer.ok()) {
+    state.SkipWithError("cannot listen on loopback");
+    return;
+  }
+  EscPosEncoder encoder(48);
+  const std::vector<uint8_t> encoded = encoder.EncodeReceipt(receipt.doc());
+  std::string error;
+  for (auto _ : state) {
+    // The codec decoding the Uint8List
+    std::vector<uint8_t> decoded(encoded);
+    printer.spy().Watch(decoded.data(), decoded.size());
+    if (!printer.Print(std::move(decoded), &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  SetPrintCounters(state, encoded.size(), printer.spy());
+}
+
+void BM_PrintRawAsContent(benchmark::State& state) {
+  const BuffetReceipt receipt(static_cast<int>(state.range(0)));
+  LoopbackQueue printer;
+  if (!printer.ok()) {
+    state.SkipWithError("cannot listen on loopback");
+    return;
+  }
+  EscPosEncoder encoder(48);
+  const std::vector<uint8_t> encoded = encoder.EncodeReceipt(receipt.doc());
+  std::string error;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    // The codec decoding the content string
+    const std::string content(encoded.begin(), encoded.end());
+    printer.spy().Watch(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+    encoder.EncodeText(content);
+    std::vector<uint8_t> data = encoder.TakeBuffer();
+    OptimizeEscPos(&data);
+    bytes = data.size();
+    if (!printer.Print(std::move(data), &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  SetPrintCounters(state, bytes, printer.spy());
+}
+
+BENCHMARK(BM_PrintReceipt)->Apply(ReceiptSizes)->UseRealTime();
+BENCHMARK(BM_PrintReceiptTraced)->Apply(ReceiptSizes)->UseRealTime();
+BENCHMARK(BM_TraceRecord);
+BENCHMARK(BM_PrintRaw)->Apply(ReceiptSizes)->UseRealTime();
+BENCHMARK(BM_PrintRawAsContent)->Apply(ReceiptSizes)->UseRealTime();
+
+}  // namespace
+}  // namespace bench
+}  // namespace printer_core
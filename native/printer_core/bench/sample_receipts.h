@@ -0,0 +1,82 @@
+#ifndef PRINTER_CORE_BENCH_SAMPLE_RECEIPTS_H_
+#define PRINTER_CORE_BENCH_SAMPLE_RECEIPTS_H_
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "text_layout.h"
+
+namespace printer_core {
+namespace bench {
+
+// Receipt sizes every encode benchmark runs at: a single drink, a table, a
+// buffet, and an end-of-day listing.
+constexpr int kReceiptSizes[] = {1, 50, 500, 5000};
+
+// Runs a benchmark once per kReceiptSizes entry, passed as range(0).
+inline void ReceiptSizes(benchmark::internal::Benchmark* b) {
+  for (int items : kReceiptSizes) b->Arg(items);
+}
+
+// A buffet receipt with |items| lines of mixed names, quantities and prices,
+// totals, a barcode and a QR code. Owns the strings the document views.
+class BuffetReceipt {
+ public:
+  explicit BuffetReceipt(int items) {
+    static const char* const kDishes[] = {
+        "Nasi Lemak Ayam Goreng", "Teh Tarik", "Roti Canai Telur", "Mee Goreng Mamak",
+        "Kopi O Ais", "Char Kuey Teow Udang", "Satay Ayam (10 cucuk)", "Cendol Durian"};
+    names_.reserve(static_cast<size_t>(items));
+    for (int i = 0; i < items; ++i) {
+      names_.push_back(std::string(kDishes[i % 8]) + " #" + std::to_string(i + 1));
+    }
+    double subtotal = 0;
+    for (int i = 0; i < items; ++i) {
+      ReceiptItem item;
+      item.name = names_[static_cast<size_t>(i)];
+      item.quantity = 1 + i % 3;
+      item.price = 2.5 + (i % 17) * 0.85;
+      subtotal += item.price * item.quantity;
+      doc_.items.push_back(item);
+    }
+    doc_.title = "EXTROPOS BUFFET";
+    doc_.subtotal = subtotal;
+    doc_.tax = subtotal * 0.06;
+    doc_.service_charge = subtotal * 0.10;
+    doc_.total = subtotal * 1.16;
+    doc_.barcode = "INV-000123";
+    doc_.qr_data = "https://myinvois.hasil.gov.my/abc";
+
+    // The same receipt as laid-out rows
+    rows_.reserve(doc_.items.size());
+    prices_.reserve(doc_.items.size());
+    for (const ReceiptItem& item : doc_.items) {
+      prices_.push_back("RM " + std::to_string(item.price * item.quantity).substr(0, 5));
+      ReceiptRow row;
+      row.left = item.name;
+      row.right = prices_.back();
+      rows_.push_back(row);
+    }
+  }
+
+  BuffetReceipt(const BuffetReceipt&) = delete;
+  BuffetReceipt& operator=(const BuffetReceipt&) = delete;
+
+  const ReceiptDocument& doc() const { return doc_; }
+  const std::vector<ReceiptRow>& rows() const { return rows_; }
+  const std::vector<std::string>& names() const { return names_; }
+
+ private:
+  std::vector<std::string> names_;
+  std::vector<std::string> prices_;
+  ReceiptDocument doc_;
+  std::vector<ReceiptRow> rows_;
+};
+
+}  // namespace bench
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_BENCH_SAMPLE_RECEIPTS_H_
@@ -0,0 +1,418 @@
+#include "code_page.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "text_layout.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <iconv.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PRINTER_CORE_SSE2 1
+#endif
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+
+// Unicode code points of bytes 0x80-0xFF; 0 where the table has none.
+constexpr uint16_t kCp437High[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+constexpr uint16_t kCp858High[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00F8, 0x00A3, 0x00D8, 0x00D7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x00AE, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x00C1, 0x00C2, 0x00C0,
+    0x00A9, 0x2563, 0x2551, 0x2557, 0x255D, 0x00A2, 0x00A5, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x00E3, 0x00C3,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x00A4,
+    0x00F0, 0x00D0, 0x00CA, 0x00CB, 0x00C8, 0x20AC, 0x00CD, 0x00CE,
+    0x00CF, 0x2518, 0x250C, 0x2588, 0x2584, 0x00A6, 0x00CC, 0x2580,
+    0x00D3, 0x00DF, 0x00D4, 0x00D2, 0x00F5, 0x00D5, 0x00B5, 0x00FE,
+    0x00DE, 0x00DA, 0x00DB, 0x00D9, 0x00FD, 0x00DD, 0x00AF, 0x00B4,
+    0x00AD, 0x00B1, 0x2017, 0x00BE, 0x00B6, 0x00A7, 0x00F7, 0x00B8,
+    0x00B0, 0x00A8, 0x00B7, 0x00B9, 0x00B3, 0x00B2, 0x25A0, 0x00A0,
+};
+constexpr uint16_t kCp1252High[128] = {
+    0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017D, 0x0000,
+    0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x017E, 0x0178,
+    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+    0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+    0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+};
+
+// A single-byte table: its ESC t number and code point -> byte pairs sorted
+// for binary search.
+struct SingleByteTable {
+  CodePage page;
+  uint8_t esc_t;
+  std::array<std::pair<uint16_t, uint8_t>, 128> reverse;
+  size_t size = 0;
+
+  SingleByteTable(CodePage p, uint8_t n, const uint16_t (&high)[128]) : page(p), esc_t(n) {
+    for (int i = 0; i < 128; ++i) {
+      if (high[i] != 0) reverse[size++] = {high[i], static_cast<uint8_t>(0x80 + i)};
+    }
+    std::sort(reverse.begin(), reverse.begin() + size);
+  }
+
+  // The byte for |code_point|, or 0.
+  uint8_t Find(uint32_t code_point) const {
+    if (code_point > 0xFFFF) return 0;
+    const auto end = reverse.begin() + size;
+    const auto it = std::lower_bound(reverse.begin(), end,
+                                     std::make_pair(static_cast<uint16_t>(code_point), uint8_t{0}));
+    return it != end && it->first == code_point ? it->second : 0;
+  }
+};
+
+const std::array<SingleByteTable, 3>& SingleByteTables() {
+  static const std::array<SingleByteTable, 3> tables = {
+      SingleByteTable(CodePage::kCp437, 0, kCp437High),
+      SingleByteTable(CodePage::kCp858, 19, kCp858High),
+      SingleByteTable(CodePage::kCp1252, 16, kCp1252High),
+  };
+  return tables;
+}
+
+const SingleByteTable* TableFor(CodePage page) {
+  for (const SingleByteTable& table : SingleByteTables()) {
+    if (table.page == page) return &table;
+  }
+  return nullptr;
+}
+
+void AppendUtf8(uint32_t code_point, std::string* utf8) {
+  if (code_point < 0x80) {
+    utf8->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    utf8->push_back(static_cast<char>(0xC0 | code_point >> 6));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    utf8->push_back(static_cast<char>(0xE0 | code_point >> 12));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    utf8->push_back(static_cast<char>(0xF0 | code_point >> 18));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+constexpr uint32_t kReplacement = 0xFFFD;
+
+// Length of the ASCII run at the start of |data|.
+size_t AsciiPrefix(const uint8_t* data, size_t size) {
+  size_t i = 0;
+#ifdef PRINTER_CORE_SSE2
+  for (; i + 16 <= size; i += 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const int high = _mm_movemask_epi8(chunk);
+    if (high != 0) {
+      int bit = 0;
+      while (!(high & (1 << bit))) ++bit;
+      return i + bit;
+    }
+  }
+#endif
+  while (i < size && data[i] < 0x80) ++i;
+  return i;
+}
+
+}  // namespace
+
+bool ParseCodePage(std::string_view name, CodePage* page) {
+  static const std::pair<std::string_view, CodePage> kNames[] = {
+      {"none", CodePage::kNone},       {"cp437", CodePage::kCp437},
+      {"cp858", CodePage::kCp858},     {"cp1252", CodePage::kCp1252},
+      {"gb18030", CodePage::kGb18030}, {"big5", CodePage::kBig5},
+  };
+  for (const auto& entry : kNames) {
+    if (entry.first == name) {
+      *page = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+CodePage CodePageForEscT(uint8_t n) {
+  for (const SingleByteTable& table : SingleByteTables()) {
+    if (table.esc_t == n) return table.page;
+  }
+  return CodePage::kNone;
+}
+
+CodePageTranscoder::CodePageTranscoder(CodePage single_byte, CodePage double_byte)
+    : single_byte_(single_byte), double_byte_(double_byte) {}
+
+CodePageTranscoder::~CodePageTranscoder() {
+#ifndef _WIN32
+  if (converter_ != nullptr) iconv_close(static_cast<iconv_t>(converter_));
+#endif
+}
+
+void CodePageTranscoder::set_pages(CodePage single_byte, CodePage double_byte) {
+  single_byte_ = single_byte;
+  if (double_byte != double_byte_) {
+#ifndef _WIN32
+    if (converter_ != nullptr) iconv_close(static_cast<iconv_t>(converter_));
+    converter_ = nullptr;
+#endif
+    double_byte_ = double_byte;
+  }
+  Reset();
+}
+
+void CodePageTranscoder::Reset() {
+  selected_ = CodePage::kNone;
+  double_byte_mode_ = -1;
+}
+
+size_t CodePageTranscoder::Transcode(std::string_view utf8, uint8_t* out) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(utf8.data());
+  const size_t size = utf8.size();
+  size_t written = 0;
+  size_t i = 0;
+  while (i < size) {
+    // ASCII is the same in every table and in double-byte mode.
+    const size_t ascii = AsciiPrefix(data + i, size - i);
+    std::memcpy(out + written, data + i, ascii);
+    written += ascii;
+    i += ascii;
+    if (i == size) break;
+
+    uint32_t code_point = 0;
+    const size_t length = DecodeUtf8(data + i, size - i, &code_point);
+    if (length == 0) {
+      out[written++] = '?';
+      ++i;
+      continue;
+    }
+    written += EncodeCharacter(code_point, utf8.substr(i, length), out + written);
+    i += length;
+  }
+  return written;
+}
+
+void CodePageTranscoder::Append(std::string_view utf8, std::vector<uint8_t>* out) {
+  const size_t start = out->size();
+  out->resize(start + kTranscodeMaxExpansion * utf8.size());
+  out->resize(start + Transcode(utf8, out->data() + start));
+}
+
+size_t CodePageTranscoder::EncodeCharacter(uint32_t code_point, std::string_view utf8,
+                                           uint8_t* out) {
+  // The selected table first, then the preferred one, then the rest
+  const SingleByteTable* table = nullptr;
+  uint8_t byte = 0;
+  const SingleByteTable* selected = TableFor(selected_);
+  const SingleByteTable* preferred = TableFor(single_byte_);
+  if (selected != nullptr && (byte = selected->Find(code_point)) != 0) {
+    table = selected;
+  } else if (preferred != nullptr && (byte = preferred->Find(code_point)) != 0) {
+    table = preferred;
+  } else {
+    for (const SingleByteTable& other : SingleByteTables()) {
+      if ((byte = other.Find(code_point)) != 0) {
+        table = &other;
+        break;
+      }
+    }
+  }
+
+  size_t n = 0;
+  if (table != nullptr) {
+    // Bytes above 0x7F would start a double-byte character in FS & mode.
+    if (double_byte_ != CodePage::kNone && double_byte_mode_ != 0) {
+      out[n++] = kFs;
+      out[n++] = '.';
+      double_byte_mode_ = 0;
+    }
+    if (selected_ != table->page) {
+      out[n++] = kEsc;
+      out[n++] = 't';
+      out[n++] = table->esc_t;
+      selected_ = table->page;
+    }
+    out[n++] = byte;
+    return n;
+  }
+
+  // Combining marks and format characters take no column; leave them out.
+  if (CodePointWidth(code_point) == 0) return 0;
+
+  if (double_byte_ != CodePage::kNone) {
+    uint8_t encoded[4];
+    const size_t length = EncodeDoubleByte(utf8, encoded);
+    if (length > 0) {
+      if (double_byte_mode_ != 1) {
+        out[n++] = kFs;
+        out[n++] = '&';
+        double_byte_mode_ = 1;
+      }
+      std::memcpy(out + n, encoded, length);
+      return n + length;
+    }
+  }
+  out[n++] = '?';
+  return n;
+}
+
+size_t CodePageTranscoder::EncodeDoubleByte(std::string_view utf8, uint8_t* out) {
+#ifdef _WIN32
+  wchar_t wide[2];
+  const int units = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8.data(),
+                                        static_cast<int>(utf8.size()), wide, 2);
+  if (units <= 0) return 0;
+  char bytes[4];
+  int length;
+  if (double_byte_ == CodePage::kGb18030) {
+    // GB18030 covers all of Unicode; the code page rejects a used-default
+    // flag.
+    length = WideCharToMultiByte(54936, 0, wide, units, bytes, sizeof(bytes), nullptr, nullptr);
+  } else {
+    BOOL used_default = FALSE;
+    length = WideCharToMultiByte(950, WC_NO_BEST_FIT_CHARS, wide, units, bytes, sizeof(bytes),
+                                 nullptr, &used_default);
+    if (used_default) return 0;
+  }
+  if (length <= 0) return 0;
+  std::memcpy(out, bytes, length);
+  return static_cast<size_t>(length);
+#else
+  if (converter_ == nullptr) {
+    const iconv_t converter =
+        iconv_open(double_byte_ == CodePage::kGb18030 ? "GB18030" : "BIG5", "UTF-8");
+    if (converter == reinterpret_cast<iconv_t>(-1)) return 0;
+    converter_ = converter;
+  }
+  char* in = const_cast<char*>(utf8.data());
+  size_t in_left = utf8.size();
+  char* to = reinterpret_cast<char*>(out);
+  size_t out_left = 4;
+  const size_t result = iconv(static_cast<iconv_t>(converter_), &in, &in_left, &to, &out_left);
+  if (result == static_cast<size_t>(-1) || in_left != 0) {
+    // Back to the initial state after a failed conversion
+    iconv(static_cast<iconv_t>(converter_), nullptr, nullptr, nullptr, nullptr);
+    return 0;
+  }
+  return 4 - out_left;
+#endif
+}
+
+CodePageDecoder::CodePageDecoder(CodePage double_byte) : double_byte_(double_byte) {}
+
+CodePageDecoder::~CodePageDecoder() {
+#ifndef _WIN32
+  if (converter_ != nullptr) iconv_close(static_cast<iconv_t>(converter_));
+#endif
+}
+
+size_t CodePageDecoder::DoubleByteLength(const uint8_t* data, size_t size) const {
+  // GB18030 second bytes 0x30-0x39 start a four-byte sequence.
+  const size_t length =
+      double_byte_ == CodePage::kGb18030 && size >= 2 && data[1] >= 0x30 && data[1] <= 0x39 ? 4
+                                                                                            : 2;
+  return length <= size ? length : 0;
+}
+
+void CodePageDecoder::AppendSingleByte(CodePage table, uint8_t b, std::string* utf8) {
+  if (b < 0x80) {
+    utf8->push_back(static_cast<char>(b));
+    return;
+  }
+  const uint16_t* high = table == CodePage::kCp437    ? kCp437High
+                         : table == CodePage::kCp858  ? kCp858High
+                         : table == CodePage::kCp1252 ? kCp1252High
+                                                      : nullptr;
+  const uint32_t code_point = high != nullptr ? high[b - 0x80] : 0;
+  AppendUtf8(code_point != 0 ? code_point : kReplacement, utf8);
+}
+
+void CodePageDecoder::AppendDoubleByte(std::string_view bytes, std::string* utf8) {
+  if (double_byte_ == CodePage::kNone || bytes.size() > 4) {
+    AppendUtf8(kReplacement, utf8);
+    return;
+  }
+#ifdef _WIN32
+  wchar_t wide[2];
+  const int units =
+      MultiByteToWideChar(double_byte_ == CodePage::kGb18030 ? 54936 : 950, MB_ERR_INVALID_CHARS,
+                          bytes.data(), static_cast<int>(bytes.size()), wide, 2);
+  char out[8];
+  const int length =
+      units > 0 ? WideCharToMultiByte(CP_UTF8, 0, wide, units, out, sizeof(out), nullptr, nullptr)
+                : 0;
+  if (length <= 0) {
+    AppendUtf8(kReplacement, utf8);
+    return;
+  }
+  utf8->append(out, static_cast<size_t>(length));
+#else
+  if (converter_ == nullptr) {
+    const iconv_t converter =
+        iconv_open("UTF-8", double_byte_ == CodePage::kGb18030 ? "GB18030" : "BIG5");
+    if (converter == reinterpret_cast<iconv_t>(-1)) {
+      AppendUtf8(kReplacement, utf8);
+      return;
+    }
+    converter_ = converter;
+  }
+  char* in = const_cast<char*>(bytes.data());
+  size_t in_left = bytes.size();
+  char out[8];
+  char* to = out;
+  size_t out_left = sizeof(out);
+  const size_t result = iconv(static_cast<iconv_t>(converter_), &in, &in_left, &to, &out_left);
+  if (result == static_cast<size_t>(-1) || in_left != 0) {
+    iconv(static_cast<iconv_t>(converter_), nullptr, nullptr, nullptr, nullptr);
+    AppendUtf8(kReplacement, utf8);
+    return;
+  }
+  utf8->append(out, sizeof(out) - out_left);
+#endif
+}
+
+}  // namespace printer_core
@@ -0,0 +1,133 @@
+#ifndef PRINTER_CORE_CODE_PAGE_H_
+#define PRINTER_CORE_CODE_PAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace printer_core {
+
+// Character tables a printer can print text outside ASCII with.
+enum class CodePage {
+  kNone,
+  // Single-byte tables, selected with ESC t
+  kCp437,
+  kCp858,
+  kCp1252,
+  // Double-byte encodings of Chinese models, entered with FS &
+  kGb18030,
+  kBig5,
+};
+
+// "cp437", "cp858", "cp1252", "gb18030", "big5" or "none".
+bool ParseCodePage(std::string_view name, CodePage* page);
+
+// The single-byte table ESC t |n| selects, or kNone for tables not listed
+// above.
+CodePage CodePageForEscT(uint8_t n);
+
+// Most bytes Transcode() writes per input byte: a two-byte UTF-8 character
+// can cost FS . and ESC t n before its own byte.
+constexpr size_t kTranscodeMaxExpansion = 3;
+
+// Converts UTF-8 text to the bytes a printer prints, tracking the printer's
+// code page so ESC t / FS & / FS . go out only when it has to change. ASCII
+// passes through unchanged (checked 16 bytes at a time). Characters outside
+// ASCII use the preferred single-byte table, then the other single-byte
+// tables, then the double-byte encoding if the printer has one. Combining
+// marks the tables lack are dropped; anything else, and malformed UTF-8,
+// prints as '?', so output matches DisplayWidth(). Not thread-safe; use one
+// per encoder.
+class CodePageTranscoder {
+ public:
+  // |single_byte| is the preferred ESC t table; |double_byte| is kGb18030 or
+  // kBig5 on Chinese models and kNone elsewhere.
+  explicit CodePageTranscoder(CodePage single_byte = CodePage::kCp437,
+                              CodePage double_byte = CodePage::kNone);
+  ~CodePageTranscoder();
+
+  CodePageTranscoder(const CodePageTranscoder&) = delete;
+  CodePageTranscoder& operator=(const CodePageTranscoder&) = delete;
+
+  void set_pages(CodePage single_byte, CodePage double_byte);
+
+  // Forgets which table the printer has selected, as after ESC @ (which
+  // restores the printer's own default).
+  void Reset();
+
+  // Which table and mode the printer has selected after the bytes written
+  // so far, for callers that splice in text transcoded earlier.
+  struct State {
+    CodePage selected = CodePage::kNone;
+    int double_byte_mode = -1;
+  };
+  State state() const { return {selected_, double_byte_mode_}; }
+  void set_state(const State& state) {
+    selected_ = state.selected;
+    double_byte_mode_ = state.double_byte_mode;
+  }
+
+  // Writes |utf8| converted to |out|, which must hold
+  // kTranscodeMaxExpansion * utf8.size() bytes. Returns the bytes written.
+  size_t Transcode(std::string_view utf8, uint8_t* out);
+
+  void Append(std::string_view utf8, std::vector<uint8_t>* out);
+
+ private:
+  // Writes |code_point| (UTF-8 in |utf8|) in the first table that has it.
+  size_t EncodeCharacter(uint32_t code_point, std::string_view utf8, uint8_t* out);
+  // Double-byte bytes for |utf8|, or 0 if the encoding lacks it.
+  size_t EncodeDoubleByte(std::string_view utf8, uint8_t* out);
+
+  CodePage single_byte_;
+  CodePage double_byte_;
+  // Table the printer has selected; kNone when unknown.
+  CodePage selected_ = CodePage::kNone;
+  // Whether FS & is in effect: unknown (-1), off (0) or on (1).
+  int double_byte_mode_ = -1;
+#ifndef _WIN32
+  // iconv_t from UTF-8 to double_byte_, opened on first use.
+  void* converter_ = nullptr;
+#endif
+};
+
+// Converts printed bytes back to UTF-8, for reading a stream the way the
+// printer would. Not thread-safe.
+class CodePageDecoder {
+ public:
+  // |double_byte| is what FS & selects on the model: kGb18030, kBig5 or
+  // kNone.
+  explicit CodePageDecoder(CodePage double_byte = CodePage::kNone);
+  ~CodePageDecoder();
+
+  CodePageDecoder(const CodePageDecoder&) = delete;
+  CodePageDecoder& operator=(const CodePageDecoder&) = delete;
+
+  CodePage double_byte() const { return double_byte_; }
+
+  // Bytes in the double-byte character starting at |data| (first byte
+  // >= 0x80): 2, or 4 for GB18030 four-byte sequences; 0 if it runs past
+  // |size|.
+  size_t DoubleByteLength(const uint8_t* data, size_t size) const;
+
+  // Appends byte |b| of single-byte table |table|. Bytes the table lacks,
+  // and bytes above 0x7F of tables not listed, append U+FFFD.
+  static void AppendSingleByte(CodePage table, uint8_t b, std::string* utf8);
+
+  // Appends the double-byte character |bytes|, or U+FFFD if the encoding
+  // lacks it.
+  void AppendDoubleByte(std::string_view bytes, std::string* utf8);
+
+ private:
+  CodePage double_byte_;
+#ifndef _WIN32
+  // iconv_t from double_byte_ to UTF-8, opened on first use.
+  void* converter_ = nullptr;
+#endif
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_CODE_PAGE_H_
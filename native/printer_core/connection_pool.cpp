@@ -0,0 +1,233 @@
+#include "connection_pool.h"
+
+#include <iterator>
+#include <utility>
+
+namespace printer_core {
+
+class ConnectionPool::PooledTransport : public PrinterTransport {
+ public:
+  PooledTransport(ConnectionPool* pool, PrinterTarget target,
+                  SocketHandle socket, bool reused)
+      : pool_(pool),
+        target_(std::move(target)),
+        socket_(socket),
+        reused_(reused) {}
+
+  ~PooledTransport() override {
+    if (broken_) {
+      CloseSocket(socket_);
+    } else {
+      pool_->Release(target_.Key(), socket_);
+    }
+  }
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    const ByteSpan span{data, size};
+    size_t written = 0;
+    return WriteV(&span, 1, &written, error);
+  }
+
+  bool WriteV(const ByteSpan* spans, size_t count, size_t* written,
+              std::string* error) override {
+    if (SendAllV(socket_, spans, count, target_.write_timeout_ms, error, written)) {
+      reused_ = true;
+      return true;
+    }
+    // A pooled socket can pass the idle check and still be dead. Retry once
+    // on a fresh connection, but only if nothing reached the printer, so a
+    // retry never prints part of a receipt twice.
+    if (!reused_ || *written != 0) {
+      broken_ = true;
+      return false;
+    }
+    CloseSocket(socket_);
+    socket_ = pool_->Connect(target_, error);
+    if (socket_ == kInvalidSocket) {
+      broken_ = true;
+      return false;
+    }
+    pool_->CountReconnect();
+    reused_ = false;
+    if (!SendAllV(socket_, spans, count, target_.write_timeout_ms, error, written)) {
+      broken_ = true;
+      return false;
+    }
+    reused_ = true;
+    return true;
+  }
+
+  long Read(uint8_t* data, size_t size, int timeout_ms,
+            std::string* error) override {
+    bool timed_out = false;
+    const long n = Receive(socket_, data, size, timeout_ms, &timed_out, error);
+    // A closed or failed socket must not go back to the pool.
+    if (n < 0 || (n == 0 && !timed_out)) broken_ = true;
+    return n;
+  }
+
+ private:
+  ConnectionPool* pool_;
+  PrinterTarget target_;
+  SocketHandle socket_;
+  // True while the socket has carried an earlier write (from the pool or
+  // this lease); only such sockets are worth a transparent reconnect.
+  bool reused_;
+  bool broken_ = false;
+};
+
+ConnectionPool::ConnectionPool(ConnectionPoolOptions options)
+    : options_(options) {
+  if (options_.maintenance_interval_ms > 0) {
+    maintenance_ = std::thread([this] { MaintenanceLoop(); });
+  }
+}
+
+ConnectionPool::~ConnectionPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (maintenance_.joinable()) maintenance_.join();
+  Clear();
+}
+
+std::unique_ptr<PrinterTransport> ConnectionPool::Acquire(
+    const PrinterTarget& target, std::string* error) {
+  if (target.kind != PrinterTarget::Kind::kNetwork) {
+    return OpenDefaultTransport(target, error);
+  }
+
+  const std::string key = target.Key();
+  for (;;) {
+    SocketHandle socket = kInvalidSocket;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = idle_.find(key);
+      if (it == idle_.end() || it->second.empty()) break;
+      // Most recently used first: the likeliest to still be open.
+      socket = it->second.back().socket;
+      it->second.pop_back();
+    }
+    std::vector<uint8_t> unsolicited;
+    const bool alive = IsConnectionAlive(socket, &unsolicited);
+    Deliver(key, unsolicited);
+    if (alive) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.hits;
+      return std::make_unique<PooledTransport>(this, target, socket, true);
+    }
+    CloseSocket(socket);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.health_failures;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.misses;
+  }
+  SocketHandle socket = Connect(target, error);
+  if (socket == kInvalidSocket) return nullptr;
+  return std::make_unique<PooledTransport>(this, target, socket, false);
+}
+
+SocketHandle ConnectionPool::Connect(const PrinterTarget& target,
+                                     std::string* error) {
+  SocketHandle socket =
+      TcpConnect(target.host, target.port, target.connect_timeout_ms, error);
+  if (socket != kInvalidSocket) EnableKeepAlive(socket, options_.keepalive_seconds);
+  return socket;
+}
+
+void ConnectionPool::Release(const std::string& key, SocketHandle socket) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<IdleSocket>& idle = idle_[key];
+    if (!stopping_ && idle.size() < options_.max_idle_per_printer) {
+      idle.push_back(IdleSocket{socket, Clock::now()});
+      return;
+    }
+  }
+  CloseSocket(socket);
+}
+
+void ConnectionPool::CountReconnect() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.reconnects;
+}
+
+void ConnectionPool::RunMaintenance() {
+  const Clock::time_point now = Clock::now();
+  const auto timeout = std::chrono::milliseconds(options_.idle_timeout_ms);
+  std::vector<SocketHandle> to_close;
+  std::vector<std::pair<std::string, std::vector<uint8_t>>> unsolicited;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = idle_.begin(); it != idle_.end();) {
+      std::vector<IdleSocket>& sockets = it->second;
+      std::vector<IdleSocket> keep;
+      for (const IdleSocket& idle : sockets) {
+        std::vector<uint8_t> bytes;
+        if (now - idle.since >= timeout) {
+          ++stats_.reaped;
+          to_close.push_back(idle.socket);
+        } else if (!IsConnectionAlive(idle.socket, &bytes)) {
+          ++stats_.health_failures;
+          to_close.push_back(idle.socket);
+        } else {
+          keep.push_back(idle);
+        }
+        if (!bytes.empty()) unsolicited.emplace_back(it->first, std::move(bytes));
+      }
+      sockets.swap(keep);
+      it = sockets.empty() ? idle_.erase(it) : std::next(it);
+    }
+  }
+  for (SocketHandle socket : to_close) CloseSocket(socket);
+  // Outside mutex_: the listener may take its own locks
+  for (const auto& entry : unsolicited) Deliver(entry.first, entry.second);
+}
+
+void ConnectionPool::set_unsolicited_listener(UnsolicitedListener listener) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  listener_ = std::move(listener);
+}
+
+void ConnectionPool::Deliver(const std::string& key, const std::vector<uint8_t>& bytes) {
+  if (bytes.empty()) return;
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  if (listener_) listener_(key, bytes.data(), bytes.size());
+}
+
+void ConnectionPool::Clear() {
+  std::map<std::string, std::vector<IdleSocket>> idle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle.swap(idle_);
+  }
+  for (const auto& entry : idle) {
+    for (const IdleSocket& socket : entry.second) CloseSocket(socket.socket);
+  }
+}
+
+ConnectionPoolStats ConnectionPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ConnectionPoolStats stats = stats_;
+  stats.idle = 0;
+  for (const auto& entry : idle_) stats.idle += entry.second.size();
+  return stats;
+}
+
+void ConnectionPool::MaintenanceLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    cv_.wait_for(lock, std::chrono::milliseconds(options_.maintenance_interval_ms));
+    if (stopping_) break;
+    lock.unlock();
+    RunMaintenance();
+    lock.lock();
+  }
+}
+
+}  // namespace printer_core
@@ -0,0 +1,113 @@
+#ifndef PRINTER_CORE_CONNECTION_POOL_H_
+#define PRINTER_CORE_CONNECTION_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net_socket.h"
+#include "printer_transport.h"
+
+namespace printer_core {
+
+struct ConnectionPoolOptions {
+  // Idle sockets kept per printer (ip:port). Jobs for one printer are
+  // serialized by the queue, so one is usually enough.
+  size_t max_idle_per_printer = 2;
+  // Idle sockets older than this are closed by maintenance.
+  int idle_timeout_ms = 60000;
+  // TCP keepalive idle time for pooled sockets.
+  int keepalive_seconds = 30;
+  // How often the background thread reaps and health-checks idle sockets;
+  // 0 disables the thread (call RunMaintenance() yourself).
+  int maintenance_interval_ms = 5000;
+};
+
+struct ConnectionPoolStats {
+  // Acquires served by an idle pooled socket.
+  uint64_t hits = 0;
+  // Acquires that had to open a new connection.
+  uint64_t misses = 0;
+  // Writes retried on a fresh socket after a pooled one turned out dead.
+  uint64_t reconnects = 0;
+  // Idle sockets closed for exceeding idle_timeout_ms.
+  uint64_t reaped = 0;
+  // Idle sockets found closed or reset by the printer.
+  uint64_t health_failures = 0;
+  size_t idle = 0;
+};
+
+// Keeps TCP connections to network printers open between jobs so busy
+// printers skip the handshake and session setup. Acquire() hands out a
+// PrinterTransport that goes back to the pool when destroyed, which makes
+// the pool a drop-in TransportFactory for PrintJobQueue. Non-network targets
+// fall through to OpenDefaultTransport. Thread-safe; the pool must outlive
+// every transport it hands out.
+class ConnectionPool {
+ public:
+  // Bytes a printer sent on an idle socket (automatic status blocks, late
+  // status replies), found by the liveness check in Acquire() or
+  // RunMaintenance(). |key| is the PrinterTarget::Key() of the printer.
+  using UnsolicitedListener =
+      std::function<void(const std::string& key, const uint8_t* data, size_t size)>;
+
+  explicit ConnectionPool(ConnectionPoolOptions options = ConnectionPoolOptions());
+  ~ConnectionPool();
+
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+  std::unique_ptr<PrinterTransport> Acquire(const PrinterTarget& target,
+                                            std::string* error);
+
+  // Closes idle sockets that timed out or were closed by the printer.
+  void RunMaintenance();
+
+  // Closes every idle socket; sockets in use are closed when released.
+  void Clear();
+
+  ConnectionPoolStats stats() const;
+
+  // Replaces the listener for unsolicited bytes; pass nullptr to remove it.
+  // Once this returns the old listener is not running and is never called
+  // again. Without a listener the bytes are dropped.
+  void set_unsolicited_listener(UnsolicitedListener listener);
+
+ private:
+  class PooledTransport;
+  using Clock = std::chrono::steady_clock;
+
+  struct IdleSocket {
+    SocketHandle socket;
+    Clock::time_point since;
+  };
+
+  SocketHandle Connect(const PrinterTarget& target, std::string* error);
+  void Release(const std::string& key, SocketHandle socket);
+  void CountReconnect();
+  void MaintenanceLoop();
+  void Deliver(const std::string& key, const std::vector<uint8_t>& bytes);
+
+  const ConnectionPoolOptions options_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, std::vector<IdleSocket>> idle_;
+  ConnectionPoolStats stats_;
+  bool stopping_ = false;
+  std::thread maintenance_;
+  // Held while the listener runs so set_unsolicited_listener() can wait it out.
+  std::mutex listener_mutex_;
+  UnsolicitedListener listener_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_CONNECTION_POOL_H_
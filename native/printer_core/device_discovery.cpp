@@ -0,0 +1,55 @@
+#include "device_discovery.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+namespace printer_core {
+
+namespace {
+
+// Returns N for names of the form "lp<N>", or -1.
+long LinePrinterIndex(const char* name) {
+  if (std::strncmp(name, "lp", 2) != 0 || name[2] == '\0') return -1;
+  char* end = nullptr;
+  const long index = std::strtol(name + 2, &end, 10);
+  return *end == '\0' && index >= 0 ? index : -1;
+}
+
+}  // namespace
+
+std::vector<std::string> ListLinePrinterDevices(const std::string& dir) {
+  std::vector<std::pair<long, std::string>> found;
+#ifndef _WIN32
+  DIR* handle = opendir(dir.c_str());
+  if (!handle) return {};
+  while (dirent* entry = readdir(handle)) {
+    const long index = LinePrinterIndex(entry->d_name);
+    if (index >= 0) found.emplace_back(index, dir + "/" + entry->d_name);
+  }
+  closedir(handle);
+#else
+  (void)dir;
+#endif
+  std::sort(found.begin(), found.end());
+  std::vector<std::string> paths;
+  paths.reserve(found.size());
+  for (auto& entry : found) paths.push_back(std::move(entry.second));
+  return paths;
+}
+
+bool IsDeviceWritable(const std::string& path) {
+#ifndef _WIN32
+  return access(path.c_str(), W_OK) == 0;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+}  // namespace printer_core
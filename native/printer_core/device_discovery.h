@@ -0,0 +1,22 @@
+#ifndef PRINTER_CORE_DEVICE_DISCOVERY_H_
+#define PRINTER_CORE_DEVICE_DISCOVERY_H_
+
+#include <string>
+#include <vector>
+
+namespace printer_core {
+
+// Directory where the Linux usblp driver creates lp0, lp1, ...
+constexpr const char kLinePrinterDeviceDir[] = "/dev/usb";
+
+// Full paths of the lp<N> entries in |dir|, sorted by N. Always empty on
+// Windows, where USB printers go through the vendor DLL or the spooler.
+std::vector<std::string> ListLinePrinterDevices(
+    const std::string& dir = kLinePrinterDeviceDir);
+
+// True if |path| exists and the process may open it for writing.
+bool IsDeviceWritable(const std::string& path);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_DEVICE_DISCOVERY_H_
@@ -0,0 +1,503 @@
+#include "escpos_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "symbology.h"
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kGs = 0x1D;
+constexpr uint8_t kLf = 0x0A;
+
+// Longest "<sign><digits>.<cents>" we ever produce, plus the separating space.
+constexpr size_t kMoneyDigitsMax = 24;
+// " x" followed by a 32-bit quantity.
+constexpr size_t kQuantitySuffixMax = 13;
+// Longest totals label ("Subtotal:").
+constexpr size_t kTotalsLabelMax = 9;
+
+// Native symbol sizes: GS w 2 bars, GS h 80 tall, GS ( k size 6 modules.
+constexpr int kBarcodeModuleDots = 2;
+constexpr int kBarcodeHeight = 80;
+constexpr int kQrModuleDots = 6;
+
+// Cursor over a pre-sized output buffer. Callers guarantee capacity through
+// EscPosEncoder::MeasureReceipt so the writer never checks bounds.
+class Writer {
+ public:
+  explicit Writer(uint8_t* out) : begin_(out), cur_(out) {}
+
+  void Byte(uint8_t b) { *cur_++ = b; }
+  void Bytes(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t b : bytes) *cur_++ = b;
+  }
+  void Bytes(const uint8_t* bytes, size_t size) {
+    if (size == 0) return;
+    std::memcpy(cur_, bytes, size);
+    cur_ += size;
+  }
+  void Bytes(const std::vector<uint8_t>& bytes) { Bytes(bytes.data(), bytes.size()); }
+  // UTF-8 text in the printer's code page.
+  void Text(CodePageTranscoder& transcoder, std::string_view s) {
+    cur_ += transcoder.Transcode(s, cur_);
+  }
+  void Str(std::string_view s) {
+    if (s.empty()) return;
+    std::memcpy(cur_, s.data(), s.size());
+    cur_ += s.size();
+  }
+  void Fill(uint8_t c, int count) {
+    if (count <= 0) return;
+    std::memset(cur_, c, static_cast<size_t>(count));
+    cur_ += count;
+  }
+  size_t size() const { return static_cast<size_t>(cur_ - begin_); }
+
+ private:
+  uint8_t* begin_;
+  uint8_t* cur_;
+};
+
+size_t AppendUnsigned(uint64_t value, char* out) {
+  char tmp[20];
+  size_t n = 0;
+  do {
+    tmp[n++] = static_cast<char>('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+  for (size_t i = 0; i < n; ++i) out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+bool IsPriceLine(std::string_view line) {
+  return line.find("RM") != std::string_view::npos ||
+         line.find('$') != std::string_view::npos;
+}
+
+// Writes "<label><padding><value>\n", or the label and the right-aligned value
+// on separate lines when both do not fit with at least one space between.
+void WriteLabelValue(Writer& w, CodePageTranscoder& transcoder, std::string_view label,
+                     std::string_view value, int chars_per_line, int wide_columns) {
+  const int label_len = static_cast<int>(label.size());
+  const int value_len = DisplayWidth(value, wide_columns);
+  w.Str(label);
+  if (label_len + value_len + 1 > chars_per_line) {
+    w.Byte('\n');
+    w.Fill(' ', chars_per_line - value_len);
+  } else {
+    w.Fill(' ', chars_per_line - label_len - value_len);
+  }
+  w.Text(transcoder, value);
+  w.Byte('\n');
+}
+
+}  // namespace
+
+size_t FormatMoney(std::string_view currency, double value, char* out) {
+  size_t n = 0;
+  if (!currency.empty()) {
+    std::memcpy(out, currency.data(), currency.size());
+    n = currency.size();
+  }
+  out[n++] = ' ';
+
+  if (!std::isfinite(value)) value = 0.0;
+  // Clamp far outside any till amount so the cent count fits in 64 bits.
+  value = std::max(-1e15, std::min(1e15, value));
+  long long cents = std::llround(value * 100.0);
+  if (cents < 0) {
+    out[n++] = '-';
+    cents = -cents;
+  }
+  const uint64_t whole = static_cast<uint64_t>(cents) / 100;
+  const uint64_t frac = static_cast<uint64_t>(cents) % 100;
+  n += AppendUnsigned(whole, out + n);
+  out[n++] = '.';
+  out[n++] = static_cast<char>('0' + frac / 10);
+  out[n++] = static_cast<char>('0' + frac % 10);
+  return n;
+}
+
+EscPosEncoder::EscPosEncoder(int chars_per_line)
+    : chars_per_line_(chars_per_line),
+      transcoder_(profile_.code_page, profile_.chinese_code_page) {}
+
+void EscPosEncoder::set_profile(const PrinterProfile& profile) {
+  // Runners set the profile before every receipt; only a new one costs a
+  // template compile.
+  if (profile == profile_) return;
+  profile_ = profile;
+  transcoder_.set_pages(profile.code_page, profile.chinese_code_page);
+  template_valid_ = false;
+}
+
+void EscPosEncoder::set_chars_per_line(int chars_per_line) {
+  if (chars_per_line == chars_per_line_) return;
+  chars_per_line_ = chars_per_line;
+  template_valid_ = false;
+}
+
+void EscPosEncoder::set_store(const StoreSettings& store) {
+  if (store == store_) return;
+  store_ = store;
+  template_valid_ = false;
+}
+
+int EscPosEncoder::WideColumns() const {
+  return profile_.chinese_code_page != CodePage::kNone ? 2 : 1;
+}
+
+size_t EscPosEncoder::MeasureReceipt(const ReceiptDocument& doc,
+                                     int chars_per_line) {
+  const size_t cpl = static_cast<size_t>(std::max(chars_per_line, 0));
+  // Text may grow when transcoded to the printer's code page.
+  const size_t text = kTranscodeMaxExpansion;
+  const size_t money = text * doc.currency.size() + kMoneyDigitsMax;
+
+  size_t n = 2;                       // ESC @
+  n += 3 + cpl + 1;                   // centre + '=' divider
+  if (doc.title) n += text * doc.title->size() + 1;
+  n += cpl + 1;                       // '-' divider
+  for (const ReceiptItem& item : doc.items) {
+    // Alignment, name and quantity, wrap, padding, price, newline.
+    n += 3 + text * item.name.size() + kQuantitySuffixMax + 1 + cpl + money + 1;
+  }
+  n += cpl + 1;                       // '-' divider
+  n += 4 * (kTotalsLabelMax + 1 + cpl + money + 1);
+  n += cpl + 1;                       // '=' divider
+  if (!doc.barcode.empty()) {
+    n += 16 + std::min<size_t>(doc.barcode.size(), 255) + 1;
+  }
+  if (!doc.qr_data.empty()) {
+    n += 3 + 9 + 8 + 8 + 8 + doc.qr_data.size() + 8 + 1;
+  }
+  n += 1 + 4;                         // feed + cut
+  return n;
+}
+
+void EscPosEncoder::RasterizeSymbols(const ReceiptDocument& doc) {
+  barcode_raster_.clear();
+  qr_raster_.clear();
+  const int dots = profile_.dots_per_line;
+
+  if (!doc.barcode.empty() && !profile_.native_code128 &&
+      EncodeCode128(doc.barcode.substr(0, 255), &symbols_)) {
+    // Narrower bars when the native width would not fit the paper
+    const int modules = Code128Modules(symbols_);
+    const int module_dots = std::min(kBarcodeModuleDots, dots / modules);
+    if (module_dots > 0) {
+      barcode_raster_ = {kEsc, 0x61, 0x01};
+      AppendRasterBands(Code128Bitmap(symbols_, module_dots, kBarcodeHeight),
+                        &barcode_raster_);
+    }
+  }
+
+  QrCode qr;
+  if (!doc.qr_data.empty() && !profile_.native_qr &&
+      EncodeQrCode(doc.qr_data, QrErrorCorrection::kLow, &qr)) {
+    const int module_dots = std::min(kQrModuleDots, dots / (qr.size + 8));
+    if (module_dots > 0) {
+      qr_raster_ = {kEsc, 0x61, 0x01};
+      AppendRasterBands(QrBitmap(qr, module_dots), &qr_raster_);
+      qr_raster_.push_back('\n');
+    }
+  }
+}
+
+void EscPosEncoder::CompileTemplate(const ReceiptDocument& doc) {
+  const int cpl = std::max(chars_per_line_, 0);
+  size_t text = doc.title ? doc.title->size() + 1 : 0;
+  for (const std::string& line : store_.header_lines) text += line.size() + 1;
+  for (const std::string& line : store_.footer_lines) text += line.size() + 1;
+  // Reset, centre, four dividers, footer alignment, feed and cut
+  template_bytes_.resize(2 + 3 + 4 * (static_cast<size_t>(cpl) + 1) + 3 + 1 + 4 +
+                         kTranscodeMaxExpansion * text);
+  template_ops_.clear();
+  Writer w(template_bytes_.data());
+
+  // Each static section is transcoded from an unknown table, so its bytes
+  // select what they need whatever the slot before it printed.
+  size_t start = 0;
+  transcoder_.Reset();
+  auto end_section = [&](TemplateSlot next) {
+    TemplateOp op;
+    op.offset = start;
+    op.size = w.size() - start;
+    op.state = transcoder_.state();
+    op.sets_state = op.state.selected != CodePage::kNone || op.state.double_byte_mode != -1;
+    template_ops_.push_back(op);
+    TemplateOp slot;
+    slot.slot = next;
+    template_ops_.push_back(slot);
+    start = w.size();
+    transcoder_.Reset();
+  };
+
+  // Header
+  w.Bytes({kEsc, 0x40});
+  w.Bytes({kEsc, 0x61, 0x01});
+  w.Fill('=', cpl);
+  w.Byte('\n');
+  if (doc.title) {
+    w.Text(transcoder_, *doc.title);
+    w.Byte('\n');
+  }
+  for (const std::string& line : store_.header_lines) {
+    w.Text(transcoder_, line);
+    w.Byte('\n');
+  }
+  w.Fill('-', cpl);
+  w.Byte('\n');
+  end_section(TemplateSlot::kItems);
+
+  w.Fill('-', cpl);
+  w.Byte('\n');
+  end_section(TemplateSlot::kTotals);
+
+  w.Fill('=', cpl);
+  w.Byte('\n');
+  if (!store_.footer_lines.empty()) {
+    w.Bytes({kEsc, 0x61, 0x01});
+    for (const std::string& line : store_.footer_lines) {
+      w.Text(transcoder_, line);
+      w.Byte('\n');
+    }
+  }
+  end_section(TemplateSlot::kSymbols);
+
+  w.Byte(kLf);
+  w.Bytes({kGs, 0x56, 0x42, 0x00});  // feed and full cut
+  TemplateOp tail;
+  tail.offset = start;
+  tail.size = w.size() - start;
+  template_ops_.push_back(tail);
+  template_bytes_.resize(w.size());
+
+  if (doc.title) {
+    template_title_.emplace(*doc.title);
+  } else {
+    template_title_.reset();
+  }
+  template_valid_ = true;
+  ++templates_compiled_;
+}
+
+const std::vector<uint8_t>& EscPosEncoder::EncodeReceipt(
+    const ReceiptDocument& doc) {
+  const int cpl = chars_per_line_;
+  const int wide = WideColumns();
+  if (!template_valid_ || template_title_.has_value() != doc.title.has_value() ||
+      (doc.title && *template_title_ != *doc.title)) {
+    CompileTemplate(doc);
+  }
+  RasterizeSymbols(doc);
+  buffer_.resize(MeasureReceipt(doc, cpl) + template_bytes_.size() +
+                 barcode_raster_.size() + qr_raster_.size());
+  Writer w(buffer_.data());
+  transcoder_.Reset();
+
+  const std::string_view currency = doc.currency.substr(0, 64);
+  char money[64 + kMoneyDigitsMax];
+
+  auto write_items = [&] {
+    char left_suffix[kQuantitySuffixMax];
+    for (const ReceiptItem& item : doc.items) {
+      const size_t money_len =
+          FormatMoney(currency, item.price * item.quantity, money);
+      const std::string_view price(money, money_len);
+
+      size_t suffix_len = 0;
+      if (item.quantity != 1) {
+        left_suffix[0] = ' ';
+        left_suffix[1] = 'x';
+        suffix_len = 2;
+        uint64_t magnitude = static_cast<uint64_t>(
+            item.quantity < 0 ? -static_cast<int64_t>(item.quantity)
+                              : item.quantity);
+        if (item.quantity < 0) left_suffix[suffix_len++] = '-';
+        suffix_len += AppendUnsigned(magnitude, left_suffix + suffix_len);
+      }
+      const std::string_view suffix(left_suffix, suffix_len);
+      // Columns, not bytes: UTF-8 and CJK names would otherwise push the price
+      // off the line.
+      const int left_len = DisplayWidth(item.name, wide) + static_cast<int>(suffix_len);
+      const int price_len = DisplayWidth(price, wide);
+
+      if (cpl >= 48 && left_len + price_len + 1 <= cpl) {
+        // Name and quantity left, price right on one line.
+        w.Bytes({kEsc, 0x61, 0x00});
+        w.Text(transcoder_, item.name);
+        w.Str(suffix);
+        w.Fill(' ', cpl - left_len - price_len);
+      } else {
+        // Narrow paper or long names: price on its own right-aligned line.
+        if (cpl < 48) w.Bytes({kEsc, 0x61, 0x00});
+        w.Text(transcoder_, item.name);
+        w.Str(suffix);
+        w.Byte('\n');
+        w.Fill(' ', cpl - price_len);
+      }
+      w.Text(transcoder_, price);
+      w.Byte('\n');
+    }
+  };
+
+  auto write_totals = [&] {
+    auto write_total = [&](std::string_view label, double value) {
+      const size_t len = FormatMoney(currency, value, money);
+      WriteLabelValue(w, transcoder_, label, std::string_view(money, len), cpl, wide);
+    };
+    if (doc.subtotal) write_total("Subtotal:", *doc.subtotal);
+    if (doc.tax) write_total("Tax:", *doc.tax);
+    if (doc.service_charge) write_total("Service:", *doc.service_charge);
+    if (doc.total) write_total("TOTAL:", *doc.total);
+  };
+
+  auto write_symbols = [&] {
+    if (!barcode_raster_.empty()) {
+      // Centred bars, then the text where the printer would put it
+      w.Bytes(barcode_raster_);
+      w.Str(doc.barcode.substr(0, 255));
+      w.Byte('\n');
+    } else if (!doc.barcode.empty()) {
+      const std::string_view barcode = doc.barcode.substr(0, 255);
+      w.Bytes({kEsc, 0x61, 0x01});  // centre
+      w.Bytes({kGs, 0x48, 0x02});   // HRI below
+      w.Bytes({kGs, 0x68, 0x50});   // height
+      w.Bytes({kGs, 0x77, 0x02});   // module width
+      w.Bytes({kGs, 0x6B, 0x49, static_cast<uint8_t>(barcode.size())});  // Code128
+      w.Str(barcode);
+      w.Byte('\n');
+    }
+
+    if (!qr_raster_.empty()) {
+      w.Bytes(qr_raster_);
+    } else if (!doc.qr_data.empty()) {
+      w.Bytes({kEsc, 0x61, 0x01});  // centre
+      w.Bytes({kGs, 0x28, 0x6B, 0x04, 0x00, 0x31, 0x41, 0x32, 0x00});  // model 2
+      w.Bytes({kGs, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x43, 0x06});        // size 6
+      w.Bytes({kGs, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x45, 0x30});        // EC level L
+      const size_t len = doc.qr_data.size() + 3;
+      w.Bytes({kGs, 0x28, 0x6B, static_cast<uint8_t>(len & 0xFF),
+               static_cast<uint8_t>((len >> 8) & 0xFF), 0x31, 0x50, 0x30});
+      w.Str(doc.qr_data);
+      w.Bytes({kGs, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x51, 0x30});        // print
+      w.Byte('\n');
+    }
+  };
+
+  for (const TemplateOp& op : template_ops_) {
+    switch (op.slot) {
+      case TemplateSlot::kStatic:
+        w.Bytes(template_bytes_.data() + op.offset, op.size);
+        if (op.sets_state) transcoder_.set_state(op.state);
+        break;
+      case TemplateSlot::kItems:
+        write_items();
+        break;
+      case TemplateSlot::kTotals:
+        write_totals();
+        break;
+      case TemplateSlot::kSymbols:
+        write_symbols();
+        break;
+    }
+  }
+  buffer_.resize(w.size());
+  return buffer_;
+}
+
+const std::vector<uint8_t>& EscPosEncoder::EncodeText(
+    std::string_view text, const TextOptions& options) {
+  // Every line gains at most an alignment command and a newline.
+  size_t lines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+  buffer_.resize(2 + kTranscodeMaxExpansion * text.size() + lines * 4 + 1 + 4);
+  Writer w(buffer_.data());
+
+  w.Bytes({kEsc, 0x40});
+  transcoder_.Reset();
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const void* nl = std::memchr(text.data() + pos, '\n', text.size() - pos);
+    const size_t end =
+        nl ? static_cast<size_t>(static_cast<const char*>(nl) - text.data())
+           : text.size();
+    const std::string_view line = text.substr(pos, end - pos);
+    if (!line.empty() || options.align_blank_lines) {
+      w.Bytes({kEsc, 0x61, static_cast<uint8_t>(IsPriceLine(line) ? 0x00 : 0x01)});
+      w.Text(transcoder_, line);
+    }
+    w.Byte(kLf);
+    pos = end + 1;
+  }
+  if (options.feed_before_cut) w.Byte(kLf);
+  w.Bytes({kGs, 0x56, 0x42, 0x00});
+  buffer_.resize(w.size());
+  return buffer_;
+}
+
+const std::vector<uint8_t>& EscPosEncoder::EncodeRows(const std::vector<ReceiptRow>& rows) {
+  const int cpl = std::max(chars_per_line_, 0);
+  layout_.set_columns(cpl, WideColumns());
+  // Sized row by row from each row's lines; the buffer keeps its capacity
+  // across calls.
+  buffer_.resize(2);
+  buffer_[0] = kEsc;
+  buffer_[1] = 0x40;
+  transcoder_.Reset();
+  size_t size = 2;
+  for (const ReceiptRow& row : rows) {
+    if (row.divider != 0) {
+      buffer_.resize(size + cpl + 1);
+      Writer w(buffer_.data() + size);
+      w.Fill(static_cast<uint8_t>(row.divider), cpl);
+      w.Byte('\n');
+      size += w.size();
+      continue;
+    }
+    const std::vector<LayoutLine>& lines = layout_.Layout(row);
+    // Padding never exceeds the line, and text never grows past the
+    // transcoder's bound.
+    buffer_.resize(size + kTranscodeMaxExpansion * (row.left.size() + row.right.size()) +
+                   lines.size() * (cpl + 1));
+    Writer w(buffer_.data() + size);
+    for (const LayoutLine& line : lines) {
+      w.Fill(' ', line.indent);
+      w.Text(transcoder_, line.text);
+      w.Fill(' ', line.gap);
+      w.Text(transcoder_, line.right);
+      w.Byte('\n');
+    }
+    size += w.size();
+  }
+  buffer_.resize(size + 1 + 4);
+  Writer w(buffer_.data() + size);
+  w.Byte(kLf);
+  w.Bytes({kGs, 0x56, 0x42, 0x00});  // feed and full cut
+  return buffer_;
+}
+
+const std::vector<uint8_t>& EscPosEncoder::EncodeRaw(std::string_view data) {
+  buffer_.assign(data.begin(), data.end());
+  return buffer_;
+}
+
+const std::vector<uint8_t>& EscPosEncoder::EncodeRawText(std::string_view text) {
+  buffer_.clear();
+  transcoder_.Reset();
+  transcoder_.Append(text, &buffer_);
+  return buffer_;
+}
+
+std::vector<uint8_t> EscPosEncoder::TakeBuffer() {
+  std::vector<uint8_t> out;
+  out.swap(buffer_);
+  return out;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,199 @@
+#ifndef PRINTER_CORE_ESCPOS_ENCODER_H_
+#define PRINTER_CORE_ESCPOS_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "code_page.h"
+#include "text_layout.h"
+
+namespace printer_core {
+
+// A single receipt line item. Strings are views into storage owned by the
+// caller (for example the decoded method-channel map) and must outlive the
+// encode call.
+struct ReceiptItem {
+  std::string_view name;
+  int quantity = 1;
+  double price = 0.0;
+};
+
+// Platform-neutral description of a structured receipt. Optional fields that
+// are not set are omitted from the output, matching the behaviour of the
+// original map-based builders.
+struct ReceiptDocument {
+  std::string_view currency = "RM";
+  std::optional<std::string_view> title;
+  std::vector<ReceiptItem> items;
+  std::optional<double> subtotal;
+  std::optional<double> tax;
+  std::optional<double> service_charge;
+  std::optional<double> total;
+  std::string_view barcode;
+  std::string_view qr_data;
+};
+
+// What the target printer can print itself. Symbols it cannot are drawn by
+// the encoder and sent as raster bands, so they print on any printer that
+// takes GS v 0.
+struct PrinterProfile {
+  // QR codes through GS ( k (model 2).
+  bool native_qr = true;
+  // Code128 through GS k 73.
+  bool native_code128 = true;
+  // Printable width in dots for raster symbols: 576 on 80 mm paper, 384 on
+  // 58 mm.
+  int dots_per_line = 576;
+  // Preferred ESC t table for text outside ASCII.
+  CodePage code_page = CodePage::kCp437;
+  // GB18030 or Big5 on Chinese models (FS &); kNone elsewhere.
+  CodePage chinese_code_page = CodePage::kNone;
+
+  bool operator==(const PrinterProfile& other) const {
+    return native_qr == other.native_qr && native_code128 == other.native_code128 &&
+           dots_per_line == other.dots_per_line && code_page == other.code_page &&
+           chinese_code_page == other.chinese_code_page;
+  }
+  bool operator!=(const PrinterProfile& other) const { return !(*this == other); }
+};
+
+// Store lines printed centred on every structured receipt: the header under
+// the title (address, phone, registration number), the footer under the
+// totals. UTF-8.
+struct StoreSettings {
+  std::vector<std::string> header_lines;
+  std::vector<std::string> footer_lines;
+
+  bool operator==(const StoreSettings& other) const {
+    return header_lines == other.header_lines && footer_lines == other.footer_lines;
+  }
+  bool operator!=(const StoreSettings& other) const { return !(*this == other); }
+};
+
+// Options for encoding free-form receipt text line by line.
+struct TextOptions {
+  // Emit an alignment command before empty lines as well as non-empty ones.
+  bool align_blank_lines = true;
+  // Emit an extra line feed before the final paper cut.
+  bool feed_before_cut = true;
+};
+
+// Formats |value| as "<currency> <units>.<cents>" into |out| using integer
+// arithmetic only. |out| must hold at least currency.size() + 24 bytes.
+// Returns the number of bytes written.
+size_t FormatMoney(std::string_view currency, double value, char* out);
+
+// Encodes receipts into ESC/POS bytes. The encoder owns a single output
+// buffer that is reused across calls so steady-state encoding does not
+// allocate; each Encode* call replaces the previous contents.
+class EscPosEncoder {
+ public:
+  explicit EscPosEncoder(int chars_per_line = 48);
+
+  void set_chars_per_line(int chars_per_line);
+  int chars_per_line() const { return chars_per_line_; }
+
+  void set_profile(const PrinterProfile& profile);
+  const PrinterProfile& profile() const { return profile_; }
+
+  void set_store(const StoreSettings& store);
+  const StoreSettings& store() const { return store_; }
+
+  // Times EncodeReceipt has compiled its template. The width, profile,
+  // store and title are compiled in once; setting any of them to a new
+  // value, or a receipt with another title, compiles it again.
+  uint64_t templates_compiled() const { return templates_compiled_; }
+
+  // Encodes a structured receipt: header dividers, title, store header, item
+  // rows with right-aligned prices, totals, store footer, optional Code128
+  // barcode and QR code, then a feed and full cut. The static sections come
+  // pre-encoded from a template, so a receipt only formats its own fields.
+  //
+  // The barcode and QR code use the printer's own commands or raster bands
+  // as the profile says; a symbol the software encoders cannot draw (too
+  // long, or non-ASCII Code128) falls back to the printer's command.
+  const std::vector<uint8_t>& EncodeReceipt(const ReceiptDocument& doc);
+
+  // Encodes free-form text. Lines containing a price marker ("RM" or "$") are
+  // left aligned, everything else is centred. Receipt text is UTF-8 and is
+  // transcoded to the profile's code pages here and in EncodeReceipt.
+  const std::vector<uint8_t>& EncodeText(std::string_view text,
+                                         const TextOptions& options = {});
+
+  // Encodes rows laid out by display width at chars_per_line() columns
+  // (32, 42, 48 or 64 on common paper), then a feed and full cut. Wrapping,
+  // cutting and padding count columns, not bytes, so accented and CJK text
+  // keeps prices on the right margin.
+  const std::vector<uint8_t>& EncodeRows(const std::vector<ReceiptRow>& rows);
+
+  // Replaces the buffer contents with |data| unchanged.
+  const std::vector<uint8_t>& EncodeRaw(std::string_view data);
+
+  // Replaces the buffer contents with preformatted UTF-8 |text| (which may
+  // carry its own ASCII commands) transcoded to the profile's code pages.
+  const std::vector<uint8_t>& EncodeRawText(std::string_view text);
+
+  // Returns an upper bound on the encoded size of |doc| at the given width,
+  // computed in a single pass over the document, with native symbols and
+  // no store lines.
+  static size_t MeasureReceipt(const ReceiptDocument& doc,
+                               int chars_per_line);
+
+  const std::vector<uint8_t>& buffer() const { return buffer_; }
+
+  // Moves the encoded bytes out; the next encode call starts a new buffer.
+  std::vector<uint8_t> TakeBuffer();
+
+ private:
+  // Fills barcode_raster_ and qr_raster_ with the symbols of |doc| the
+  // profile wants drawn; each stays empty when the native command is used.
+  void RasterizeSymbols(const ReceiptDocument& doc);
+
+  // Columns a wide character prints in: 2 with a Chinese encoding, 1 where
+  // it prints as '?'.
+  int WideColumns() const;
+
+  // Parts of a compiled receipt template, in print order.
+  enum class TemplateSlot { kStatic, kItems, kTotals, kSymbols };
+
+  struct TemplateOp {
+    TemplateSlot slot = TemplateSlot::kStatic;
+    // kStatic: bytes in template_bytes_.
+    size_t offset = 0;
+    size_t size = 0;
+    // Set when the bytes select a code table, so text after them is
+    // transcoded from that state.
+    bool sets_state = false;
+    CodePageTranscoder::State state;
+  };
+
+  // Pre-encodes the dividers, title and store lines of a receipt titled like
+  // |doc| into template_bytes_, with slots for the document's fields.
+  void CompileTemplate(const ReceiptDocument& doc);
+
+  int chars_per_line_;
+  PrinterProfile profile_;
+  StoreSettings store_;
+  CodePageTranscoder transcoder_;
+  RowLayout layout_;
+  std::vector<uint8_t> buffer_;
+  // Reused across receipts
+  std::vector<uint8_t> symbols_;
+  std::vector<uint8_t> barcode_raster_;
+  std::vector<uint8_t> qr_raster_;
+  // Compiled receipt template; stale when template_valid_ is false or the
+  // title differs.
+  bool template_valid_ = false;
+  std::optional<std::string> template_title_;
+  std::vector<uint8_t> template_bytes_;
+  std::vector<TemplateOp> template_ops_;
+  uint64_t templates_compiled_ = 0;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_ESCPOS_ENCODER_H_
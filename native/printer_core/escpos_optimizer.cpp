@@ -0,0 +1,372 @@
+#include "escpos_optimizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kDle = 0x10;
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+constexpr uint8_t kGs = 0x1D;
+constexpr uint8_t kLf = 0x0A;
+
+// Feeds shorter than this stay line feeds; ESC d n is three bytes.
+constexpr int kMinMergedFeeds = 4;
+
+bool IsCommandStart(uint8_t b) {
+  return b == kEsc || b == kGs || b == kFs || b == kDle;
+}
+
+// |fixed| bytes plus |variable| more, if all of them are there.
+size_t Fits(size_t fixed, size_t variable, size_t size) {
+  if (fixed > size || variable > size - fixed) return 0;
+  return fixed + variable;
+}
+
+size_t Uint16At(const uint8_t* data) {
+  return static_cast<size_t>(data[0]) | static_cast<size_t>(data[1]) << 8;
+}
+
+size_t EscLength(const uint8_t* data, size_t size) {
+  switch (data[1]) {
+    case '@': case '2': case '<': case 'i': case 'm': case 'L': case 'S': case 0x0C:
+      return 2;
+    case '!': case ' ': case '%': case '-': case '3': case '=': case 'E': case 'G':
+    case 'J': case 'M': case 'R': case 'T': case 'U': case 'V': case 'a': case 'd':
+    case 'e': case 'r': case 't': case '{':
+      return Fits(3, 0, size);
+    case '$': case '\\': case 'c':
+      return Fits(4, 0, size);
+    case 'p':
+      return Fits(5, 0, size);
+    case 'W':
+      return Fits(10, 0, size);
+    case '*': {
+      // ESC * m nL nH: one byte a column, three in the 24-dot modes
+      if (size < 5) return 0;
+      const size_t columns = Uint16At(data + 3);
+      return Fits(5, (data[2] & 0x20) ? 3 * columns : columns, size);
+    }
+    default:
+      return 0;
+  }
+}
+
+size_t GsLength(const uint8_t* data, size_t size) {
+  switch (data[1]) {
+    case '!': case '/': case 'B': case 'E': case 'H': case 'I': case 'a': case 'b':
+    case 'f': case 'h': case 'r': case 'w':
+      return Fits(3, 0, size);
+    case '$': case 'L': case 'P': case 'W': case '\\':
+      return Fits(4, 0, size);
+    case 'V': {
+      if (size < 3) return 0;
+      const uint8_t m = data[2];
+      if (m == 0 || m == 1 || m == 48 || m == 49) return 3;
+      if (m == 65 || m == 66 || m == 97 || m == 98 || m == 103 || m == 104) {
+        return Fits(4, 0, size);
+      }
+      return 0;
+    }
+    case 'v':
+      // GS v 0 m xL xH yL yH: x bytes by y rows
+      if (size < 8 || data[2] != '0') return 0;
+      return Fits(8, Uint16At(data + 4) * Uint16At(data + 6), size);
+    case '*':
+      if (size < 4) return 0;
+      return Fits(4, static_cast<size_t>(data[2]) * data[3] * 8, size);
+    case '(':
+      if (size < 5) return 0;
+      return Fits(5, Uint16At(data + 3), size);
+    case '8':
+      if (size < 7 || data[2] != 'L') return 0;
+      return Fits(7, Uint16At(data + 3) | Uint16At(data + 5) << 16, size);
+    case 'k': {
+      if (size < 4) return 0;
+      const uint8_t m = data[2];
+      if (m <= 6) {
+        // NUL-terminated data
+        const void* end = std::memchr(data + 3, 0, size - 3);
+        if (end == nullptr) return 0;
+        return static_cast<size_t>(static_cast<const uint8_t*>(end) - data) + 1;
+      }
+      if (m >= 65 && m <= 79) return Fits(4, data[3], size);
+      return 0;
+    }
+    default:
+      return 0;
+  }
+}
+
+size_t FsLength(const uint8_t* data, size_t size) {
+  switch (data[1]) {
+    case '&': case '.':
+      return 2;
+    case '!': case '-': case 'C': case 'W':
+      return Fits(3, 0, size);
+    case 'S': case 'p':
+      return Fits(4, 0, size);
+    case '(':
+      if (size < 5) return 0;
+      return Fits(5, Uint16At(data + 3), size);
+    case 'q': {
+      // FS q n, then n images of xL xH yL yH and x * y * 8 bytes
+      if (size < 3) return 0;
+      size_t length = 3;
+      for (int image = 0; image < data[2]; ++image) {
+        if (size - length < 4) return 0;
+        const size_t bytes = Uint16At(data + length) * Uint16At(data + length + 2) * 8;
+        length = Fits(length + 4, bytes, size);
+        if (length == 0) return 0;
+      }
+      return length;
+    }
+    default:
+      return 0;
+  }
+}
+
+// Printer state the optimizer tracks; -1 where it is not known.
+struct TrackedState {
+  int align = -1;
+  int bold = -1;
+  int underline = -1;
+  int size = -1;
+  int code_page = -1;
+  int kanji = -1;
+};
+
+// What ESC @ restores. The code table and Kanji mode come from the
+// printer's own settings.
+TrackedState PowerOnState() {
+  TrackedState state;
+  state.align = 0;
+  state.bold = 0;
+  state.underline = 0;
+  state.size = 0;
+  return state;
+}
+
+// Writes the optimized stream behind the read position.
+class Rewriter {
+ public:
+  explicit Rewriter(uint8_t* out) : out_(out) {}
+
+  size_t size() const { return size_; }
+
+  void Text(const uint8_t* data, size_t length) {
+    Flush();
+    Copy(data, length);
+    at_line_start_ = false;
+  }
+
+  void Feed(int lines) {
+    // Character height sets the height of a blank line too.
+    if (wanted_.size != -1 && wanted_.size != printer_.size) {
+      EmitFeeds();
+      EmitSize();
+    }
+    feeds_ += lines;
+    at_line_start_ = true;
+  }
+
+  void Command(const uint8_t* data, size_t length) {
+    const uint8_t prefix = data[0];
+    const uint8_t code = data[1];
+    const uint8_t n = length > 2 ? data[2] : 0;
+    if (prefix == kEsc && code == '@') {
+      // Everything pending is reset anyway.
+      EmitFeeds();
+      Copy(data, length);
+      printer_ = wanted_ = PowerOnState();
+      at_line_start_ = true;
+      return;
+    }
+    if (prefix == kEsc && code == 'a' && at_line_start_ && Alignment(n) >= 0) {
+      wanted_.align = Alignment(n);
+      return;
+    }
+    if (prefix == kEsc && code == 'E') {
+      wanted_.bold = n & 1;
+      return;
+    }
+    if (prefix == kEsc && code == '-' && Alignment(n) >= 0) {
+      wanted_.underline = Alignment(n);
+      return;
+    }
+    if (prefix == kGs && code == '!') {
+      wanted_.size = n;
+      return;
+    }
+    if (prefix == kEsc && code == 't') {
+      wanted_.code_page = n;
+      return;
+    }
+    if (prefix == kFs && (code == '&' || code == '.')) {
+      wanted_.kanji = code == '&' ? 1 : 0;
+      return;
+    }
+    if (prefix == kEsc && code == 'd' && n > 0) {
+      Feed(n);
+      return;
+    }
+
+    if ((prefix == kGs && code == 'V') || (prefix == kEsc && code == 'p') || prefix == kDle) {
+      // Cuts, drawer kicks and real-time requests print nothing, so settings
+      // can wait for the next text.
+      EmitFeeds();
+    } else {
+      Flush();
+    }
+    Copy(data, length);
+    if (prefix == kEsc && code == 'a') {
+      // Mid-line ESC a: leave it to the printer and stop assuming.
+      printer_.align = wanted_.align = -1;
+    } else if (prefix == kEsc && code == '!') {
+      // Print mode sets emphasis and underline and doubles the size its own
+      // way.
+      printer_.bold = wanted_.bold = (n >> 3) & 1;
+      printer_.underline = wanted_.underline = (n >> 7) & 1;
+      printer_.size = wanted_.size = -1;
+    }
+    if ((prefix == kEsc && (code == 'J' || code == 'd')) ||
+        (prefix == kGs && (code == 'V' || code == 'v' || code == 'k')) ||
+        (prefix == kFs && code == 'p')) {
+      at_line_start_ = true;
+    } else if (prefix == kEsc && code == '*') {
+      at_line_start_ = false;
+    }
+  }
+
+  // Passes the rest of the stream through untouched.
+  void Rest(const uint8_t* data, size_t length) {
+    Flush();
+    Copy(data, length);
+  }
+
+  // Emits pending feeds and every setting that differs from the printer's.
+  void Flush() {
+    EmitFeeds();
+    if (wanted_.align != -1 && wanted_.align != printer_.align) {
+      Emit({kEsc, 'a', static_cast<uint8_t>(wanted_.align)});
+      printer_.align = wanted_.align;
+    }
+    if (wanted_.bold != -1 && wanted_.bold != printer_.bold) {
+      Emit({kEsc, 'E', static_cast<uint8_t>(wanted_.bold)});
+      printer_.bold = wanted_.bold;
+    }
+    if (wanted_.underline != -1 && wanted_.underline != printer_.underline) {
+      Emit({kEsc, '-', static_cast<uint8_t>(wanted_.underline)});
+      printer_.underline = wanted_.underline;
+    }
+    EmitSize();
+    if (wanted_.code_page != -1 && wanted_.code_page != printer_.code_page) {
+      Emit({kEsc, 't', static_cast<uint8_t>(wanted_.code_page)});
+      printer_.code_page = wanted_.code_page;
+    }
+    if (wanted_.kanji != -1 && wanted_.kanji != printer_.kanji) {
+      Emit({kFs, static_cast<uint8_t>(wanted_.kanji ? '&' : '.')});
+      printer_.kanji = wanted_.kanji;
+    }
+  }
+
+ private:
+  // ESC a and ESC - take 0-2 or '0'-'2'.
+  static int Alignment(uint8_t n) {
+    if (n <= 2) return n;
+    if (n >= '0' && n <= '2') return n - '0';
+    return -1;
+  }
+
+  void EmitSize() {
+    if (wanted_.size != -1 && wanted_.size != printer_.size) {
+      Emit({kGs, '!', static_cast<uint8_t>(wanted_.size)});
+      printer_.size = wanted_.size;
+    }
+  }
+
+  void EmitFeeds() {
+    while (feeds_ >= kMinMergedFeeds) {
+      const int lines = std::min(feeds_, 255);
+      Emit({kEsc, 'd', static_cast<uint8_t>(lines)});
+      feeds_ -= lines;
+    }
+    for (; feeds_ > 0; --feeds_) out_[size_++] = kLf;
+  }
+
+  // Each setting emitted stands for at least one command of the same size
+  // already read, so writes never overtake reads.
+  void Emit(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t b : bytes) out_[size_++] = b;
+  }
+
+  void Copy(const uint8_t* data, size_t length) {
+    std::memmove(out_ + size_, data, length);
+    size_ += length;
+  }
+
+  uint8_t* out_;
+  size_t size_ = 0;
+  TrackedState printer_;
+  TrackedState wanted_;
+  int feeds_ = 0;
+  bool at_line_start_ = true;
+};
+
+}  // namespace
+
+size_t EscPosCommandLength(const uint8_t* data, size_t size) {
+  if (size < 2) return 0;
+  switch (data[0]) {
+    case kEsc:
+      return EscLength(data, size);
+    case kGs:
+      return GsLength(data, size);
+    case kFs:
+      return FsLength(data, size);
+    case kDle:
+      // DLE EOT n, DLE ENQ n, DLE DC4 fn m t
+      if (data[1] == 0x04 || data[1] == 0x05) return Fits(3, 0, size);
+      if (data[1] == 0x14) return Fits(5, 0, size);
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+size_t OptimizeEscPos(uint8_t* data, size_t size) {
+  Rewriter out(data);
+  size_t i = 0;
+  while (i < size) {
+    const uint8_t b = data[i];
+    if (b == kLf) {
+      out.Feed(1);
+      ++i;
+    } else if (IsCommandStart(b)) {
+      const size_t length = EscPosCommandLength(data + i, size - i);
+      if (length == 0) {
+        out.Rest(data + i, size - i);
+        return out.size();
+      }
+      out.Command(data + i, length);
+      i += length;
+    } else {
+      // Text, and control bytes the optimizer does not track
+      size_t end = i + 1;
+      while (end < size && data[end] != kLf && !IsCommandStart(data[end])) ++end;
+      out.Text(data + i, end - i);
+      i = end;
+    }
+  }
+  out.Flush();
+  return out.size();
+}
+
+void OptimizeEscPos(std::vector<uint8_t>* data) {
+  data->resize(OptimizeEscPos(data->data(), data->size()));
+}
+
+}  // namespace printer_core
@@ -0,0 +1,28 @@
+#ifndef PRINTER_CORE_ESCPOS_OPTIMIZER_H_
+#define PRINTER_CORE_ESCPOS_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace printer_core {
+
+// Length of the ESC, GS, FS or DLE command at the start of |data|, including
+// any data it carries (raster, barcode, NV image), or 0 if the command is
+// unknown or runs past |size|.
+size_t EscPosCommandLength(const uint8_t* data, size_t size);
+
+// Rewrites an ESC/POS stream in one pass so it prints the same with fewer
+// bytes. It tracks alignment, emphasis, underline, character size, code
+// table and Kanji mode. Commands that set what is already in effect, or that
+// are overridden before anything prints, are dropped. Runs of four or more
+// line feeds become ESC d n. Other commands pass through unchanged. If a
+// command is unknown, the rest of the stream is left as it is. Works in place;
+// the output is never longer than the input. Returns the new size.
+size_t OptimizeEscPos(uint8_t* data, size_t size);
+
+void OptimizeEscPos(std::vector<uint8_t>* data);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_ESCPOS_OPTIMIZER_H_
@@ -0,0 +1,201 @@
+#include "ffi/printer_core_ffi.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "logo_raster.h"
+#include "receipt_blob.h"
+#include "text_layout.h"
+
+using printer_core::CodePage;
+using printer_core::DitherMode;
+using printer_core::EscPosEncoder;
+using printer_core::PixelLayout;
+using printer_core::ReceiptDocument;
+using printer_core::ReceiptRow;
+using printer_core::RowAlign;
+
+struct pc_encoder {
+  explicit pc_encoder(int chars_per_line) : encoder(chars_per_line) {}
+
+  EscPosEncoder encoder;
+  // Reused across calls, so steady-state encodes do not allocate.
+  ReceiptDocument doc;
+  std::vector<ReceiptRow> rows;
+};
+
+struct pc_buffer {
+  std::vector<uint8_t> bytes;
+};
+
+namespace {
+
+// The C constants are the enum values, so they convert with a cast.
+static_assert(static_cast<int>(CodePage::kBig5) == PC_CODE_PAGE_BIG5, "CodePage");
+static_assert(static_cast<int>(RowAlign::kRight) == PC_ALIGN_RIGHT, "RowAlign");
+static_assert(static_cast<int>(PixelLayout::kRgb) == PC_PIXELS_RGB, "PixelLayout");
+static_assert(static_cast<int>(DitherMode::kFloydSteinberg) == PC_DITHER_FLOYD_STEINBERG,
+              "DitherMode");
+
+bool ValidWidth(int32_t chars_per_line) {
+  return chars_per_line > 0 && chars_per_line <= 1024;
+}
+
+bool ToCodePage(int32_t value, CodePage* page) {
+  if (value < PC_CODE_PAGE_NONE || value > PC_CODE_PAGE_BIG5) return false;
+  *page = static_cast<CodePage>(value);
+  return true;
+}
+
+// Null with a zero size is an empty string.
+bool ToView(const char* data, size_t size, std::string_view* out) {
+  if (!data && size != 0) return false;
+  *out = size == 0 ? std::string_view() : std::string_view(data, size);
+  return true;
+}
+
+std::vector<std::string> SplitLines(std::string_view text) {
+  std::vector<std::string> lines;
+  while (!text.empty()) {
+    const size_t end = text.find('\n');
+    lines.emplace_back(text.substr(0, end));
+    if (end == std::string_view::npos) break;
+    text.remove_prefix(end + 1);
+  }
+  return lines;
+}
+
+}  // namespace
+
+extern "C" {
+
+int32_t pc_abi_version(void) { return PC_ABI_VERSION; }
+
+pc_encoder* pc_encoder_new(int32_t chars_per_line) {
+  if (!ValidWidth(chars_per_line)) return nullptr;
+  return new pc_encoder(chars_per_line);
+}
+
+void pc_encoder_free(pc_encoder* encoder) { delete encoder; }
+
+int32_t pc_encoder_set_chars_per_line(pc_encoder* encoder, int32_t chars_per_line) {
+  if (!encoder || !ValidWidth(chars_per_line)) return PC_INVALID_ARGUMENT;
+  encoder->encoder.set_chars_per_line(chars_per_line);
+  return PC_OK;
+}
+
+int32_t pc_encoder_set_profile(pc_encoder* encoder, const pc_profile* profile) {
+  if (!encoder || !profile || profile->dots_per_line <= 0) return PC_INVALID_ARGUMENT;
+  printer_core::PrinterProfile value;
+  value.native_qr = profile->native_qr != 0;
+  value.native_code128 = profile->native_code128 != 0;
+  value.dots_per_line = profile->dots_per_line;
+  if (!ToCodePage(profile->code_page, &value.code_page) ||
+      !ToCodePage(profile->chinese_code_page, &value.chinese_code_page)) {
+    return PC_INVALID_ARGUMENT;
+  }
+  encoder->encoder.set_profile(value);
+  return PC_OK;
+}
+
+int32_t pc_encoder_set_store(pc_encoder* encoder, const char* header, size_t header_size,
+                             const char* footer, size_t footer_size) {
+  std::string_view header_text;
+  std::string_view footer_text;
+  if (!encoder || !ToView(header, header_size, &header_text) ||
+      !ToView(footer, footer_size, &footer_text)) {
+    return PC_INVALID_ARGUMENT;
+  }
+  printer_core::StoreSettings store;
+  store.header_lines = SplitLines(header_text);
+  store.footer_lines = SplitLines(footer_text);
+  encoder->encoder.set_store(store);
+  return PC_OK;
+}
+
+int32_t pc_encode_receipt(pc_encoder* encoder, const uint8_t* blob, size_t size) {
+  if (!encoder || !blob) return PC_INVALID_ARGUMENT;
+  if (!printer_core::ReadReceiptBlob(blob, size, &encoder->doc)) return PC_MALFORMED_INPUT;
+  encoder->encoder.EncodeReceipt(encoder->doc);
+  return PC_OK;
+}
+
+int32_t pc_encode_text(pc_encoder* encoder, const char* text, size_t size, int32_t flags) {
+  std::string_view view;
+  if (!encoder || !ToView(text, size, &view)) return PC_INVALID_ARGUMENT;
+  printer_core::TextOptions options;
+  options.align_blank_lines = (flags & PC_TEXT_ALIGN_BLANK_LINES) != 0;
+  options.feed_before_cut = (flags & PC_TEXT_FEED_BEFORE_CUT) != 0;
+  encoder->encoder.EncodeText(view, options);
+  return PC_OK;
+}
+
+int32_t pc_encode_rows(pc_encoder* encoder, const pc_row* rows, size_t count) {
+  if (!encoder || (!rows && count != 0)) return PC_INVALID_ARGUMENT;
+  encoder->rows.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const pc_row& in = rows[i];
+    ReceiptRow& row = encoder->rows[i];
+    if (!ToView(in.left, in.left_size, &row.left) ||
+        !ToView(in.right, in.right_size, &row.right) || in.align < PC_ALIGN_LEFT ||
+        in.align > PC_ALIGN_RIGHT || in.divider < 0 || in.divider > 0x7F) {
+      return PC_INVALID_ARGUMENT;
+    }
+    row.align = static_cast<RowAlign>(in.align);
+    row.truncate = in.truncate != 0;
+    row.divider = static_cast<char>(in.divider);
+  }
+  encoder->encoder.EncodeRows(encoder->rows);
+  return PC_OK;
+}
+
+const uint8_t* pc_encoder_data(const pc_encoder* encoder) {
+  return encoder ? encoder->encoder.buffer().data() : nullptr;
+}
+
+size_t pc_encoder_size(const pc_encoder* encoder) {
+  return encoder ? encoder->encoder.buffer().size() : 0;
+}
+
+pc_buffer* pc_encoder_take(pc_encoder* encoder) {
+  if (!encoder) return nullptr;
+  return new pc_buffer{encoder->encoder.TakeBuffer()};
+}
+
+pc_buffer* pc_buffer_new(size_t size) { return new pc_buffer{std::vector<uint8_t>(size)}; }
+
+uint8_t* pc_buffer_data(pc_buffer* buffer) { return buffer ? buffer->bytes.data() : nullptr; }
+
+size_t pc_buffer_size(const pc_buffer* buffer) { return buffer ? buffer->bytes.size() : 0; }
+
+void pc_buffer_free(pc_buffer* buffer) { delete buffer; }
+
+int32_t pc_display_width(const char* text, size_t size, int32_t wide_columns) {
+  std::string_view view;
+  if (!ToView(text, size, &view) || (wide_columns != 1 && wide_columns != 2)) {
+    return PC_INVALID_ARGUMENT;
+  }
+  return printer_core::DisplayWidth(view, wide_columns);
+}
+
+pc_buffer* pc_rasterize_logo(const uint8_t* pixels, int32_t width, int32_t height,
+                             size_t stride, int32_t layout, int32_t print_width,
+                             int32_t dither) {
+  if (width < 0 || height < 0 || print_width <= 0 || layout < PC_PIXELS_RGBA ||
+      layout > PC_PIXELS_RGB || dither < PC_DITHER_THRESHOLD ||
+      dither > PC_DITHER_FLOYD_STEINBERG) {
+    return nullptr;
+  }
+  if (width == 0 || height == 0) return new pc_buffer;
+  const size_t channels = layout == PC_PIXELS_RGB ? 3 : 4;
+  if (!pixels || stride < static_cast<size_t>(width) * channels) return nullptr;
+  const printer_core::GrayImage gray = printer_core::GrayFromPixels(
+      pixels, width, height, stride, static_cast<PixelLayout>(layout));
+  return new pc_buffer{
+      printer_core::RasterizeLogo(gray, print_width, static_cast<DitherMode>(dither))};
+}
+
+}  // extern "C"
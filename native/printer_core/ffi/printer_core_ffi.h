@@ -0,0 +1,158 @@
+#ifndef PRINTER_CORE_FFI_PRINTER_CORE_FFI_H_
+#define PRINTER_CORE_FFI_PRINTER_CORE_FFI_H_
+
+// C ABI over the receipt encoder, text layout and logo rasterizer, built as
+// libprinter_core_ffi for dart:ffi (lib/services/native/printer_core_ffi.dart).
+// Calls are synchronous, so an isolate can encode without the method channel
+// and the platform thread.
+//
+// Ownership:
+//   - An encoder's output stays owned by the encoder. pc_encoder_data() and
+//     pc_encoder_size() describe it until the next encode, take or free on
+//     that encoder; Dart views it with asTypedList() without copying.
+//   - pc_encoder_take() and pc_rasterize_logo() hand over a pc_buffer that
+//     the caller frees with pc_buffer_free(), which has the signature of a
+//     Dart NativeFinalizer, so a typed list can own the bytes.
+//   - Input pointers are only read during the call.
+//
+// An encoder may be used from one thread at a time; separate encoders and
+// the free functions are safe to call concurrently. Strings are UTF-8 with
+// an explicit length and need not be NUL-terminated.
+//
+// Additions keep existing signatures and values; anything incompatible
+// bumps PC_ABI_VERSION.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(PRINTER_CORE_FFI_IMPLEMENTATION)
+#define PC_EXPORT __declspec(dllexport)
+#else
+#define PC_EXPORT __declspec(dllimport)
+#endif
+#else
+#define PC_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PC_ABI_VERSION 1
+
+// Status codes; calls that can fail return one.
+#define PC_OK 0
+// A null handle or pointer, or a value out of range.
+#define PC_INVALID_ARGUMENT (-1)
+// A receipt blob that fails validation (native/printer_core/receipt_blob.h).
+#define PC_MALFORMED_INPUT (-2)
+
+// Code pages for pc_profile (printer_core::CodePage).
+#define PC_CODE_PAGE_NONE 0
+#define PC_CODE_PAGE_CP437 1
+#define PC_CODE_PAGE_CP858 2
+#define PC_CODE_PAGE_CP1252 3
+#define PC_CODE_PAGE_GB18030 4
+#define PC_CODE_PAGE_BIG5 5
+
+// Row alignment for pc_row.
+#define PC_ALIGN_LEFT 0
+#define PC_ALIGN_CENTER 1
+#define PC_ALIGN_RIGHT 2
+
+// Pixel layouts for pc_rasterize_logo.
+#define PC_PIXELS_RGBA 0
+#define PC_PIXELS_BGRA 1
+#define PC_PIXELS_RGB 2
+
+// Dither modes for pc_rasterize_logo.
+#define PC_DITHER_THRESHOLD 0
+#define PC_DITHER_ORDERED 1
+#define PC_DITHER_FLOYD_STEINBERG 2
+
+// pc_encode_text flags.
+#define PC_TEXT_ALIGN_BLANK_LINES 1
+#define PC_TEXT_FEED_BEFORE_CUT 2
+
+typedef struct pc_encoder pc_encoder;
+typedef struct pc_buffer pc_buffer;
+
+// printer_core::PrinterProfile; booleans are 0 or 1.
+typedef struct pc_profile {
+  int32_t native_qr;
+  int32_t native_code128;
+  int32_t dots_per_line;
+  int32_t code_page;
+  int32_t chinese_code_page;
+} pc_profile;
+
+// printer_core::ReceiptRow. |left| and |right| may be null when their size
+// is 0; a non-zero |divider| makes the row a full-width line of it.
+typedef struct pc_row {
+  const char* left;
+  size_t left_size;
+  const char* right;
+  size_t right_size;
+  int32_t align;
+  int32_t truncate;
+  int32_t divider;
+  int32_t reserved;
+} pc_row;
+
+// PC_ABI_VERSION of the loaded library.
+PC_EXPORT int32_t pc_abi_version(void);
+
+// An encoder at |chars_per_line| columns with the default profile.
+PC_EXPORT pc_encoder* pc_encoder_new(int32_t chars_per_line);
+PC_EXPORT void pc_encoder_free(pc_encoder* encoder);
+
+PC_EXPORT int32_t pc_encoder_set_chars_per_line(pc_encoder* encoder, int32_t chars_per_line);
+PC_EXPORT int32_t pc_encoder_set_profile(pc_encoder* encoder, const pc_profile* profile);
+
+// Store header and footer lines, each given as lines joined by '\n'.
+PC_EXPORT int32_t pc_encoder_set_store(pc_encoder* encoder, const char* header,
+                                       size_t header_size, const char* footer,
+                                       size_t footer_size);
+
+// Encodes the receipt in |blob| (the format ReceiptBlob.encode writes).
+PC_EXPORT int32_t pc_encode_receipt(pc_encoder* encoder, const uint8_t* blob, size_t size);
+
+// Encodes free-form receipt text; |flags| combines PC_TEXT_* values.
+PC_EXPORT int32_t pc_encode_text(pc_encoder* encoder, const char* text, size_t size,
+                                 int32_t flags);
+
+// Encodes |count| rows laid out at the encoder's width.
+PC_EXPORT int32_t pc_encode_rows(pc_encoder* encoder, const pc_row* rows, size_t count);
+
+// The bytes of the last encode, owned by the encoder.
+PC_EXPORT const uint8_t* pc_encoder_data(const pc_encoder* encoder);
+PC_EXPORT size_t pc_encoder_size(const pc_encoder* encoder);
+
+// Moves the bytes of the last encode into a new buffer, leaving the encoder
+// empty. Null if |encoder| is.
+PC_EXPORT pc_buffer* pc_encoder_take(pc_encoder* encoder);
+
+// A zeroed buffer of |size| bytes the caller can fill, e.g. with input for
+// the calls above.
+PC_EXPORT pc_buffer* pc_buffer_new(size_t size);
+PC_EXPORT uint8_t* pc_buffer_data(pc_buffer* buffer);
+PC_EXPORT size_t pc_buffer_size(const pc_buffer* buffer);
+PC_EXPORT void pc_buffer_free(pc_buffer* buffer);
+
+// Columns |text| prints in when wide characters take |wide_columns| (2 with
+// a Chinese code page, 1 otherwise).
+PC_EXPORT int32_t pc_display_width(const char* text, size_t size, int32_t wide_columns);
+
+// Converts decoded pixels to gray, scales them to |print_width| dots and
+// dithers them into a centred GS v 0 raster block. Null on invalid
+// arguments; an empty buffer for an empty image.
+PC_EXPORT pc_buffer* pc_rasterize_logo(const uint8_t* pixels, int32_t width, int32_t height,
+                                       size_t stride, int32_t layout, int32_t print_width,
+                                       int32_t dither);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // PRINTER_CORE_FFI_PRINTER_CORE_FFI_H_
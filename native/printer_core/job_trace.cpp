@@ -0,0 +1,159 @@
+#include "job_trace.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace printer_core {
+
+namespace {
+
+std::atomic<uint64_t> g_next_serial{1};
+
+struct CachedRing {
+  uint64_t serial;
+  void* ring;
+};
+
+// Rings this thread has recorded into, by tracer serial. Entries of tracers
+// that are gone are never matched again.
+thread_local std::vector<CachedRing> t_rings;
+
+// Span names and argument names are literals, but keep the JSON valid
+// whatever they hold.
+void AppendJsonString(const char* text, std::string* out) {
+  out->push_back('"');
+  for (const char* c = text; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out->push_back('\\');
+      out->push_back(*c);
+    } else if (static_cast<unsigned char>(*c) >= 0x20) {
+      out->push_back(*c);
+    }
+  }
+  out->push_back('"');
+}
+
+}  // namespace
+
+int64_t TraceNow() { return TraceMicros(std::chrono::steady_clock::now()); }
+
+int64_t TraceMicros(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch())
+      .count();
+}
+
+struct JobTracer::ThreadRing {
+  std::mutex mutex;
+  std::vector<TraceSpan> spans;
+  // Slot the next span goes to, and how many slots hold one.
+  size_t next = 0;
+  size_t size = 0;
+  uint32_t thread = 0;
+};
+
+JobTracer::JobTracer(JobTracerOptions options)
+    : options_(std::move(options)), serial_(g_next_serial.fetch_add(1)) {}
+
+JobTracer::~JobTracer() = default;
+
+uint64_t JobTracer::BeginJob() {
+  const uint64_t trace_id = next_trace_id_.fetch_add(1, std::memory_order_relaxed);
+  const int64_t now = TraceNow();
+  std::lock_guard<std::mutex> lock(mutex_);
+  open_jobs_[trace_id] = now;
+  return trace_id;
+}
+
+int64_t JobTracer::FinishJob(uint64_t trace_id) {
+  int64_t begin;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = open_jobs_.find(trace_id);
+    if (it == open_jobs_.end()) return -1;
+    begin = it->second;
+    open_jobs_.erase(it);
+  }
+  const int64_t end = TraceNow();
+  Record(trace_id, "job", begin, end);
+  const int64_t duration = end - begin;
+  if (options_.slow_job_us > 0 && duration >= options_.slow_job_us &&
+      options_.on_slow_job) {
+    options_.on_slow_job(trace_id, duration, Export(trace_id));
+  }
+  return duration;
+}
+
+JobTracer::ThreadRing* JobTracer::RingForThisThread() {
+  for (const CachedRing& cached : t_rings) {
+    if (cached.serial == serial_) return static_cast<ThreadRing*>(cached.ring);
+  }
+  auto ring = std::make_unique<ThreadRing>();
+  ring->spans.resize(std::max<size_t>(options_.spans_per_thread, 1));
+  ThreadRing* raw = ring.get();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    raw->thread = static_cast<uint32_t>(rings_.size() + 1);
+    rings_.push_back(std::move(ring));
+  }
+  t_rings.push_back(CachedRing{serial_, raw});
+  return raw;
+}
+
+void JobTracer::Record(uint64_t trace_id, const char* name, int64_t start_us, int64_t end_us,
+                       const char* arg_name, int64_t arg) {
+  if (trace_id == 0) return;
+  ThreadRing* ring = RingForThisThread();
+  // Only Export() ever waits for this lock
+  std::lock_guard<std::mutex> lock(ring->mutex);
+  TraceSpan& span = ring->spans[ring->next];
+  span.trace_id = trace_id;
+  span.name = name;
+  span.start_us = start_us;
+  span.end_us = std::max(start_us, end_us);
+  span.thread = ring->thread;
+  span.arg_name = arg_name;
+  span.arg = arg;
+  ring->next = (ring->next + 1) % ring->spans.size();
+  if (ring->size < ring->spans.size()) ++ring->size;
+}
+
+std::string JobTracer::Export(uint64_t trace_id) const {
+  std::vector<TraceSpan> spans;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<ThreadRing>& ring : rings_) {
+      std::lock_guard<std::mutex> ring_lock(ring->mutex);
+      for (size_t i = 0; i < ring->size; ++i) {
+        const TraceSpan& span = ring->spans[i];
+        if (trace_id == 0 || span.trace_id == trace_id) spans.push_back(span);
+      }
+    }
+  }
+  // Parents before the spans they contain, which the viewers expect
+  std::sort(spans.begin(), spans.end(), [](const TraceSpan& a, const TraceSpan& b) {
+    if (a.start_us != b.start_us) return a.start_us < b.start_us;
+    return a.end_us > b.end_us;
+  });
+
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < spans.size(); ++i) {
+    const TraceSpan& span = spans[i];
+    if (i > 0) json += ',';
+    json += "{\"name\":";
+    AppendJsonString(span.name, &json);
+    json += ",\"cat\":\"print\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(span.thread) +
+            ",\"ts\":" + std::to_string(span.start_us) +
+            ",\"dur\":" + std::to_string(span.end_us - span.start_us) +
+            ",\"args\":{\"job\":" + std::to_string(span.trace_id);
+    if (span.arg_name != nullptr) {
+      json += ',';
+      AppendJsonString(span.arg_name, &json);
+      json += ':' + std::to_string(span.arg);
+    }
+    json += "}}";
+  }
+  json += "]}";
+  return json;
+}
+
+}  // namespace printer_core
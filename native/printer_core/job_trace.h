@@ -0,0 +1,128 @@
+#ifndef PRINTER_CORE_JOB_TRACE_H_
+#define PRINTER_CORE_JOB_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+
+// Microseconds on the monotonic clock every trace timestamp uses.
+int64_t TraceNow();
+int64_t TraceMicros(std::chrono::steady_clock::time_point time);
+
+// One timed step of a print job.
+struct TraceSpan {
+  uint64_t trace_id = 0;
+  // A string literal such as "encode" or "write".
+  const char* name = nullptr;
+  int64_t start_us = 0;
+  int64_t end_us = 0;
+  // Small id of the recording thread, 1 for the first one seen.
+  uint32_t thread = 0;
+  // Optional numeric detail, e.g. "bytes"; |arg_name| is a literal or null.
+  const char* arg_name = nullptr;
+  int64_t arg = 0;
+};
+
+// Called with a finished job that took at least slow_job_us, and its timeline
+// as Chrome trace JSON.
+using SlowJobCallback =
+    std::function<void(uint64_t trace_id, int64_t duration_us, const std::string& json)>;
+
+struct JobTracerOptions {
+  // Spans each thread keeps; the oldest are overwritten first.
+  size_t spans_per_thread = 4096;
+  // Jobs taking at least this long from BeginJob() to FinishJob() are handed
+  // to on_slow_job; 0 to never report them.
+  int64_t slow_job_us = 0;
+  SlowJobCallback on_slow_job;
+};
+
+// Per-job timeline of a print: the runner's decode and encode, the queue
+// wait, connect and each chunk written, and the hop back to the platform
+// thread. Each thread records into its own fixed ring of spans, guarded by a
+// mutex only an export ever contends on, so recording costs a clock read and
+// a copy. Export() writes the spans of one job, or all of them, in the Chrome
+// trace event format (chrome://tracing, Perfetto). Thread-safe.
+class JobTracer {
+ public:
+  explicit JobTracer(JobTracerOptions options = JobTracerOptions());
+  ~JobTracer();
+
+  JobTracer(const JobTracer&) = delete;
+  JobTracer& operator=(const JobTracer&) = delete;
+
+  // Starts a job's timeline and returns its trace id (never 0).
+  uint64_t BeginJob();
+
+  // Ends the timeline with a "job" span from BeginJob() to now, and reports
+  // it if it was slow. Returns how long the job took, or -1 for an unknown
+  // id.
+  int64_t FinishJob(uint64_t trace_id);
+
+  // Records a span on the calling thread's ring. Does nothing for trace id 0.
+  void Record(uint64_t trace_id, const char* name, int64_t start_us, int64_t end_us,
+              const char* arg_name = nullptr, int64_t arg = 0);
+
+  // Chrome trace JSON ({"traceEvents": [...]}) with the spans still held for
+  // |trace_id|, or for every job when it is 0.
+  std::string Export(uint64_t trace_id = 0) const;
+
+ private:
+  struct ThreadRing;
+
+  ThreadRing* RingForThisThread();
+
+  const JobTracerOptions options_;
+  // Tells this tracer apart from an earlier one at the same address in the
+  // threads' cached ring pointers.
+  const uint64_t serial_;
+  std::atomic<uint64_t> next_trace_id_{1};
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadRing>> rings_;
+  // BeginJob() time of jobs not yet finished.
+  std::map<uint64_t, int64_t> open_jobs_;
+};
+
+// Records a span from construction to destruction; inert when |tracer| is
+// null or |trace_id| is 0.
+class ScopedTraceSpan {
+ public:
+  ScopedTraceSpan(JobTracer* tracer, uint64_t trace_id, const char* name)
+      : tracer_(tracer && trace_id != 0 ? tracer : nullptr),
+        trace_id_(trace_id),
+        name_(name),
+        start_us_(tracer_ ? TraceNow() : 0) {}
+  ~ScopedTraceSpan() {
+    if (tracer_) tracer_->Record(trace_id_, name_, start_us_, TraceNow(), arg_name_, arg_);
+  }
+
+  ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+  ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+  void set_arg(const char* name, int64_t value) {
+    arg_name_ = name;
+    arg_ = value;
+  }
+
+ private:
+  JobTracer* const tracer_;
+  const uint64_t trace_id_;
+  const char* const name_;
+  const int64_t start_us_;
+  const char* arg_name_ = nullptr;
+  int64_t arg_ = 0;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_JOB_TRACE_H_
@@ -0,0 +1,305 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+namespace printer_core {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t capacity = 2;
+  while (capacity < n) capacity <<= 1;
+  return capacity;
+}
+
+// The longest prefix of |text| up to |max| bytes that does not split a UTF-8
+// character.
+size_t CutUtf8(std::string_view text, size_t max) {
+  if (text.size() <= max) return text.size();
+  size_t size = max;
+  while (size > 0 && (static_cast<uint8_t>(text[size]) & 0xC0) == 0x80) --size;
+  return size;
+}
+
+int64_t NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// "2026-01-31T12:34:56.789Z"
+void FormatTime(int64_t time_us, char* out, size_t size) {
+  const std::time_t seconds = static_cast<std::time_t>(time_us / 1000000);
+  std::tm utc{};
+#ifdef _WIN32
+  gmtime_s(&utc, &seconds);
+#else
+  gmtime_r(&seconds, &utc);
+#endif
+  const size_t n = std::strftime(out, size, "%Y-%m-%dT%H:%M:%S", &utc);
+  std::snprintf(out + n, size - n, ".%03dZ", static_cast<int>(time_us / 1000 % 1000));
+}
+
+// The runners pass UTF-8 paths; the narrow fopen on Windows would read them
+// in the ANSI code page.
+std::FILE* OpenForAppend(const std::filesystem::path& path) {
+#ifdef _WIN32
+  return _wfopen(path.c_str(), L"ab");
+#else
+  return std::fopen(path.c_str(), "ab");
+#endif
+}
+
+}  // namespace
+
+const char* LogLevelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::kDebug:
+      return "DEBUG";
+    case LogLevel::kInfo:
+      return "INFO";
+    case LogLevel::kWarning:
+      return "WARNING";
+    case LogLevel::kError:
+      return "ERROR";
+  }
+  return "INFO";
+}
+
+LogRing::LogRing(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+  for (size_t i = 0; i <= mask_; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool LogRing::TryPush(int64_t time_us, LogLevel level, std::string_view category,
+                      std::string_view message) {
+  size_t index = push_index_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[index & mask_];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t turn = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index);
+    if (turn == 0) {
+      // Free for this turn; claim it
+      if (push_index_.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) break;
+    } else if (turn < 0) {
+      // Still holds the message from one lap ago
+      return false;
+    } else {
+      index = push_index_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->time_us = time_us;
+  slot->level = level;
+  slot->category_size = static_cast<uint8_t>(CutUtf8(category, kLogCategoryMax));
+  std::memcpy(slot->category, category.data(), slot->category_size);
+  slot->message_size = static_cast<uint16_t>(CutUtf8(message, kLogMessageMax));
+  std::memcpy(slot->message, message.data(), slot->message_size);
+  slot->sequence.store(index + 1, std::memory_order_release);
+  return true;
+}
+
+bool LogRing::TryPop(LogEntry* entry) {
+  size_t index = pop_index_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[index & mask_];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t turn =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index + 1);
+    if (turn == 0) {
+      if (pop_index_.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) break;
+    } else if (turn < 0) {
+      // Not written yet
+      return false;
+    } else {
+      index = pop_index_.load(std::memory_order_relaxed);
+    }
+  }
+  entry->time_us = slot->time_us;
+  entry->level = slot->level;
+  entry->category.assign(slot->category, slot->category_size);
+  entry->message.assign(slot->message, slot->message_size);
+  // Free for the producer one lap on
+  slot->sequence.store(index + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+Logger::Logger(LoggerOptions options, LogBatchSink sink)
+    : options_(std::move(options)),
+      sink_(std::move(sink)),
+      ring_(options_.capacity),
+      min_level_(options_.min_level) {
+  for (const LogCategoryRule& rule : options_.categories) {
+    auto category = std::make_unique<Category>();
+    category->rule = rule;
+    category->rule.sample_every = std::max<uint32_t>(rule.sample_every, 1);
+    categories_.push_back(std::move(category));
+  }
+  default_category_.rule.max_per_second = options_.default_max_per_second;
+  if (!options_.file_path.empty()) {
+    file_ = OpenForAppend(std::filesystem::u8path(options_.file_path));
+    if (file_ && std::fseek(file_, 0, SEEK_END) == 0) {
+      file_size_ = static_cast<size_t>(std::max(0L, std::ftell(file_)));
+    }
+  }
+  flusher_ = std::thread([this] { FlushLoop(); });
+}
+
+Logger::~Logger() {
+  Shutdown();
+  if (file_) std::fclose(file_);
+}
+
+Logger::Category* Logger::Find(std::string_view name) {
+  for (const std::unique_ptr<Category>& category : categories_) {
+    if (category->rule.category == name) return category.get();
+  }
+  return &default_category_;
+}
+
+bool Logger::Log(LogLevel level, std::string_view category, std::string_view message) {
+  if (stopped_.load(std::memory_order_relaxed)) return false;
+  if (!Enabled(level)) {
+    filtered_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Category* rule = Find(category);
+  if (level < rule->rule.min_level) {
+    filtered_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (level < LogLevel::kWarning && rule->rule.sample_every > 1 &&
+      rule->seen.fetch_add(1, std::memory_order_relaxed) % rule->rule.sample_every != 0) {
+    sampled_out_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  const int64_t now = NowMicros();
+  if (rule->rule.max_per_second > 0) {
+    // Whoever moves the window resets its count; messages racing the move
+    // may count against either second.
+    const int64_t second = now / 1000000;
+    int64_t window = rule->window.load(std::memory_order_relaxed);
+    if (window != second &&
+        rule->window.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+      rule->in_window.store(0, std::memory_order_relaxed);
+    }
+    if (rule->in_window.fetch_add(1, std::memory_order_relaxed) >= rule->rule.max_per_second) {
+      rate_limited_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  if (!ring_.TryPush(now, level, category, message)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  logged_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void Logger::Flush() {
+  std::lock_guard<std::mutex> lock(flush_mutex_);
+  Drain();
+}
+
+void Logger::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    if (stopping_) return;
+    stopping_ = true;
+  }
+  wake_cv_.notify_all();
+  if (flusher_.joinable()) flusher_.join();
+  stopped_.store(true, std::memory_order_relaxed);
+  Flush();
+}
+
+LoggerStats Logger::stats() const {
+  LoggerStats stats;
+  stats.logged = logged_.load(std::memory_order_relaxed);
+  stats.filtered = filtered_.load(std::memory_order_relaxed);
+  stats.sampled_out = sampled_out_.load(std::memory_order_relaxed);
+  stats.rate_limited = rate_limited_.load(std::memory_order_relaxed);
+  stats.dropped = dropped_.load(std::memory_order_relaxed);
+  stats.batches = batches_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void Logger::FlushLoop() {
+  const auto interval = std::chrono::milliseconds(std::max(options_.flush_interval_ms, 1));
+  std::unique_lock<std::mutex> wake_lock(wake_mutex_);
+  while (!stopping_) {
+    wake_cv_.wait_for(wake_lock, interval, [this] { return stopping_; });
+    wake_lock.unlock();
+    Flush();
+    wake_lock.lock();
+  }
+}
+
+void Logger::Drain() {
+  batch_.clear();
+  LogEntry entry;
+  while (ring_.TryPop(&entry)) batch_.push_back(std::move(entry));
+  const uint64_t lost = rate_limited_.load(std::memory_order_relaxed) +
+                        dropped_.load(std::memory_order_relaxed);
+  if (lost != reported_lost_) {
+    LogEntry note;
+    note.time_us = NowMicros();
+    note.level = LogLevel::kWarning;
+    note.category = "LOG";
+    note.message = std::to_string(lost - reported_lost_) +
+                   " message(s) dropped by rate limits or a full buffer";
+    batch_.push_back(std::move(note));
+    reported_lost_ = lost;
+  }
+  if (batch_.empty()) return;
+  WriteFile(batch_);
+  if (sink_) sink_(batch_);
+  batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::WriteFile(const std::vector<LogEntry>& batch) {
+  if (!file_) return;
+  char time[32];
+  for (const LogEntry& entry : batch) {
+    FormatTime(entry.time_us, time, sizeof(time));
+    const int n = std::fprintf(file_, "%s %s %s: %.*s\n", time, LogLevelName(entry.level),
+                               entry.category.c_str(), static_cast<int>(entry.message.size()),
+                               entry.message.data());
+    if (n > 0) file_size_ += static_cast<size_t>(n);
+  }
+  std::fflush(file_);
+  if (file_size_ >= options_.max_file_bytes) RotateFile();
+}
+
+void Logger::RotateFile() {
+  std::fclose(file_);
+  file_ = nullptr;
+  const std::filesystem::path path = std::filesystem::u8path(options_.file_path);
+  auto numbered = [&path](int n) {
+    std::filesystem::path file = path;
+    file += "." + std::to_string(n);
+    return file;
+  };
+  // A missing file is fine at every step, so errors are ignored.
+  std::error_code ec;
+  std::filesystem::remove(numbered(std::max(options_.max_files - 1, 1)), ec);
+  for (int n = options_.max_files - 2; n >= 1; --n) {
+    std::filesystem::rename(numbered(n), numbered(n + 1), ec);
+  }
+  if (options_.max_files > 1) {
+    std::filesystem::rename(path, numbered(1), ec);
+  } else {
+    std::filesystem::remove(path, ec);
+  }
+  file_ = OpenForAppend(path);
+  file_size_ = 0;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,209 @@
+#ifndef PRINTER_CORE_LOGGER_H_
+#define PRINTER_CORE_LOGGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace printer_core {
+
+enum class LogLevel : uint8_t { kDebug, kInfo, kWarning, kError };
+
+// "DEBUG", "INFO", "WARNING" or "ERROR".
+const char* LogLevelName(LogLevel level);
+
+// Longest category and message a LogRing slot holds; longer ones are cut at
+// a UTF-8 character boundary.
+constexpr size_t kLogCategoryMax = 15;
+constexpr size_t kLogMessageMax = 480;
+
+// A message taken out of the ring.
+struct LogEntry {
+  // Microseconds since the Unix epoch.
+  int64_t time_us = 0;
+  LogLevel level = LogLevel::kInfo;
+  std::string category;
+  std::string message;
+};
+
+// Bounded multi-producer, multi-consumer queue of log messages in fixed-size
+// slots. Each slot carries a sequence number that says whether it is free
+// for the producer of a given turn or filled for the consumer of that turn
+// (after Vyukov), so a push or pop is one compare-and-swap on a shared index
+// plus a copy, with no lock and no allocation. A full ring refuses the push
+// instead of waiting.
+class LogRing {
+ public:
+  // |capacity| is rounded up to a power of two, at least 2.
+  explicit LogRing(size_t capacity);
+
+  LogRing(const LogRing&) = delete;
+  LogRing& operator=(const LogRing&) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // False when the ring is full.
+  bool TryPush(int64_t time_us, LogLevel level, std::string_view category,
+               std::string_view message);
+
+  // False when the ring is empty. Reuses the capacity of |entry|'s strings.
+  bool TryPop(LogEntry* entry);
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    int64_t time_us = 0;
+    LogLevel level = LogLevel::kInfo;
+    uint8_t category_size = 0;
+    uint16_t message_size = 0;
+    char category[kLogCategoryMax];
+    char message[kLogMessageMax];
+  };
+
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  // On separate cache lines so producers and the consumer do not contend.
+  alignas(64) std::atomic<size_t> push_index_{0};
+  alignas(64) std::atomic<size_t> pop_index_{0};
+};
+
+// Filtering for one category. Sampling only thins out debug and info
+// messages; the rate limit applies to every level.
+struct LogCategoryRule {
+  std::string category;
+  // Messages below this level are dropped.
+  LogLevel min_level = LogLevel::kDebug;
+  // Keep one debug or info message in this many.
+  uint32_t sample_every = 1;
+  // Most messages kept per second; 0 for no limit.
+  uint32_t max_per_second = 0;
+};
+
+struct LoggerOptions {
+  // Ring slots; a burst larger than this between flushes is dropped.
+  size_t capacity = 1024;
+  // How often the flusher hands a batch to the sink and the file.
+  int flush_interval_ms = 250;
+  // Messages below this level are dropped whatever their category.
+  LogLevel min_level = LogLevel::kInfo;
+  // Rules by category; categories without one are only rate limited by
+  // default_max_per_second.
+  std::vector<LogCategoryRule> categories;
+  uint32_t default_max_per_second = 0;
+  // Log file, rotated to |file_path|.1 ... .|max_files - 1| when it grows past
+  // |max_file_bytes|. Empty for no file.
+  std::string file_path;
+  size_t max_file_bytes = 1 << 20;
+  int max_files = 3;
+};
+
+struct LoggerStats {
+  // Messages queued.
+  uint64_t logged = 0;
+  // Below the global or category level.
+  uint64_t filtered = 0;
+  uint64_t sampled_out = 0;
+  uint64_t rate_limited = 0;
+  // Lost because the ring was full.
+  uint64_t dropped = 0;
+  // Batches handed to the sink.
+  uint64_t batches = 0;
+};
+
+// Receives each non-empty batch on the flusher thread, oldest first.
+using LogBatchSink = std::function<void(const std::vector<LogEntry>& batch)>;
+
+// Logging for the runner plugins. Log() filters a message and copies it into
+// a LogRing; it never takes a lock, allocates or waits, so job workers, the
+// status poller and the platform thread can log freely. A flusher thread
+// drains the ring every flush_interval_ms into one batch for the sink (the
+// runners send it to Dart as a single channel call) and appends it to a
+// rotating log file. Messages lost to rate limits or a full ring are
+// counted and reported in the next batch. Thread-safe.
+class Logger {
+ public:
+  Logger(LoggerOptions options, LogBatchSink sink);
+  // Flushes what is queued and stops the flusher.
+  ~Logger();
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  void set_min_level(LogLevel level) { min_level_.store(level, std::memory_order_relaxed); }
+  LogLevel min_level() const { return min_level_.load(std::memory_order_relaxed); }
+
+  // Whether a message at |level| gets past the global level, so callers can
+  // skip formatting one that would not.
+  bool Enabled(LogLevel level) const { return level >= min_level(); }
+
+  // Queues |message| unless it is filtered out or the ring is full; returns
+  // whether it was queued.
+  bool Log(LogLevel level, std::string_view category, std::string_view message);
+
+  // Drains the ring to the sink and file now, on the calling thread.
+  void Flush();
+
+  // Flushes and stops the flusher; later messages are dropped.
+  void Shutdown();
+
+  LoggerStats stats() const;
+
+ private:
+  struct Category {
+    LogCategoryRule rule;
+    std::atomic<uint64_t> seen{0};
+    // Second of the current rate window and messages kept in it.
+    std::atomic<int64_t> window{0};
+    std::atomic<uint32_t> in_window{0};
+  };
+
+  // The rule state for |name|; the default one if it has no rule.
+  Category* Find(std::string_view name);
+  void FlushLoop();
+  // Moves the ring into batch_ and writes it out; call with flush_mutex_.
+  void Drain();
+  void WriteFile(const std::vector<LogEntry>& batch);
+  void RotateFile();
+
+  const LoggerOptions options_;
+  const LogBatchSink sink_;
+  LogRing ring_;
+  std::atomic<LogLevel> min_level_;
+  // Fixed after construction, so lookups need no lock.
+  std::vector<std::unique_ptr<Category>> categories_;
+  Category default_category_;
+  std::atomic<bool> stopped_{false};
+
+  std::atomic<uint64_t> logged_{0};
+  std::atomic<uint64_t> filtered_{0};
+  std::atomic<uint64_t> sampled_out_{0};
+  std::atomic<uint64_t> rate_limited_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> batches_{0};
+
+  // Consumer side: the flusher and Flush() callers.
+  std::mutex flush_mutex_;
+  std::vector<LogEntry> batch_;
+  // rate_limited_ + dropped_ as of the last batch.
+  uint64_t reported_lost_ = 0;
+  std::FILE* file_ = nullptr;
+  size_t file_size_ = 0;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  bool stopping_ = false;
+  std::thread flusher_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_LOGGER_H_
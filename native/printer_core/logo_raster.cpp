@@ -0,0 +1,441 @@
+#include "logo_raster.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PRINTER_CORE_SSE2 1
+#endif
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kGs = 0x1D;
+
+// Bit-reversed bytes: movemask puts the leftmost pixel in bit 0, ESC/POS
+// wants it in bit 7.
+const uint8_t* ReversedBits() {
+  static const auto table = [] {
+    std::vector<uint8_t> t(256);
+    for (int i = 0; i < 256; ++i) {
+      uint8_t r = 0;
+      for (int b = 0; b < 8; ++b) r |= ((i >> b) & 1) << (7 - b);
+      t[i] = r;
+    }
+    return t;
+  }();
+  return table.data();
+}
+
+// out[x] = average of |count| rows starting at |rows|, |stride| bytes apart.
+void AverageRows(const uint8_t* rows, size_t stride, int count, int width, uint8_t* out) {
+  if (count == 1) {
+    std::memcpy(out, rows, width);
+    return;
+  }
+  int x = 0;
+#ifdef PRINTER_CORE_SSE2
+  // 16-bit sums hold up to 257 rows of 255; the divide is a multiply by a
+  // 16-bit reciprocal.
+  if (count <= 257) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(static_cast<short>(count / 2));
+    const __m128i recip = _mm_set1_epi16(static_cast<short>((65536 + count - 1) / count));
+    for (; x + 16 <= width; x += 16) {
+      __m128i lo = half;
+      __m128i hi = half;
+      const uint8_t* p = rows + x;
+      for (int r = 0; r < count; ++r, p += stride) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+        hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+      }
+      lo = _mm_mulhi_epu16(lo, recip);
+      hi = _mm_mulhi_epu16(hi, recip);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(lo, hi));
+    }
+  }
+#endif
+  for (; x < width; ++x) {
+    uint32_t sum = static_cast<uint32_t>(count / 2);
+    const uint8_t* p = rows + x;
+    for (int r = 0; r < count; ++r, p += stride) sum += *p;
+    out[x] = static_cast<uint8_t>(sum / count);
+  }
+}
+
+// Sets bit x of |out| (MSB first) where pixels[x] < thresholds[x].
+void PackDarker(const uint8_t* pixels, const uint8_t* thresholds, int width, uint8_t* out) {
+  const uint8_t* reversed = ReversedBits();
+  int x = 0;
+#ifdef PRINTER_CORE_SSE2
+  // Flipping the top bit turns the signed compare into an unsigned one.
+  const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+  for (; x + 16 <= width; x += 16) {
+    const __m128i p = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x)), flip);
+    const __m128i t = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + x)), flip);
+    const int mask = _mm_movemask_epi8(_mm_cmplt_epi8(p, t));
+    out[x / 8] = reversed[mask & 0xFF];
+    out[x / 8 + 1] = reversed[(mask >> 8) & 0xFF];
+  }
+#endif
+  for (; x < width; x += 8) {
+    uint8_t byte = 0;
+    for (int b = 0; b < 8 && x + b < width; ++b) {
+      if (pixels[x + b] < thresholds[x + b]) byte |= 0x80 >> b;
+    }
+    out[x / 8] = byte;
+  }
+}
+
+void DitherFloydSteinberg(const GrayImage& image, MonoBitmap* bitmap) {
+  const int w = image.width;
+  // Error for this row and the next, with a guard cell on each side.
+  std::vector<int> current(w + 2, 0);
+  std::vector<int> next(w + 2, 0);
+  for (int y = 0; y < image.height; ++y) {
+    const uint8_t* row = &image.pixels[static_cast<size_t>(y) * w];
+    uint8_t* out = &bitmap->bits[static_cast<size_t>(y) * bitmap->bytes_per_row];
+    std::fill(next.begin(), next.end(), 0);
+    for (int x = 0; x < w; ++x) {
+      const int value = row[x] + current[x + 1] / 16;
+      const bool dark = value < 128;
+      if (dark) out[x / 8] |= 0x80 >> (x % 8);
+      const int error = value - (dark ? 0 : 255);
+      current[x + 2] += error * 7;
+      next[x] += error * 3;
+      next[x + 1] += error * 5;
+      next[x + 2] += error;
+    }
+    std::swap(current, next);
+  }
+}
+
+// Rows [y, y + rows) printed as one GS v 0 command without |trim| bytes on
+// either side.
+void AppendRasterRows(const MonoBitmap& bitmap, int y, int rows, int trim,
+                      std::vector<uint8_t>* out) {
+  const int width = bitmap.bytes_per_row - 2 * trim;
+  const uint8_t header[] = {kGs,
+                            'v',
+                            '0',
+                            0,
+                            static_cast<uint8_t>(width & 0xFF),
+                            static_cast<uint8_t>(width >> 8),
+                            static_cast<uint8_t>(rows & 0xFF),
+                            static_cast<uint8_t>(rows >> 8)};
+  out->insert(out->end(), header, header + sizeof(header));
+  if (trim == 0) {
+    const auto begin = bitmap.bits.begin() + static_cast<size_t>(y) * bitmap.bytes_per_row;
+    out->insert(out->end(), begin, begin + static_cast<size_t>(rows) * bitmap.bytes_per_row);
+    return;
+  }
+  for (int r = y; r < y + rows; ++r) {
+    const auto begin = bitmap.bits.begin() + static_cast<size_t>(r) * bitmap.bytes_per_row + trim;
+    out->insert(out->end(), begin, begin + width);
+  }
+}
+
+// A run of rows in a compact band: fed over when blank, otherwise printed
+// with |trim| blank bytes dropped on each side.
+struct BandSegment {
+  int y = 0;
+  int rows = 0;
+  bool blank = false;
+  int trim = 0;
+};
+
+// Splits rows [y, y + rows) into blank runs and trimmed ink runs. Empty when
+// the plain band is no longer than that, counting |feed_overhead| more bytes
+// if any blank run is fed over.
+std::vector<BandSegment> CompactBand(const MonoBitmap& bitmap, int y, int rows,
+                                     size_t feed_overhead) {
+  const int width = bitmap.bytes_per_row;
+  // Blank bytes on the narrower side of each row; |width| for a blank row.
+  std::vector<int> margin(rows);
+  for (int r = 0; r < rows; ++r) {
+    const uint8_t* row = &bitmap.bits[static_cast<size_t>(y + r) * width];
+    int lead = 0;
+    while (lead < width && row[lead] == 0) ++lead;
+    int tail = 0;
+    while (tail < width - lead && row[width - 1 - tail] == 0) ++tail;
+    margin[r] = lead == width ? width : std::min(lead, tail);
+  }
+
+  // A blank run is worth a feed (3 bytes) and a new GS v 0 header (8 bytes)
+  // once it is longer than that as zero bytes.
+  std::vector<BandSegment> segments;
+  size_t compact_size = 0;
+  for (int r = 0; r < rows;) {
+    int end = r;
+    while (end < rows && margin[end] == width) ++end;
+    if (end > r && static_cast<size_t>(end - r) * width > 11) {
+      segments.push_back(BandSegment{y + r, end - r, true, 0});
+      compact_size += 3 * ((end - r + 254) / 255) + feed_overhead;
+      feed_overhead = 0;
+      r = end;
+      continue;
+    }
+    // Ink rows, absorbing blank runs too short to split on.
+    BandSegment ink{y + r, 0, false, width};
+    for (end = r; end < rows;) {
+      int blank_end = end;
+      while (blank_end < rows && margin[blank_end] == width) ++blank_end;
+      if (blank_end > end && static_cast<size_t>(blank_end - end) * width > 11) break;
+      end = blank_end;
+      if (end < rows) ink.trim = std::min(ink.trim, margin[end++]);
+    }
+    ink.rows = end - r;
+    if (ink.trim == width) ink.trim = 0;
+    segments.push_back(ink);
+    compact_size += 8 + static_cast<size_t>(width - 2 * ink.trim) * ink.rows;
+    r = end;
+  }
+  if (compact_size >= 8 + static_cast<size_t>(width) * rows) segments.clear();
+  return segments;
+}
+
+}  // namespace
+
+bool ParseDitherMode(std::string_view name, DitherMode* mode) {
+  if (name == "threshold") {
+    *mode = DitherMode::kThreshold;
+  } else if (name == "ordered") {
+    *mode = DitherMode::kOrdered;
+  } else if (name == "floyd_steinberg" || name == "floyd-steinberg") {
+    *mode = DitherMode::kFloydSteinberg;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+GrayImage GrayFromPixels(const uint8_t* pixels, int width, int height, size_t stride,
+                         PixelLayout layout) {
+  GrayImage image;
+  if (width <= 0 || height <= 0) return image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(static_cast<size_t>(width) * height);
+  const int step = layout == PixelLayout::kRgb ? 3 : 4;
+  const int red = layout == PixelLayout::kBgra ? 2 : 0;
+  const int blue = 2 - red;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* p = pixels + static_cast<size_t>(y) * stride;
+    uint8_t* out = &image.pixels[static_cast<size_t>(y) * width];
+    for (int x = 0; x < width; ++x, p += step) {
+      const uint32_t luma = (77u * p[red] + 150u * p[1] + 29u * p[blue] + 128) >> 8;
+      const uint32_t alpha = step == 4 ? p[3] : 255;
+      out[x] = static_cast<uint8_t>((luma * alpha + 255 * (255 - alpha) + 127) / 255);
+    }
+  }
+  return image;
+}
+
+GrayImage ScaleToWidth(const GrayImage& image, int width) {
+  GrayImage scaled;
+  if (image.width <= 0 || image.height <= 0 || width <= 0) return scaled;
+  const int height = std::max(
+      1, static_cast<int>((static_cast<int64_t>(image.height) * width + image.width / 2) /
+                          image.width));
+  scaled.width = width;
+  scaled.height = height;
+  scaled.pixels.resize(static_cast<size_t>(width) * height);
+
+  // Source columns [x_begin[x], x_begin[x + 1]) make up output column x; an
+  // upscaled column repeats its nearest source column.
+  std::vector<int> x_begin(width + 1);
+  for (int x = 0; x <= width; ++x) {
+    x_begin[x] = static_cast<int>(static_cast<int64_t>(x) * image.width / width);
+  }
+  std::vector<uint8_t> row(image.width);
+  std::vector<uint32_t> prefix(image.width + 1, 0);
+  for (int y = 0; y < height; ++y) {
+    const int y0 = static_cast<int>(static_cast<int64_t>(y) * image.height / height);
+    const int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(y + 1) *
+                                                     image.height / height));
+    AverageRows(&image.pixels[static_cast<size_t>(y0) * image.width], image.width, y1 - y0,
+                image.width, row.data());
+    for (int x = 0; x < image.width; ++x) prefix[x + 1] = prefix[x] + row[x];
+    uint8_t* out = &scaled.pixels[static_cast<size_t>(y) * width];
+    for (int x = 0; x < width; ++x) {
+      const int x0 = x_begin[x];
+      const int x1 = std::max(x0 + 1, x_begin[x + 1]);
+      const uint32_t n = static_cast<uint32_t>(x1 - x0);
+      out[x] = static_cast<uint8_t>((prefix[x1] - prefix[x0] + n / 2) / n);
+    }
+  }
+  return scaled;
+}
+
+MonoBitmap Dither(const GrayImage& image, DitherMode mode) {
+  MonoBitmap bitmap;
+  if (image.width <= 0 || image.height <= 0) return bitmap;
+  bitmap.width = image.width;
+  bitmap.height = image.height;
+  bitmap.bytes_per_row = (image.width + 7) / 8;
+  bitmap.bits.assign(static_cast<size_t>(bitmap.bytes_per_row) * image.height, 0);
+  if (mode == DitherMode::kFloydSteinberg) {
+    DitherFloydSteinberg(image, &bitmap);
+    return bitmap;
+  }
+
+  // Threshold and ordered dithering are one compare against a per-dot
+  // threshold; ordered tiles an 8x8 Bayer matrix across the row.
+  static const uint8_t kBayer[8][8] = {
+      {0, 32, 8, 40, 2, 34, 10, 42},   {48, 16, 56, 24, 50, 18, 58, 26},
+      {12, 44, 4, 36, 14, 46, 6, 38},  {60, 28, 52, 20, 62, 30, 54, 22},
+      {3, 35, 11, 43, 1, 33, 9, 41},   {51, 19, 59, 27, 49, 17, 57, 25},
+      {15, 47, 7, 39, 13, 45, 5, 37},  {63, 31, 55, 23, 61, 29, 53, 21}};
+  const int pattern_rows = mode == DitherMode::kOrdered ? 8 : 1;
+  std::vector<uint8_t> thresholds(static_cast<size_t>(pattern_rows) * image.width, 128);
+  if (mode == DitherMode::kOrdered) {
+    for (int r = 0; r < 8; ++r) {
+      for (int x = 0; x < image.width; ++x) {
+        thresholds[static_cast<size_t>(r) * image.width + x] =
+            static_cast<uint8_t>((kBayer[r][x % 8] * 256 + 128) / 64);
+      }
+    }
+  }
+  for (int y = 0; y < image.height; ++y) {
+    PackDarker(&image.pixels[static_cast<size_t>(y) * image.width],
+               &thresholds[static_cast<size_t>(y % pattern_rows) * image.width], image.width,
+               &bitmap.bits[static_cast<size_t>(y) * bitmap.bytes_per_row]);
+  }
+  return bitmap;
+}
+
+void AppendRasterBands(const MonoBitmap& bitmap, std::vector<uint8_t>* out,
+                       const RasterOptions& options) {
+  bool feed_unit_set = false;
+  for (int y = 0; y < bitmap.height; y += kRasterBandRows) {
+    const int rows = std::min(kRasterBandRows, bitmap.height - y);
+    const std::vector<BandSegment> segments =
+        // The first feed also pays for setting and restoring GS P.
+        options.compact ? CompactBand(bitmap, y, rows, feed_unit_set ? 0 : 8)
+                        : std::vector<BandSegment>();
+    if (segments.empty()) {
+      AppendRasterRows(bitmap, y, rows, 0, out);
+      continue;
+    }
+    for (const BandSegment& segment : segments) {
+      if (segment.blank && !feed_unit_set) {
+        const int dpi = std::clamp(options.dots_per_inch, 1, 255);
+        const uint8_t unit[] = {kGs, 'P', 0, static_cast<uint8_t>(dpi)};
+        out->insert(out->end(), unit, unit + sizeof(unit));
+        feed_unit_set = true;
+      }
+      if (segment.blank) {
+        for (int left = segment.rows; left > 0; left -= 255) {
+          const uint8_t feed[] = {kEsc, 'J', static_cast<uint8_t>(std::min(left, 255))};
+          out->insert(out->end(), feed, feed + sizeof(feed));
+        }
+      } else {
+        AppendRasterRows(bitmap, segment.y, segment.rows, segment.trim, out);
+      }
+    }
+  }
+  if (feed_unit_set) {
+    const uint8_t reset[] = {kGs, 'P', 0, 0};
+    out->insert(out->end(), reset, reset + sizeof(reset));
+  }
+}
+
+std::vector<uint8_t> RasterBlock(const MonoBitmap& bitmap, const RasterOptions& options) {
+  if (bitmap.bits.empty()) return {};
+  // Starting from a non-empty vector keeps GCC 12's -Wstringop-overflow from
+  // misreading a range insert into an empty one in Release builds.
+  std::vector<uint8_t> out = {kEsc, 'a', 1};
+  out.reserve(bitmap.bits.size() + 16 * (bitmap.height / kRasterBandRows + 1));
+  AppendRasterBands(bitmap, &out, options);
+  // A line of space under the logo, then back to left alignment
+  const uint8_t tail[] = {'\n', kEsc, 'a', 0};
+  out.insert(out.end(), tail, tail + sizeof(tail));
+  return out;
+}
+
+std::vector<uint8_t> RasterizeLogo(const GrayImage& image, int width, DitherMode mode) {
+  if (image.width <= 0 || image.height <= 0 || width <= 0) return {};
+  return RasterBlock(Dither(image.width == width ? image : ScaleToWidth(image, width), mode));
+}
+
+void PrependLogo(const std::vector<uint8_t>& logo, std::vector<uint8_t>* receipt) {
+  const uint8_t reset[] = {kEsc, '@'};
+  receipt->insert(receipt->begin(), logo.begin(), logo.end());
+  receipt->insert(receipt->begin(), reset, reset + sizeof(reset));
+}
+
+uint64_t HashBytes(const uint8_t* data, size_t size) {
+  constexpr uint64_t kPrime = 0x100000001B3ull;
+  uint64_t hash = 0xCBF29CE484222325ull ^ size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * kPrime;
+  }
+  for (; i < size; ++i) hash = (hash ^ data[i]) * kPrime;
+  return hash;
+}
+
+LogoCache::LogoCache(size_t max_entries) : max_entries_(std::max<size_t>(1, max_entries)) {}
+
+std::shared_ptr<const RasterLogo> LogoCache::Get(const uint8_t* file, size_t size, int width,
+                                                 DitherMode mode, const Decoder& decode) {
+  const LogoKey key{HashBytes(file, size), width, mode};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      ++hits_;
+      it->second.last_used = ++tick_;
+      return it->second.logo;
+    }
+    ++misses_;
+  }
+
+  // Decoding and dithering happen outside the lock; a racing miss for the
+  // same logo just does the work twice.
+  GrayImage image;
+  if (!decode(&image) || image.pixels.empty() || width <= 0) return nullptr;
+  auto logo = std::make_shared<RasterLogo>();
+  logo->key = key;
+  logo->bitmap = Dither(image.width == width ? image : ScaleToWidth(image, width), mode);
+  logo->raster = RasterBlock(logo->bitmap);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[key];
+  if (!entry.logo) entry.logo = std::move(logo);
+  entry.last_used = ++tick_;
+  while (entries_.size() > max_entries_) {
+    auto oldest = std::min_element(entries_.begin(), entries_.end(),
+                                   [](const auto& a, const auto& b) {
+                                     return a.second.last_used < b.second.last_used;
+                                   });
+    entries_.erase(oldest);
+  }
+  return entry.logo;
+}
+
+size_t LogoCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+uint64_t LogoCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t LogoCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,158 @@
+#ifndef PRINTER_CORE_LOGO_RASTER_H_
+#define PRINTER_CORE_LOGO_RASTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace printer_core {
+
+// Common print widths in dots: 58 mm rolls, 80 mm rolls as the Dart
+// generator sized logos, and the full 72 mm printable width of 80 mm heads.
+constexpr int kLogoWidth58mm = 256;
+constexpr int kLogoWidth80mm = 384;
+constexpr int kLogoWidthFull80mm = 576;
+
+// GS v 0 commands carry at most this many rows each, so a tall logo does not
+// have to fit the printer's receive buffer in one piece.
+constexpr int kRasterBandRows = 256;
+
+enum class DitherMode {
+  // Dark below 50% gray; crisp for line-art logos.
+  kThreshold,
+  // 8x8 Bayer matrix; stable patterns, no error bleed.
+  kOrdered,
+  // Error diffusion; best for photos and gradients.
+  kFloydSteinberg,
+};
+
+// "threshold", "ordered" or "floyd_steinberg" (also "floyd-steinberg").
+bool ParseDitherMode(std::string_view name, DitherMode* mode);
+
+// 8-bit grayscale, row-major without padding; 0 is black.
+struct GrayImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Channel order of decoded pixels handed to GrayFromPixels.
+enum class PixelLayout { kRgba, kBgra, kRgb };
+
+// Converts decoded pixels to gray (BT.601 luma), compositing any alpha over
+// white paper. |stride| is the distance between rows in bytes.
+GrayImage GrayFromPixels(const uint8_t* pixels, int width, int height, size_t stride,
+                         PixelLayout layout);
+
+// Scales |image| to |width| pixels wide, keeping the aspect ratio. Each output
+// pixel is the average of the source area it covers, so large logos shrink
+// without aliasing.
+GrayImage ScaleToWidth(const GrayImage& image, int width);
+
+// One bit per dot, most significant bit leftmost, rows padded to whole bytes;
+// a set bit prints.
+struct MonoBitmap {
+  int width = 0;
+  int height = 0;
+  int bytes_per_row = 0;
+  std::vector<uint8_t> bits;
+};
+
+MonoBitmap Dither(const GrayImage& image, DitherMode mode);
+
+// How AppendRasterBands may shorten bands on the wire.
+struct RasterOptions {
+  // Lets a band feed over runs of blank rows (ESC J) and drop blank margins
+  // when that is shorter than sending the paper as zero bytes. Margins are
+  // dropped equally on both sides, so this assumes centred printing.
+  bool compact = true;
+  // Print head resolution; GS P makes the ESC J feed unit one dot with it.
+  int dots_per_inch = 203;
+};
+
+// Appends |bitmap| in bands of at most kRasterBandRows rows, each written as
+// a plain GS v 0 command or in its compact form, whichever is shorter.
+void AppendRasterBands(const MonoBitmap& bitmap, std::vector<uint8_t>* out,
+                       const RasterOptions& options = RasterOptions());
+
+// Centred raster block for |bitmap|, ready to go in front of a receipt.
+std::vector<uint8_t> RasterBlock(const MonoBitmap& bitmap,
+                                 const RasterOptions& options = RasterOptions());
+
+// Scales, dithers and packs |image| into a RasterBlock. Empty if the image is
+// empty.
+std::vector<uint8_t> RasterizeLogo(const GrayImage& image, int width, DitherMode mode);
+
+// Puts |logo| at the top of |receipt| behind an ESC @, so the block prints the
+// same whatever modes the previous job left set.
+void PrependLogo(const std::vector<uint8_t>& logo, std::vector<uint8_t>* receipt);
+
+// FNV-1a over 64-bit words of |data|; identifies a logo file by content.
+uint64_t HashBytes(const uint8_t* data, size_t size);
+
+struct LogoKey {
+  uint64_t hash = 0;
+  int width = 0;
+  DitherMode dither = DitherMode::kThreshold;
+
+  bool operator==(const LogoKey& other) const {
+    return hash == other.hash && width == other.width && dither == other.dither;
+  }
+  bool operator<(const LogoKey& other) const {
+    if (hash != other.hash) return hash < other.hash;
+    if (width != other.width) return width < other.width;
+    return dither < other.dither;
+  }
+};
+
+// A logo ready to print: the dithered bitmap, kept for NV uploads, and its
+// raster block.
+struct RasterLogo {
+  LogoKey key;
+  MonoBitmap bitmap;
+  std::vector<uint8_t> raster;
+};
+
+// Rasterized logos keyed by file content, width and dither mode, so a receipt
+// after the first only copies bytes. Least recently used entries are dropped
+// beyond |max_entries|. Thread-safe.
+class LogoCache {
+ public:
+  using Decoder = std::function<bool(GrayImage* image)>;
+
+  explicit LogoCache(size_t max_entries = 8);
+
+  LogoCache(const LogoCache&) = delete;
+  LogoCache& operator=(const LogoCache&) = delete;
+
+  // The logo for the image file whose bytes are |file|. |decode| is only
+  // called on a miss; returns null if it fails.
+  std::shared_ptr<const RasterLogo> Get(const uint8_t* file, size_t size, int width,
+                                        DitherMode mode, const Decoder& decode);
+
+  size_t size() const;
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  struct Entry {
+    std::shared_ptr<const RasterLogo> logo;
+    uint64_t last_used = 0;
+  };
+
+  const size_t max_entries_;
+  mutable std::mutex mutex_;
+  std::map<LogoKey, Entry> entries_;
+  uint64_t tick_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_LOGO_RASTER_H_
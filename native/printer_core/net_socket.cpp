@@ -0,0 +1,338 @@
+#include "net_socket.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <mutex>
+
+namespace printer_core {
+
+namespace {
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+using PollFd = WSAPOLLFD;
+
+int LastSocketError() { return WSAGetLastError(); }
+bool WouldBlock(int err) { return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS; }
+int PollSockets(PollFd* fds, unsigned long count, int timeout_ms) {
+  return WSAPoll(fds, count, timeout_ms);
+}
+bool SetNonBlocking(NativeSocket s) {
+  u_long mode = 1;
+  return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+constexpr int kSendFlags = 0;
+#else
+using NativeSocket = int;
+using PollFd = pollfd;
+
+int LastSocketError() { return errno; }
+bool WouldBlock(int err) {
+  return err == EAGAIN || err == EWOULDBLOCK || err == EINPROGRESS;
+}
+int PollSockets(PollFd* fds, unsigned long count, int timeout_ms) {
+  int rc;
+  do {
+    rc = poll(fds, static_cast<nfds_t>(count), timeout_ms);
+  } while (rc < 0 && errno == EINTR);
+  return rc;
+}
+bool SetNonBlocking(NativeSocket s) {
+  int flags = fcntl(s, F_GETFL, 0);
+  return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+NativeSocket ToNative(SocketHandle s) { return static_cast<NativeSocket>(s); }
+
+std::string ErrorText(const char* what, int err) {
+  return std::string(what) + " failed (" + std::to_string(err) + ")";
+}
+
+// After a send error: waits for buffer space when the socket would block and
+// returns true to retry, otherwise fills |error| and returns false.
+bool WaitToResend(NativeSocket s, int err, int timeout_ms, std::string* error) {
+  if (!WouldBlock(err)) {
+    if (error) *error = ErrorText("send", err);
+    return false;
+  }
+  PollFd pfd;
+  pfd.fd = s;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  const int ready = PollSockets(&pfd, 1, timeout_ms);
+  if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP)) == 0) return true;
+  if (error) *error = ready == 0 ? "send timed out" : "connection lost";
+  return false;
+}
+
+}  // namespace
+
+bool NetStartup() {
+#ifdef _WIN32
+  static std::once_flag once;
+  static bool ok = false;
+  std::call_once(once, [] {
+    WSADATA data;
+    ok = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+  });
+  return ok;
+#else
+  return true;
+#endif
+}
+
+SocketHandle TcpConnect(const std::string& host, uint16_t port, int timeout_ms,
+                        std::string* error) {
+  if (!NetStartup()) {
+    if (error) *error = "socket library unavailable";
+    return kInvalidSocket;
+  }
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  addrinfo* addresses = nullptr;
+  const std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0 ||
+      addresses == nullptr) {
+    if (error) *error = "cannot resolve " + host;
+    return kInvalidSocket;
+  }
+
+  NativeSocket s = socket(addresses->ai_family, addresses->ai_socktype,
+                          addresses->ai_protocol);
+  if (s == ToNative(kInvalidSocket)) {
+    if (error) *error = ErrorText("socket", LastSocketError());
+    freeaddrinfo(addresses);
+    return kInvalidSocket;
+  }
+  SetNonBlocking(s);
+  int no_delay = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+  int rc = connect(s, addresses->ai_addr,
+                   static_cast<int>(addresses->ai_addrlen));
+  freeaddrinfo(addresses);
+  if (rc != 0) {
+    const int err = LastSocketError();
+    if (!WouldBlock(err)) {
+      if (error) *error = ErrorText("connect", err);
+      CloseSocket(static_cast<SocketHandle>(s));
+      return kInvalidSocket;
+    }
+    PollFd pfd;
+    pfd.fd = s;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    rc = PollSockets(&pfd, 1, timeout_ms);
+    if (rc <= 0) {
+      if (error) *error = rc == 0 ? "connect timed out" : ErrorText("poll", LastSocketError());
+      CloseSocket(static_cast<SocketHandle>(s));
+      return kInvalidSocket;
+    }
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+    getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&so_error), &len);
+    if (so_error != 0) {
+      if (error) *error = ErrorText("connect", so_error);
+      CloseSocket(static_cast<SocketHandle>(s));
+      return kInvalidSocket;
+    }
+  }
+  return static_cast<SocketHandle>(s);
+}
+
+bool SendAll(SocketHandle socket, const uint8_t* data, size_t size,
+             int timeout_ms, std::string* error, size_t* sent_out) {
+  const NativeSocket s = ToNative(socket);
+  size_t sent = 0;
+  size_t ignored;
+  if (!sent_out) sent_out = &ignored;
+  *sent_out = 0;
+  while (sent < size) {
+    const size_t chunk = size - sent > 0x7FFFFFFF ? 0x7FFFFFFF : size - sent;
+    const auto rc = send(s, reinterpret_cast<const char*>(data + sent),
+                         static_cast<int>(chunk), kSendFlags);
+    if (rc > 0) {
+      sent += static_cast<size_t>(rc);
+      *sent_out = sent;
+      continue;
+    }
+    if (rc < 0 && WaitToResend(s, LastSocketError(), timeout_ms, error)) continue;
+    if (rc == 0 && error) *error = "connection lost";
+    return false;
+  }
+  return true;
+}
+
+bool SendAllV(SocketHandle socket, const ByteSpan* spans, size_t count,
+              int timeout_ms, std::string* error, size_t* sent_out) {
+  const NativeSocket s = ToNative(socket);
+  // Buffers handed to one call; well under IOV_MAX everywhere.
+  constexpr size_t kMaxBuffers = 64;
+  size_t ignored;
+  if (!sent_out) sent_out = &ignored;
+  *sent_out = 0;
+  size_t index = 0;   // first span not fully sent
+  size_t offset = 0;  // bytes of spans[index] already sent
+  for (;;) {
+    while (index < count && offset == spans[index].size) {
+      ++index;
+      offset = 0;
+    }
+    if (index == count) return true;
+
+#ifdef _WIN32
+    WSABUF buffers[kMaxBuffers];
+    DWORD n = 0;
+    for (size_t i = index; i < count && n < kMaxBuffers; ++i) {
+      const size_t skip = i == index ? offset : 0;
+      const size_t size = spans[i].size - skip;
+      if (size == 0) continue;
+      buffers[n].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(spans[i].data + skip));
+      buffers[n].len = static_cast<ULONG>(size > 0x7FFFFFFF ? 0x7FFFFFFF : size);
+      ++n;
+    }
+    DWORD sent = 0;
+    const long rc = WSASend(s, buffers, n, &sent, 0, nullptr, nullptr) == 0
+                        ? static_cast<long>(sent)
+                        : -1;
+#else
+    iovec buffers[kMaxBuffers];
+    size_t n = 0;
+    for (size_t i = index; i < count && n < kMaxBuffers; ++i) {
+      const size_t skip = i == index ? offset : 0;
+      if (spans[i].size == skip) continue;
+      buffers[n].iov_base = const_cast<uint8_t*>(spans[i].data + skip);
+      buffers[n].iov_len = spans[i].size - skip;
+      ++n;
+    }
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = buffers;
+    message.msg_iovlen = n;
+    const ssize_t rc = sendmsg(s, &message, kSendFlags);
+#endif
+
+    if (rc > 0) {
+      size_t left = static_cast<size_t>(rc);
+      *sent_out += left;
+      while (left > 0) {
+        const size_t available = spans[index].size - offset;
+        if (left < available) {
+          offset += left;
+          left = 0;
+        } else {
+          left -= available;
+          ++index;
+          offset = 0;
+        }
+      }
+      continue;
+    }
+    if (rc < 0 && WaitToResend(s, LastSocketError(), timeout_ms, error)) continue;
+    if (rc == 0 && error) *error = "connection lost";
+    return false;
+  }
+}
+
+long Receive(SocketHandle socket, uint8_t* data, size_t size, int timeout_ms,
+             bool* timed_out, std::string* error) {
+  const NativeSocket s = ToNative(socket);
+  if (timed_out) *timed_out = false;
+  PollFd pfd;
+  pfd.fd = s;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  const int ready = PollSockets(&pfd, 1, timeout_ms);
+  if (ready == 0) {
+    if (timed_out) *timed_out = true;
+    return 0;
+  }
+  if (ready < 0) {
+    if (error) *error = ErrorText("poll", LastSocketError());
+    return -1;
+  }
+  const auto rc = recv(s, reinterpret_cast<char*>(data), static_cast<int>(size), 0);
+  if (rc < 0) {
+    const int err = LastSocketError();
+    if (WouldBlock(err)) {
+      if (timed_out) *timed_out = true;
+      return 0;
+    }
+    if (error) *error = ErrorText("recv", err);
+    return -1;
+  }
+  return static_cast<long>(rc);
+}
+
+void EnableKeepAlive(SocketHandle socket, int idle_seconds) {
+  const NativeSocket s = ToNative(socket);
+  int on = 1;
+  setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&on),
+             sizeof(on));
+#ifdef TCP_KEEPIDLE
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE,
+             reinterpret_cast<const char*>(&idle_seconds), sizeof(idle_seconds));
+  int interval = idle_seconds > 5 ? 5 : idle_seconds;
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL,
+             reinterpret_cast<const char*>(&interval), sizeof(interval));
+#else
+  (void)idle_seconds;
+#endif
+}
+
+bool IsConnectionAlive(SocketHandle socket, std::vector<uint8_t>* unsolicited) {
+  const NativeSocket s = ToNative(socket);
+  for (;;) {
+    PollFd pfd;
+    pfd.fd = s;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    const int ready = PollSockets(&pfd, 1, 0);
+    if (ready == 0) return true;
+    if (ready < 0 || (pfd.revents & (POLLERR | POLLNVAL)) != 0) return false;
+    char buf[256];
+    const auto rc = recv(s, buf, sizeof(buf), 0);
+    if (rc > 0) {
+      // drain and look again
+      if (unsolicited) unsolicited->insert(unsolicited->end(), buf, buf + rc);
+      continue;
+    }
+    return rc < 0 && WouldBlock(LastSocketError());
+  }
+}
+
+void CloseSocket(SocketHandle socket) {
+  if (socket == kInvalidSocket) return;
+#ifdef _WIN32
+  closesocket(ToNative(socket));
+#else
+  close(ToNative(socket));
+#endif
+}
+
+}  // namespace printer_core
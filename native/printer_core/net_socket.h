@@ -0,0 +1,67 @@
+#ifndef PRINTER_CORE_NET_SOCKET_H_
+#define PRINTER_CORE_NET_SOCKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+
+// Native socket handle: SOCKET on Windows, a file descriptor elsewhere. Kept
+// as an integer so this header does not pull in winsock2.h.
+#ifdef _WIN32
+using SocketHandle = uintptr_t;
+constexpr SocketHandle kInvalidSocket = ~static_cast<uintptr_t>(0);
+#else
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+// A borrowed run of bytes, used for gathered (vectored) writes.
+struct ByteSpan {
+  const uint8_t* data;
+  size_t size;
+};
+
+// Initializes the socket library once per process (WSAStartup on Windows).
+// Safe to call repeatedly; returns false if sockets are unavailable.
+bool NetStartup();
+
+// Connects to host:port with a timeout. The returned socket is non-blocking.
+// Returns kInvalidSocket and fills |error| on failure.
+SocketHandle TcpConnect(const std::string& host, uint16_t port, int timeout_ms,
+                        std::string* error);
+
+// Sends all |size| bytes, waiting up to |timeout_ms| for each stall. |sent|
+// (optional) receives how many bytes the kernel accepted, also on failure.
+bool SendAll(SocketHandle socket, const uint8_t* data, size_t size,
+             int timeout_ms, std::string* error, size_t* sent = nullptr);
+
+// Sends the spans back to back with gathered writes (sendmsg / WSASend), so N
+// buffers cost about one system call instead of N. Same timeout and |sent|
+// semantics as SendAll.
+bool SendAllV(SocketHandle socket, const ByteSpan* spans, size_t count,
+              int timeout_ms, std::string* error, size_t* sent = nullptr);
+
+// Reads up to |size| bytes, waiting up to |timeout_ms| for data. Returns the
+// number of bytes read, 0 when the peer closed the connection or the wait
+// timed out (|timed_out| tells which), and -1 on error.
+long Receive(SocketHandle socket, uint8_t* data, size_t size, int timeout_ms,
+             bool* timed_out, std::string* error);
+
+// Turns on TCP keepalive probes after |idle_seconds| without traffic, where
+// the platform lets us set the interval.
+void EnableKeepAlive(SocketHandle socket, int idle_seconds);
+
+// Non-blocking check that an idle connection is still usable: false when the
+// peer closed or reset it. Unsolicited bytes (for example automatic status
+// reports) are read and appended to |unsolicited|, or discarded when it is
+// null.
+bool IsConnectionAlive(SocketHandle socket, std::vector<uint8_t>* unsolicited = nullptr);
+
+void CloseSocket(SocketHandle socket);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_NET_SOCKET_H_
@@ -0,0 +1,394 @@
+#include "network_scanner.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+#include "net_socket.h"
+
+namespace printer_core {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+
+int LastSocketError() { return WSAGetLastError(); }
+bool InProgress(int err) { return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS; }
+bool OutOfDescriptors(int err) { return err == WSAEMFILE || err == WSAENOBUFS; }
+bool SetNonBlocking(NativeSocket s) {
+  u_long mode = 1;
+  return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+// WSAPoll has no descriptor limit worth clamping to.
+size_t DescriptorBudget() { return SIZE_MAX; }
+#else
+using NativeSocket = int;
+
+int LastSocketError() { return errno; }
+bool InProgress(int err) { return err == EINPROGRESS || err == EAGAIN; }
+bool OutOfDescriptors(int err) {
+  return err == EMFILE || err == ENFILE || err == ENOBUFS;
+}
+bool SetNonBlocking(NativeSocket s) {
+  int flags = fcntl(s, F_GETFL, 0);
+  return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+// Probes may use the soft RLIMIT_NOFILE minus some room for the rest of the
+// process (pooled printer connections, files, the epoll descriptor).
+size_t DescriptorBudget() {
+  constexpr size_t kReserved = 64;
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+    return SIZE_MAX;
+  }
+  const size_t soft = static_cast<size_t>(limit.rlim_cur);
+  return soft > 2 * kReserved ? soft - kReserved : soft / 2;
+}
+#endif
+
+NativeSocket ToNative(SocketHandle s) { return static_cast<NativeSocket>(s); }
+
+int SocketError(NativeSocket s) {
+  int so_error = 0;
+  socklen_t len = sizeof(so_error);
+  if (getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&so_error),
+                 &len) != 0) {
+    return LastSocketError();
+  }
+  return so_error;
+}
+
+// Readiness for pending connects, keyed by probe slot.
+#ifdef __linux__
+class ConnectPoller {
+ public:
+  ConnectPoller() : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {}
+  ~ConnectPoller() {
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+  }
+
+  bool ok() const { return epoll_fd_ >= 0; }
+
+  bool Add(NativeSocket s, size_t slot) {
+    epoll_event event;
+    event.events = EPOLLOUT;
+    event.data.u64 = slot;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, s, &event) == 0;
+  }
+
+  // Closing the descriptor drops it from the epoll set.
+  void Remove(NativeSocket) {}
+
+  template <typename OnReady>
+  void Wait(int timeout_ms, OnReady on_ready) {
+    epoll_event events[256];
+    const int n = epoll_wait(epoll_fd_, events, 256, timeout_ms);
+    for (int i = 0; i < n; ++i) on_ready(static_cast<size_t>(events[i].data.u64));
+  }
+
+ private:
+  int epoll_fd_;
+};
+#else
+class ConnectPoller {
+ public:
+  bool ok() const { return true; }
+
+  bool Add(NativeSocket s, size_t slot) {
+#ifdef _WIN32
+    WSAPOLLFD pfd;
+#else
+    pollfd pfd;
+#endif
+    pfd.fd = s;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    fds_.push_back(pfd);
+    slots_.push_back(slot);
+    return true;
+  }
+
+  void Remove(NativeSocket s) {
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i].fd != s) continue;
+      fds_[i] = fds_.back();
+      slots_[i] = slots_.back();
+      fds_.pop_back();
+      slots_.pop_back();
+      return;
+    }
+  }
+
+  template <typename OnReady>
+  void Wait(int timeout_ms, OnReady on_ready) {
+#ifdef _WIN32
+    const int n = WSAPoll(fds_.data(), static_cast<ULONG>(fds_.size()), timeout_ms);
+#else
+    const int n = poll(fds_.data(), static_cast<nfds_t>(fds_.size()), timeout_ms);
+#endif
+    if (n <= 0) return;
+    // on_ready removes entries, so collect the slots first.
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i].revents != 0) ready.push_back(slots_[i]);
+    }
+    for (size_t slot : ready) on_ready(slot);
+  }
+
+ private:
+#ifdef _WIN32
+  std::vector<WSAPOLLFD> fds_;
+#else
+  std::vector<pollfd> fds_;
+#endif
+  std::vector<size_t> slots_;
+};
+#endif
+
+struct Probe {
+  SocketHandle socket = kInvalidSocket;
+  uint32_t address = 0;
+  uint16_t port = 0;
+  Clock::time_point deadline;
+  // Bumped on every reuse of the slot, so stale timeout entries are skipped.
+  uint64_t generation = 0;
+};
+
+}  // namespace
+
+bool ParseCidr(const std::string& text, Ipv4Range* range, std::string* error) {
+  const size_t slash = text.find('/');
+  const std::string host = text.substr(0, slash);
+  int prefix = 32;
+  if (slash != std::string::npos) {
+    const std::string bits = text.substr(slash + 1);
+    if (bits.empty() || bits.size() > 2 ||
+        !std::all_of(bits.begin(), bits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+      if (error) *error = "invalid prefix in " + text;
+      return false;
+    }
+    prefix = std::stoi(bits);
+  }
+  if (prefix < 16 || prefix > 32) {
+    if (error) *error = "prefix must be between /16 and /32: " + text;
+    return false;
+  }
+
+  in_addr parsed;
+  if (inet_pton(AF_INET, host.c_str(), &parsed) != 1) {
+    if (error) *error = "invalid IPv4 address: " + host;
+    return false;
+  }
+  const uint32_t address = ntohl(parsed.s_addr);
+  const uint32_t mask = prefix == 32 ? 0xFFFFFFFFu : ~(0xFFFFFFFFu >> prefix);
+  range->first = address & mask;
+  range->last = range->first | ~mask;
+  if (prefix <= 30) {
+    ++range->first;
+    --range->last;
+  }
+  return true;
+}
+
+std::string FormatIpv4(uint32_t address) {
+  return std::to_string(address >> 24) + "." + std::to_string((address >> 16) & 0xFF) +
+         "." + std::to_string((address >> 8) & 0xFF) + "." +
+         std::to_string(address & 0xFF);
+}
+
+std::vector<Ipv4Range> LocalSubnets() {
+  std::vector<uint32_t> addresses;
+#ifdef _WIN32
+  if (NetStartup()) {
+    char name[256];
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    addrinfo* list = nullptr;
+    if (gethostname(name, sizeof(name)) == 0 &&
+        getaddrinfo(name, nullptr, &hints, &list) == 0) {
+      for (addrinfo* ai = list; ai != nullptr; ai = ai->ai_next) {
+        const auto* in = reinterpret_cast<const sockaddr_in*>(ai->ai_addr);
+        addresses.push_back(ntohl(in->sin_addr.s_addr));
+      }
+      freeaddrinfo(list);
+    }
+  }
+#else
+  ifaddrs* list = nullptr;
+  if (getifaddrs(&list) == 0) {
+    for (ifaddrs* ifa = list; ifa != nullptr; ifa = ifa->ifa_next) {
+      if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET) continue;
+      const auto* in = reinterpret_cast<const sockaddr_in*>(ifa->ifa_addr);
+      addresses.push_back(ntohl(in->sin_addr.s_addr));
+    }
+    freeifaddrs(list);
+  }
+#endif
+
+  std::vector<Ipv4Range> ranges;
+  for (uint32_t address : addresses) {
+    // Skip loopback (127/8) and link-local (169.254/16) addresses.
+    if ((address >> 24) == 127 || (address >> 16) == 0xA9FE) continue;
+    Ipv4Range range;
+    range.first = (address & 0xFFFFFF00u) + 1;
+    range.last = (address & 0xFFFFFF00u) + 254;
+    const bool seen = std::any_of(ranges.begin(), ranges.end(), [&](const Ipv4Range& r) {
+      return r.first == range.first;
+    });
+    if (!seen) ranges.push_back(range);
+  }
+  return ranges;
+}
+
+bool ScanNetwork(const std::vector<Ipv4Range>& ranges,
+                 const ScanOptions& options,
+                 const std::function<void(const ScanHit&)>& on_found,
+                 std::string* error) {
+  if (!NetStartup()) {
+    if (error) *error = "socket library unavailable";
+    return false;
+  }
+  ConnectPoller poller;
+  if (!poller.ok()) {
+    if (error) *error = "cannot create poller";
+    return false;
+  }
+  if (options.ports.empty()) return true;
+
+  // Targets are numbered address-major: target t is address t / ports at
+  // port t % ports, walking the ranges in order.
+  std::vector<uint32_t> addresses;
+  for (const Ipv4Range& range : ranges) {
+    for (uint64_t a = range.first; a <= range.last && range.last >= range.first; ++a) {
+      addresses.push_back(static_cast<uint32_t>(a));
+    }
+  }
+  const size_t port_count = options.ports.size();
+  const size_t total = addresses.size() * port_count;
+
+  size_t limit = std::min({options.max_in_flight, DescriptorBudget(), total});
+  if (limit == 0) limit = 1;
+  std::vector<Probe> probes(limit);
+  std::vector<size_t> free_slots;
+  free_slots.reserve(limit);
+  for (size_t i = limit; i > 0; --i) free_slots.push_back(i - 1);
+  // Slots in start order; deadlines are non-decreasing along it.
+  std::deque<std::pair<size_t, uint64_t>> started;
+  const auto timeout = std::chrono::milliseconds(std::max(options.timeout_ms, 1));
+
+  auto report = [&](uint32_t address, uint16_t port) {
+    if (on_found) on_found(ScanHit{FormatIpv4(address), port});
+  };
+  auto finish = [&](size_t slot) {
+    Probe& probe = probes[slot];
+    poller.Remove(ToNative(probe.socket));
+    CloseSocket(probe.socket);
+    probe.socket = kInvalidSocket;
+    free_slots.push_back(slot);
+  };
+
+  size_t next = 0;
+  while (next < total || free_slots.size() < limit) {
+    if (options.cancel && options.cancel->load()) break;
+
+    // Start as many connects as there are free slots.
+    while (next < total && !free_slots.empty()) {
+      const uint32_t address = addresses[next / port_count];
+      const uint16_t port = options.ports[next % port_count];
+      const NativeSocket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      if (s == ToNative(kInvalidSocket)) {
+        // Out of descriptors: retry this target once some probes finish.
+        if (OutOfDescriptors(LastSocketError()) && free_slots.size() < limit) break;
+        if (error) *error = "socket failed (" + std::to_string(LastSocketError()) + ")";
+        return false;
+      }
+      ++next;
+      SetNonBlocking(s);
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(address);
+      if (connect(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0) {
+        CloseSocket(static_cast<SocketHandle>(s));
+        report(address, port);
+        continue;
+      }
+      const size_t slot = free_slots.back();
+      if (!InProgress(LastSocketError()) || !poller.Add(s, slot)) {
+        CloseSocket(static_cast<SocketHandle>(s));
+        continue;
+      }
+      free_slots.pop_back();
+      Probe& probe = probes[slot];
+      probe.socket = static_cast<SocketHandle>(s);
+      probe.address = address;
+      probe.port = port;
+      probe.deadline = Clock::now() + timeout;
+      started.emplace_back(slot, ++probe.generation);
+    }
+
+    // Drop finished entries and time out the oldest connects.
+    const Clock::time_point now = Clock::now();
+    while (!started.empty()) {
+      Probe& probe = probes[started.front().first];
+      if (probe.generation == started.front().second &&
+          probe.socket != kInvalidSocket) {
+        if (probe.deadline > now) break;
+        finish(started.front().first);
+      }
+      started.pop_front();
+    }
+    if (started.empty()) continue;
+
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        probes[started.front().first].deadline - now);
+    // Wake at least every 100ms so cancellation is noticed.
+    const int wait_ms = static_cast<int>(std::min<long long>(wait.count() + 1, 100));
+    poller.Wait(wait_ms, [&](size_t slot) {
+      Probe& probe = probes[slot];
+      if (probe.socket == kInvalidSocket) return;
+      const bool connected = SocketError(ToNative(probe.socket)) == 0;
+      const uint32_t address = probe.address;
+      const uint16_t port = probe.port;
+      finish(slot);
+      if (connected) report(address, port);
+    });
+  }
+
+  for (const auto& entry : started) {
+    if (probes[entry.first].socket != kInvalidSocket &&
+        probes[entry.first].generation == entry.second) {
+      finish(entry.first);
+    }
+  }
+  return true;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,64 @@
+#ifndef PRINTER_CORE_NETWORK_SCANNER_H_
+#define PRINTER_CORE_NETWORK_SCANNER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+
+// Inclusive range of IPv4 addresses in host byte order.
+struct Ipv4Range {
+  uint32_t first = 0;
+  uint32_t last = 0;
+
+  size_t size() const { return last >= first ? size_t{last - first} + 1 : 0; }
+};
+
+// Parses "a.b.c.d/n" (n = 16..32) or a bare address. Network and broadcast
+// addresses are left out for prefixes up to /30.
+bool ParseCidr(const std::string& text, Ipv4Range* range, std::string* error);
+
+// Dotted-quad form of a host-order address.
+std::string FormatIpv4(uint32_t address);
+
+// The /24 around each non-loopback IPv4 address of this machine, without
+// duplicates. Used when the caller does not configure a range.
+std::vector<Ipv4Range> LocalSubnets();
+
+// Raw ESC/POS (9100), LPD (515) and IPP (631).
+constexpr uint16_t kPrinterPorts[] = {9100, 515, 631};
+
+struct ScanOptions {
+  std::vector<uint16_t> ports{std::begin(kPrinterPorts), std::end(kPrinterPorts)};
+  // How long each connect may take before the address counts as silent.
+  int timeout_ms = 1000;
+  // Upper bound on simultaneous connects; also kept below the process file
+  // descriptor limit.
+  size_t max_in_flight = 4096;
+  // Optional; setting it makes the scan stop early.
+  const std::atomic<bool>* cancel = nullptr;
+};
+
+struct ScanHit {
+  std::string host;
+  uint16_t port = 0;
+};
+
+// Probes every address and port in |ranges| with non-blocking connects, all
+// in flight at once up to |options.max_in_flight| (epoll on Linux, poll or
+// WSAPoll elsewhere). A /24 on three ports takes about |timeout_ms|.
+// |on_found| runs on the calling thread as soon as a connect succeeds.
+// Returns false and fills |error| only if the scan could not run at all.
+bool ScanNetwork(const std::vector<Ipv4Range>& ranges,
+                 const ScanOptions& options,
+                 const std::function<void(const ScanHit&)>& on_found,
+                 std::string* error);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_NETWORK_SCANNER_H_
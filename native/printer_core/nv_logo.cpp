@@ -0,0 +1,367 @@
+#include "nv_logo.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+constexpr uint8_t kGs = 0x1D;
+
+// First line of the saved table.
+constexpr char kTableHeader[] = "extropos-nv-logos 1";
+
+// GS ( L carries a 16-bit parameter count; bigger logos need GS 8 L.
+constexpr size_t kMaxShortParams = 0xFFFF;
+
+const char* SupportName(NvLogoSupport support) {
+  switch (support) {
+    case NvLogoSupport::kNone:
+      return "raster";
+    case NvLogoSupport::kGraphics:
+      return "nv_graphics";
+    case NvLogoSupport::kBitImage:
+      return "nv_bit_image";
+    case NvLogoSupport::kUnknown:
+      break;
+  }
+  return "auto";
+}
+
+bool StoresLogos(NvLogoSupport support) {
+  return support == NvLogoSupport::kGraphics || support == NvLogoSupport::kBitImage;
+}
+
+// NV graphics function 67: raster data, one tone, stored under
+// kNvLogoKeyCode.
+void AppendGraphicsDefine(const MonoBitmap& bitmap, std::vector<uint8_t>* out) {
+  const size_t data_size = static_cast<size_t>(bitmap.bytes_per_row) * bitmap.height;
+  const size_t params = 11 + data_size;
+  if (params <= kMaxShortParams) {
+    const uint8_t head[] = {kGs, '(', 'L', static_cast<uint8_t>(params & 0xFF),
+                            static_cast<uint8_t>(params >> 8)};
+    out->insert(out->end(), head, head + sizeof(head));
+  } else {
+    const uint8_t head[] = {kGs,
+                            '8',
+                            'L',
+                            static_cast<uint8_t>(params & 0xFF),
+                            static_cast<uint8_t>((params >> 8) & 0xFF),
+                            static_cast<uint8_t>((params >> 16) & 0xFF),
+                            static_cast<uint8_t>((params >> 24) & 0xFF)};
+    out->insert(out->end(), head, head + sizeof(head));
+  }
+  const uint8_t fields[] = {48,
+                            67,
+                            48,
+                            kNvLogoKeyCode[0],
+                            kNvLogoKeyCode[1],
+                            1,
+                            static_cast<uint8_t>(bitmap.width & 0xFF),
+                            static_cast<uint8_t>(bitmap.width >> 8),
+                            static_cast<uint8_t>(bitmap.height & 0xFF),
+                            static_cast<uint8_t>(bitmap.height >> 8),
+                            49};
+  out->insert(out->end(), fields, fields + sizeof(fields));
+  out->insert(out->end(), bitmap.bits.begin(), bitmap.bits.end());
+}
+
+// FS q 1: one NV bit image in column format, each byte eight dots down with
+// the top dot in the high bit, columns left to right. Height is padded to a
+// multiple of 8 with paper.
+void AppendBitImageDefine(const MonoBitmap& bitmap, std::vector<uint8_t>* out) {
+  const int bands = (bitmap.height + 7) / 8;
+  const int columns = bitmap.bytes_per_row * 8;
+  const uint8_t head[] = {kFs,
+                          'q',
+                          1,
+                          static_cast<uint8_t>(bitmap.bytes_per_row & 0xFF),
+                          static_cast<uint8_t>(bitmap.bytes_per_row >> 8),
+                          static_cast<uint8_t>(bands & 0xFF),
+                          static_cast<uint8_t>(bands >> 8)};
+  out->insert(out->end(), head, head + sizeof(head));
+  const size_t start = out->size();
+  out->resize(start + static_cast<size_t>(columns) * bands, 0);
+  uint8_t* data = out->data() + start;
+  for (int y = 0; y < bitmap.height; ++y) {
+    const uint8_t* row = &bitmap.bits[static_cast<size_t>(y) * bitmap.bytes_per_row];
+    const uint8_t bit = static_cast<uint8_t>(0x80 >> (y % 8));
+    for (int x = 0; x < columns; ++x) {
+      if (row[x / 8] & (0x80 >> (x % 8))) data[static_cast<size_t>(x) * bands + y / 8] |= bit;
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseLogoStorage(std::string_view name, NvLogoSupport* support) {
+  if (name == "auto") {
+    *support = NvLogoSupport::kUnknown;
+  } else if (name == "raster") {
+    *support = NvLogoSupport::kNone;
+  } else if (name == "nv_graphics") {
+    *support = NvLogoSupport::kGraphics;
+  } else if (name == "nv_bit_image") {
+    *support = NvLogoSupport::kBitImage;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void AppendNvLogoDefine(const MonoBitmap& bitmap, NvLogoSupport support,
+                        std::vector<uint8_t>* out) {
+  if (bitmap.bits.empty()) return;
+  if (support == NvLogoSupport::kGraphics) {
+    AppendGraphicsDefine(bitmap, out);
+  } else if (support == NvLogoSupport::kBitImage) {
+    AppendBitImageDefine(bitmap, out);
+  }
+}
+
+std::vector<uint8_t> NvLogoPrintBlock(NvLogoSupport support) {
+  std::vector<uint8_t> out = {kEsc, 'a', 1};
+  if (support == NvLogoSupport::kGraphics) {
+    const uint8_t print[] = {kGs, '(', 'L', 6, 0, 48, 69, kNvLogoKeyCode[0], kNvLogoKeyCode[1],
+                             1, 1};
+    out.insert(out.end(), print, print + sizeof(print));
+  } else {
+    const uint8_t print[] = {kFs, 'p', 1, 0};
+    out.insert(out.end(), print, print + sizeof(print));
+  }
+  const uint8_t tail[] = {'\n', kEsc, 'a', 0};
+  out.insert(out.end(), tail, tail + sizeof(tail));
+  return out;
+}
+
+NvLogoSupport ProbeNvLogoSupport(PrinterTransport* transport, int timeout_ms) {
+  using Clock = std::chrono::steady_clock;
+  static const uint8_t kRequest[] = {kGs, '(', 'L', 2, 0, 48, 48};
+  std::string error;
+  if (!transport->Write(kRequest, sizeof(kRequest), &error)) return NvLogoSupport::kNone;
+
+  // Reply: header 0x37, identifier 0x30, the capacity in decimal digits, NUL.
+  // Read through to the NUL so none of it is left for the next reader of a
+  // pooled connection.
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  std::vector<uint8_t> reply;
+  uint8_t buffer[32];
+  while (reply.empty() || reply.back() != 0) {
+    const auto left =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+    if (left.count() <= 0) break;
+    const long n = transport->Read(buffer, sizeof(buffer), static_cast<int>(left.count()), &error);
+    if (n <= 0) break;
+    reply.insert(reply.end(), buffer, buffer + n);
+  }
+  for (size_t i = 0; i + 2 < reply.size(); ++i) {
+    if (reply[i] == 0x37 && reply[i + 1] == 0x30) return NvLogoSupport::kGraphics;
+  }
+  return NvLogoSupport::kNone;
+}
+
+NvLogoStore::NvLogoStore(std::string path, TransportFactory factory)
+    : path_(std::move(path)), factory_(std::move(factory)) {}
+
+NvLogoStore::~NvLogoStore() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (prober_.joinable()) prober_.join();
+}
+
+bool NvLogoStore::Load(std::string* error) {
+  if (path_.empty()) return true;
+  std::ifstream in(std::filesystem::u8path(path_));
+  if (!in) {
+    std::error_code ec;
+    if (!std::filesystem::exists(std::filesystem::u8path(path_), ec)) return true;
+    if (error) *error = "cannot read " + path_;
+    return false;
+  }
+  std::string line;
+  if (!std::getline(in, line) || line != kTableHeader) {
+    // Unknown or damaged table: start over, which at worst uploads again.
+    return true;
+  }
+  std::map<std::string, Printer> printers;
+  while (std::getline(in, line)) {
+    // printer \t support [\t hash width dither]
+    std::istringstream fields(line);
+    std::string printer, support_name;
+    if (!std::getline(fields, printer, '\t') || !std::getline(fields, support_name, '\t')) {
+      continue;
+    }
+    Printer entry;
+    if (!ParseLogoStorage(support_name, &entry.support)) continue;
+    unsigned long long hash = 0;
+    int width = 0;
+    int dither = 0;
+    std::string logo;
+    if (std::getline(fields, logo) &&
+        std::sscanf(logo.c_str(), "%llx %d %d", &hash, &width, &dither) == 3 &&
+        dither >= static_cast<int>(DitherMode::kThreshold) &&
+        dither <= static_cast<int>(DitherMode::kFloydSteinberg)) {
+      entry.holds_logo = true;
+      entry.logo = LogoKey{static_cast<uint64_t>(hash), width, static_cast<DitherMode>(dither)};
+    }
+    printers[printer] = entry;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  printers_ = std::move(printers);
+  return true;
+}
+
+NvLogoSupport NvLogoStore::support(const std::string& printer) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = printers_.find(printer);
+  return it == printers_.end() ? NvLogoSupport::kUnknown : it->second.support;
+}
+
+void NvLogoStore::SetSupport(const std::string& printer, NvLogoSupport support) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Printer& entry = printers_[printer];
+    if (entry.support == support) return;
+    entry.support = support;
+    entry.holds_logo = false;
+  }
+  Save();
+}
+
+void NvLogoStore::Probe(const PrinterTarget& target, int timeout_ms) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Printer& entry = printers_[target.Key()];
+    if (entry.support != NvLogoSupport::kUnknown || entry.probing || stopping_) return;
+    entry.probing = true;
+    probes_.push_back(ProbeRequest{target, timeout_ms});
+    if (!prober_.joinable()) prober_ = std::thread([this] { ProbeLoop(); });
+  }
+  cv_.notify_all();
+}
+
+std::vector<uint8_t> NvLogoStore::Block(const std::string& printer, const RasterLogo& logo,
+                                        bool* upload) {
+  *upload = false;
+  NvLogoSupport support;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = printers_.find(printer);
+    if (it == printers_.end() || !StoresLogos(it->second.support)) return logo.raster;
+    Printer& entry = it->second;
+    support = entry.support;
+    if (!entry.holds_logo || !(entry.logo == logo.key)) {
+      if (entry.uploading) return logo.raster;
+      entry.uploading = true;
+      *upload = true;
+    }
+  }
+  std::vector<uint8_t> out;
+  if (*upload) AppendNvLogoDefine(logo.bitmap, support, &out);
+  const std::vector<uint8_t> print = NvLogoPrintBlock(support);
+  out.insert(out.end(), print.begin(), print.end());
+  return out;
+}
+
+void NvLogoStore::FinishUpload(const std::string& printer, const LogoKey& logo, bool printed) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Printer& entry = printers_[printer];
+    entry.uploading = false;
+    if (!printed) return;
+    entry.holds_logo = true;
+    entry.logo = logo;
+  }
+  Save();
+}
+
+void NvLogoStore::WaitForProbes() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return probes_.empty() && !probe_running_; });
+}
+
+void NvLogoStore::Save() {
+  if (path_.empty()) return;
+  std::lock_guard<std::mutex> save_lock(save_mutex_);
+  std::ostringstream table;
+  table << kTableHeader << '\n';
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [printer, entry] : printers_) {
+      // Probe results and settings are worth keeping; unprobed printers are
+      // not.
+      if (entry.support == NvLogoSupport::kUnknown) continue;
+      table << printer << '\t' << SupportName(entry.support);
+      if (entry.holds_logo) {
+        char logo[64];
+        std::snprintf(logo, sizeof(logo), "\t%llx %d %d",
+                      static_cast<unsigned long long>(entry.logo.hash), entry.logo.width,
+                      static_cast<int>(entry.logo.dither));
+        table << logo;
+      }
+      table << '\n';
+    }
+  }
+  // Written aside and renamed over the old table so a crash leaves one or
+  // the other.
+  const std::filesystem::path path = std::filesystem::u8path(path_);
+  std::filesystem::path fresh = path;
+  fresh += ".tmp";
+  {
+    std::ofstream out(fresh, std::ios::binary | std::ios::trunc);
+    out << table.str();
+    if (!out.flush()) return;
+  }
+  std::error_code ec;
+  std::filesystem::rename(fresh, path, ec);
+}
+
+void NvLogoStore::ProbeLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return stopping_ || !probes_.empty(); });
+    if (stopping_) break;
+    ProbeRequest request = std::move(probes_.front());
+    probes_.pop_front();
+    probe_running_ = true;
+    lock.unlock();
+
+    NvLogoSupport support = NvLogoSupport::kNone;
+    std::string error;
+    std::unique_ptr<PrinterTransport> transport = factory_(request.target, &error);
+    const bool reached = transport != nullptr;
+    if (reached) support = ProbeNvLogoSupport(transport.get(), request.timeout_ms);
+    transport.reset();
+
+    lock.lock();
+    Printer& entry = printers_[request.target.Key()];
+    entry.probing = false;
+    // An unreachable printer is asked again on a later receipt; a setting
+    // made meanwhile wins over the probe.
+    const bool changed = reached && entry.support == NvLogoSupport::kUnknown;
+    if (changed) {
+      entry.support = support;
+      lock.unlock();
+      Save();
+      lock.lock();
+    }
+    probe_running_ = false;
+    idle_cv_.notify_all();
+  }
+  probes_.clear();
+  probe_running_ = false;
+  idle_cv_.notify_all();
+}
+
+}  // namespace printer_core
@@ -0,0 +1,127 @@
+#ifndef PRINTER_CORE_NV_LOGO_H_
+#define PRINTER_CORE_NV_LOGO_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "logo_raster.h"
+#include "printer_transport.h"
+
+namespace printer_core {
+
+// How a printer can keep a logo in its non-volatile memory.
+enum class NvLogoSupport {
+  // Not probed yet; logos go out as raster meanwhile.
+  kUnknown,
+  // No NV storage; logos go out as GS v 0 raster with every receipt.
+  kNone,
+  // NV graphics (GS ( L / GS 8 L), printed by key code with GS ( L fn 69.
+  kGraphics,
+  // Legacy NV bit images (FS q), printed with FS p.
+  kBitImage,
+};
+
+// "auto" (probe, kUnknown), "raster" (kNone), "nv_graphics" or
+// "nv_bit_image".
+bool ParseLogoStorage(std::string_view name, NvLogoSupport* support);
+
+// Key code the logo is stored under with GS ( L.
+constexpr uint8_t kNvLogoKeyCode[2] = {'E', 'L'};
+
+// Appends the command that stores |bitmap| in NV memory with |support|
+// (kGraphics or kBitImage). FS q replaces every NV bit image on the printer.
+void AppendNvLogoDefine(const MonoBitmap& bitmap, NvLogoSupport support,
+                        std::vector<uint8_t>* out);
+
+// Centred block printing the stored logo, framed like RasterBlock.
+std::vector<uint8_t> NvLogoPrintBlock(NvLogoSupport support);
+
+// Asks for the NV graphics capacity (GS ( L fn 48) and waits up to
+// |timeout_ms| for the answer. kGraphics if the printer replies, kNone if it
+// stays silent or the transport has no back channel.
+NvLogoSupport ProbeNvLogoSupport(PrinterTransport* transport, int timeout_ms);
+
+// Remembers which printers can store logos and which logo (file hash, width
+// and dither mode) each one holds, so a logo crosses the wire once per
+// printer and later receipts only send the print command. The table is saved
+// to a file because the printer keeps the logo across restarts and NV writes
+// wear its flash. Probes run on a background thread. Thread-safe.
+class NvLogoStore {
+ public:
+  // |path| is where the table is saved; empty keeps it in memory. Probe
+  // connections are opened through |factory|.
+  NvLogoStore(std::string path, TransportFactory factory);
+  ~NvLogoStore();
+
+  NvLogoStore(const NvLogoStore&) = delete;
+  NvLogoStore& operator=(const NvLogoStore&) = delete;
+
+  // Reads the saved table. A missing file is an empty table; returns false
+  // and fills |error| only if the file is unreadable.
+  bool Load(std::string* error);
+
+  NvLogoSupport support(const std::string& printer) const;
+  // Overrides what |printer| supports (from settings, or after a probe).
+  // Changing it forgets the logo the printer was thought to hold.
+  void SetSupport(const std::string& printer, NvLogoSupport support);
+
+  // Probes |target| in the background unless its support is known or a
+  // probe is already pending.
+  void Probe(const PrinterTarget& target, int timeout_ms);
+
+  // Logo bytes to put in front of a receipt for |printer|: the print command
+  // when it already holds |logo|, or the upload followed by the print command
+  // when it can store logos but does not hold this one yet (|*upload| is then
+  // set; call FinishUpload() with the job's outcome). The raster block
+  // otherwise, including while another upload to |printer| is in flight.
+  std::vector<uint8_t> Block(const std::string& printer, const RasterLogo& logo,
+                             bool* upload);
+
+  // Records the outcome of a job carrying an upload from Block().
+  void FinishUpload(const std::string& printer, const LogoKey& logo, bool printed);
+
+  // Waits until no probe is pending.
+  void WaitForProbes();
+
+ private:
+  struct Printer {
+    NvLogoSupport support = NvLogoSupport::kUnknown;
+    bool holds_logo = false;
+    LogoKey logo;
+    bool uploading = false;
+    bool probing = false;
+  };
+
+  struct ProbeRequest {
+    PrinterTarget target;
+    int timeout_ms = 0;
+  };
+
+  // Writes the table to path_; call without mutex_ held.
+  void Save();
+  void ProbeLoop();
+
+  const std::string path_;
+  const TransportFactory factory_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_;
+  std::map<std::string, Printer> printers_;
+  std::deque<ProbeRequest> probes_;
+  bool probe_running_ = false;
+  bool stopping_ = false;
+  // Serializes Save() calls so an older table never lands last.
+  std::mutex save_mutex_;
+  std::thread prober_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_NV_LOGO_H_
@@ -0,0 +1,383 @@
+#include "print_job_queue.h"
+
+#include <utility>
+
+#include "escpos_optimizer.h"
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kDle = 0x10;
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+constexpr uint8_t kGs = 0x1D;
+constexpr uint8_t kLf = 0x0A;
+
+size_t ClassIndex(JobPriority priority) {
+  return static_cast<size_t>(priority);
+}
+
+}  // namespace
+
+std::vector<size_t> LineBreakPoints(const std::vector<uint8_t>& data,
+                                    size_t min_chunk) {
+  std::vector<size_t> points;
+  if (min_chunk == 0) min_chunk = 1;
+  // Nothing is known of the printer until the job's first ESC @. After it,
+  // alignment, emphasis, underline, size, print mode and motion units are
+  // followed; any other setting (code table, Kanji, line spacing, barcode
+  // options, ...) holds until the next ESC @.
+  bool reset = false;
+  bool sticky = false;
+  uint8_t align = 0, bold = 0, underline = 0, size = 0, mode = 0, motion = 0;
+  size_t last = 0;
+  size_t i = 0;
+  while (i < data.size()) {
+    const uint8_t b = data[i];
+    if (b == kLf) {
+      ++i;
+      const bool clean = reset && !sticky &&
+                         (align | bold | underline | size | mode | motion) == 0;
+      if (clean && i - last >= min_chunk && i < data.size()) {
+        points.push_back(i);
+        last = i;
+      }
+      continue;
+    }
+    if (b != kEsc && b != kGs && b != kFs && b != kDle) {
+      ++i;
+      continue;
+    }
+    const size_t length = EscPosCommandLength(data.data() + i, data.size() - i);
+    // Past an unknown command the stream cannot be followed
+    if (length == 0) break;
+    const uint8_t code = data[i + 1];
+    const uint8_t n = length > 2 ? data[i + 2] : 0;
+    if (b == kEsc) {
+      switch (code) {
+        case '@':
+          reset = true;
+          sticky = false;
+          align = bold = underline = size = mode = motion = 0;
+          break;
+        case 'a': align = n == '0' ? 0 : n; break;
+        case 'E': bold = n & 1; break;
+        case '-': underline = n == '0' ? 0 : n; break;
+        case '!': mode = n; break;
+        // Feeds, drawer kicks and bit images print, they set nothing
+        case 'J': case 'd': case 'p': case '*': break;
+        default: sticky = true; break;
+      }
+    } else if (b == kGs) {
+      switch (code) {
+        case '!': size = n; break;
+        case 'P': motion = n | data[i + 3]; break;
+        // Raster images, cuts, symbols and NV graphics carry their own data
+        case 'v': case 'V': case '8': case 'k': case '*': case '/': break;
+        // GS ( k (QR) and GS ( L (graphics); other GS ( functions set things
+        case '(': sticky = sticky || (n != 'k' && n != 'L'); break;
+        default: sticky = true; break;
+      }
+    } else if (b == kFs) {
+      // FS p prints an NV bit image; the rest set Kanji modes
+      if (code != 'p') sticky = true;
+    }
+    i += length;
+  }
+  return points;
+}
+
+void SetPreemptPoints(PrintJob* job, size_t min_chunk) {
+  if (job->data.size() > min_chunk) job->break_points = LineBreakPoints(job->data, min_chunk);
+}
+
+PrintJobQueue::PrintJobQueue(size_t worker_count, TransportFactory factory)
+    : factory_(std::move(factory)) {
+  if (worker_count == 0) worker_count = 1;
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+PrintJobQueue::~PrintJobQueue() { Shutdown(); }
+
+uint64_t PrintJobQueue::Submit(PrintJob job, PrintJobCallback on_complete) {
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return 0;
+    id = next_id_++;
+    std::string key = job.target.Key();
+    Enqueue(Entry{id, std::move(key), std::move(job), std::move(on_complete),
+                  Clock::now(), {}});
+  }
+  // notify_all: a worker paused at a break point may want this job too.
+  cv_.notify_all();
+  return id;
+}
+
+std::vector<uint64_t> PrintJobQueue::SubmitBatch(std::vector<PrintJob> jobs,
+                                                 PrintJobCallback on_complete) {
+  std::vector<uint64_t> ids;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return ids;
+    ids.reserve(jobs.size());
+    const Clock::time_point now = Clock::now();
+    // Groups keep the order in which their printer/class first appears.
+    std::vector<Entry> groups;
+    for (PrintJob& job : jobs) {
+      const uint64_t id = next_id_++;
+      ids.push_back(id);
+      std::string key = job.target.Key();
+      Entry* group = nullptr;
+      for (Entry& candidate : groups) {
+        if (candidate.key == key && candidate.job.priority == job.priority) {
+          group = &candidate;
+          break;
+        }
+      }
+      if (group) {
+        group->batch.push_back(BatchPart{id, std::move(job)});
+      } else {
+        groups.push_back(Entry{id, std::move(key), std::move(job), on_complete,
+                               now, {}});
+      }
+    }
+    for (Entry& group : groups) Enqueue(std::move(group));
+  }
+  cv_.notify_all();
+  return ids;
+}
+
+void PrintJobQueue::Enqueue(Entry entry) {
+  const size_t index = ClassIndex(entry.job.priority);
+  const size_t count = 1 + entry.batch.size();
+  Lane& lane = lanes_[entry.key];
+  lane.waiting[index].push_back(std::move(entry));
+  stats_[index].depth += count;
+  waiting_ += count;
+}
+
+size_t PrintJobQueue::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return waiting_ + running_;
+}
+
+bool PrintJobQueue::IsBusy(const PrinterTarget& target) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = lanes_.find(target.Key());
+  return it != lanes_.end() && it->second.busy;
+}
+
+PrintQueueStats PrintJobQueue::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PrintJobQueue::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ && workers_.empty()) return;
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& worker : workers_) {
+    if (worker.joinable()) worker.join();
+  }
+  workers_.clear();
+}
+
+bool PrintJobQueue::TakeRunnable(Entry* out) {
+  std::deque<Entry>* best = nullptr;
+  size_t best_class = kJobPriorityCount;
+  for (auto& entry : lanes_) {
+    Lane& lane = entry.second;
+    if (lane.busy) continue;
+    for (size_t c = 0; c < kJobPriorityCount && c <= best_class; ++c) {
+      std::deque<Entry>& waiting = lane.waiting[c];
+      if (waiting.empty()) continue;
+      if (c < best_class || waiting.front().id < best->front().id) {
+        best = &waiting;
+        best_class = c;
+      }
+      break;
+    }
+  }
+  if (!best) return false;
+  *out = std::move(best->front());
+  best->pop_front();
+  NoteStarted(*out);
+  return true;
+}
+
+bool PrintJobQueue::TakeUrgent(const std::string& key, JobPriority priority,
+                               Entry* out) {
+  auto it = lanes_.find(key);
+  if (it == lanes_.end()) return false;
+  for (size_t c = 0; c < ClassIndex(priority); ++c) {
+    std::deque<Entry>& waiting = it->second.waiting[c];
+    if (waiting.empty()) continue;
+    *out = std::move(waiting.front());
+    waiting.pop_front();
+    NoteStarted(*out);
+    ++stats_[c].preemptions;
+    return true;
+  }
+  return false;
+}
+
+void PrintJobQueue::NoteStarted(const Entry& entry) {
+  PriorityClassStats& stats = stats_[ClassIndex(entry.job.priority)];
+  const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - entry.submitted);
+  const size_t count = 1 + entry.batch.size();
+  stats.depth -= count;
+  stats.started += count;
+  stats.total_wait += wait * static_cast<int64_t>(count);
+  if (wait > stats.max_wait) stats.max_wait = wait;
+  waiting_ -= count;
+  running_ += count;
+}
+
+void PrintJobQueue::WorkerLoop() {
+  for (;;) {
+    Entry entry;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] {
+        return TakeRunnable(&entry) || (stopping_ && waiting_ == 0);
+      });
+      if (entry.id == 0) return;  // stopping and drained
+      lanes_[entry.key].busy = true;
+    }
+
+    Run(&entry);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ -= 1 + entry.batch.size();
+      auto it = lanes_.find(entry.key);
+      it->second.busy = false;
+      bool empty = true;
+      for (const auto& waiting : it->second.waiting) empty = empty && waiting.empty();
+      if (empty) lanes_.erase(it);
+    }
+    // A job for this printer may have been waiting on the one just finished.
+    cv_.notify_all();
+  }
+}
+
+void PrintJobQueue::Run(Entry* entry) {
+  const int64_t started = TraceNow();
+  Trace(*entry, "queue", TraceMicros(entry->submitted), started);
+  std::string open_error;
+  std::unique_ptr<PrinterTransport> transport =
+      factory_(entry->job.target, &open_error);
+  Trace(*entry, "connect", started, TraceNow());
+  if (!transport || !entry->batch.empty() || entry->job.break_points.empty()) {
+    Deliver(transport.get(), *entry, open_error);
+    return;
+  }
+
+  PrintJobResult result;
+  result.job_id = entry->id;
+  result.trace_id = entry->job.trace_id;
+  const size_t size = entry->job.byte_count();
+  size_t begin = 0;
+  bool ok = true;
+  for (size_t point : entry->job.break_points) {
+    if (point <= begin || point >= size) continue;
+    if (!Write(transport.get(), *entry, begin, point, &result)) {
+      ok = false;
+      break;
+    }
+    begin = point;
+    RunUrgent(transport.get(), *entry);
+  }
+  result.success = ok && Write(transport.get(), *entry, begin, size, &result);
+  if (entry->on_complete) entry->on_complete(result);
+}
+
+bool PrintJobQueue::Write(PrinterTransport* transport, const Entry& entry,
+                          size_t begin, size_t end, PrintJobResult* result) {
+  if (begin == end) return true;
+  const int64_t start = TraceNow();
+  const bool ok =
+      transport->Write(entry.job.bytes() + begin, end - begin, &result->error);
+  JobTracer* tracer = tracer_.load(std::memory_order_acquire);
+  if (tracer) {
+    tracer->Record(entry.job.trace_id, "write", start, TraceNow(), "bytes",
+                   static_cast<int64_t>(end - begin));
+  }
+  if (!ok) return false;
+  result->bytes_written += end - begin;
+  return true;
+}
+
+void PrintJobQueue::Deliver(PrinterTransport* transport, const Entry& entry,
+                            const std::string& open_error) {
+  std::vector<ByteSpan> spans;
+  spans.reserve(1 + entry.batch.size());
+  spans.push_back(ByteSpan{entry.job.bytes(), entry.job.byte_count()});
+  for (const BatchPart& part : entry.batch) {
+    spans.push_back(ByteSpan{part.job.bytes(), part.job.byte_count()});
+  }
+
+  size_t written = 0;
+  std::string error = open_error;
+  const int64_t start = TraceNow();
+  const bool ok =
+      transport && transport->WriteV(spans.data(), spans.size(), &written, &error);
+  const int64_t finish = TraceNow();
+  JobTracer* tracer = transport ? tracer_.load(std::memory_order_acquire) : nullptr;
+
+  // A job succeeded if all of its bytes were accepted before any failure.
+  size_t end = 0;
+  for (size_t i = 0; i < spans.size(); ++i) {
+    PrintJobResult result;
+    result.job_id = i == 0 ? entry.id : entry.batch[i - 1].id;
+    result.trace_id = i == 0 ? entry.job.trace_id : entry.batch[i - 1].job.trace_id;
+    if (tracer) {
+      // One gathered write, shown on every job it carried
+      tracer->Record(result.trace_id, "write", start, finish, "bytes",
+                     static_cast<int64_t>(spans[i].size));
+    }
+    end += spans[i].size;
+    result.success = transport && (ok || end <= written);
+    if (result.success) {
+      result.bytes_written = spans[i].size;
+    } else {
+      result.error = error;
+    }
+    if (entry.on_complete) entry.on_complete(result);
+  }
+}
+
+void PrintJobQueue::RunUrgent(PrinterTransport* transport, const Entry& paused) {
+  for (;;) {
+    Entry urgent;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!TakeUrgent(paused.key, paused.job.priority, &urgent)) return;
+    }
+    Trace(urgent, "queue", TraceMicros(urgent.submitted), TraceNow());
+    Deliver(transport, urgent, std::string());
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ -= 1 + urgent.batch.size();
+  }
+}
+
+void PrintJobQueue::Trace(const Entry& entry, const char* name, int64_t start_us,
+                          int64_t end_us) {
+  JobTracer* tracer = tracer_.load(std::memory_order_acquire);
+  if (!tracer) return;
+  tracer->Record(entry.job.trace_id, name, start_us, end_us);
+  for (const BatchPart& part : entry.batch) {
+    tracer->Record(part.job.trace_id, name, start_us, end_us);
+  }
+}
+
+}  // namespace printer_core
@@ -0,0 +1,212 @@
+#ifndef PRINTER_CORE_PRINT_JOB_QUEUE_H_
+#define PRINTER_CORE_PRINT_JOB_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "job_trace.h"
+#include "printer_transport.h"
+
+namespace printer_core {
+
+// Scheduling class of a job; lower values are served first on a printer.
+enum class JobPriority {
+  // Cash drawer kicks and beeper pulses: a few bytes, someone is waiting.
+  kDrawer = 0,
+  // Customer receipts.
+  kReceipt = 1,
+  // Kitchen and order tickets.
+  kKitchen = 2,
+  // X/Z reports, summaries and other long printouts.
+  kReport = 3,
+};
+
+constexpr size_t kJobPriorityCount = 4;
+
+struct PrintJob {
+  PrinterTarget target;
+  // Encoded ESC/POS bytes. A job without data only opens the transport, which
+  // doubles as a reachability check.
+  std::vector<uint8_t> data;
+  // Bytes kept alive by |borrowed_owner| and sent in place of an empty
+  // |data|, for a buffer the runner cannot move into |data| (the FlValue a
+  // Linux method call decoded). The job holds the owner until it is done.
+  std::shared_ptr<const void> borrowed_owner;
+  const uint8_t* borrowed_data = nullptr;
+  size_t borrowed_size = 0;
+  JobPriority priority = JobPriority::kReceipt;
+  // Ascending offsets into |data| where the job may pause so that waiting
+  // jobs of a higher class on the same printer go first. Offsets must fall
+  // between commands where the printer is back in its power-on state (see
+  // LineBreakPoints).
+  std::vector<size_t> break_points;
+  // JobTracer timeline the queue adds its wait, connect and write spans to;
+  // 0 for none.
+  uint64_t trace_id = 0;
+
+  // The bytes the job sends: |data|, or the borrowed bytes when it is empty.
+  const uint8_t* bytes() const { return data.empty() ? borrowed_data : data.data(); }
+  size_t byte_count() const { return data.empty() ? borrowed_size : data.size(); }
+};
+
+struct PrintJobResult {
+  uint64_t job_id = 0;
+  // PrintJob::trace_id of the job.
+  uint64_t trace_id = 0;
+  bool success = false;
+  size_t bytes_written = 0;
+  std::string error;
+};
+
+// Called on a worker thread once the job has finished. Runners marshal the
+// result back to their platform thread before touching Flutter APIs.
+using PrintJobCallback = std::function<void(const PrintJobResult&)>;
+
+// Per-class counters reported by PrintJobQueue::stats().
+struct PriorityClassStats {
+  // Jobs of this class waiting to start.
+  size_t depth = 0;
+  // Jobs of this class that have started.
+  uint64_t started = 0;
+  // Time from Submit() to the first byte, summed over started jobs and the
+  // worst seen; divide by |started| for the mean.
+  std::chrono::microseconds total_wait{0};
+  std::chrono::microseconds max_wait{0};
+  // Times a job of this class went ahead of a paused, lower-class job.
+  uint64_t preemptions = 0;
+};
+
+using PrintQueueStats = std::array<PriorityClassStats, kJobPriorityCount>;
+
+// Offsets just after a line feed, at least |min_chunk| bytes apart, where
+// the printer is back in its power-on state, suitable as
+// PrintJob::break_points. Walks the stream command by command, so line feed
+// bytes inside raster, NV or symbol data never count; a point needs an
+// ESC @ before it and every setting made since undone. Stops at the first
+// unknown command. Not for opaque data such as printRaw bytes.
+std::vector<size_t> LineBreakPoints(const std::vector<uint8_t>& data,
+                                    size_t min_chunk);
+
+// Jobs above this size may be paused at line ends for higher-class jobs.
+constexpr size_t kPreemptChunkBytes = 4096;
+
+// Sets |job|'s break points from LineBreakPoints when its data is larger
+// than |min_chunk|; smaller jobs print in one go. The runners call it for
+// receipts and orders, never for printRaw bytes.
+void SetPreemptPoints(PrintJob* job, size_t min_chunk = kPreemptChunkBytes);
+
+// Runs print jobs on background worker threads so the platform thread never
+// waits on a connect or write. Each physical printer (PrinterTarget::Key) has
+// its own lane: jobs in a lane run one at a time, highest class first and in
+// submission order within a class, while different printers run in parallel.
+// A running job with break points yields between chunks to higher-class jobs
+// for the same printer, which are written over the same transport.
+class PrintJobQueue {
+ public:
+  explicit PrintJobQueue(size_t worker_count = 2,
+                         TransportFactory factory = OpenDefaultTransport);
+  ~PrintJobQueue();
+
+  PrintJobQueue(const PrintJobQueue&) = delete;
+  PrintJobQueue& operator=(const PrintJobQueue&) = delete;
+
+  // Queues |job| and returns its id immediately. |on_complete| may be empty.
+  // Returns 0 if the queue has been shut down.
+  uint64_t Submit(PrintJob job, PrintJobCallback on_complete);
+
+  // Queues several jobs at once and returns their ids in input order (empty
+  // after shutdown). Jobs for the same printer and class are sent together
+  // over one transport with a single gathered write; |on_complete| runs once
+  // per job. Break points only apply to a job that ends up alone in its group.
+  std::vector<uint64_t> SubmitBatch(std::vector<PrintJob> jobs,
+                                    PrintJobCallback on_complete);
+
+  // Number of jobs waiting or running.
+  size_t pending() const;
+
+  // True while a job for |target|'s printer is running, i.e. while its lane
+  // holds a transport to it.
+  bool IsBusy(const PrinterTarget& target) const;
+
+  PrintQueueStats stats() const;
+
+  // Where jobs with a trace id record their spans; null (the default) for
+  // nowhere. |tracer| must outlive the queue.
+  void set_tracer(JobTracer* tracer) { tracer_.store(tracer, std::memory_order_release); }
+
+  // Stops accepting jobs, finishes the queued ones and joins the workers.
+  void Shutdown();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // A further job written together with an entry's own job.
+  struct BatchPart {
+    uint64_t id;
+    PrintJob job;
+  };
+
+  struct Entry {
+    uint64_t id = 0;
+    std::string key;
+    PrintJob job;
+    PrintJobCallback on_complete;
+    Clock::time_point submitted;
+    std::vector<BatchPart> batch;
+  };
+
+  struct Lane {
+    std::array<std::deque<Entry>, kJobPriorityCount> waiting;
+    bool busy = false;
+  };
+
+  void WorkerLoop();
+  // Picks the idle lane whose best waiting job has the highest class (oldest
+  // first on ties) and pops that job; requires mutex_.
+  bool TakeRunnable(Entry* out);
+  // Pops a waiting job for |key| with a class above |priority|; requires
+  // mutex_.
+  bool TakeUrgent(const std::string& key, JobPriority priority, Entry* out);
+  // Adds |entry| to its lane; requires mutex_.
+  void Enqueue(Entry entry);
+  // Records wait time for an entry that is about to start; requires mutex_.
+  void NoteStarted(const Entry& entry);
+  void Run(Entry* entry);
+  // Writes an entry's job and batch parts in one gathered write and reports
+  // each of them.
+  void Deliver(PrinterTransport* transport, const Entry& entry,
+               const std::string& open_error);
+  bool Write(PrinterTransport* transport, const Entry& entry, size_t begin,
+             size_t end, PrintJobResult* result);
+  void RunUrgent(PrinterTransport* transport, const Entry& paused);
+  // Records a span for the entry's job and each batch part.
+  void Trace(const Entry& entry, const char* name, int64_t start_us, int64_t end_us);
+
+  std::atomic<JobTracer*> tracer_{nullptr};
+  TransportFactory factory_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, Lane> lanes_;
+  PrintQueueStats stats_;
+  std::vector<std::thread> workers_;
+  uint64_t next_id_ = 1;
+  size_t waiting_ = 0;
+  size_t running_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_PRINT_JOB_QUEUE_H_
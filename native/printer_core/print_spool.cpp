@@ -0,0 +1,479 @@
+#include "print_spool.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+
+namespace printer_core {
+
+namespace {
+
+// File layout: a 64-byte header, then 8-byte aligned records
+//   u32 crc32 (of everything after it), u32 epoch, u32 payload size,
+//   u8 type, 3 bytes padding, u64 spool id, payload.
+// Records from an earlier epoch, a torn tail or unused space all fail the
+// epoch or CRC check, which is where a scan stops.
+constexpr char kMagic[8] = {'E', 'X', 'P', 'S', 'P', 'O', 'O', 'L'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordHeaderSize = 24;
+// u8 kind, u8 priority, u16 port, i32 connect and write timeouts, u32 host,
+// device, break point and data lengths.
+constexpr size_t kJobFixedSize = 28;
+// Every live job holds this much back for the done record it will need.
+constexpr size_t kDoneRecordSize = (kRecordHeaderSize + 7) & ~static_cast<size_t>(7);
+
+constexpr uint8_t kRecordJob = 1;
+constexpr uint8_t kRecordDone = 2;
+
+size_t Align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+const std::array<uint32_t, 256>& CrcTable() {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  return table;
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size) {
+  const std::array<uint32_t, 256>& table = CrcTable();
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i) c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+uint8_t* Put(uint8_t* p, T value) {
+  std::memcpy(p, &value, sizeof(T));
+  return p + sizeof(T);
+}
+
+template <typename T>
+T Get(const uint8_t* p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+size_t JobPayloadSize(const PrintJob& job) {
+  return kJobFixedSize + job.target.host.size() + job.target.device.size() +
+         job.break_points.size() * sizeof(uint64_t) + job.byte_count();
+}
+
+void EncodeJob(const PrintJob& job, uint8_t* p) {
+  const PrinterTarget& t = job.target;
+  p = Put<uint8_t>(p, static_cast<uint8_t>(t.kind));
+  p = Put<uint8_t>(p, static_cast<uint8_t>(job.priority));
+  p = Put<uint16_t>(p, t.port);
+  p = Put<int32_t>(p, t.connect_timeout_ms);
+  p = Put<int32_t>(p, t.write_timeout_ms);
+  p = Put<uint32_t>(p, static_cast<uint32_t>(t.host.size()));
+  p = Put<uint32_t>(p, static_cast<uint32_t>(t.device.size()));
+  p = Put<uint32_t>(p, static_cast<uint32_t>(job.break_points.size()));
+  p = Put<uint32_t>(p, static_cast<uint32_t>(job.byte_count()));
+  std::memcpy(p, t.host.data(), t.host.size());
+  p += t.host.size();
+  std::memcpy(p, t.device.data(), t.device.size());
+  p += t.device.size();
+  for (size_t offset : job.break_points) p = Put<uint64_t>(p, offset);
+  if (job.byte_count() > 0) std::memcpy(p, job.bytes(), job.byte_count());
+}
+
+bool DecodeJob(const uint8_t* p, size_t size, PrintJob* job) {
+  if (size < kJobFixedSize) return false;
+  const uint8_t kind = p[0];
+  const uint8_t priority = p[1];
+  const uint64_t host_size = Get<uint32_t>(p + 12);
+  const uint64_t device_size = Get<uint32_t>(p + 16);
+  const uint64_t break_count = Get<uint32_t>(p + 20);
+  const uint64_t data_size = Get<uint32_t>(p + 24);
+  if (kind > static_cast<uint8_t>(PrinterTarget::Kind::kCustom) ||
+      priority >= kJobPriorityCount ||
+      kJobFixedSize + host_size + device_size + break_count * sizeof(uint64_t) + data_size !=
+          size) {
+    return false;
+  }
+  PrinterTarget& t = job->target;
+  t.kind = static_cast<PrinterTarget::Kind>(kind);
+  job->priority = static_cast<JobPriority>(priority);
+  t.port = Get<uint16_t>(p + 2);
+  t.connect_timeout_ms = Get<int32_t>(p + 4);
+  t.write_timeout_ms = Get<int32_t>(p + 8);
+  p += kJobFixedSize;
+  t.host.assign(reinterpret_cast<const char*>(p), host_size);
+  p += host_size;
+  t.device.assign(reinterpret_cast<const char*>(p), device_size);
+  p += device_size;
+  job->break_points.resize(break_count);
+  for (uint64_t i = 0; i < break_count; ++i, p += sizeof(uint64_t)) {
+    job->break_points[i] = static_cast<size_t>(Get<uint64_t>(p));
+  }
+  job->data.assign(p, p + data_size);
+  return true;
+}
+
+void WriteHeader(uint8_t* base, uint32_t epoch) {
+  std::memset(base, 0, kHeaderSize);
+  std::memcpy(base, kMagic, sizeof(kMagic));
+  Put<uint32_t>(base + 8, kVersion);
+  Put<uint32_t>(base + 12, epoch);
+}
+
+// Replays the records of one epoch: |pending| gets the jobs with no done
+// record. Returns the epoch, or 0 if the file is not a spool.
+uint32_t ScanJournal(const uint8_t* base, size_t size, std::map<uint64_t, PrintJob>* pending,
+                     uint64_t* max_id) {
+  if (size < kHeaderSize || std::memcmp(base, kMagic, sizeof(kMagic)) != 0 ||
+      Get<uint32_t>(base + 8) != kVersion) {
+    return 0;
+  }
+  const uint32_t epoch = Get<uint32_t>(base + 12);
+  size_t offset = kHeaderSize;
+  while (size - offset >= kRecordHeaderSize) {
+    const uint8_t* record = base + offset;
+    const size_t payload = Get<uint32_t>(record + 8);
+    if (Get<uint32_t>(record + 4) != epoch ||
+        payload > size - offset - kRecordHeaderSize ||
+        Crc32(record + 4, kRecordHeaderSize - 4 + payload) != Get<uint32_t>(record)) {
+      break;
+    }
+    const uint8_t type = record[12];
+    const uint64_t id = Get<uint64_t>(record + 16);
+    *max_id = std::max(*max_id, id);
+    if (type == kRecordJob) {
+      PrintJob job;
+      if (!DecodeJob(record + kRecordHeaderSize, payload, &job)) break;
+      (*pending)[id] = std::move(job);
+    } else if (type == kRecordDone) {
+      pending->erase(id);
+    } else {
+      break;
+    }
+    offset += Align8(kRecordHeaderSize + payload);
+  }
+  return epoch;
+}
+
+#ifdef _WIN32
+std::wstring Widen(const std::string& s) {
+  if (s.empty()) return std::wstring();
+  const int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), nullptr, 0);
+  std::wstring w(static_cast<size_t>(n), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), &w[0], n);
+  return w;
+}
+#endif
+
+void RemoveFile(const std::string& path) {
+#ifdef _WIN32
+  DeleteFileW(Widen(path).c_str());
+#else
+  ::unlink(path.c_str());
+#endif
+}
+
+// Atomically replaces |to| with |from| and makes the rename durable.
+bool ReplaceJournal(const std::string& from, const std::string& to, std::string* error) {
+#ifdef _WIN32
+  if (!MoveFileExW(Widen(from).c_str(), Widen(to).c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    if (error) *error = "rename spool failed: " + std::to_string(GetLastError());
+    return false;
+  }
+  return true;
+#else
+  if (std::rename(from.c_str(), to.c_str()) != 0) {
+    if (error) *error = std::string("rename spool failed: ") + std::strerror(errno);
+    return false;
+  }
+  const size_t slash = to.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : to.substr(0, slash);
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    ::fsync(fd);
+    ::close(fd);
+  }
+  return true;
+#endif
+}
+
+}  // namespace
+
+// A read-write shared mapping of a whole file, sized once at open.
+class PrintSpool::MappedFile {
+ public:
+  // Opens or creates |path| and grows it to at least |min_size| bytes.
+  static std::unique_ptr<MappedFile> Open(const std::string& path, size_t min_size,
+                                          std::string* error) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    file->handle_ = CreateFileW(Widen(path).c_str(), GENERIC_READ | GENERIC_WRITE,
+                                // Shared for delete so the fresh journal can
+                                // be renamed into place while mapped.
+                                FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->handle_ == INVALID_HANDLE_VALUE) {
+      if (error) *error = "open spool failed: " + std::to_string(GetLastError());
+      return nullptr;
+    }
+    LARGE_INTEGER current;
+    if (!GetFileSizeEx(file->handle_, &current)) current.QuadPart = 0;
+    const uint64_t size = std::max<uint64_t>(static_cast<uint64_t>(current.QuadPart), min_size);
+    file->mapping_ = CreateFileMappingW(file->handle_, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(size >> 32),
+                                        static_cast<DWORD>(size & 0xFFFFFFFFu), nullptr);
+    void* view = file->mapping_ ? MapViewOfFile(file->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0)
+                                : nullptr;
+    if (view == nullptr) {
+      if (error) *error = "map spool failed: " + std::to_string(GetLastError());
+      return nullptr;
+    }
+#else
+    file->fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (file->fd_ < 0 || ::fstat(file->fd_, &st) != 0) {
+      if (error) *error = std::string("open spool failed: ") + std::strerror(errno);
+      return nullptr;
+    }
+    const size_t size = std::max(static_cast<size_t>(st.st_size), min_size);
+    if (static_cast<size_t>(st.st_size) < size && ::ftruncate(file->fd_, size) != 0) {
+      if (error) *error = std::string("size spool failed: ") + std::strerror(errno);
+      return nullptr;
+    }
+    void* view = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd_, 0);
+    if (view == MAP_FAILED) {
+      if (error) *error = std::string("map spool failed: ") + std::strerror(errno);
+      return nullptr;
+    }
+#endif
+    file->data_ = static_cast<uint8_t*>(view);
+    file->size_ = static_cast<size_t>(size);
+    return file;
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    if (handle_ != INVALID_HANDLE_VALUE) CloseHandle(handle_);
+#else
+    if (data_ != nullptr) ::munmap(data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+#endif
+  }
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Writes bytes [offset, offset + length) through to the disk.
+  bool Sync(size_t offset, size_t length) {
+    if (length == 0) return true;
+#ifdef _WIN32
+    return FlushViewOfFile(data_ + offset, length) && FlushFileBuffers(handle_);
+#else
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t begin = offset - offset % page;
+    return ::msync(data_ + begin, offset + length - begin, MS_SYNC) == 0;
+#endif
+  }
+
+ private:
+  MappedFile() = default;
+
+#ifdef _WIN32
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+bool ShouldSpool(const PrintJob& job) {
+  return job.byte_count() > 0 && job.priority != JobPriority::kDrawer;
+}
+
+std::unique_ptr<PrintSpool> PrintSpool::Open(const std::string& path,
+                                             PrintSpoolOptions options,
+                                             std::string* error) {
+  options.capacity = std::max(options.capacity, kHeaderSize + kRecordHeaderSize);
+
+  std::map<uint64_t, PrintJob> pending;
+  uint64_t max_id = 0;
+  uint32_t epoch = 0;
+  {
+    std::unique_ptr<MappedFile> old = MappedFile::Open(path, kHeaderSize, error);
+    if (!old) return nullptr;
+    epoch = ScanJournal(old->data(), old->size(), &pending, &max_id);
+  }
+
+  // Unfinished jobs move to a fresh journal under the next epoch, written
+  // aside and renamed over the old one so a crash here loses nothing.
+  const std::string fresh_path = path + ".tmp";
+  RemoveFile(fresh_path);
+  std::unique_ptr<MappedFile> fresh = MappedFile::Open(fresh_path, options.capacity, error);
+  if (!fresh) return nullptr;
+  std::unique_ptr<PrintSpool> spool(new PrintSpool(std::move(fresh), options));
+  spool->epoch_ = epoch + 1 == 0 ? 1 : epoch + 1;
+  spool->next_id_ = max_id + 1;
+  WriteHeader(spool->file_->data(), spool->epoch_);
+  spool->write_offset_ = kHeaderSize;
+  for (auto& entry : pending) {
+    const size_t payload = JobPayloadSize(entry.second);
+    if (spool->write_offset_ + Align8(kRecordHeaderSize + payload) +
+            (spool->live_.size() + 1) * kDoneRecordSize >
+        spool->file_->size()) {
+      break;
+    }
+    spool->WriteRecord(kRecordJob, entry.first, &entry.second, payload);
+    spool->live_.insert(entry.first);
+    spool->recovered_.push_back(SpooledJob{entry.first, std::move(entry.second)});
+  }
+  spool->stats_.recovered = spool->recovered_.size();
+  if (!spool->file_->Sync(0, spool->write_offset_)) {
+    if (error) *error = "sync spool failed";
+    return nullptr;
+  }
+  if (!ReplaceJournal(fresh_path, path, error)) return nullptr;
+  spool->dirty_begin_ = spool->write_offset_;
+  spool->committer_ = std::thread([s = spool.get()] { s->CommitLoop(); });
+  return spool;
+}
+
+PrintSpool::PrintSpool(std::unique_ptr<MappedFile> file, PrintSpoolOptions options)
+    : file_(std::move(file)), options_(options) {}
+
+PrintSpool::~PrintSpool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  commit_cv_.notify_all();
+  if (committer_.joinable()) committer_.join();
+}
+
+std::vector<SpooledJob> PrintSpool::TakeRecovered() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::move(recovered_);
+}
+
+void PrintSpool::WriteRecord(uint8_t type, uint64_t id, const PrintJob* job,
+                             size_t payload_size) {
+  uint8_t* record = file_->data() + write_offset_;
+  Put<uint32_t>(record + 4, epoch_);
+  Put<uint32_t>(record + 8, static_cast<uint32_t>(payload_size));
+  record[12] = type;
+  record[13] = record[14] = record[15] = 0;
+  Put<uint64_t>(record + 16, id);
+  if (job != nullptr) EncodeJob(*job, record + kRecordHeaderSize);
+  Put<uint32_t>(record, Crc32(record + 4, kRecordHeaderSize - 4 + payload_size));
+  write_offset_ += Align8(kRecordHeaderSize + payload_size);
+  ++written_seq_;
+}
+
+uint64_t PrintSpool::Append(const PrintJob& job) {
+  const size_t payload = JobPayloadSize(job);
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Keep room for the done records of this job and every live one.
+    if (write_offset_ + Align8(kRecordHeaderSize + payload) +
+            (live_.size() + 1) * kDoneRecordSize >
+        file_->size()) {
+      return 0;
+    }
+    id = next_id_++;
+    WriteRecord(kRecordJob, id, &job, payload);
+    live_.insert(id);
+    ++stats_.appended;
+  }
+  commit_cv_.notify_one();
+  return id;
+}
+
+void PrintSpool::Complete(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (live_.erase(id) == 0) return;
+    ++stats_.completed;
+    if (live_.empty() && write_offset_ >= options_.compact_threshold) {
+      // Nothing left to replay: a new epoch invalidates every record at once.
+      epoch_ = epoch_ + 1 == 0 ? 1 : epoch_ + 1;
+      WriteHeader(file_->data(), epoch_);
+      write_offset_ = kHeaderSize;
+      dirty_begin_ = 0;
+      ++written_seq_;
+    } else {
+      // Append() kept room for it.
+      WriteRecord(kRecordDone, id, nullptr, 0);
+    }
+  }
+  commit_cv_.notify_one();
+}
+
+void PrintSpool::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t target = written_seq_;
+  commit_cv_.notify_one();
+  durable_cv_.wait(lock, [&] { return durable_seq_ >= target; });
+}
+
+PrintSpoolStats PrintSpool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PrintSpoolStats stats = stats_;
+  stats.live = live_.size();
+  stats.bytes_used = write_offset_;
+  return stats;
+}
+
+void PrintSpool::CommitLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    commit_cv_.wait(lock, [this] { return stopping_ || durable_seq_ < written_seq_; });
+    if (durable_seq_ == written_seq_) break;
+    if (!stopping_ && options_.commit_delay_ms > 0) {
+      // Let appends that arrive together share this flush.
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(options_.commit_delay_ms));
+      lock.lock();
+    }
+    const uint64_t target = written_seq_;
+    const size_t begin = std::min(dirty_begin_, write_offset_);
+    const size_t end = write_offset_;
+    dirty_begin_ = write_offset_;
+    lock.unlock();
+    // The mapping never moves, so flushing needs no lock while appends go on
+    // past |end|.
+    file_->Sync(begin, end - begin);
+    lock.lock();
+    durable_seq_ = target;
+    ++stats_.commits;
+    durable_cv_.notify_all();
+  }
+}
+
+}  // namespace printer_core
@@ -0,0 +1,124 @@
+#ifndef PRINTER_CORE_PRINT_SPOOL_H_
+#define PRINTER_CORE_PRINT_SPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "print_job_queue.h"
+
+namespace printer_core {
+
+struct PrintSpoolOptions {
+  // Size of the journal file. Appends fail once it is full of unfinished
+  // jobs; it starts over whenever every job has completed.
+  size_t capacity = 8 << 20;
+  // Starting over is only worth a header write once this much is used.
+  size_t compact_threshold = 256 << 10;
+  // The committer waits this long after the first unsynced append so that
+  // appends arriving together share one flush.
+  int commit_delay_ms = 2;
+};
+
+struct PrintSpoolStats {
+  uint64_t appended = 0;
+  uint64_t completed = 0;
+  // Flushes to disk; each covers every append made before it started.
+  uint64_t commits = 0;
+  // Unfinished jobs found when the journal was opened.
+  uint64_t recovered = 0;
+  // Jobs appended (or recovered) and not yet completed.
+  size_t live = 0;
+  size_t bytes_used = 0;
+};
+
+// Whether |job| is worth replaying after a crash: it prints something. Empty
+// reachability probes and cash drawer kicks, which would pop the drawer at
+// startup, are left out.
+bool ShouldSpool(const PrintJob& job);
+
+// A job the previous run recorded but never completed.
+struct SpooledJob {
+  uint64_t id = 0;
+  PrintJob job;
+};
+
+// Append-only journal of encoded print jobs, so a job survives the app
+// crashing or the till losing power between payment and printing. Runners
+// Append() a job before queueing it and Complete() it when the queue reports
+// the outcome; on the next start Open() hands back whatever was left.
+//
+// The file is memory-mapped once at a fixed size, so an append is a copy into
+// the page cache under a mutex. A committer thread flushes it to disk a few
+// milliseconds later together with whatever else was appended meanwhile
+// (group commit). A job is therefore durable a few milliseconds after
+// Append() returns, and a crash between printing and the completion reaching
+// disk prints it again: replay is at-least-once. Thread-safe.
+class PrintSpool {
+ public:
+  // Opens or creates the journal at |path|. Unfinished jobs from the last run
+  // are carried over into a fresh journal and returned by TakeRecovered().
+  // Returns null and fills |error| if the file cannot be created or mapped.
+  static std::unique_ptr<PrintSpool> Open(const std::string& path,
+                                          PrintSpoolOptions options,
+                                          std::string* error);
+  ~PrintSpool();
+
+  PrintSpool(const PrintSpool&) = delete;
+  PrintSpool& operator=(const PrintSpool&) = delete;
+
+  // Unfinished jobs found by Open(), oldest first; empty on later calls. They
+  // stay in the journal until completed.
+  std::vector<SpooledJob> TakeRecovered();
+
+  // Records |job| and returns its spool id, or 0 if the journal is full.
+  // Never waits for the disk.
+  uint64_t Append(const PrintJob& job);
+
+  // Marks spool job |id| as done (printed or failed for good).
+  void Complete(uint64_t id);
+
+  // Waits until everything appended or completed so far is on disk.
+  void Flush();
+
+  PrintSpoolStats stats() const;
+
+ private:
+  class MappedFile;
+
+  PrintSpool(std::unique_ptr<MappedFile> file, PrintSpoolOptions options);
+
+  // Copies a record into the mapping at write_offset_; call with mutex_ held
+  // after checking it fits.
+  void WriteRecord(uint8_t type, uint64_t id, const PrintJob* job, size_t payload_size);
+  void CommitLoop();
+
+  const std::unique_ptr<MappedFile> file_;
+  const PrintSpoolOptions options_;
+  mutable std::mutex mutex_;
+  std::condition_variable commit_cv_;
+  std::condition_variable durable_cv_;
+  uint32_t epoch_ = 0;
+  size_t write_offset_ = 0;
+  // Bytes [dirty_begin_, write_offset_) have not been flushed yet.
+  size_t dirty_begin_ = 0;
+  // Changes made / flushed so far, for Flush() and the committer.
+  uint64_t written_seq_ = 0;
+  uint64_t durable_seq_ = 0;
+  uint64_t next_id_ = 1;
+  std::unordered_set<uint64_t> live_;
+  std::vector<SpooledJob> recovered_;
+  PrintSpoolStats stats_;
+  bool stopping_ = false;
+  std::thread committer_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_PRINT_SPOOL_H_
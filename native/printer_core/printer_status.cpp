@@ -0,0 +1,134 @@
+#include "printer_status.h"
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kDle = 0x10;
+constexpr uint8_t kEot = 0x04;
+constexpr uint8_t kGs = 0x1D;
+
+bool Bit(uint8_t byte, int bit) { return (byte >> bit) & 1; }
+
+// Fixed bits 0, 1, 4 and 7: DLE EOT replies read x0x1xx10, automatic status
+// blocks start with x0x1xx00.
+bool IsRealtimeReply(uint8_t byte) { return (byte & 0x93) == 0x12; }
+bool IsAutoStatusStart(uint8_t byte) { return (byte & 0x93) == 0x10; }
+
+}  // namespace
+
+const char* PrinterStatus::Summary() const {
+  if (!known) return "unknown";
+  if (!reachable) return "offline";
+  if (!reported) return "online";
+  if (error) return "error";
+  if (cover_open) return "cover_open";
+  if (paper_out) return "paper_out";
+  if (offline) return "offline";
+  if (paper_near_end) return "paper_near_end";
+  return "online";
+}
+
+bool PrinterStatus::SameCondition(const PrinterStatus& other) const {
+  return known == other.known && reachable == other.reachable &&
+         reported == other.reported && offline == other.offline &&
+         cover_open == other.cover_open && paper_near_end == other.paper_near_end &&
+         paper_out == other.paper_out && error == other.error;
+}
+
+bool DecodeRealtimeStatus(uint8_t n, uint8_t byte, PrinterStatus* status) {
+  if (!IsRealtimeReply(byte)) return false;
+  switch (n) {
+    case 1:
+      status->drawer_signal = Bit(byte, 2);
+      status->offline = Bit(byte, 3);
+      break;
+    case 2:
+      status->cover_open = Bit(byte, 2);
+      status->paper_out = status->paper_out || Bit(byte, 5);
+      status->error = status->error || Bit(byte, 6);
+      break;
+    case 3:
+      status->error = status->error || Bit(byte, 2) || Bit(byte, 3) ||
+                      Bit(byte, 5) || Bit(byte, 6);
+      break;
+    case 4:
+      status->paper_near_end = Bit(byte, 2) || Bit(byte, 3);
+      status->paper_out = status->paper_out || Bit(byte, 5) || Bit(byte, 6);
+      break;
+    default:
+      return false;
+  }
+  status->reported = true;
+  return true;
+}
+
+bool DecodeAutoStatus(const uint8_t* bytes, PrinterStatus* status) {
+  if (!IsAutoStatusStart(bytes[0])) return false;
+  for (int i = 1; i < 4; ++i) {
+    if ((bytes[i] & 0x90) != 0) return false;
+  }
+  status->drawer_signal = Bit(bytes[0], 2);
+  status->offline = Bit(bytes[0], 3);
+  status->cover_open = Bit(bytes[0], 5);
+  status->error = Bit(bytes[1], 2) || Bit(bytes[1], 3) || Bit(bytes[1], 5) ||
+                  Bit(bytes[1], 6);
+  status->paper_near_end = Bit(bytes[2], 0) || Bit(bytes[2], 1);
+  status->paper_out = Bit(bytes[2], 2) || Bit(bytes[2], 3);
+  status->reported = true;
+  return true;
+}
+
+void StatusParser::Feed(const uint8_t* data, size_t size, PrinterStatus* status) {
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t byte = data[i];
+    if (block_size_ > 0) {
+      block_[block_size_++] = byte;
+      if (block_size_ == 4) {
+        auto_status_seen_ = DecodeAutoStatus(block_, status) || auto_status_seen_;
+        block_size_ = 0;
+      }
+    } else if (IsAutoStatusStart(byte)) {
+      block_[block_size_++] = byte;
+    } else if (IsRealtimeReply(byte) && !expected_.empty()) {
+      DecodeRealtimeStatus(expected_.front(), byte, status);
+      expected_.pop_front();
+    }
+  }
+}
+
+void QueryPrinterStatus(PrinterTransport* transport, int timeout_ms,
+                        PrinterStatus* status) {
+  using Clock = std::chrono::steady_clock;
+  *status = PrinterStatus();
+  status->known = true;
+  status->updated = Clock::now();
+
+  // Real-time requests are answered even while the printer is busy or
+  // offline; GS a 0x0F turns on automatic status for drawer, offline, error
+  // and paper sensor changes and makes the printer send one block now.
+  static const uint8_t kRequest[] = {kDle, kEot, 1, kDle, kEot, 2, kDle, kEot, 3,
+                                     kDle, kEot, 4, kGs,  'a',  0x0F};
+  StatusParser parser;
+  for (uint8_t n = 1; n <= 4; ++n) parser.ExpectRealtime(n);
+  if (!transport->Write(kRequest, sizeof(kRequest), &status->last_error)) return;
+  status->reachable = true;
+
+  // Either a full set of DLE EOT replies or one status block is a complete
+  // picture; anything arriving later is drained with the idle socket.
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  uint8_t buffer[64];
+  while (parser.pending_realtime() > 0 && !parser.auto_status_seen()) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - Clock::now());
+    if (left.count() <= 0) break;
+    std::string read_error;
+    const long n = transport->Read(buffer, sizeof(buffer), static_cast<int>(left.count()),
+                                   &read_error);
+    if (n <= 0) break;
+    parser.Feed(buffer, static_cast<size_t>(n), status);
+  }
+  status->updated = Clock::now();
+}
+
+}  // namespace printer_core
@@ -0,0 +1,83 @@
+#ifndef PRINTER_CORE_PRINTER_STATUS_H_
+#define PRINTER_CORE_PRINTER_STATUS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "printer_transport.h"
+
+namespace printer_core {
+
+// What a printer last said about itself. The condition flags are only
+// meaningful when |reported| is set.
+struct PrinterStatus {
+  // False until the printer has been polled or printed to.
+  bool known = false;
+  // The last connection and status request went through.
+  bool reachable = false;
+  // The printer answered DLE EOT or sent automatic status (GS a).
+  bool reported = false;
+  // The printer says it is offline (cover open, paper out, error, feeding).
+  bool offline = false;
+  bool cover_open = false;
+  bool paper_near_end = false;
+  bool paper_out = false;
+  // Mechanical, auto-cutter, unrecoverable or auto-recoverable error.
+  bool error = false;
+  // Drawer kick connector pin 3; whether high means open depends on the drawer.
+  bool drawer_signal = false;
+  // Why the printer was unreachable, if it was.
+  std::string last_error;
+  std::chrono::steady_clock::time_point updated;
+
+  // Same reachability and condition flags; timestamps and error text are
+  // ignored. Used to publish only real changes.
+  bool SameCondition(const PrinterStatus& other) const;
+
+  // One word for Dart: "unknown", "offline", "error", "cover_open",
+  // "paper_out", "paper_near_end" or "online", most severe first.
+  const char* Summary() const;
+};
+
+// Decodes the reply byte to DLE EOT |n| (1 = printer, 2 = offline cause,
+// 3 = error cause, 4 = paper sensor) into |status|. Returns false if |byte|
+// does not look like a real-time status reply.
+bool DecodeRealtimeStatus(uint8_t n, uint8_t byte, PrinterStatus* status);
+
+// Decodes a 4-byte automatic status block (GS a). Returns false if the
+// bytes are not a status block.
+bool DecodeAutoStatus(const uint8_t* bytes, PrinterStatus* status);
+
+// Splits a stream of printer replies into DLE EOT answers and automatic
+// status blocks; the two are told apart by their fixed bits.
+class StatusParser {
+ public:
+  // Call once per DLE EOT sent, in order, so replies map to their |n|.
+  void ExpectRealtime(uint8_t n) { expected_.push_back(n); }
+
+  // Decodes |size| received bytes into |status| (setting |reported| on any
+  // match). Bytes that fit neither format are skipped.
+  void Feed(const uint8_t* data, size_t size, PrinterStatus* status);
+
+  size_t pending_realtime() const { return expected_.size(); }
+  bool auto_status_seen() const { return auto_status_seen_; }
+
+ private:
+  std::deque<uint8_t> expected_;
+  uint8_t block_[4] = {};
+  size_t block_size_ = 0;
+  bool auto_status_seen_ = false;
+};
+
+// Sends DLE EOT 1-4 and GS a (automatic status on) over |transport| and
+// decodes what comes back within |timeout_ms|. Replaces |status|; a printer
+// that takes the request but never answers is reachable without details.
+void QueryPrinterStatus(PrinterTransport* transport, int timeout_ms,
+                        PrinterStatus* status);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_PRINTER_STATUS_H_
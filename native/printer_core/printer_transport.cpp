@@ -0,0 +1,128 @@
+#include "printer_transport.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "net_socket.h"
+
+namespace printer_core {
+
+namespace {
+
+class TcpTransport : public PrinterTransport {
+ public:
+  TcpTransport(SocketHandle socket, int write_timeout_ms)
+      : socket_(socket), write_timeout_ms_(write_timeout_ms) {}
+  ~TcpTransport() override { CloseSocket(socket_); }
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    return SendAll(socket_, data, size, write_timeout_ms_, error);
+  }
+
+  bool WriteV(const ByteSpan* spans, size_t count, size_t* written,
+              std::string* error) override {
+    return SendAllV(socket_, spans, count, write_timeout_ms_, error, written);
+  }
+
+  long Read(uint8_t* data, size_t size, int timeout_ms,
+            std::string* error) override {
+    bool timed_out = false;
+    return Receive(socket_, data, size, timeout_ms, &timed_out, error);
+  }
+
+ private:
+  SocketHandle socket_;
+  int write_timeout_ms_;
+};
+
+// Writes to a device node such as /dev/usb/lp0. Uses stdio so the same code
+// works for Windows device paths and for plain files in tests.
+class DeviceTransport : public PrinterTransport {
+ public:
+  explicit DeviceTransport(FILE* file) : file_(file) {}
+  ~DeviceTransport() override { std::fclose(file_); }
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    if (std::fwrite(data, 1, size, file_) != size || std::fflush(file_) != 0) {
+      if (error) *error = "device write failed";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  FILE* file_;
+};
+
+}  // namespace
+
+bool PrinterTransport::WriteV(const ByteSpan* spans, size_t count,
+                              size_t* written, std::string* error) {
+  *written = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (spans[i].size == 0) continue;
+    if (!Write(spans[i].data, spans[i].size, error)) return false;
+    *written += spans[i].size;
+  }
+  return true;
+}
+
+long PrinterTransport::Read(uint8_t*, size_t, int, std::string* error) {
+  if (error) *error = "transport cannot read";
+  return -1;
+}
+
+PrinterTarget PrinterTarget::Network(std::string host, uint16_t port) {
+  PrinterTarget target;
+  target.kind = Kind::kNetwork;
+  target.host = std::move(host);
+  target.port = port;
+  return target;
+}
+
+PrinterTarget PrinterTarget::Device(std::string path) {
+  PrinterTarget target;
+  target.kind = Kind::kDevice;
+  target.device = std::move(path);
+  return target;
+}
+
+PrinterTarget PrinterTarget::Custom(std::string name) {
+  PrinterTarget target;
+  target.kind = Kind::kCustom;
+  target.device = std::move(name);
+  return target;
+}
+
+std::string PrinterTarget::Key() const {
+  if (kind == Kind::kNetwork) return host + ":" + std::to_string(port);
+  return device;
+}
+
+std::unique_ptr<PrinterTransport> OpenDefaultTransport(
+    const PrinterTarget& target, std::string* error) {
+  switch (target.kind) {
+    case PrinterTarget::Kind::kNetwork: {
+      SocketHandle s = TcpConnect(target.host, target.port,
+                                  target.connect_timeout_ms, error);
+      if (s == kInvalidSocket) return nullptr;
+      return std::make_unique<TcpTransport>(s, target.write_timeout_ms);
+    }
+    case PrinterTarget::Kind::kDevice: {
+      // Append mode is a no-op for device nodes and lets a plain file stand
+      // in for a printer, collecting every job.
+      FILE* file = std::fopen(target.device.c_str(), "ab");
+      if (!file) {
+        if (error) *error = "cannot open " + target.device;
+        return nullptr;
+      }
+      return std::make_unique<DeviceTransport>(file);
+    }
+    case PrinterTarget::Kind::kCustom:
+      break;
+  }
+  if (error) *error = "no transport for " + target.Key();
+  return nullptr;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,75 @@
+#ifndef PRINTER_CORE_PRINTER_TRANSPORT_H_
+#define PRINTER_CORE_PRINTER_TRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "net_socket.h"
+
+namespace printer_core {
+
+// Where a job is sent.
+struct PrinterTarget {
+  enum class Kind {
+    // Raw TCP socket (port 9100 on most receipt printers).
+    kNetwork,
+    // Character device or file path, e.g. /dev/usb/lp0.
+    kDevice,
+    // Resolved by a runner-provided transport factory (for example the
+    // POSMAC USB handle on Windows).
+    kCustom,
+  };
+
+  Kind kind = Kind::kNetwork;
+  std::string host;
+  uint16_t port = 9100;
+  std::string device;
+  int connect_timeout_ms = 5000;
+  int write_timeout_ms = 10000;
+
+  static PrinterTarget Network(std::string host, uint16_t port);
+  static PrinterTarget Device(std::string path);
+  static PrinterTarget Custom(std::string name);
+
+  // Identifies the physical printer: "ip:port" for network targets, the
+  // device path or custom name otherwise. Jobs with the same key are never
+  // sent concurrently.
+  std::string Key() const;
+};
+
+// An open connection to a printer.
+class PrinterTransport {
+ public:
+  virtual ~PrinterTransport() = default;
+
+  virtual bool Write(const uint8_t* data, size_t size, std::string* error) = 0;
+
+  // Writes |count| spans back to back. |written| receives the bytes accepted
+  // so far, also on failure. Socket transports gather the spans into as few
+  // system calls as possible; the default writes them one by one.
+  virtual bool WriteV(const ByteSpan* spans, size_t count, size_t* written,
+                      std::string* error);
+
+  // Reads bytes the printer sent back (status replies), waiting up to
+  // |timeout_ms|. Returns the byte count, 0 on timeout or when the printer
+  // closed the connection, and -1 on error. Transports without a back
+  // channel always fail.
+  virtual long Read(uint8_t* data, size_t size, int timeout_ms,
+                    std::string* error);
+};
+
+// Opens a transport for |target|; returns null and fills |error| on failure.
+using TransportFactory = std::function<std::unique_ptr<PrinterTransport>(
+    const PrinterTarget& target, std::string* error)>;
+
+// Handles kNetwork (TCP) and kDevice (file write) targets. kCustom targets
+// fail unless a runner wraps this factory.
+std::unique_ptr<PrinterTransport> OpenDefaultTransport(
+    const PrinterTarget& target, std::string* error);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_PRINTER_TRANSPORT_H_
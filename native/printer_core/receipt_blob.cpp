@@ -0,0 +1,152 @@
+#include "receipt_blob.h"
+
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'E', 'X', 'R', 'B'};
+
+uint32_t Uint32At(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+         static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint16_t Uint16At(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+double DoubleAt(const uint8_t* p) {
+  const uint64_t bits = static_cast<uint64_t>(Uint32At(p)) |
+                        static_cast<uint64_t>(Uint32At(p + 4)) << 32;
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void PutUint32(uint32_t value, uint8_t* p) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void PutDouble(double value, uint8_t* p) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  PutUint32(static_cast<uint32_t>(bits), p);
+  PutUint32(static_cast<uint32_t>(bits >> 32), p + 4);
+}
+
+// The string an offset and length at |ref| point to in |strings|.
+bool StringAt(const uint8_t* ref, std::string_view strings, std::string_view* out) {
+  const uint32_t offset = Uint32At(ref);
+  const uint32_t length = Uint32At(ref + 4);
+  if (offset > strings.size() || length > strings.size() - offset) return false;
+  *out = strings.substr(offset, length);
+  return true;
+}
+
+// Appends |s| to the string table and writes its reference at |ref|.
+void PutString(std::string_view s, uint8_t* ref, std::vector<uint8_t>* strings) {
+  PutUint32(static_cast<uint32_t>(strings->size()), ref);
+  PutUint32(static_cast<uint32_t>(s.size()), ref + 4);
+  strings->insert(strings->end(), s.begin(), s.end());
+}
+
+}  // namespace
+
+bool ReadReceiptBlob(const uint8_t* data, size_t size, ReceiptDocument* doc) {
+  if (size < kReceiptBlobHeaderSize || std::memcmp(data, kMagic, 4) != 0 ||
+      Uint16At(data + 4) != kReceiptBlobVersion) {
+    return false;
+  }
+  const size_t header_size = Uint16At(data + 6);
+  const uint32_t flags = Uint32At(data + 8);
+  const size_t item_count = Uint32At(data + 12);
+  const size_t item_size = Uint32At(data + 16);
+  const size_t strings_size = Uint32At(data + 20);
+  if (header_size < kReceiptBlobHeaderSize || header_size > size ||
+      item_size < kReceiptBlobItemSize) {
+    return false;
+  }
+  // By division, so a huge count cannot wrap the product
+  if (item_count != 0 && item_size > (size - header_size) / item_count) return false;
+  const size_t items_end = header_size + item_count * item_size;
+  if (strings_size != size - items_end) return false;
+  const std::string_view strings(reinterpret_cast<const char*>(data + items_end),
+                                 strings_size);
+
+  std::string_view title;
+  if (!StringAt(data + 24, strings, &doc->currency) || !StringAt(data + 32, strings, &title) ||
+      !StringAt(data + 40, strings, &doc->barcode) ||
+      !StringAt(data + 48, strings, &doc->qr_data)) {
+    return false;
+  }
+  doc->title.reset();
+  if (flags & kReceiptBlobTitle) doc->title = title;
+  auto money = [&](uint32_t flag, size_t offset, std::optional<double>* out) {
+    out->reset();
+    if (flags & flag) *out = DoubleAt(data + offset);
+  };
+  money(kReceiptBlobSubtotal, 56, &doc->subtotal);
+  money(kReceiptBlobTax, 64, &doc->tax);
+  money(kReceiptBlobServiceCharge, 72, &doc->service_charge);
+  money(kReceiptBlobTotal, 80, &doc->total);
+
+  doc->items.resize(item_count);
+  const uint8_t* record = data + header_size;
+  for (ReceiptItem& item : doc->items) {
+    if (!StringAt(record, strings, &item.name)) return false;
+    item.quantity = static_cast<int32_t>(Uint32At(record + 8));
+    item.price = DoubleAt(record + 16);
+    record += item_size;
+  }
+  return true;
+}
+
+void WriteReceiptBlob(const ReceiptDocument& doc, std::vector<uint8_t>* out) {
+  std::vector<uint8_t> strings;
+  out->assign(kReceiptBlobHeaderSize + doc.items.size() * kReceiptBlobItemSize, 0);
+  uint8_t* header = out->data();
+  std::memcpy(header, kMagic, 4);
+  header[4] = kReceiptBlobVersion & 0xFF;
+  header[5] = kReceiptBlobVersion >> 8;
+  header[6] = kReceiptBlobHeaderSize & 0xFF;
+  header[7] = kReceiptBlobHeaderSize >> 8;
+
+  uint32_t flags = 0;
+  PutString(doc.currency, header + 24, &strings);
+  if (doc.title) {
+    flags |= kReceiptBlobTitle;
+    PutString(*doc.title, header + 32, &strings);
+  } else {
+    PutString({}, header + 32, &strings);
+  }
+  PutString(doc.barcode, header + 40, &strings);
+  PutString(doc.qr_data, header + 48, &strings);
+  auto money = [&](uint32_t flag, size_t offset, const std::optional<double>& value) {
+    if (!value) return;
+    flags |= flag;
+    PutDouble(*value, header + offset);
+  };
+  money(kReceiptBlobSubtotal, 56, doc.subtotal);
+  money(kReceiptBlobTax, 64, doc.tax);
+  money(kReceiptBlobServiceCharge, 72, doc.service_charge);
+  money(kReceiptBlobTotal, 80, doc.total);
+  PutUint32(flags, header + 8);
+  PutUint32(static_cast<uint32_t>(doc.items.size()), header + 12);
+  PutUint32(kReceiptBlobItemSize, header + 16);
+
+  uint8_t* record = header + kReceiptBlobHeaderSize;
+  for (const ReceiptItem& item : doc.items) {
+    PutString(item.name, record, &strings);
+    PutUint32(static_cast<uint32_t>(item.quantity), record + 8);
+    PutDouble(item.price, record + 16);
+    record += kReceiptBlobItemSize;
+  }
+  PutUint32(static_cast<uint32_t>(strings.size()), out->data() + 20);
+  out->insert(out->end(), strings.begin(), strings.end());
+}
+
+}  // namespace printer_core
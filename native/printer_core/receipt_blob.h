@@ -0,0 +1,59 @@
+#ifndef PRINTER_CORE_RECEIPT_BLOB_H_
+#define PRINTER_CORE_RECEIPT_BLOB_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "escpos_encoder.h"
+
+namespace printer_core {
+
+// A structured receipt as one flat little-endian buffer, so the Dart side
+// can send receiptData "receiptBlob" as a Uint8List instead of a map of
+// lists of maps, and the runner can read it without a lookup per field.
+//
+//   header (kReceiptBlobHeaderSize bytes)
+//     0  "EXRB"
+//     4  u16 version (kReceiptBlobVersion)
+//     6  u16 header size
+//     8  u32 flags: which of title, subtotal, tax, service charge and total
+//        are set (ReceiptBlobFlag)
+//    12  u32 item count
+//    16  u32 item record size
+//    20  u32 string table size
+//    24  currency, title, barcode, qr_data: u32 offset, u32 length each
+//    56  f64 subtotal, tax, service charge, total
+//   item records (item record size bytes each)
+//     0  name: u32 offset, u32 length
+//     8  i32 quantity
+//    12  u32 reserved
+//    16  f64 price
+//   string table: UTF-8, offsets relative to its start
+//
+// Readers take larger header and record sizes than they know, skipping the
+// extra fields, so fields can be added without a new version.
+constexpr uint16_t kReceiptBlobVersion = 1;
+constexpr size_t kReceiptBlobHeaderSize = 88;
+constexpr size_t kReceiptBlobItemSize = 24;
+
+enum ReceiptBlobFlag : uint32_t {
+  kReceiptBlobTitle = 1u << 0,
+  kReceiptBlobSubtotal = 1u << 1,
+  kReceiptBlobTax = 1u << 2,
+  kReceiptBlobServiceCharge = 1u << 3,
+  kReceiptBlobTotal = 1u << 4,
+};
+
+// Reads |data| into |doc|, whose strings then view |data|. Reuses the
+// capacity of doc->items, so steady-state reads do not allocate. Returns
+// false, leaving |doc| unspecified, if |data| is not a version 1 blob or
+// any count, size or string reference falls outside it.
+bool ReadReceiptBlob(const uint8_t* data, size_t size, ReceiptDocument* doc);
+
+// Replaces |out| with |doc| as a blob.
+void WriteReceiptBlob(const ReceiptDocument& doc, std::vector<uint8_t>* out);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_RECEIPT_BLOB_H_
@@ -0,0 +1,179 @@
+#include "status_monitor.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace printer_core {
+
+StatusMonitor::StatusMonitor(TransportFactory factory, StatusMonitorOptions options)
+    : factory_(std::move(factory)), options_(options) {
+  if (options_.poll_interval_ms > 0) {
+    poller_ = std::thread([this] { PollLoop(); });
+  }
+}
+
+StatusMonitor::~StatusMonitor() { Shutdown(); }
+
+StatusMonitor::Entry& StatusMonitor::Track(const PrinterTarget& target, bool* added) {
+  const std::string key = target.Key();
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    it = entries_.emplace(key, Entry{target, PrinterStatus(), Clock::now(), false, {}}).first;
+    poll_requested_ = *added = true;
+  }
+  it->second.last_requested = Clock::now();
+  return it->second;
+}
+
+void StatusMonitor::Update(std::unique_lock<std::mutex>* lock, Entry* entry,
+                           PrinterStatus status) {
+  const bool changed = !entry->status.SameCondition(status);
+  entry->status = std::move(status);
+  if (!changed || !listener_) return;
+  const PrinterTarget target = entry->target;
+  const PrinterStatus snapshot = entry->status;
+  const ChangeListener listener = listener_;
+  lock->unlock();
+  listener(target, snapshot);
+}
+
+PrinterStatus StatusMonitor::Get(const PrinterTarget& target) {
+  bool added = false;
+  PrinterStatus status;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status = Track(target, &added).status;
+  }
+  if (added) cv_.notify_all();
+  return status;
+}
+
+void StatusMonitor::ReportJobResult(const PrinterTarget& target, bool success,
+                                    const std::string& error) {
+  bool added = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry& entry = Track(target, &added);
+    PrinterStatus status = entry.status;
+    status.known = true;
+    status.reachable = success;
+    status.last_error = success ? std::string() : error;
+    status.updated = Clock::now();
+    Update(&lock, &entry, std::move(status));
+  }
+  if (added) cv_.notify_all();
+}
+
+void StatusMonitor::Watch(const PrinterTarget& target) {
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Track(target, &added).pinned = true;
+  }
+  if (added) cv_.notify_all();
+}
+
+void StatusMonitor::Unwatch(const PrinterTarget& target) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(target.Key());
+  if (it != entries_.end()) it->second.pinned = false;
+}
+
+void StatusMonitor::set_listener(ChangeListener listener) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  listener_ = std::move(listener);
+}
+
+void StatusMonitor::set_busy_check(BusyCheck busy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  busy_ = std::move(busy);
+}
+
+void StatusMonitor::FeedUnsolicited(const std::string& key, const uint8_t* data,
+                                    size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return;
+  PrinterStatus decoded;
+  it->second.unsolicited.Feed(data, size, &decoded);
+  if (!decoded.reported) return;
+  // Only a connected printer sends automatic status
+  decoded.known = true;
+  decoded.reachable = true;
+  decoded.updated = Clock::now();
+  Update(&lock, &it->second, std::move(decoded));
+}
+
+void StatusMonitor::PollNow() {
+  std::vector<PrinterTarget> targets;
+  BusyCheck busy;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point now = Clock::now();
+    const auto watch = std::chrono::milliseconds(options_.watch_timeout_ms);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (!it->second.pinned && now - it->second.last_requested > watch) {
+        it = entries_.erase(it);
+        continue;
+      }
+      targets.push_back(it->second.target);
+      ++it;
+    }
+    poll_requested_ = false;
+    busy = busy_;
+  }
+
+  for (PrinterTarget& target : targets) {
+    // A second connection could fail or hold up the job; its result updates
+    // the cache instead.
+    if (busy && busy(target)) continue;
+    target.connect_timeout_ms = std::min(target.connect_timeout_ms, options_.connect_timeout_ms);
+    PrinterStatus status;
+    std::string error;
+    std::unique_ptr<PrinterTransport> transport = factory_(target, &error);
+    if (transport) {
+      QueryPrinterStatus(transport.get(), options_.reply_timeout_ms, &status);
+    } else {
+      status.known = true;
+      status.last_error = error;
+      status.updated = Clock::now();
+    }
+    transport.reset();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(target.Key());
+    if (it == entries_.end()) continue;
+    // A reachable printer that stayed silent keeps its last reported details.
+    if (status.reachable && !status.reported && it->second.status.reported) {
+      status = it->second.status;
+      status.reachable = true;
+      status.last_error.clear();
+      status.updated = Clock::now();
+    }
+    Update(&lock, &it->second, std::move(status));
+  }
+}
+
+void StatusMonitor::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (poller_.joinable()) poller_.join();
+}
+
+void StatusMonitor::PollLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    cv_.wait_for(lock, std::chrono::milliseconds(options_.poll_interval_ms),
+                 [this] { return stopping_ || poll_requested_; });
+    if (stopping_) break;
+    lock.unlock();
+    PollNow();
+    lock.lock();
+  }
+}
+
+}  // namespace printer_core
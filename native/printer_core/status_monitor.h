@@ -0,0 +1,120 @@
+#ifndef PRINTER_CORE_STATUS_MONITOR_H_
+#define PRINTER_CORE_STATUS_MONITOR_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "printer_status.h"
+#include "printer_transport.h"
+
+namespace printer_core {
+
+struct StatusMonitorOptions {
+  // How often each watched printer is polled; 0 disables the thread (call
+  // PollNow() yourself).
+  int poll_interval_ms = 3000;
+  // Connect timeout for polls, shorter than a print job's.
+  int connect_timeout_ms = 2000;
+  // How long a poll waits for the status replies.
+  int reply_timeout_ms = 500;
+  // Printers nobody asked about for this long are no longer polled.
+  int watch_timeout_ms = 120000;
+};
+
+// Answers status questions from a cache that a background thread keeps
+// fresh, so callers on the UI thread never wait on the network. A printer is
+// watched from the first Get() or job result until nobody has asked about it
+// for watch_timeout_ms, or until Unwatch() when added with Watch(). Polls go
+// through |factory| (typically ConnectionPool::Acquire, so they reuse the
+// print connection) and skip printers the busy check says are printing, as
+// many printers take only one connection on port 9100. Automatic status
+// blocks the pool finds on idle sockets come in through FeedUnsolicited().
+// Thread-safe.
+class StatusMonitor {
+ public:
+  // Called when a watched printer's condition changes, on the poller thread
+  // or on the thread that reported a job result, without the monitor's lock
+  // held.
+  using ChangeListener =
+      std::function<void(const PrinterTarget& target, const PrinterStatus& status)>;
+  // True while a job holds a connection to the printer (typically
+  // PrintJobQueue::IsBusy).
+  using BusyCheck = std::function<bool(const PrinterTarget& target)>;
+
+  explicit StatusMonitor(TransportFactory factory,
+                         StatusMonitorOptions options = StatusMonitorOptions());
+  ~StatusMonitor();
+
+  StatusMonitor(const StatusMonitor&) = delete;
+  StatusMonitor& operator=(const StatusMonitor&) = delete;
+
+  // Cached status of |target|; never does I/O. A printer seen for the first
+  // time is polled right away and reads known = false until then.
+  PrinterStatus Get(const PrinterTarget& target);
+
+  // Folds in the outcome of a print job so a failed write shows up without
+  // waiting for the next poll, and starts watching the printer.
+  void ReportJobResult(const PrinterTarget& target, bool success,
+                       const std::string& error);
+
+  // Keeps polling |target| until Unwatch(), whether or not anyone asks.
+  void Watch(const PrinterTarget& target);
+  void Unwatch(const PrinterTarget& target);
+
+  // Replaces the change listener; pass nullptr to remove it.
+  void set_listener(ChangeListener listener);
+
+  // Replaces the busy check; pass nullptr to poll every printer.
+  void set_busy_check(BusyCheck busy);
+
+  // Decodes bytes a printer sent unasked (the automatic status turned on by
+  // each poll) for the printer with PrinterTarget::Key() |key|; fits
+  // ConnectionPool::UnsolicitedListener. Ignored for printers not watched.
+  void FeedUnsolicited(const std::string& key, const uint8_t* data, size_t size);
+
+  // Polls every watched printer once on the calling thread.
+  void PollNow();
+
+  void Shutdown();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    PrinterTarget target;
+    PrinterStatus status;
+    Clock::time_point last_requested;
+    bool pinned = false;
+    // Automatic status blocks split across FeedUnsolicited() calls.
+    StatusParser unsolicited;
+  };
+
+  // Finds or adds the entry for |target| with mutex_ held; a new printer
+  // sets poll_requested_ and |*added|.
+  Entry& Track(const PrinterTarget& target, bool* added);
+  // Stores |status| in |entry| with |lock| held, then releases the lock and
+  // tells the listener if the condition changed.
+  void Update(std::unique_lock<std::mutex>* lock, Entry* entry, PrinterStatus status);
+  void PollLoop();
+
+  const TransportFactory factory_;
+  const StatusMonitorOptions options_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, Entry> entries_;
+  ChangeListener listener_;
+  BusyCheck busy_;
+  // Set when a new printer is tracked so the poller runs before its interval.
+  bool poll_requested_ = false;
+  bool stopping_ = false;
+  std::thread poller_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_STATUS_MONITOR_H_
@@ -0,0 +1,660 @@
+#include "symbology.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdlib>
+#include <cstring>
+
+namespace printer_core {
+
+namespace {
+
+// --- QR code ---
+
+// Error correction codewords per block and block count, by level and
+// version (ISO/IEC 18004 table 9). Index 0 is unused.
+constexpr int8_t kQrEccPerBlock[4][41] = {
+    {-1, 7,  10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28,
+     28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26,
+     26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30,
+     28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28,
+     30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+};
+constexpr int8_t kQrBlocks[4][41] = {
+    {-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 6, 6, 6, 6, 7, 8,
+     8, 9, 9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5, 5, 8, 9, 9, 10, 10, 11, 13, 14, 16,
+     17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8, 8, 10, 12, 16, 12, 17, 16, 18, 21, 20,
+     23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+    {-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25,
+     25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},
+};
+
+// Format information value of each level (L, M, Q, H).
+constexpr int kQrFormatBits[4] = {1, 0, 3, 2};
+
+// Modules left for data and error correction once the function patterns are
+// placed.
+int QrRawModules(int version) {
+  int modules = (16 * version + 128) * version + 64;
+  if (version >= 2) {
+    const int align = version / 7 + 2;
+    modules -= (25 * align - 10) * align - 55;
+    if (version >= 7) modules -= 36;
+  }
+  return modules;
+}
+
+int QrDataCodewords(int version, int ec) {
+  return QrRawModules(version) / 8 - kQrEccPerBlock[ec][version] * kQrBlocks[ec][version];
+}
+
+// GF(256) with the QR polynomial x^8 + x^4 + x^3 + x^2 + 1.
+struct GaloisTables {
+  std::array<uint8_t, 512> exp;
+  std::array<uint8_t, 256> log;
+
+  GaloisTables() {
+    int x = 1;
+    for (int i = 0; i < 255; ++i) {
+      exp[i] = static_cast<uint8_t>(x);
+      log[x] = static_cast<uint8_t>(i);
+      x <<= 1;
+      if (x & 0x100) x ^= 0x11D;
+    }
+    for (int i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+    log[0] = 0;
+  }
+
+  uint8_t Multiply(uint8_t a, uint8_t b) const {
+    return a == 0 || b == 0 ? 0 : exp[log[a] + log[b]];
+  }
+};
+
+const GaloisTables& Galois() {
+  static const GaloisTables tables;
+  return tables;
+}
+
+// Coefficients of the Reed-Solomon generator of |degree|, highest power
+// first with the leading 1 dropped.
+std::vector<uint8_t> ReedSolomonDivisor(int degree) {
+  const GaloisTables& gf = Galois();
+  std::vector<uint8_t> divisor(degree, 0);
+  divisor[degree - 1] = 1;
+  uint8_t root = 1;
+  for (int i = 0; i < degree; ++i) {
+    for (int j = 0; j < degree; ++j) {
+      divisor[j] = gf.Multiply(divisor[j], root);
+      if (j + 1 < degree) divisor[j] ^= divisor[j + 1];
+    }
+    root = gf.Multiply(root, 0x02);
+  }
+  return divisor;
+}
+
+void ReedSolomonRemainder(const uint8_t* data, size_t size, const std::vector<uint8_t>& divisor,
+                          uint8_t* out) {
+  const GaloisTables& gf = Galois();
+  const size_t degree = divisor.size();
+  std::memset(out, 0, degree);
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t factor = data[i] ^ out[0];
+    std::memmove(out, out + 1, degree - 1);
+    out[degree - 1] = 0;
+    if (factor == 0) continue;
+    const int log_factor = gf.log[factor];
+    for (size_t j = 0; j < degree; ++j) {
+      if (divisor[j] != 0) out[j] ^= gf.exp[gf.log[divisor[j]] + log_factor];
+    }
+  }
+}
+
+// Appends |count| low bits of |value| to a big-endian bit string.
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>* bytes) : bytes_(bytes) {}
+
+  void Append(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+      if (bits_ % 8 == 0) bytes_->push_back(0);
+      if ((value >> i) & 1) bytes_->back() |= static_cast<uint8_t>(0x80 >> (bits_ % 8));
+      ++bits_;
+    }
+  }
+  size_t bits() const { return bits_; }
+
+ private:
+  std::vector<uint8_t>* bytes_;
+  size_t bits_ = 0;
+};
+
+// One row or column of up to 177 modules as bits, module x at bit x % 64 of
+// word x / 64, so the penalty rules run 64 modules at a time.
+struct ModuleLine {
+  uint64_t words[3] = {0, 0, 0};
+
+  void Set(int x) { words[x >> 6] |= uint64_t{1} << (x & 63); }
+  int Count() const {
+    return static_cast<int>(std::bitset<64>(words[0]).count() + std::bitset<64>(words[1]).count() +
+                            std::bitset<64>(words[2]).count());
+  }
+  ModuleLine operator&(const ModuleLine& o) const {
+    return {{words[0] & o.words[0], words[1] & o.words[1], words[2] & o.words[2]}};
+  }
+  ModuleLine operator|(const ModuleLine& o) const {
+    return {{words[0] | o.words[0], words[1] | o.words[1], words[2] | o.words[2]}};
+  }
+  ModuleLine operator^(const ModuleLine& o) const {
+    return {{words[0] ^ o.words[0], words[1] ^ o.words[1], words[2] ^ o.words[2]}};
+  }
+  ModuleLine operator~() const { return {{~words[0], ~words[1], ~words[2]}}; }
+  // Module x moves to x + k (1 <= k < 64).
+  ModuleLine Up(int k) const {
+    return {{words[0] << k, words[1] << k | words[0] >> (64 - k),
+             words[2] << k | words[1] >> (64 - k)}};
+  }
+  // Module x moves to x - k (1 <= k < 64).
+  ModuleLine Down(int k) const {
+    return {{words[0] >> k | words[1] << (64 - k), words[1] >> k | words[2] << (64 - k),
+             words[2] >> k}};
+  }
+};
+
+// Modules [from, to) set.
+ModuleLine LineRange(int from, int to) {
+  ModuleLine line;
+  for (int x = from; x < to; ++x) line.Set(x);
+  return line;
+}
+
+// Runs of five or more modules (3 points plus one per extra module) and
+// 1:1:3:1:1 finder lookalikes with four light modules on one side (40 each).
+long LinePenalty(const ModuleLine& line, const ModuleLine& pairs, const ModuleLine& windows) {
+  // Modules equal to the one before, then those ending a run of five
+  const ModuleLine same = ~(line ^ line.Up(1)) & pairs;
+  const ModuleLine five = same & same.Up(1) & same.Up(2) & same.Up(3);
+  const ModuleLine first = five & ~five.Up(1);
+  long penalty = five.Count() + 2 * first.Count();
+
+  // Window modules first to last from the high bit down
+  constexpr uint16_t kLightThenFinder = 0x05D;  // 0000 1011101
+  constexpr uint16_t kFinderThenLight = 0x5D0;  // 1011101 0000
+  ModuleLine before = windows;
+  ModuleLine after = windows;
+  for (int k = 0; k < 11; ++k) {
+    const ModuleLine at = k == 0 ? line : line.Down(k);
+    before = before & ((kLightThenFinder >> (10 - k)) & 1 ? at : ~at);
+    after = after & ((kFinderThenLight >> (10 - k)) & 1 ? at : ~at);
+  }
+  // The two cannot start at the same module.
+  return penalty + 40 * (before | after).Count();
+}
+
+class QrBuilder {
+ public:
+  QrBuilder(int version, int ec)
+      : version_(version),
+        ec_(ec),
+        size_(version * 4 + 17),
+        modules_(static_cast<size_t>(size_) * size_, 0),
+        function_(modules_.size(), 0) {}
+
+  void DrawFunctionPatterns() {
+    for (int i = 0; i < size_; ++i) {
+      SetFunction(6, i, i % 2 == 0);
+      SetFunction(i, 6, i % 2 == 0);
+    }
+    DrawFinder(3, 3);
+    DrawFinder(size_ - 4, 3);
+    DrawFinder(3, size_ - 4);
+
+    const std::vector<int> align = AlignmentPositions();
+    const size_t count = align.size();
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t j = 0; j < count; ++j) {
+        // The three corners hold finders.
+        if ((i == 0 && j == 0) || (i == 0 && j == count - 1) || (i == count - 1 && j == 0)) {
+          continue;
+        }
+        DrawAlignment(align[i], align[j]);
+      }
+    }
+    // Reserve the format areas; the real bits go in once the mask is chosen.
+    DrawFormatBits(0);
+    DrawVersion();
+  }
+
+  // Places |codewords| in the zigzag order of ISO/IEC 18004 7.7.3.
+  void DrawCodewords(const std::vector<uint8_t>& codewords) {
+    const size_t total = codewords.size() * 8;
+    size_t i = 0;
+    for (int right = size_ - 1; right >= 1; right -= 2) {
+      if (right == 6) right = 5;
+      const bool upward = ((right + 1) & 2) == 0;
+      for (int vert = 0; vert < size_; ++vert) {
+        const int y = upward ? size_ - 1 - vert : vert;
+        for (int j = 0; j < 2; ++j) {
+          const int x = right - j;
+          if (function_[Index(x, y)] || i >= total) continue;
+          modules_[Index(x, y)] = (codewords[i >> 3] >> (7 - (i & 7))) & 1;
+          ++i;
+        }
+      }
+    }
+  }
+
+  // Replaces the data modules with |unmasked| XOR |mask|.
+  void ApplyMask(const std::vector<uint8_t>& unmasked, int mask) {
+    for (int y = 0; y < size_; ++y) {
+      const uint8_t* in = &unmasked[Index(0, y)];
+      const uint8_t* function = &function_[Index(0, y)];
+      uint8_t* out = &modules_[Index(0, y)];
+      // One pattern per row keeps the mask switch out of the inner loop.
+      auto apply = [&](auto invert) {
+        for (int x = 0; x < size_; ++x) {
+          out[x] = function[x] ? out[x] : in[x] ^ static_cast<uint8_t>(invert(x));
+        }
+      };
+      switch (mask) {
+        case 0: apply([y](int x) { return (x + y) % 2 == 0; }); break;
+        case 1: apply([y](int) { return y % 2 == 0; }); break;
+        case 2: apply([](int x) { return x % 3 == 0; }); break;
+        case 3: apply([y](int x) { return (x + y) % 3 == 0; }); break;
+        case 4: apply([y](int x) { return (x / 3 + y / 2) % 2 == 0; }); break;
+        case 5: apply([y](int x) { return x * y % 2 + x * y % 3 == 0; }); break;
+        case 6: apply([y](int x) { return (x * y % 2 + x * y % 3) % 2 == 0; }); break;
+        default: apply([y](int x) { return ((x + y) % 2 + x * y % 3) % 2 == 0; }); break;
+      }
+    }
+  }
+
+  const std::vector<uint8_t>& modules() const { return modules_; }
+
+  void DrawFormatBits(int mask) {
+    const int data = kQrFormatBits[ec_] << 3 | mask;
+    int rem = data;
+    for (int i = 0; i < 10; ++i) rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+    const int bits = (data << 10 | rem) ^ 0x5412;
+    auto bit = [bits](int i) { return ((bits >> i) & 1) != 0; };
+
+    // Around the top left finder
+    for (int i = 0; i <= 5; ++i) SetFunction(8, i, bit(i));
+    SetFunction(8, 7, bit(6));
+    SetFunction(8, 8, bit(7));
+    SetFunction(7, 8, bit(8));
+    for (int i = 9; i < 15; ++i) SetFunction(14 - i, 8, bit(i));
+    // Split between the other two
+    for (int i = 0; i < 8; ++i) SetFunction(size_ - 1 - i, 8, bit(i));
+    for (int i = 8; i < 15; ++i) SetFunction(8, size_ - 15 + i, bit(i));
+    SetFunction(8, size_ - 8, true);
+  }
+
+  // ISO/IEC 18004 7.8.3 penalty score of the current modules.
+  long Penalty() {
+    rows_.assign(size_, ModuleLine());
+    columns_.assign(size_, ModuleLine());
+    for (int y = 0; y < size_; ++y) {
+      const uint8_t* row = &modules_[Index(0, y)];
+      uint64_t* row_words = rows_[y].words;
+      const uint64_t column_bit = uint64_t{1} << (y & 63);
+      for (int x = 0; x < size_; ++x) {
+        row_words[x >> 6] |= uint64_t{row[x]} << (x & 63);
+        columns_[x].words[y >> 6] |= row[x] ? column_bit : 0;
+      }
+    }
+    // Where a module can follow another, and where 11-module windows start
+    const ModuleLine pairs = LineRange(1, size_);
+    const ModuleLine windows = LineRange(0, size_ - 10);
+    long penalty = 0;
+    long dark = 0;
+    for (int i = 0; i < size_; ++i) {
+      penalty += LinePenalty(rows_[i], pairs, windows) + LinePenalty(columns_[i], pairs, windows);
+      dark += rows_[i].Count();
+    }
+    // 2x2 blocks of one color: equal to the module below and both right
+    const ModuleLine lefts = LineRange(0, size_ - 1);
+    for (int y = 0; y + 1 < size_; ++y) {
+      const ModuleLine& top = rows_[y];
+      const ModuleLine& bottom = rows_[y + 1];
+      const ModuleLine block = ~(top ^ bottom) & ~(top ^ top.Down(1)) &
+                               ~(bottom ^ bottom.Down(1)) & lefts;
+      penalty += 3 * block.Count();
+    }
+    // Dark modules away from half
+    const long total = static_cast<long>(modules_.size());
+    const long k = (std::labs(dark * 20 - total * 10) + total - 1) / total - 1;
+    penalty += k * 10;
+    return penalty;
+  }
+
+  void TakeModules(QrCode* out) {
+    out->version = version_;
+    out->size = size_;
+    out->modules = std::move(modules_);
+  }
+
+ private:
+  size_t Index(int x, int y) const { return static_cast<size_t>(y) * size_ + x; }
+
+  void SetFunction(int x, int y, bool dark) {
+    modules_[Index(x, y)] = dark ? 1 : 0;
+    function_[Index(x, y)] = 1;
+  }
+
+  // Finder centred on (x, y) with its light separator.
+  void DrawFinder(int x, int y) {
+    for (int dy = -4; dy <= 4; ++dy) {
+      for (int dx = -4; dx <= 4; ++dx) {
+        const int xx = x + dx;
+        const int yy = y + dy;
+        if (xx < 0 || xx >= size_ || yy < 0 || yy >= size_) continue;
+        const int dist = std::max(std::abs(dx), std::abs(dy));
+        SetFunction(xx, yy, dist != 2 && dist != 4);
+      }
+    }
+  }
+
+  void DrawAlignment(int x, int y) {
+    for (int dy = -2; dy <= 2; ++dy) {
+      for (int dx = -2; dx <= 2; ++dx) {
+        SetFunction(x + dx, y + dy, std::max(std::abs(dx), std::abs(dy)) != 1);
+      }
+    }
+  }
+
+  std::vector<int> AlignmentPositions() const {
+    if (version_ == 1) return {};
+    const int count = version_ / 7 + 2;
+    const int step =
+        version_ == 32 ? 26 : (version_ * 4 + count * 2 + 1) / (count * 2 - 2) * 2;
+    std::vector<int> positions(count);
+    positions[0] = 6;
+    for (int i = count - 1, pos = size_ - 7; i >= 1; --i, pos -= step) positions[i] = pos;
+    return positions;
+  }
+
+  void DrawVersion() {
+    if (version_ < 7) return;
+    int rem = version_;
+    for (int i = 0; i < 12; ++i) rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+    const int bits = version_ << 12 | rem;
+    for (int i = 0; i < 18; ++i) {
+      const bool dark = ((bits >> i) & 1) != 0;
+      const int a = size_ - 11 + i % 3;
+      const int b = i / 3;
+      SetFunction(a, b, dark);
+      SetFunction(b, a, dark);
+    }
+  }
+
+  const int version_;
+  const int ec_;
+  const int size_;
+  std::vector<uint8_t> modules_;
+  std::vector<uint8_t> function_;
+  std::vector<ModuleLine> rows_;
+  std::vector<ModuleLine> columns_;
+};
+
+// Splits |data| into blocks, appends each block's error correction and
+// interleaves them (ISO/IEC 18004 7.6).
+std::vector<uint8_t> AddErrorCorrection(const std::vector<uint8_t>& data, int version, int ec) {
+  const int blocks = kQrBlocks[ec][version];
+  const int ecc_len = kQrEccPerBlock[ec][version];
+  const int raw = QrRawModules(version) / 8;
+  const int short_blocks = blocks - raw % blocks;
+  const int short_len = raw / blocks;
+  const std::vector<uint8_t> divisor = ReedSolomonDivisor(ecc_len);
+
+  // Each block padded to the long block length; short blocks skip the last
+  // data slot when interleaving.
+  std::vector<uint8_t> padded(static_cast<size_t>(blocks) * (short_len + 1), 0);
+  size_t k = 0;
+  for (int i = 0; i < blocks; ++i) {
+    const int data_len = short_len - ecc_len + (i < short_blocks ? 0 : 1);
+    uint8_t* block = &padded[static_cast<size_t>(i) * (short_len + 1)];
+    std::memcpy(block, &data[k], data_len);
+    ReedSolomonRemainder(block, data_len, divisor, block + short_len + 1 - ecc_len);
+    k += data_len;
+  }
+  std::vector<uint8_t> out;
+  out.reserve(raw);
+  for (int i = 0; i <= short_len; ++i) {
+    for (int j = 0; j < blocks; ++j) {
+      if (i == short_len - ecc_len && j < short_blocks) continue;
+      out.push_back(padded[static_cast<size_t>(j) * (short_len + 1) + i]);
+    }
+  }
+  return out;
+}
+
+// --- Code128 ---
+
+// Bar and space widths of each symbol value; 106 is the stop pattern with
+// its final bar.
+constexpr char kCode128Widths[107][8] = {
+    "212222", "222122", "222221", "121223", "121322", "131222", "122213", "122312", "132212",
+    "221213", "221312", "231212", "112232", "122132", "122231", "113222", "123122", "123221",
+    "223211", "221132", "221231", "213212", "223112", "312131", "311222", "321122", "321221",
+    "312212", "322112", "322211", "212123", "212321", "232121", "111323", "131123", "131321",
+    "112313", "132113", "132311", "211313", "231113", "231311", "112133", "112331", "132131",
+    "113123", "113321", "133121", "313121", "211331", "231131", "213113", "213311", "213131",
+    "311123", "311321", "331121", "312113", "312311", "332111", "314111", "221411", "431111",
+    "111224", "111422", "121124", "121421", "141122", "141221", "112214", "112412", "122114",
+    "122411", "142112", "142211", "241211", "221114", "413111", "241112", "134111", "111242",
+    "121142", "121241", "114212", "124112", "124211", "411212", "421112", "421211", "212141",
+    "214121", "412121", "111143", "111341", "131141", "114113", "114311", "411113", "411311",
+    "113141", "114131", "311141", "411131", "211412", "211214", "211232", "2331112",
+};
+
+constexpr uint8_t kCode128Shift = 98;
+constexpr uint8_t kCode128CodeC = 99;
+constexpr uint8_t kCode128CodeB = 100;
+constexpr uint8_t kCode128CodeA = 101;
+constexpr uint8_t kCode128StartA = 103;
+constexpr uint8_t kCode128Stop = 106;
+constexpr int kCode128QuietModules = 10;
+
+enum class CodeSet { kNone, kA, kB, kC };
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Code set A holds control characters, B lower case; both hold the rest of
+// printable ASCII.
+bool InSet(CodeSet set, uint8_t c) {
+  return set == CodeSet::kA ? c < 96 : c >= 32;
+}
+
+uint8_t ValueIn(CodeSet set, uint8_t c) {
+  return set == CodeSet::kA && c < 32 ? c + 64 : c - 32;
+}
+
+// A or B for the characters from |i|: whichever the first character only one
+// of them holds needs, B if none does.
+CodeSet PickTextSet(std::string_view data, size_t i) {
+  for (; i < data.size(); ++i) {
+    const uint8_t c = static_cast<uint8_t>(data[i]);
+    if (c < 32) return CodeSet::kA;
+    if (c >= 96) return CodeSet::kB;
+  }
+  return CodeSet::kB;
+}
+
+}  // namespace
+
+bool EncodeQrCode(std::string_view data, QrErrorCorrection ec_level, QrCode* out) {
+  const int ec = static_cast<int>(ec_level);
+  int version = 1;
+  for (;; ++version) {
+    if (version > 40) return false;
+    const size_t count_bits = version <= 9 ? 8 : 16;
+    if (4 + count_bits + data.size() * 8 <= static_cast<size_t>(QrDataCodewords(version, ec)) * 8) {
+      break;
+    }
+  }
+
+  // Byte mode segment, terminator, then pad bytes
+  const size_t capacity = static_cast<size_t>(QrDataCodewords(version, ec));
+  std::vector<uint8_t> codewords;
+  codewords.reserve(capacity);
+  BitWriter bits(&codewords);
+  bits.Append(0x4, 4);
+  bits.Append(static_cast<uint32_t>(data.size()), version <= 9 ? 8 : 16);
+  for (char c : data) bits.Append(static_cast<uint8_t>(c), 8);
+  bits.Append(0, static_cast<int>(std::min<size_t>(4, capacity * 8 - bits.bits())));
+  for (uint8_t pad = 0xEC; codewords.size() < capacity; pad ^= 0xEC ^ 0x11) {
+    codewords.push_back(pad);
+  }
+
+  QrBuilder builder(version, ec);
+  builder.DrawFunctionPatterns();
+  builder.DrawCodewords(AddErrorCorrection(codewords, version, ec));
+  const std::vector<uint8_t> unmasked = builder.modules();
+  int best_mask = 0;
+  long best_penalty = -1;
+  for (int mask = 0; mask < 8; ++mask) {
+    builder.ApplyMask(unmasked, mask);
+    builder.DrawFormatBits(mask);
+    const long penalty = builder.Penalty();
+    if (best_penalty < 0 || penalty < best_penalty) {
+      best_mask = mask;
+      best_penalty = penalty;
+    }
+  }
+  builder.ApplyMask(unmasked, best_mask);
+  builder.DrawFormatBits(best_mask);
+  builder.TakeModules(out);
+  return true;
+}
+
+MonoBitmap QrBitmap(const QrCode& qr, int module_dots) {
+  constexpr int kQuietModules = 4;
+  MonoBitmap bitmap;
+  if (qr.size <= 0 || module_dots <= 0) return bitmap;
+  const int modules = qr.size + 2 * kQuietModules;
+  bitmap.width = modules * module_dots;
+  bitmap.height = bitmap.width;
+  bitmap.bytes_per_row = (bitmap.width + 7) / 8;
+  bitmap.bits.assign(static_cast<size_t>(bitmap.bytes_per_row) * bitmap.height, 0);
+  for (int y = 0; y < qr.size; ++y) {
+    // Pack one row of modules, then copy it down for the module height.
+    uint8_t* row = &bitmap.bits[static_cast<size_t>(kQuietModules + y) * module_dots *
+                                bitmap.bytes_per_row];
+    for (int x = 0; x < qr.size; ++x) {
+      if (!qr.dark(x, y)) continue;
+      const int left = (kQuietModules + x) * module_dots;
+      for (int dot = left; dot < left + module_dots; ++dot) {
+        row[dot >> 3] |= static_cast<uint8_t>(0x80 >> (dot & 7));
+      }
+    }
+    for (int r = 1; r < module_dots; ++r) {
+      std::memcpy(row + static_cast<size_t>(r) * bitmap.bytes_per_row, row,
+                  bitmap.bytes_per_row);
+    }
+  }
+  return bitmap;
+}
+
+bool EncodeCode128(std::string_view data, std::vector<uint8_t>* symbols) {
+  symbols->clear();
+  if (data.empty()) return false;
+  for (char c : data) {
+    if (static_cast<uint8_t>(c) > 0x7F) return false;
+  }
+
+  CodeSet set = CodeSet::kNone;
+  auto switch_to = [&](CodeSet next) {
+    if (set == next) return;
+    if (set == CodeSet::kNone) {
+      symbols->push_back(static_cast<uint8_t>(kCode128StartA + static_cast<int>(next) - 1));
+    } else {
+      symbols->push_back(next == CodeSet::kA   ? kCode128CodeA
+                         : next == CodeSet::kB ? kCode128CodeB
+                                               : kCode128CodeC);
+    }
+    set = next;
+  };
+
+  const size_t n = data.size();
+  for (size_t i = 0; i < n;) {
+    size_t run = 0;
+    while (i + run < n && IsDigit(data[i + run])) ++run;
+    // Set C pays off for four digits at either end (or an even all-digit
+    // string), six in the middle where it costs two switches.
+    const bool at_end = i == 0 || i + run == n;
+    if (run >= (at_end ? 4 : 6) || (run == n && run % 2 == 0)) {
+      switch_to(CodeSet::kC);
+      for (; run >= 2; run -= 2, i += 2) {
+        symbols->push_back(static_cast<uint8_t>((data[i] - '0') * 10 + (data[i + 1] - '0')));
+      }
+      continue;
+    }
+
+    const uint8_t c = static_cast<uint8_t>(data[i]);
+    if (set == CodeSet::kNone || set == CodeSet::kC) {
+      switch_to(PickTextSet(data, i));
+    } else if (!InSet(set, c)) {
+      // Shift for a single character the other set holds.
+      const bool next_fits = i + 1 >= n || InSet(set, static_cast<uint8_t>(data[i + 1]));
+      const CodeSet other = set == CodeSet::kA ? CodeSet::kB : CodeSet::kA;
+      if (next_fits && i + 1 < n) {
+        symbols->push_back(kCode128Shift);
+        symbols->push_back(ValueIn(other, c));
+        ++i;
+        continue;
+      }
+      switch_to(other);
+    }
+    symbols->push_back(ValueIn(set, c));
+    ++i;
+  }
+
+  int checksum = (*symbols)[0];
+  for (size_t i = 1; i < symbols->size(); ++i) {
+    checksum += static_cast<int>(i) * (*symbols)[i];
+  }
+  symbols->push_back(static_cast<uint8_t>(checksum % 103));
+  symbols->push_back(kCode128Stop);
+  return true;
+}
+
+int Code128Modules(const std::vector<uint8_t>& symbols) {
+  if (symbols.empty()) return 0;
+  // Every symbol is 11 modules; the stop pattern's final bar adds two.
+  return static_cast<int>(symbols.size()) * 11 + 2 + 2 * kCode128QuietModules;
+}
+
+MonoBitmap Code128Bitmap(const std::vector<uint8_t>& symbols, int module_dots, int height) {
+  MonoBitmap bitmap;
+  if (symbols.empty() || module_dots <= 0 || height <= 0) return bitmap;
+  bitmap.width = Code128Modules(symbols) * module_dots;
+  bitmap.height = height;
+  bitmap.bytes_per_row = (bitmap.width + 7) / 8;
+  bitmap.bits.assign(static_cast<size_t>(bitmap.bytes_per_row) * height, 0);
+
+  uint8_t* row = bitmap.bits.data();
+  int dot = kCode128QuietModules * module_dots;
+  for (uint8_t symbol : symbols) {
+    bool bar = true;
+    for (const char* w = kCode128Widths[std::min<uint8_t>(symbol, kCode128Stop)]; *w; ++w) {
+      const int end = dot + (*w - '0') * module_dots;
+      if (bar) {
+        for (; dot < end; ++dot) row[dot >> 3] |= static_cast<uint8_t>(0x80 >> (dot & 7));
+      }
+      dot = end;
+      bar = !bar;
+    }
+  }
+  for (int y = 1; y < height; ++y) {
+    std::memcpy(row + static_cast<size_t>(y) * bitmap.bytes_per_row, row, bitmap.bytes_per_row);
+  }
+  return bitmap;
+}
+
+}  // namespace printer_core
@@ -0,0 +1,48 @@
+#ifndef PRINTER_CORE_SYMBOLOGY_H_
+#define PRINTER_CORE_SYMBOLOGY_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "logo_raster.h"
+
+namespace printer_core {
+
+// Software QR code and Code128 encoders for printers that ignore GS ( k and
+// GS k. Symbols render to a MonoBitmap that goes out as raster bands.
+
+enum class QrErrorCorrection { kLow, kMedium, kQuartile, kHigh };
+
+// A QR code symbol without its quiet zone; one byte per module, 1 is dark.
+struct QrCode {
+  int version = 0;
+  int size = 0;
+  std::vector<uint8_t> modules;
+
+  bool dark(int x, int y) const { return modules[static_cast<size_t>(y) * size + x] != 0; }
+};
+
+// Encodes |data| in byte mode at the smallest version (1-40) that holds it
+// with |ec|, choosing the mask with the lowest penalty. False if it does not
+// fit in version 40.
+bool EncodeQrCode(std::string_view data, QrErrorCorrection ec, QrCode* out);
+
+// |qr| with a four-module quiet zone, each module |module_dots| square.
+MonoBitmap QrBitmap(const QrCode& qr, int module_dots);
+
+// Code128 symbol values for |data|: start code, data, checksum and stop code.
+// Switches between code sets A, B and C so digit runs pack two to a symbol.
+// False if |data| is empty or has bytes above 0x7F.
+bool EncodeCode128(std::string_view data, std::vector<uint8_t>* symbols);
+
+// Bars for |symbols| with a ten-module quiet zone on each side, each module
+// |module_dots| wide and |height| rows tall.
+MonoBitmap Code128Bitmap(const std::vector<uint8_t>& symbols, int module_dots, int height);
+
+// Width in modules of the bars for |symbols|, quiet zones included.
+int Code128Modules(const std::vector<uint8_t>& symbols);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_SYMBOLOGY_H_
@@ -0,0 +1,96 @@
+#include "batch_encoder.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+TEST(BatchEncoderTest, MatchesSingleEncoderInInputOrder) {
+  std::vector<std::string> names;
+  for (int i = 0; i < 100; ++i) names.push_back("Item " + std::to_string(i));
+  std::vector<ReceiptDocument> receipts(names.size());
+  std::vector<BatchDocument> documents;
+  for (size_t i = 0; i < names.size(); ++i) {
+    receipts[i].title = names[i];
+    receipts[i].items.push_back(ReceiptItem{names[i], static_cast<int>(i % 3) + 1, 1.5 * i});
+    receipts[i].total = 1.5 * i;
+    BatchDocument document;
+    document.receipt = &receipts[i];
+    document.chars_per_line = i % 2 ? 32 : 48;
+    documents.push_back(document);
+  }
+  BatchDocument text;
+  text.text = "Thanks\nTotal RM 1.00\n";
+  documents.push_back(text);
+  BatchDocument raw;
+  raw.text = "\x1B@raw";
+  raw.text_mode = BatchText::kRaw;
+  documents.push_back(raw);
+
+  const std::vector<std::vector<uint8_t>> encoded = EncodeBatch(documents, 4);
+  ASSERT_EQ(documents.size(), encoded.size());
+  for (size_t i = 0; i < receipts.size(); ++i) {
+    EscPosEncoder encoder(documents[i].chars_per_line);
+    EXPECT_EQ(encoder.EncodeReceipt(receipts[i]), encoded[i]) << "document " << i;
+  }
+  EscPosEncoder encoder;
+  EXPECT_EQ(encoder.EncodeText(text.text), encoded[receipts.size()]);
+  EXPECT_EQ(std::vector<uint8_t>({0x1B, '@', 'r', 'a', 'w'}), encoded.back());
+}
+
+// What printReceipt encodes for each kind of receiptData, with its one
+// long-lived encoder.
+TEST(BatchEncoderTest, MatchesPrintReceiptEncoding) {
+  PrinterProfile profile;
+  profile.code_page = CodePage::kCp858;
+  profile.native_qr = false;
+  profile.dots_per_line = 384;
+  StoreSettings store;
+  store.header_lines = {"Kedai Caf\xC3\xA9", "Jalan 1"};
+  store.footer_lines = {"Terima kasih"};
+  ReceiptDocument receipt;
+  receipt.title = "Caf\xC3\xA9";
+  receipt.items.push_back(ReceiptItem{"Cr\xC3\xA8me br\xC3\xBBl\xC3\xA9" "e", 2, 7.5});
+  receipt.total = 15.0;
+  receipt.qr_data = "order:42";
+  const std::vector<ReceiptRow> rows = {{"Caf\xC3\xA9 au lait", "RM 6.00"},
+                                        {"", "", RowAlign::kLeft, false, '-'}};
+  const std::string content = "Re\xC3\xA7u\n\x1B" "E\x01Total\x1B" "E\x00 RM 15.00\n";
+
+  std::vector<BatchDocument> documents(4);
+  for (BatchDocument& document : documents) {
+    document.chars_per_line = 32;
+    document.profile = profile;
+  }
+  documents[0].receipt = &receipt;
+  documents[0].store = store;
+  documents[1].rows = &rows;
+  documents[2].text = content;
+  documents[2].text_mode = BatchText::kPreformatted;
+  documents[3].receipt = &receipt;
+  documents[3].store = store;
+  const std::vector<std::vector<uint8_t>> encoded = EncodeBatch(documents, 2);
+
+  EscPosEncoder encoder(48);
+  auto print_receipt = [&]() {
+    encoder.set_chars_per_line(32);
+    encoder.set_profile(profile);
+    encoder.set_store(store);
+    return encoder.EncodeReceipt(receipt);
+  };
+  ASSERT_EQ(4u, encoded.size());
+  EXPECT_EQ(print_receipt(), encoded[0]);
+  EXPECT_EQ(encoder.EncodeRows(rows), encoded[1]);
+  EXPECT_EQ(encoder.EncodeRawText(content), encoded[2]);
+  EXPECT_EQ(print_receipt(), encoded[3]);
+}
+
+TEST(BatchEncoderTest, HandlesEmptyBatch) {
+  EXPECT_TRUE(EncodeBatch({}).empty());
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,113 @@
+#include "code_page.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+using namespace std::string_literals;
+
+std::string Transcode(CodePageTranscoder& transcoder, const std::string& utf8) {
+  std::vector<uint8_t> out;
+  transcoder.Append(utf8, &out);
+  return std::string(out.begin(), out.end());
+}
+
+TEST(CodePageTest, ParsesCodePages) {
+  CodePage page = CodePage::kNone;
+  EXPECT_TRUE(ParseCodePage("cp858", &page));
+  EXPECT_EQ(page, CodePage::kCp858);
+  EXPECT_TRUE(ParseCodePage("big5", &page));
+  EXPECT_EQ(page, CodePage::kBig5);
+  EXPECT_TRUE(ParseCodePage("none", &page));
+  EXPECT_EQ(page, CodePage::kNone);
+  EXPECT_FALSE(ParseCodePage("utf8", &page));
+}
+
+TEST(CodePageTest, PassesAsciiThrough) {
+  CodePageTranscoder transcoder;
+  const std::string ascii = "\x1B\x61\x01Nasi Lemak Special x2      RM 17.00\n";
+  EXPECT_EQ(Transcode(transcoder, ascii), ascii);
+  EXPECT_EQ(Transcode(transcoder, ""), "");
+}
+
+TEST(CodePageTest, SelectsTableOnlyWhenItChanges) {
+  CodePageTranscoder transcoder(CodePage::kCp437);
+  // Long enough that the accents fall after a 16-byte ASCII chunk
+  EXPECT_EQ(Transcode(transcoder, "Kopi O Kosong + Caf\xC3\xA9 cr\xC3\xA8me"),
+            "Kopi O Kosong + Caf\x1Bt\x00\x82 cr\x8Ame"s);
+  EXPECT_EQ(Transcode(transcoder, "na\xC3\xAFve"), "na\x8Bve");
+  // ESC @ restores the printer's own default, so select again.
+  transcoder.Reset();
+  EXPECT_EQ(Transcode(transcoder, "\xC3\xA9"), "\x1Bt\x00\x82"s);
+}
+
+TEST(CodePageTest, FallsBackToTablesThatHaveTheCharacter) {
+  CodePageTranscoder transcoder(CodePage::kCp437);
+  // The euro sign is in CP858, which also has e-acute; the quote is only in
+  // CP1252.
+  EXPECT_EQ(Transcode(transcoder, "\xE2\x82\xAC" "5 \xC3\xA9 \xE2\x80\x98"),
+            "\x1Bt\x13\xD5" "5 \x82 \x1Bt\x10\x91");
+  // Characters no table has print as '?'.
+  EXPECT_EQ(Transcode(transcoder, "\xE4\xB8\xAD"), "?");
+  // Combining marks take no column, so they are dropped rather than printed.
+  EXPECT_EQ(Transcode(transcoder, "e\xCC\x81\xE2\x80\x8D"), "e");
+}
+
+TEST(CodePageTest, EncodesChineseInDoubleByteMode) {
+  CodePageTranscoder transcoder(CodePage::kCp437, CodePage::kGb18030);
+  // Kanji mode for the Chinese, then out of it before a byte above 0x7F
+  EXPECT_EQ(Transcode(transcoder, "\xE4\xB8\xAD\xE6\x96\x87 caf\xC3\xA9 \xE4\xB8\xAD"),
+            "\x1C&\xD6\xD0\xCE\xC4 caf\x1C.\x1Bt\x00\x82 \x1C&\xD6\xD0"s);
+
+  transcoder.set_pages(CodePage::kCp437, CodePage::kBig5);
+  EXPECT_EQ(Transcode(transcoder, "\xE4\xB8\xAD"), "\x1C&\xA4\xA4");
+  // Not in Big5
+  EXPECT_EQ(Transcode(transcoder, "\xF0\x9F\x98\x80"), "?");
+}
+
+TEST(CodePageTest, ReplacesMalformedUtf8) {
+  CodePageTranscoder transcoder;
+  // Truncated, overlong, surrogate, stray continuation, past U+10FFFF
+  EXPECT_EQ(Transcode(transcoder, "a\xC3"), "a?");
+  EXPECT_EQ(Transcode(transcoder, "\xC0\xAF" "b"), "??b");
+  EXPECT_EQ(Transcode(transcoder, "\xED\xA0\x80"), "???");
+  EXPECT_EQ(Transcode(transcoder, "\x80" "c"), "?c");
+  EXPECT_EQ(Transcode(transcoder, "\xF4\x90\x80\x80"), "????");
+}
+
+TEST(CodePageTest, DecodesPrintedBytes) {
+  EXPECT_EQ(CodePageForEscT(19), CodePage::kCp858);
+  EXPECT_EQ(CodePageForEscT(99), CodePage::kNone);
+
+  std::string utf8;
+  CodePageDecoder::AppendSingleByte(CodePage::kCp858, 0xD5, &utf8);   // euro sign
+  CodePageDecoder::AppendSingleByte(CodePage::kCp1252, 0x81, &utf8);  // unassigned
+  CodePageDecoder::AppendSingleByte(CodePage::kNone, 'a', &utf8);
+  EXPECT_EQ(utf8, "\xE2\x82\xAC" "\xEF\xBF\xBD" "a");
+
+  CodePageDecoder decoder(CodePage::kGb18030);
+  const uint8_t four[] = {0x81, 0x30, 0x81, 0x30};
+  EXPECT_EQ(decoder.DoubleByteLength(four, 4), 4u);
+  EXPECT_EQ(decoder.DoubleByteLength(four, 3), 0u);
+  utf8.clear();
+  decoder.AppendDoubleByte("\xD6\xD0", &utf8);
+  decoder.AppendDoubleByte(std::string_view("\x81\x30\x81\x30", 4), &utf8);
+  EXPECT_EQ(utf8, "\xE4\xB8\xAD" "\xC2\x80");
+}
+
+TEST(CodePageTest, StaysWithinTheExpansionBound) {
+  // Every character forces a table switch and leaves double-byte mode.
+  CodePageTranscoder transcoder(CodePage::kCp437, CodePage::kGb18030);
+  std::string worst;
+  for (int i = 0; i < 50; ++i) worst += "\xC3\xA9\xE4\xB8\xAD\xE2\x80\x98";
+  std::vector<uint8_t> out;
+  transcoder.Append(worst, &out);
+  EXPECT_LE(out.size(), kTranscodeMaxExpansion * worst.size());
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,133 @@
+#include "connection_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "print_job_queue.h"
+#include "test/loopback_printer.h"
+
+namespace printer_core {
+namespace {
+
+using testing::LoopbackPrinter;
+
+ConnectionPoolOptions ManualOptions() {
+  ConnectionPoolOptions options;
+  options.maintenance_interval_ms = 0;
+  return options;
+}
+
+bool WriteJob(ConnectionPool* pool, uint16_t port, const std::string& payload) {
+  std::string error;
+  std::unique_ptr<PrinterTransport> transport =
+      pool->Acquire(PrinterTarget::Network("127.0.0.1", port), &error);
+  if (!transport) return false;
+  return transport->Write(reinterpret_cast<const uint8_t*>(payload.data()),
+                          payload.size(), &error);
+}
+
+std::string Received(const LoopbackPrinter& printer) {
+  const std::vector<uint8_t> bytes = printer.received();
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(ConnectionPoolTest, ReusesConnectionForSamePrinter) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  ConnectionPool pool(ManualOptions());
+
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "one;"));
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "two;"));
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "three;"));
+
+  ASSERT_TRUE(printer.WaitForBytes(14));
+  EXPECT_EQ("one;two;three;", Received(printer));
+  EXPECT_EQ(1u, printer.accepted());
+  const ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(2u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.idle);
+}
+
+TEST(ConnectionPoolTest, ReconnectsAfterPrinterClosedIdleSocket) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  ConnectionPool pool(ManualOptions());
+
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "before;"));
+  ASSERT_TRUE(printer.WaitForBytes(7));
+  printer.DropConnections();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "after;"));
+  ASSERT_TRUE(printer.WaitForBytes(13));
+  EXPECT_EQ("before;after;", Received(printer));
+  EXPECT_EQ(2u, printer.accepted());
+  const ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(1u, stats.health_failures);
+  EXPECT_EQ(2u, stats.misses);
+}
+
+TEST(ConnectionPoolTest, MaintenanceReapsTimedOutSockets) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  ConnectionPoolOptions options = ManualOptions();
+  options.idle_timeout_ms = 20;
+  ConnectionPool pool(options);
+
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "x"));
+  EXPECT_EQ(1u, pool.stats().idle);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  pool.RunMaintenance();
+
+  const ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(1u, stats.reaped);
+  EXPECT_EQ(0u, stats.idle);
+}
+
+TEST(ConnectionPoolTest, MaintenanceDropsSocketsClosedByPrinter) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  ConnectionPool pool(ManualOptions());
+
+  ASSERT_TRUE(WriteJob(&pool, printer.port(), "x"));
+  ASSERT_TRUE(printer.WaitForBytes(1));
+  printer.DropConnections();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pool.RunMaintenance();
+
+  const ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(1u, stats.health_failures);
+  EXPECT_EQ(0u, stats.idle);
+}
+
+TEST(ConnectionPoolTest, ServesPrintJobQueueWithOneConnection) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  ConnectionPool pool(ManualOptions());
+  std::string expected;
+  {
+    PrintJobQueue queue(2, [&pool](const PrinterTarget& target, std::string* error) {
+      return pool.Acquire(target, error);
+    });
+    for (int i = 0; i < 10; ++i) {
+      const std::string payload = "job" + std::to_string(i) + ";";
+      expected += payload;
+      queue.Submit(PrintJob{PrinterTarget::Network("127.0.0.1", printer.port()),
+                            std::vector<uint8_t>(payload.begin(), payload.end())},
+                   nullptr);
+    }
+    queue.Shutdown();
+  }
+  ASSERT_TRUE(printer.WaitForBytes(expected.size()));
+  EXPECT_EQ(expected, Received(printer));
+  EXPECT_EQ(1u, printer.accepted());
+  EXPECT_EQ(9u, pool.stats().hits);
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,89 @@
+#include "device_discovery.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "print_job_queue.h"
+
+namespace printer_core {
+namespace {
+
+// A scratch directory removed with its files at the end of the test.
+class TempDir {
+ public:
+  TempDir() {
+    char path[] = "/tmp/printer_core_XXXXXX";
+    path_ = mkdtemp(path) ? path : "";
+  }
+  ~TempDir() {
+    for (const std::string& file : files_) unlink(file.c_str());
+    rmdir(path_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+  std::string Touch(const std::string& name) {
+    const std::string file = path_ + "/" + name;
+    if (FILE* f = std::fopen(file.c_str(), "w")) std::fclose(f);
+    files_.push_back(file);
+    return file;
+  }
+
+ private:
+  std::string path_;
+  std::vector<std::string> files_;
+};
+
+std::string ReadFile(const std::string& path) {
+  std::string data;
+  if (FILE* f = std::fopen(path.c_str(), "rb")) {
+    char buf[256];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+    std::fclose(f);
+  }
+  return data;
+}
+
+TEST(DeviceDiscoveryTest, ListsLinePrintersInNumericOrder) {
+  TempDir dir;
+  ASSERT_FALSE(dir.path().empty());
+  dir.Touch("lp10");
+  dir.Touch("lp2");
+  dir.Touch("lp0");
+  dir.Touch("lpx");
+  dir.Touch("hiddev0");
+
+  const std::vector<std::string> expected = {
+      dir.path() + "/lp0", dir.path() + "/lp2", dir.path() + "/lp10"};
+  EXPECT_EQ(expected, ListLinePrinterDevices(dir.path()));
+  EXPECT_TRUE(IsDeviceWritable(dir.path() + "/lp0"));
+  EXPECT_FALSE(IsDeviceWritable(dir.path() + "/lp7"));
+}
+
+TEST(DeviceDiscoveryTest, MissingDirectoryHasNoDevices) {
+  EXPECT_TRUE(ListLinePrinterDevices("/nonexistent/printer_core").empty());
+}
+
+TEST(DeviceDiscoveryTest, DeviceJobsWriteRawBytes) {
+  TempDir dir;
+  const std::string device = dir.Touch("lp0");
+  {
+    PrintJobQueue queue(1);
+    queue.Submit(PrintJob{PrinterTarget::Device(device), {0x1B, '@', 'h', 'i', '\n'}},
+                 nullptr);
+    queue.Submit(PrintJob{PrinterTarget::Device(device), {0x1D, 'V', 'B', 0}},
+                 nullptr);
+    queue.Shutdown();
+  }
+  EXPECT_EQ(std::string("\x1B@hi\n\x1DVB", 8) + '\0', ReadFile(device));
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,268 @@
+#include "escpos_encoder.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "legacy_encoder.h"
+#include "symbology.h"
+
+namespace printer_core {
+namespace {
+
+using namespace std::string_literals;
+using testing::LegacyEncode;
+
+ReceiptDocument SampleReceipt() {
+  ReceiptDocument doc;
+  doc.title = "EXTROPOS CAFE";
+  doc.items = {
+      {"Nasi Lemak", 2, 8.5},
+      {"Teh Tarik", 1, 3.2},
+      {"A very long item name that will certainly not fit on one line", 3, 12.99},
+      {"Refund", -1, 4.0},
+  };
+  doc.subtotal = 45.17;
+  doc.tax = 2.71;
+  doc.service_charge = 4.52;
+  doc.total = 52.4;
+  doc.barcode = "INV-000123";
+  doc.qr_data = "https://myinvois.hasil.gov.my/abc";
+  return doc;
+}
+
+std::string AsString(const std::vector<uint8_t>& bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(FormatMoneyTest, FormatsWithTwoDecimals) {
+  char buf[64];
+  EXPECT_EQ("RM 0.00", std::string(buf, FormatMoney("RM", 0.0, buf)));
+  EXPECT_EQ("RM 12.50", std::string(buf, FormatMoney("RM", 12.5, buf)));
+  EXPECT_EQ("$ 1234567.89", std::string(buf, FormatMoney("$", 1234567.891, buf)));
+  EXPECT_EQ("RM -4.05", std::string(buf, FormatMoney("RM", -4.05, buf)));
+  EXPECT_EQ(" 0.10", std::string(buf, FormatMoney("", 0.1, buf)));
+}
+
+TEST(EscPosEncoderTest, MatchesLegacyBuilderOn80mm) {
+  const ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(48);
+  EXPECT_EQ(AsString(LegacyEncode(doc, 48)),
+            AsString(encoder.EncodeReceipt(doc)));
+}
+
+TEST(EscPosEncoderTest, MatchesLegacyBuilderOn58mm) {
+  const ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(32);
+  EXPECT_EQ(AsString(LegacyEncode(doc, 32)),
+            AsString(encoder.EncodeReceipt(doc)));
+}
+
+TEST(EscPosEncoderTest, OmitsMissingOptionalSections) {
+  ReceiptDocument doc;
+  doc.items = {{"Kopi", 1, 2.0}};
+  EscPosEncoder encoder(48);
+  EXPECT_EQ(AsString(LegacyEncode(doc, 48)),
+            AsString(encoder.EncodeReceipt(doc)));
+}
+
+TEST(EscPosEncoderTest, MeasureIsAnUpperBound) {
+  ReceiptDocument doc = SampleReceipt();
+  for (int cpl : {0, 8, 32, 42, 48, 64}) {
+    EscPosEncoder encoder(cpl);
+    EXPECT_LE(encoder.EncodeReceipt(doc).size(),
+              EscPosEncoder::MeasureReceipt(doc, cpl));
+  }
+}
+
+TEST(EscPosEncoderTest, ReusesBufferAcrossReceipts) {
+  const ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(48);
+  const uint8_t* first = encoder.EncodeReceipt(doc).data();
+  const uint8_t* second = encoder.EncodeReceipt(doc).data();
+  EXPECT_EQ(first, second);
+}
+
+TEST(EscPosEncoderTest, PrintsStoreLines) {
+  const ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(48);
+  StoreSettings store;
+  store.header_lines = {"Jalan Ampang 12", "Tel 03-1234 5678"};
+  store.footer_lines = {"Terima kasih"};
+  encoder.set_store(store);
+
+  std::string expected = AsString(LegacyEncode(doc, 48));
+  const std::string title = "EXTROPOS CAFE\n";
+  expected.insert(expected.find(title) + title.size(), "Jalan Ampang 12\nTel 03-1234 5678\n");
+  const std::string closing = std::string(48, '=') + "\n";
+  expected.insert(expected.rfind(closing) + closing.size(), "\x1B\x61\x01Terima kasih\n");
+  EXPECT_EQ(expected, AsString(encoder.EncodeReceipt(doc)));
+
+  // Footer text selects its table whatever the items left selected.
+  PrinterProfile profile;
+  profile.chinese_code_page = CodePage::kGb18030;
+  encoder.set_profile(profile);
+  store.footer_lines = {"Caf\xC3\xA9"};
+  encoder.set_store(store);
+  ReceiptDocument chinese;
+  chinese.items = {{"\xE4\xB8\xAD", 1, 1.0}};
+  const std::string bytes = AsString(encoder.EncodeReceipt(chinese));
+  EXPECT_NE(bytes.find("\x1C&\xD6\xD0"), std::string::npos);
+  EXPECT_NE(bytes.find("\x1B\x61\x01" "Caf\x1C.\x1Bt\x00\x82\n"s), std::string::npos);
+}
+
+TEST(EscPosEncoderTest, RecompilesTemplateOnlyWhenSettingsChange) {
+  ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(48);
+  encoder.EncodeReceipt(doc);
+  encoder.EncodeReceipt(doc);
+  // Runners set the same width and profile before every receipt.
+  encoder.set_chars_per_line(48);
+  encoder.set_profile(PrinterProfile());
+  encoder.set_store(StoreSettings());
+  EXPECT_EQ(AsString(LegacyEncode(doc, 48)), AsString(encoder.EncodeReceipt(doc)));
+  EXPECT_EQ(1u, encoder.templates_compiled());
+
+  encoder.set_chars_per_line(32);
+  EXPECT_EQ(AsString(LegacyEncode(doc, 32)), AsString(encoder.EncodeReceipt(doc)));
+  EXPECT_EQ(2u, encoder.templates_compiled());
+
+  StoreSettings store;
+  store.footer_lines = {"Thank you"};
+  encoder.set_store(store);
+  EXPECT_NE(AsString(encoder.EncodeReceipt(doc)).find("Thank you\n"), std::string::npos);
+  EXPECT_EQ(3u, encoder.templates_compiled());
+
+  doc.title = "EXTROPOS BAR";
+  EXPECT_NE(AsString(encoder.EncodeReceipt(doc)).find("EXTROPOS BAR\n"), std::string::npos);
+  doc.title.reset();
+  EXPECT_EQ(std::string::npos, AsString(encoder.EncodeReceipt(doc)).find("EXTROPOS"));
+  EXPECT_EQ(5u, encoder.templates_compiled());
+}
+
+TEST(EscPosEncoderTest, RastersSymbolsThePrinterCannotPrint) {
+  const ReceiptDocument doc = SampleReceipt();
+  EscPosEncoder encoder(48);
+  PrinterProfile profile;
+  profile.native_qr = false;
+  profile.native_code128 = false;
+  encoder.set_profile(profile);
+  const std::string raster = AsString(encoder.EncodeReceipt(doc));
+  EXPECT_EQ(raster.find("\x1D\x28\x6B"), std::string::npos);
+  EXPECT_EQ(raster.find("\x1D\x6B\x49"), std::string::npos);
+
+  // Everything before the symbols is unchanged.
+  const std::string native = AsString(LegacyEncode(doc, 48));
+  const size_t symbols = native.find("\x1B\x61\x01\x1D\x48");
+  ASSERT_NE(symbols, std::string::npos);
+  EXPECT_EQ(raster.substr(0, symbols), native.substr(0, symbols));
+
+  // Code128 bars two dots a module, 80 rows, then the text beneath. Two
+  // bytes of each 20-dot quiet zone are left to the paper.
+  std::vector<uint8_t> code128;
+  ASSERT_TRUE(EncodeCode128(doc.barcode, &code128));
+  const int width = (Code128Modules(code128) * 2 + 7) / 8 - 4;
+  const std::string bars = "\x1B\x61\x01\x1D\x76\x30\x00"s +
+                           static_cast<char>(width) + "\x00\x50\x00"s;
+  EXPECT_EQ(raster.substr(symbols, bars.size()), bars);
+  EXPECT_NE(raster.find("INV-000123\n", symbols), std::string::npos);
+  EXPECT_NE(raster.find("\x1D\x76\x30", symbols + bars.size()), std::string::npos);
+
+  // Symbols the software encoders cannot draw keep the printer's command.
+  ReceiptDocument accented = doc;
+  accented.barcode = "caf\xC3\xA9";
+  EXPECT_NE(AsString(encoder.EncodeReceipt(accented)).find("\x1D\x6B\x49"), std::string::npos);
+}
+
+TEST(EscPosEncoderTest, EncodesTextWithPriceLinesLeftAligned) {
+  EscPosEncoder encoder;
+  const std::string expected =
+      "\x1B\x40"
+      "\x1B\x61\x01" "Header\n"
+      "\x1B\x61\x01" "\n"
+      "\x1B\x61\x00" "Coffee RM 3.00\n"
+      "\n\x1D\x56\x42\x00"s;
+  EXPECT_EQ(expected,
+            AsString(encoder.EncodeText("Header\n\nCoffee RM 3.00\n")));
+}
+
+TEST(EscPosEncoderTest, EncodesTextForSpoolerPrinters) {
+  EscPosEncoder encoder;
+  TextOptions options;
+  options.align_blank_lines = false;
+  options.feed_before_cut = false;
+  const std::string expected =
+      "\x1B\x40"
+      "\x1B\x61\x01" "Header\n"
+      "\n"
+      "\x1B\x61\x00" "Total $5\n"
+      "\x1D\x56\x42\x00"s;
+  EXPECT_EQ(expected,
+            AsString(encoder.EncodeText("Header\n\nTotal $5", options)));
+}
+
+TEST(EscPosEncoderTest, TranscodesTextToTheCodePage) {
+  ReceiptDocument doc;
+  doc.title = "CAF\xC3\x89 \xE4\xB8\xAD";
+  doc.items = {{"Cr\xC3\xA8me br\xC3\xBBl\xC3\xA9" "e", 1, 9.0}};
+  doc.total = 9.0;
+  EscPosEncoder encoder(48);
+  PrinterProfile profile;
+  profile.chinese_code_page = CodePage::kGb18030;
+  encoder.set_profile(profile);
+  const std::string bytes = AsString(encoder.EncodeReceipt(doc));
+  EXPECT_NE(bytes.find("CAF\x1C.\x1Bt\x00\x90 \x1C&\xD6\xD0\n"s), std::string::npos);
+  // Kanji mode ends before the next accent; CP437 is still selected.
+  EXPECT_NE(bytes.find("Cr\x1C.\x8Ame br\x96l\x82" "e"), std::string::npos);
+  EXPECT_LE(bytes.size(), EscPosEncoder::MeasureReceipt(doc, 48));
+
+  // ESC @ resets the printer's modes, so text leaves Kanji mode and selects
+  // the table again.
+  EXPECT_EQ("\x1B\x40" "\x1B\x61\x01" "\x1C.\x1Bt\x00\x82\n" "\n\x1D\x56\x42\x00"s,
+            AsString(encoder.EncodeText("\xC3\xA9")));
+}
+
+TEST(EscPosEncoderTest, PadsItemRowsByDisplayWidth) {
+  ReceiptDocument doc;
+  doc.currency = "\xE2\x82\xAC";
+  doc.items = {{"Cr\xC3\xA8me br\xC3\xBBl\xC3\xA9" "e", 2, 4.5}};
+  EscPosEncoder encoder(48);
+  const std::string bytes = AsString(encoder.EncodeReceipt(doc));
+  // 15 columns of name and quantity, 6 of price: one line, 27 spaces.
+  EXPECT_NE(bytes.find("l\x82" "e x2" + std::string(27, ' ') + "\x1Bt\x13\xD5 9.00\n"),
+            std::string::npos);
+}
+
+TEST(EscPosEncoderTest, EncodesLaidOutRows) {
+  EscPosEncoder encoder(16);
+  PrinterProfile profile;
+  profile.chinese_code_page = CodePage::kGb18030;
+  encoder.set_profile(profile);
+  std::vector<ReceiptRow> rows(4);
+  rows[0].left = "\xE4\xB8\xAD\xE6\x96\x87";
+  rows[0].align = RowAlign::kCenter;
+  rows[1].divider = '-';
+  rows[2].left = "Nasi lemak ayam goreng";
+  rows[2].right = "8.50";
+  rows[3].left = "Caf\xC3\xA9";
+  rows[3].right = "3.00";
+  const std::string expected =
+      "\x1B\x40"
+      "      \x1C&\xD6\xD0\xCE\xC4\n"
+      "----------------\n"
+      "Nasi lemak ayam\n"
+      "goreng      8.50\n"
+      "Caf\x1C.\x1Bt\x00\x82        3.00\n"
+      "\n\x1D\x56\x42\x00"s;
+  EXPECT_EQ(expected, AsString(encoder.EncodeRows(rows)));
+
+  // Wide characters print as '?' without a Chinese encoding.
+  encoder.set_profile(PrinterProfile());
+  rows.resize(1);
+  EXPECT_EQ("\x1B\x40" "       ??\n" "\n\x1D\x56\x42\x00"s,
+            AsString(encoder.EncodeRows(rows)));
+}
+
+}  // namespace
+}  // namespace printer_core
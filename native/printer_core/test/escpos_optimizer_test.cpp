@@ -0,0 +1,251 @@
+#include "escpos_optimizer.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "escpos_encoder.h"
+
+namespace printer_core {
+namespace {
+
+using namespace std::string_literals;
+
+// Reference interpreter: what a printer following the ESC/POS manual puts on
+// paper, as one record per printed line, feed and non-text command. Two
+// streams print the same if their records match.
+class ReferencePrinter {
+ public:
+  std::vector<std::string> Run(const std::string& stream) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(stream.data());
+    size_t i = 0;
+    while (i < stream.size()) {
+      const uint8_t b = data[i];
+      const size_t length = b == 0x1B || b == 0x1D || b == 0x1C || b == 0x10
+                                ? EscPosCommandLength(data + i, stream.size() - i)
+                                : 1;
+      if (length == 0) {
+        records_.push_back("unparsed " + stream.substr(i));
+        break;
+      }
+      if (length == 1) {
+        if (b == '\n') {
+          PrintLine(1);
+        } else {
+          Glyph(static_cast<char>(b));
+        }
+      } else {
+        Command(stream.substr(i, length));
+      }
+      i += length;
+    }
+    if (!line_.empty()) records_.push_back("unprinted " + line_);
+    records_.push_back("state " + State());
+    return records_;
+  }
+
+ private:
+  std::string State() const {
+    return std::to_string(bold_) + "," + std::to_string(underline_) + "," +
+           std::to_string(size_) + "," + std::to_string(code_page_) + "," +
+           std::to_string(kanji_) + "," + std::to_string(align_);
+  }
+
+  void Glyph(char c) {
+    // Alignment is taken from the start of the line.
+    if (line_.empty()) line_ = "align " + std::to_string(align_) + ":";
+    line_ += c;
+    line_ += "[" + State() + "]";
+  }
+
+  void PrintLine(int feeds) {
+    if (!line_.empty()) {
+      records_.push_back("line " + line_);
+      line_.clear();
+      --feeds;
+    }
+    for (int i = 0; i < feeds; ++i) records_.push_back("feed size " + std::to_string(size_));
+  }
+
+  void Command(const std::string& command) {
+    const char prefix = command[0];
+    const char code = command[1];
+    const int n = command.size() > 2 ? static_cast<uint8_t>(command[2]) : 0;
+    if (prefix == 0x1B && code == '@') {
+      line_.clear();
+      align_ = bold_ = underline_ = size_ = 0;
+      code_page_ = kanji_ = -1;  // the printer's settings
+      records_.push_back("reset");
+    } else if (prefix == 0x1B && code == 'a') {
+      if (line_.empty()) align_ = n % 48;
+    } else if (prefix == 0x1B && code == 'E') {
+      bold_ = n & 1;
+    } else if (prefix == 0x1B && code == '-') {
+      underline_ = n % 48;
+    } else if (prefix == 0x1B && code == '!') {
+      bold_ = (n >> 3) & 1;
+      underline_ = (n >> 7) & 1;
+      size_ = 1000 + n;
+    } else if (prefix == 0x1D && code == '!') {
+      size_ = n;
+    } else if (prefix == 0x1B && code == 't') {
+      code_page_ = n;
+    } else if (prefix == 0x1C && (code == '&' || code == '.')) {
+      kanji_ = code == '&';
+    } else if (prefix == 0x1B && code == 'd') {
+      if (n == 0) {
+        if (!line_.empty()) records_.push_back("line " + line_);
+        line_.clear();
+      } else {
+        PrintLine(n);
+      }
+    } else if (prefix == 0x1B && code == '*') {
+      // Bit images go into the line.
+      Glyph('*');
+    } else {
+      // Printing commands print the line first.
+      if ((prefix == 0x1B && code == 'J') ||
+          (prefix == 0x1D && (code == 'V' || code == 'v' || code == 'k')) ||
+          (prefix == 0x1C && code == 'p')) {
+        if (!line_.empty()) records_.push_back("line " + line_);
+        line_.clear();
+      }
+      // Cuts, drawer kicks and real-time requests do not depend on the
+      // print settings.
+      const bool settings = !(prefix == 0x1D && code == 'V') && !(prefix == 0x1B && code == 'p') &&
+                            prefix != 0x10;
+      records_.push_back("command " + command + (settings ? " at " + State() : ""));
+    }
+  }
+
+  std::vector<std::string> records_;
+  std::string line_;
+  int align_ = -1;
+  int bold_ = -1;
+  int underline_ = -1;
+  int size_ = -1;
+  int code_page_ = -1;
+  int kanji_ = -1;
+};
+
+std::string Optimize(const std::string& stream) {
+  std::vector<uint8_t> bytes(stream.begin(), stream.end());
+  OptimizeEscPos(&bytes);
+  return std::string(bytes.begin(), bytes.end());
+}
+
+void ExpectSamePrint(const std::string& stream, const std::string& optimized) {
+  EXPECT_EQ(ReferencePrinter().Run(stream), ReferencePrinter().Run(optimized));
+  EXPECT_LE(optimized.size(), stream.size());
+}
+
+std::string AsString(const std::vector<uint8_t>& bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(EscPosOptimizerTest, MeasuresCommands) {
+  auto length = [](const std::string& s) {
+    return EscPosCommandLength(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+  };
+  EXPECT_EQ(length("\x1B@"), 2u);
+  EXPECT_EQ(length("\x1B\x61\x01"), 3u);
+  EXPECT_EQ(length("\x1B\x61"), 0u);  // truncated
+  EXPECT_EQ(length("\x1Bp\x00\x19\xFA"s), 5u);
+  EXPECT_EQ(length("\x1D\x56\x42\x00"s), 4u);
+  EXPECT_EQ(length("\x1D\x56\x00"s), 3u);
+  // GS v 0: 2 bytes by 3 rows
+  EXPECT_EQ(length("\x1Dv0\x00\x02\x00\x03\x00" "abcdef"s), 14u);
+  EXPECT_EQ(length("\x1Dv0\x00\x02\x00\x03\x00" "abcde"s), 0u);
+  EXPECT_EQ(length("\x1Dk\x49\x03" "abc"), 7u);
+  EXPECT_EQ(length("\x1Dk\x04" "ABC\x00" "x"s), 7u);
+  EXPECT_EQ(length("\x1D(k\x03\x00\x31\x51\x30"s), 8u);
+  EXPECT_EQ(length("\x1D" "8L\x02\x00\x00\x00" "ab"s), 9u);
+  // FS q with one 1 x 1 image: eight bytes
+  EXPECT_EQ(length("\x1Cq\x01\x01\x00\x01\x00" "12345678"s), 15u);
+  EXPECT_EQ(length("\x1Cp\x01\x00"s), 4u);
+  EXPECT_EQ(length("\x1B*\x21\x02\x00" "abcdef"s), 11u);
+  EXPECT_EQ(length("\x10\x04\x01"), 3u);
+  EXPECT_EQ(length("\x1B\xFF"), 0u);
+}
+
+TEST(EscPosOptimizerTest, DropsRepeatedAlignment) {
+  // EncodeText puts ESC a before every line.
+  EscPosEncoder encoder;
+  const std::string text = AsString(
+      encoder.EncodeText("EXTROPOS\nJalan Ampang\n\nKopi RM 2.00\nTeh RM 2.50\n\n\n\n"));
+  const std::string optimized = Optimize(text);
+  EXPECT_EQ(optimized,
+            "\x1B@" "\x1B\x61\x01" "EXTROPOS\nJalan Ampang\n\n"
+            "\x1B\x61\x00" "Kopi RM 2.00\nTeh RM 2.50"
+            "\x1B" "d\x05" "\x1DVB\x00" "\x1B\x61\x01"s);
+  ExpectSamePrint(text, optimized);
+}
+
+TEST(EscPosOptimizerTest, DropsSettingsOverriddenBeforePrinting) {
+  const std::string stream =
+      "\x1B@" "\x1B\x45\x01\x1B\x45\x00" "a"           // bold on then off
+      "\x1D!\x11" "\n" "\x1D!\x00" "b\n"               // size kept for the feed
+      "\x1Bt\x13\x1Bt\x13\x82" "\x1C&\x1C.\x82\n"s;    // code table once
+  const std::string optimized = Optimize(stream);
+  EXPECT_EQ(optimized,
+            "\x1B@" "a" "\x1D!\x11" "\n" "\x1D!\x00" "b\n" "\x1Bt\x13\x82" "\x1C.\x82\n"s);
+  ExpectSamePrint(stream, optimized);
+}
+
+TEST(EscPosOptimizerTest, KeepsImageDataAndUnknownCommands) {
+  // Raster bytes that look like commands are data.
+  const std::string raster = "\x1Dv0\x00\x02\x00\x02\x00" "\x1B\x61\x0A\x0A"s;
+  const std::string stream = "\x1B\x61\x01" + raster + "\x1B\x61\x01" + raster;
+  EXPECT_EQ(Optimize(stream), "\x1B\x61\x01" + raster + raster);
+
+  // An unknown command ends the rewrite.
+  const std::string unknown = "\x1B\x61\x01\x1B\x61\x01" "\x1B\xF0\x1B\x61\x01\n\n\n\n\n"s;
+  EXPECT_EQ(Optimize(unknown), "\x1B\x61\x01" "\x1B\xF0\x1B\x61\x01\n\n\n\n\n"s);
+
+  // Alignment sent mid-line is the printer's business.
+  const std::string mid_line = "a\x1B\x61\x01" "b\n\x1B\x61\x01" "c\n"s;
+  EXPECT_EQ(Optimize(mid_line), mid_line);
+  ExpectSamePrint(mid_line, Optimize(mid_line));
+}
+
+TEST(EscPosOptimizerTest, ShrinksReceiptsWithoutChangingThePrint) {
+  ReceiptDocument doc;
+  doc.title = "EXTROPOS CAFE";
+  doc.items = {{"Nasi Lemak", 2, 8.5}, {"Teh Tarik", 1, 3.2}, {"Roti Canai", 3, 1.8}};
+  doc.total = 25.6;
+  doc.barcode = "INV-000123";
+  doc.qr_data = "https://myinvois.hasil.gov.my/abc";
+  for (int cpl : {32, 48}) {
+    EscPosEncoder encoder(cpl);
+    const std::string receipt = AsString(encoder.EncodeReceipt(doc));
+    const std::string optimized = Optimize(receipt);
+    // On 58 mm every item sends ESC a 0, and the QR code repeats the
+    // barcode's ESC a 1.
+    if (cpl == 32) EXPECT_EQ(optimized.size(), receipt.size() - 9);
+    ExpectSamePrint(receipt, optimized);
+  }
+}
+
+TEST(EscPosOptimizerTest, MatchesTheReferenceOnRandomStreams) {
+  const std::vector<std::string> tokens = {
+      "ab", "\x82", "\n", "\n\n\n", "\x1B\x61\x00"s, "\x1B\x61\x01", "\x1B\x61\x32",
+      "\x1B\x45\x00"s, "\x1B\x45\x01", "\x1B-\x01", "\x1B-\x00"s, "\x1D!\x00"s, "\x1D!\x11",
+      "\x1Bt\x00"s, "\x1Bt\x13", "\x1C&", "\x1C.", "\x1B" "d\x00"s, "\x1B" "d\x03",
+      "\x1B" "d\x07", "\x1B@", "\x1B!\x08", "\x1B" "J\x18", "\x1DVB\x00"s,
+      "\x1Dv0\x00\x01\x00\x02\x00\x1B\x40"s, "\x1Dk\x49\x02\x1B\x0A", "\x1B*\x00\x01\x00\xFF"s,
+      "\x1Cp\x01\x00"s, "\x10\x04\x01"};
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<size_t> pick(0, tokens.size() - 1);
+  std::uniform_int_distribution<int> count(0, 40);
+  for (int trial = 0; trial < 2000; ++trial) {
+    std::string stream;
+    for (int i = count(random); i > 0; --i) stream += tokens[pick(random)];
+    SCOPED_TRACE(trial);
+    ExpectSamePrint(stream, Optimize(stream));
+  }
+}
+
+}  // namespace
+}  // namespace printer_core
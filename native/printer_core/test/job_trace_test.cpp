@@ -0,0 +1,94 @@
+#include "job_trace.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace printer_core {
+namespace {
+
+size_t Count(const std::string& json, const std::string& text) {
+  size_t n = 0;
+  for (size_t at = json.find(text); at != std::string::npos; at = json.find(text, at + 1)) ++n;
+  return n;
+}
+
+TEST(JobTracerTest, ExportsOneJobAsChromeTraceEvents) {
+  JobTracer tracer;
+  const uint64_t receipt = tracer.BeginJob();
+  const uint64_t kitchen = tracer.BeginJob();
+  EXPECT_NE(0u, receipt);
+  EXPECT_NE(receipt, kitchen);
+
+  tracer.Record(receipt, "encode", 1000, 1250);
+  tracer.Record(kitchen, "encode", 1100, 1200);
+  std::thread worker([&] { tracer.Record(receipt, "write", 2000, 2500, "bytes", 512); });
+  worker.join();
+  tracer.Record(0, "ignored", 0, 1);
+
+  const std::string json = tracer.Export(receipt);
+  EXPECT_EQ(0u, json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"encode\",\"cat\":\"print\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                      "\"ts\":1000,\"dur\":250,\"args\":{\"job\":" +
+                      std::to_string(receipt) + "}}"));
+  // The worker got its own ring, shown as its own thread
+  EXPECT_NE(std::string::npos,
+            json.find("\"tid\":2,\"ts\":2000,\"dur\":500,\"args\":{\"job\":" +
+                      std::to_string(receipt) + ",\"bytes\":512}}"));
+  EXPECT_EQ(2u, Count(json, "\"ph\":\"X\""));
+  EXPECT_LT(json.find("\"name\":\"encode\""), json.find("\"name\":\"write\""));
+  EXPECT_EQ(3u, Count(tracer.Export(), "\"ph\":\"X\""));
+  EXPECT_EQ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}", tracer.Export(12345));
+}
+
+TEST(JobTracerTest, OverwritesTheOldestSpansOfAThread) {
+  JobTracerOptions options;
+  options.spans_per_thread = 4;
+  JobTracer tracer(options);
+  for (int i = 0; i < 6; ++i) tracer.Record(7, "write", i * 10, i * 10 + 5);
+  const std::string json = tracer.Export(7);
+  EXPECT_EQ(4u, Count(json, "\"ph\":\"X\""));
+  EXPECT_EQ(std::string::npos, json.find("\"ts\":10,"));
+  EXPECT_NE(std::string::npos, json.find("\"ts\":20,"));
+  EXPECT_NE(std::string::npos, json.find("\"ts\":50,"));
+}
+
+TEST(JobTracerTest, ReportsSlowJobsWithTheirTimeline) {
+  uint64_t slow_id = 0;
+  int64_t slow_duration = 0;
+  std::string slow_json;
+  JobTracerOptions options;
+  options.slow_job_us = 5000;
+  options.on_slow_job = [&](uint64_t trace_id, int64_t duration_us, const std::string& json) {
+    slow_id = trace_id;
+    slow_duration = duration_us;
+    slow_json = json;
+  };
+  JobTracer tracer(options);
+
+  const uint64_t fast = tracer.BeginJob();
+  EXPECT_GE(tracer.FinishJob(fast), 0);
+  EXPECT_EQ(0u, slow_id);
+  EXPECT_EQ(-1, tracer.FinishJob(fast));
+
+  const uint64_t slow = tracer.BeginJob();
+  {
+    ScopedTraceSpan span(&tracer, slow, "connect");
+    span.set_arg("attempts", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const int64_t duration = tracer.FinishJob(slow);
+  EXPECT_GE(duration, 10000);
+  EXPECT_EQ(slow, slow_id);
+  EXPECT_EQ(duration, slow_duration);
+  EXPECT_NE(std::string::npos, slow_json.find("\"name\":\"job\""));
+  EXPECT_NE(std::string::npos, slow_json.find("\"attempts\":1}"));
+  // The job span encloses the others, so it comes first
+  EXPECT_LT(slow_json.find("\"name\":\"job\""), slow_json.find("\"name\":\"connect\""));
+}
+
+}  // namespace
+}  // namespace printer_core
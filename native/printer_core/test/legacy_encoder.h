@@ -0,0 +1,111 @@
+#ifndef PRINTER_CORE_TEST_LEGACY_ENCODER_H_
+#define PRINTER_CORE_TEST_LEGACY_ENCODER_H_
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "escpos_encoder.h"
+
+namespace printer_core {
+namespace testing {
+
+// Port of the iostream-based PrinterPlugin::BuildStructuredEscPosBytes that
+// the encoder replaced; the encoder must stay byte-for-byte compatible, and
+// the benchmarks time it as the baseline.
+inline std::vector<uint8_t> LegacyEncode(const ReceiptDocument& doc,
+                                         int charsPerLine) {
+  std::vector<uint8_t> out;
+  auto pushString = [&](const std::string& value) {
+    for (char c : value) out.push_back(static_cast<uint8_t>(c));
+  };
+  const std::string currency(doc.currency);
+  out.push_back(0x1B); out.push_back(0x40);
+  out.push_back(0x1B); out.push_back(0x61); out.push_back(0x01);
+  for (int i = 0; i < charsPerLine; ++i) out.push_back('=');
+  out.push_back('\n');
+  if (doc.title) {
+    pushString(std::string(*doc.title));
+    out.push_back('\n');
+  }
+  for (int i = 0; i < charsPerLine; ++i) out.push_back('-');
+  out.push_back('\n');
+  for (const ReceiptItem& item : doc.items) {
+    std::ostringstream priceStr;
+    priceStr << currency << " " << std::fixed << std::setprecision(2)
+             << (item.price * item.quantity);
+    std::string leftPart(item.name);
+    if (item.quantity != 1) leftPart += " x" + std::to_string(item.quantity);
+    const std::string p = priceStr.str();
+    if (charsPerLine >= 48) {
+      if ((int)leftPart.length() + (int)p.length() + 1 > charsPerLine) {
+        pushString(leftPart);
+        out.push_back('\n');
+        for (int k = 0; k < charsPerLine - (int)p.length(); ++k) out.push_back(' ');
+      } else {
+        out.push_back(0x1B); out.push_back(0x61); out.push_back(0x00);
+        pushString(leftPart);
+        for (int k = 0; k < charsPerLine - (int)leftPart.length() - (int)p.length(); ++k) out.push_back(' ');
+      }
+    } else {
+      out.push_back(0x1B); out.push_back(0x61); out.push_back(0x00);
+      pushString(leftPart);
+      out.push_back('\n');
+      for (int k = 0; k < charsPerLine - (int)p.length(); ++k) out.push_back(' ');
+    }
+    pushString(p);
+    out.push_back('\n');
+  }
+  for (int i = 0; i < charsPerLine; ++i) out.push_back('-');
+  out.push_back('\n');
+  auto printTotal = [&](const std::string& label, double val) {
+    std::ostringstream s;
+    s << currency << " " << std::fixed << std::setprecision(2) << val;
+    const std::string valStr = s.str();
+    pushString(label);
+    if ((int)label.length() + (int)valStr.length() + 1 > charsPerLine) {
+      out.push_back('\n');
+      for (int k = 0; k < charsPerLine - (int)valStr.length(); ++k) out.push_back(' ');
+    } else {
+      for (int k = 0; k < charsPerLine - (int)label.length() - (int)valStr.length(); ++k) out.push_back(' ');
+    }
+    pushString(valStr);
+    out.push_back('\n');
+  };
+  if (doc.subtotal) printTotal("Subtotal:", *doc.subtotal);
+  if (doc.tax) printTotal("Tax:", *doc.tax);
+  if (doc.service_charge) printTotal("Service:", *doc.service_charge);
+  if (doc.total) printTotal("TOTAL:", *doc.total);
+  for (int i = 0; i < charsPerLine; ++i) out.push_back('=');
+  out.push_back('\n');
+  if (!doc.barcode.empty()) {
+    std::string barcode(doc.barcode.substr(0, 255));
+    out.insert(out.end(), {0x1B, 0x61, 0x01, 0x1D, 0x48, 0x02, 0x1D, 0x68,
+                           0x50, 0x1D, 0x77, 0x02, 0x1D, 0x6B, 0x49,
+                           static_cast<uint8_t>(barcode.size())});
+    pushString(barcode);
+    out.push_back('\n');
+  }
+  if (!doc.qr_data.empty()) {
+    out.insert(out.end(), {0x1B, 0x61, 0x01});
+    out.insert(out.end(), {0x1D, 0x28, 0x6B, 0x04, 0x00, 0x31, 0x41, 0x32, 0x00});
+    out.insert(out.end(), {0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x43, 0x06});
+    out.insert(out.end(), {0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x45, 0x30});
+    int len = static_cast<int>(doc.qr_data.size()) + 3;
+    out.insert(out.end(), {0x1D, 0x28, 0x6B, static_cast<uint8_t>(len & 0xFF),
+                           static_cast<uint8_t>((len >> 8) & 0xFF), 0x31, 0x50,
+                           0x30});
+    pushString(std::string(doc.qr_data));
+    out.insert(out.end(), {0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x51, 0x30});
+    out.push_back('\n');
+  }
+  out.push_back(0x0A);
+  out.insert(out.end(), {0x1D, 0x56, 0x42, 0x00});
+  return out;
+}
+
+}  // namespace testing
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_TEST_LEGACY_ENCODER_H_
@@ -0,0 +1,263 @@
+#include "logger.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+// Collects every batch a Logger hands over.
+class BatchRecorder {
+ public:
+  LogBatchSink Sink() {
+    return [this](const std::vector<LogEntry>& batch) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      batches_.push_back(batch);
+    };
+  }
+
+  std::vector<std::vector<LogEntry>> batches() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::vector<LogEntry>> batches_;
+};
+
+// Options with the flusher idle for the length of a test, so batches only
+// come from Flush().
+LoggerOptions ManualFlush() {
+  LoggerOptions options;
+  options.flush_interval_ms = 60 * 60 * 1000;
+  options.min_level = LogLevel::kDebug;
+  return options;
+}
+
+TEST(LogRingTest, RefusesPushesWhenFullAndPopsInOrder) {
+  LogRing ring(3);
+  EXPECT_EQ(4u, ring.capacity());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring.TryPush(i, LogLevel::kInfo, "NETWORK", "message " + std::to_string(i)));
+  }
+  EXPECT_FALSE(ring.TryPush(4, LogLevel::kInfo, "NETWORK", "message 4"));
+
+  LogEntry entry;
+  ASSERT_TRUE(ring.TryPop(&entry));
+  EXPECT_EQ(0, entry.time_us);
+  EXPECT_EQ("NETWORK", entry.category);
+  EXPECT_EQ("message 0", entry.message);
+  EXPECT_TRUE(ring.TryPush(4, LogLevel::kError, "SPOOL", "message 4"));
+  for (int i = 1; i <= 4; ++i) {
+    ASSERT_TRUE(ring.TryPop(&entry));
+    EXPECT_EQ("message " + std::to_string(i), entry.message);
+  }
+  EXPECT_EQ(LogLevel::kError, entry.level);
+  EXPECT_FALSE(ring.TryPop(&entry));
+}
+
+TEST(LogRingTest, CutsLongTextAtCharacterBoundaries) {
+  LogRing ring(2);
+  // 14 ASCII bytes then a two-byte character straddling the category limit
+  const std::string category = "ABCDEFGHIJKLMN\xC3\xA9";
+  const std::string message(kLogMessageMax + 10, 'x');
+  ASSERT_TRUE(ring.TryPush(0, LogLevel::kInfo, category, message));
+  LogEntry entry;
+  ASSERT_TRUE(ring.TryPop(&entry));
+  EXPECT_EQ("ABCDEFGHIJKLMN", entry.category);
+  EXPECT_EQ(kLogMessageMax, entry.message.size());
+}
+
+TEST(LogRingTest, DeliversEveryMessageFromConcurrentProducers) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 20000;
+  LogRing ring(64);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&ring, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        const std::string message = std::to_string(i);
+        while (!ring.TryPush(i, LogLevel::kInfo, std::to_string(p), message)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  // Each producer's messages arrive complete and in order
+  std::vector<int> next(kProducers, 0);
+  LogEntry entry;
+  for (int received = 0; received < kProducers * kPerProducer;) {
+    if (!ring.TryPop(&entry)) {
+      std::this_thread::yield();
+      continue;
+    }
+    const int producer = std::stoi(entry.category);
+    ASSERT_EQ(next[producer], std::stoi(entry.message));
+    ASSERT_EQ(next[producer], entry.time_us);
+    ++next[producer];
+    ++received;
+  }
+  for (std::thread& producer : producers) producer.join();
+  EXPECT_FALSE(ring.TryPop(&entry));
+}
+
+TEST(LoggerTest, FiltersSamplesAndRateLimitsByCategory) {
+  LoggerOptions options = ManualFlush();
+  options.min_level = LogLevel::kInfo;
+  LogCategoryRule debug;
+  debug.category = "DEBUG";
+  debug.sample_every = 4;
+  LogCategoryRule network;
+  network.category = "NETWORK";
+  network.min_level = LogLevel::kWarning;
+  network.max_per_second = 3;
+  options.categories = {debug, network};
+  BatchRecorder recorder;
+  Logger logger(options, recorder.Sink());
+
+  EXPECT_FALSE(logger.Log(LogLevel::kDebug, "RUNNER", "below the global level"));
+  EXPECT_FALSE(logger.Log(LogLevel::kInfo, "NETWORK", "below the category level"));
+  // One info message in four; errors are never sampled
+  int kept = 0;
+  for (int i = 0; i < 8; ++i) kept += logger.Log(LogLevel::kInfo, "DEBUG", "hex") ? 1 : 0;
+  EXPECT_EQ(2, kept);
+  EXPECT_TRUE(logger.Log(LogLevel::kError, "DEBUG", "error"));
+  // Rate limited within one second (a second boundary may reset it once)
+  kept = 0;
+  for (int i = 0; i < 5; ++i) kept += logger.Log(LogLevel::kWarning, "NETWORK", "scan") ? 1 : 0;
+  EXPECT_GE(kept, 3);
+  EXPECT_LE(kept, 5);
+
+  logger.Flush();
+  const LoggerStats stats = logger.stats();
+  EXPECT_EQ(2u, stats.filtered);
+  EXPECT_EQ(6u, stats.sampled_out);
+  EXPECT_EQ(static_cast<uint64_t>(5 - kept), stats.rate_limited);
+  EXPECT_EQ(static_cast<uint64_t>(3 + kept), stats.logged);
+
+  const std::vector<std::vector<LogEntry>> batches = recorder.batches();
+  ASSERT_EQ(1u, batches.size());
+  const std::vector<LogEntry>& batch = batches[0];
+  ASSERT_EQ(static_cast<size_t>(3 + kept + (kept < 5 ? 1 : 0)), batch.size());
+  EXPECT_EQ("hex", batch[0].message);
+  EXPECT_EQ(LogLevel::kError, batch[2].level);
+  if (kept < 5) {
+    EXPECT_EQ("LOG", batch.back().category);
+    EXPECT_EQ(LogLevel::kWarning, batch.back().level);
+  }
+}
+
+TEST(LoggerTest, ReportsMessagesLostToAFullRing) {
+  LoggerOptions options = ManualFlush();
+  options.capacity = 4;
+  BatchRecorder recorder;
+  Logger logger(options, recorder.Sink());
+  for (int i = 0; i < 10; ++i) logger.Log(LogLevel::kInfo, "BATCH", "job " + std::to_string(i));
+  EXPECT_EQ(6u, logger.stats().dropped);
+
+  logger.Flush();
+  logger.Flush();  // Nothing new: no batch
+  const std::vector<std::vector<LogEntry>> batches = recorder.batches();
+  ASSERT_EQ(1u, batches.size());
+  ASSERT_EQ(5u, batches[0].size());
+  EXPECT_EQ("job 3", batches[0][3].message);
+  EXPECT_EQ("6 message(s) dropped by rate limits or a full buffer", batches[0][4].message);
+}
+
+TEST(LoggerTest, FlushesOnItsOwnAndOnShutdown) {
+  LoggerOptions options;
+  options.flush_interval_ms = 10;
+  BatchRecorder recorder;
+  Logger logger(options, recorder.Sink());
+  logger.Log(LogLevel::kInfo, "RUNNER", "first");
+  for (int i = 0; i < 200 && recorder.batches().empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_EQ(1u, recorder.batches().size());
+
+  logger.Log(LogLevel::kInfo, "RUNNER", "last");
+  logger.Shutdown();
+  EXPECT_FALSE(logger.Log(LogLevel::kError, "RUNNER", "after shutdown"));
+  const std::vector<std::vector<LogEntry>> batches = recorder.batches();
+  ASSERT_EQ(2u, batches.size());
+  EXPECT_EQ("last", batches[1][0].message);
+}
+
+TEST(LoggerTest, WritesAndRotatesTheLogFile) {
+  char dir_template[] = "/tmp/printer_core_XXXXXX";
+  const std::string dir = mkdtemp(dir_template);
+  const std::string path = dir + "/printer.log";
+  LoggerOptions options = ManualFlush();
+  options.file_path = path;
+  options.max_file_bytes = 200;
+  options.max_files = 3;
+  {
+    Logger logger(options, nullptr);
+    for (int batch = 0; batch < 4; ++batch) {
+      for (int i = 0; i < 3; ++i) {
+        logger.Log(LogLevel::kWarning, "SPOOL", "batch " + std::to_string(batch));
+      }
+      logger.Flush();
+    }
+  }
+  auto read = [](const std::string& file) {
+    std::ifstream in(file);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  };
+  // Every second batch takes the file past the limit: batches 2 and 3 went
+  // to .1, 0 and 1 on to .2
+  EXPECT_EQ("", read(path));
+  EXPECT_NE(std::string::npos, read(path + ".1").find("WARNING SPOOL: batch 3\n"));
+  EXPECT_NE(std::string::npos, read(path + ".2").find("batch 1"));
+  EXPECT_FALSE(std::ifstream(path + ".3").good());
+  const std::string line = read(path + ".1").substr(0, read(path + ".1").find('\n'));
+  // "2026-01-31T12:34:56.789Z WARNING SPOOL: batch 3"
+  EXPECT_EQ('T', line[10]);
+  EXPECT_EQ('Z', line[23]);
+
+  unlink(path.c_str());
+  unlink((path + ".1").c_str());
+  unlink((path + ".2").c_str());
+  rmdir(dir.c_str());
+}
+
+TEST(LoggerTest, RotatesALogFileWithAUtf8Path) {
+  char dir_template[] = "/tmp/printer_core_XXXXXX";
+  const std::string dir = mkdtemp(dir_template);
+  // "impresión.log"
+  const std::string path = dir + "/impresi\xC3\xB3n.log";
+  LoggerOptions options = ManualFlush();
+  options.file_path = path;
+  options.max_file_bytes = 10;
+  options.max_files = 2;
+  {
+    Logger logger(options, nullptr);
+    logger.Log(LogLevel::kWarning, "SPOOL", "first");
+    logger.Flush();
+    logger.Log(LogLevel::kWarning, "SPOOL", "second");
+    logger.Flush();
+  }
+  std::ifstream rotated(path + ".1");
+  const std::string text((std::istreambuf_iterator<char>(rotated)),
+                         std::istreambuf_iterator<char>());
+  EXPECT_NE(std::string::npos, text.find("SPOOL: second\n"));
+  EXPECT_TRUE(std::ifstream(path).good());
+
+  unlink(path.c_str());
+  unlink((path + ".1").c_str());
+  rmdir(dir.c_str());
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,240 @@
+#include "logo_raster.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+GrayImage Solid(int width, int height, uint8_t value) {
+  GrayImage image;
+  image.width = width;
+  image.height = height;
+  image.pixels.assign(static_cast<size_t>(width) * height, value);
+  return image;
+}
+
+// Left half black, right half white.
+GrayImage Split(int width, int height) {
+  GrayImage image = Solid(width, height, 255);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width / 2; ++x) image.pixels[y * width + x] = 0;
+  }
+  return image;
+}
+
+size_t CountDots(const MonoBitmap& bitmap) {
+  size_t dots = 0;
+  for (uint8_t byte : bitmap.bits) {
+    for (; byte; byte &= byte - 1) ++dots;
+  }
+  return dots;
+}
+
+TEST(LogoRasterTest, ParsesDitherModes) {
+  DitherMode mode = DitherMode::kThreshold;
+  EXPECT_TRUE(ParseDitherMode("ordered", &mode));
+  EXPECT_EQ(mode, DitherMode::kOrdered);
+  EXPECT_TRUE(ParseDitherMode("floyd-steinberg", &mode));
+  EXPECT_EQ(mode, DitherMode::kFloydSteinberg);
+  EXPECT_TRUE(ParseDitherMode("threshold", &mode));
+  EXPECT_EQ(mode, DitherMode::kThreshold);
+  EXPECT_FALSE(ParseDitherMode("atkinson", &mode));
+}
+
+TEST(LogoRasterTest, ConvertsPixelsToGrayOverWhite) {
+  const uint8_t rgba[] = {255, 0, 0, 255, 0, 0, 0, 0, 255, 255, 255, 255};
+  GrayImage image = GrayFromPixels(rgba, 3, 1, sizeof(rgba), PixelLayout::kRgba);
+  ASSERT_EQ(image.pixels.size(), 3u);
+  EXPECT_EQ(image.pixels[0], 77);
+  // Fully transparent is paper.
+  EXPECT_EQ(image.pixels[1], 255);
+  EXPECT_EQ(image.pixels[2], 255);
+
+  const uint8_t bgra[] = {255, 0, 0, 255};
+  EXPECT_EQ(GrayFromPixels(bgra, 1, 1, 4, PixelLayout::kBgra).pixels[0], 29);
+  // Rows are |stride| apart; the padding byte is skipped.
+  const uint8_t rgb[] = {0, 0, 0, 99, 255, 255, 255, 99};
+  image = GrayFromPixels(rgb, 1, 2, 4, PixelLayout::kRgb);
+  EXPECT_EQ(image.pixels, (std::vector<uint8_t>{0, 255}));
+}
+
+TEST(LogoRasterTest, ScalesByAreaAverage) {
+  // 2x2 blocks of black and white average to mid gray.
+  GrayImage checker = Solid(64, 64, 255);
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      if ((x + y) % 2 == 0) checker.pixels[y * 64 + x] = 0;
+    }
+  }
+  GrayImage scaled = ScaleToWidth(checker, 32);
+  EXPECT_EQ(scaled.width, 32);
+  EXPECT_EQ(scaled.height, 32);
+  for (uint8_t value : scaled.pixels) EXPECT_EQ(value, 128);
+
+  // Aspect ratio is kept when upscaling too.
+  scaled = ScaleToWidth(Split(100, 50), 384);
+  EXPECT_EQ(scaled.height, 192);
+  EXPECT_EQ(scaled.pixels[0], 0);
+  EXPECT_EQ(scaled.pixels[383], 255);
+}
+
+TEST(LogoRasterTest, PacksMostSignificantBitFirst) {
+  // Wide enough to take the vector path and leave a partial last byte.
+  GrayImage image = Solid(37, 1, 255);
+  image.pixels[0] = 0;
+  image.pixels[17] = 0;
+  image.pixels[36] = 0;
+  MonoBitmap bitmap = Dither(image, DitherMode::kThreshold);
+  EXPECT_EQ(bitmap.bytes_per_row, 5);
+  EXPECT_EQ(bitmap.bits, (std::vector<uint8_t>{0x80, 0x00, 0x40, 0x00, 0x08}));
+}
+
+TEST(LogoRasterTest, DitherModesKeepTheirTone) {
+  const GrayImage gray = Solid(64, 64, 128);
+  const size_t dots = 64 * 64;
+  EXPECT_EQ(CountDots(Dither(gray, DitherMode::kThreshold)), 0u);
+  const size_t ordered = CountDots(Dither(gray, DitherMode::kOrdered));
+  EXPECT_EQ(ordered, dots / 2);
+  const size_t diffused = CountDots(Dither(gray, DitherMode::kFloydSteinberg));
+  EXPECT_NEAR(static_cast<double>(diffused), dots / 2.0, dots * 0.02);
+
+  for (DitherMode mode :
+       {DitherMode::kThreshold, DitherMode::kOrdered, DitherMode::kFloydSteinberg}) {
+    EXPECT_EQ(CountDots(Dither(Solid(40, 3, 0), mode)), 120u);
+    EXPECT_EQ(CountDots(Dither(Solid(40, 3, 255), mode)), 0u);
+  }
+}
+
+TEST(LogoRasterTest, SplitsTallLogosIntoBands) {
+  MonoBitmap bitmap;
+  bitmap.width = 16;
+  bitmap.height = 300;
+  bitmap.bytes_per_row = 2;
+  bitmap.bits.assign(600, 0xAA);
+  std::vector<uint8_t> out;
+  AppendRasterBands(bitmap, &out);
+  ASSERT_EQ(out.size(), 8 + 512 + 8 + 88u);
+  EXPECT_EQ(std::vector<uint8_t>(out.begin(), out.begin() + 8),
+            (std::vector<uint8_t>{0x1D, 'v', '0', 0, 2, 0, 0, 1}));
+  EXPECT_EQ(std::vector<uint8_t>(out.begin() + 520, out.begin() + 528),
+            (std::vector<uint8_t>{0x1D, 'v', '0', 0, 2, 0, 44, 0}));
+}
+
+TEST(LogoRasterTest, CompactsBlankRowsAndMargins) {
+  // 64 bytes wide: 100 blank rows, then 4 rows with ink in bytes 20..40,
+  // then 60 blank rows.
+  MonoBitmap bitmap;
+  bitmap.width = 512;
+  bitmap.height = 164;
+  bitmap.bytes_per_row = 64;
+  bitmap.bits.assign(64 * 164, 0);
+  for (int y = 100; y < 104; ++y) {
+    bitmap.bits[y * 64 + 20] = 0x01;
+    bitmap.bits[y * 64 + 40] = 0x80;
+  }
+  std::vector<uint8_t> out;
+  AppendRasterBands(bitmap, &out);
+  // Bytes 0..19 and 44..63 are blank on every ink row: 20 come off each side.
+  std::vector<uint8_t> expected = {0x1D, 'P', 0, 203, 0x1B, 'J', 100,
+                                   0x1D, 'v', '0', 0, 24, 0, 4, 0};
+  for (int y = 0; y < 4; ++y) {
+    std::vector<uint8_t> row(24, 0);
+    row[0] = 0x01;
+    row[20] = 0x80;
+    expected.insert(expected.end(), row.begin(), row.end());
+  }
+  const std::vector<uint8_t> tail = {0x1B, 'J', 60, 0x1D, 'P', 0, 0};
+  expected.insert(expected.end(), tail.begin(), tail.end());
+  EXPECT_EQ(out, expected);
+
+  // Long gaps take several feeds; the plain form is kept on request.
+  bitmap.height = 300;
+  bitmap.bits.assign(64 * 300, 0);
+  out.clear();
+  AppendRasterBands(bitmap, &out);
+  EXPECT_EQ(out, (std::vector<uint8_t>{0x1D, 'P', 0, 203, 0x1B, 'J', 255, 0x1B, 'J', 1,
+                                       0x1B, 'J', 44, 0x1D, 'P', 0, 0}));
+  out.clear();
+  RasterOptions plain;
+  plain.compact = false;
+  AppendRasterBands(bitmap, &out, plain);
+  EXPECT_EQ(out.size(), 8 + 64 * 256 + 8 + 64 * 44u);
+}
+
+TEST(LogoRasterTest, KeepsPlainBandsWhenShorter) {
+  // Short blank runs in a narrow bitmap cost more as feeds than as zeros.
+  MonoBitmap bitmap;
+  bitmap.width = 16;
+  bitmap.height = 8;
+  bitmap.bytes_per_row = 2;
+  bitmap.bits.assign(16, 0);
+  bitmap.bits[0] = 0xFF;
+  bitmap.bits[15] = 0x01;
+  std::vector<uint8_t> out;
+  AppendRasterBands(bitmap, &out);
+  ASSERT_EQ(out.size(), 8 + 16u);
+  EXPECT_EQ(std::vector<uint8_t>(out.begin(), out.begin() + 8),
+            (std::vector<uint8_t>{0x1D, 'v', '0', 0, 2, 0, 8, 0}));
+}
+
+TEST(LogoRasterTest, RasterizesCentredLogo) {
+  std::vector<uint8_t> out = RasterizeLogo(Split(200, 100), kLogoWidth80mm, DitherMode::kThreshold);
+  // ESC a 1, one 48-byte wide band of 192 rows, LF, ESC a 0.
+  ASSERT_EQ(out.size(), 3 + 8 + 48 * 192 + 4u);
+  EXPECT_EQ(std::vector<uint8_t>(out.begin(), out.begin() + 11),
+            (std::vector<uint8_t>{0x1B, 'a', 1, 0x1D, 'v', '0', 0, 48, 0, 192, 0}));
+  EXPECT_EQ(out[11], 0xFF);
+  EXPECT_EQ(out[11 + 47], 0x00);
+  EXPECT_EQ(std::vector<uint8_t>(out.end() - 4, out.end()),
+            (std::vector<uint8_t>{'\n', 0x1B, 'a', 0}));
+  EXPECT_TRUE(RasterizeLogo(GrayImage(), kLogoWidth80mm, DitherMode::kThreshold).empty());
+
+  std::vector<uint8_t> receipt = {0x1B, '@', 'T', '\n'};
+  PrependLogo({0x1B, 'a', 1}, &receipt);
+  EXPECT_EQ(receipt, (std::vector<uint8_t>{0x1B, '@', 0x1B, 'a', 1, 0x1B, '@', 'T', '\n'}));
+}
+
+TEST(LogoRasterTest, CacheDecodesEachLogoOnce) {
+  LogoCache cache(2);
+  int decodes = 0;
+  auto decoder = [&](GrayImage* image) {
+    ++decodes;
+    *image = Split(64, 32);
+    return true;
+  };
+  const std::vector<uint8_t> a = {'P', 'N', 'G', 1};
+  const std::vector<uint8_t> b = {'P', 'N', 'G', 2};
+
+  auto first = cache.Get(a.data(), a.size(), 256, DitherMode::kOrdered, decoder);
+  ASSERT_TRUE(first);
+  auto again = cache.Get(a.data(), a.size(), 256, DitherMode::kOrdered, decoder);
+  EXPECT_EQ(first, again);
+  EXPECT_EQ(decodes, 1);
+  EXPECT_EQ(first->key.width, 256);
+  EXPECT_EQ(first->bitmap.width, 256);
+  EXPECT_EQ(first->raster, RasterBlock(first->bitmap));
+  // Another width or dither mode is another entry.
+  cache.Get(a.data(), a.size(), 384, DitherMode::kOrdered, decoder);
+  EXPECT_EQ(decodes, 2);
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.misses(), 2u);
+
+  // The least recently used entry goes when a third arrives.
+  cache.Get(a.data(), a.size(), 256, DitherMode::kOrdered, decoder);
+  cache.Get(b.data(), b.size(), 256, DitherMode::kOrdered, decoder);
+  EXPECT_EQ(cache.size(), 2u);
+  decodes = 0;
+  cache.Get(a.data(), a.size(), 256, DitherMode::kOrdered, decoder);
+  EXPECT_EQ(decodes, 0);
+  cache.Get(a.data(), a.size(), 384, DitherMode::kOrdered, decoder);
+  EXPECT_EQ(decodes, 1);
+
+  // A failed decode is not cached.
+  EXPECT_FALSE(cache.Get(b.data(), b.size(), 576, DitherMode::kThreshold,
+                         [](GrayImage*) { return false; }));
+}
+
+}  // namespace
+}  // namespace printer_core
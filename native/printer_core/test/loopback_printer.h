@@ -0,0 +1,201 @@
+#ifndef PRINTER_CORE_TEST_LOOPBACK_PRINTER_H_
+#define PRINTER_CORE_TEST_LOOPBACK_PRINTER_H_
+
+// A stand-in network printer for tests: listens on a loopback address,
+// accepts any number of connections and records the bytes each one sends.
+// An optional responder can answer queries (for example DLE EOT status).
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace printer_core {
+namespace testing {
+
+class LoopbackPrinter {
+ public:
+  // Receives each chunk read from a connection and returns bytes to send
+  // back (may be empty).
+  using Responder = std::function<std::vector<uint8_t>(const uint8_t*, size_t)>;
+
+  // Answers DLE EOT n with |realtime[n - 1]| and, when |auto_status| is not
+  // empty, GS a with that block, like a printer with the given status.
+  static Responder StatusResponder(std::array<uint8_t, 4> realtime,
+                                   std::vector<uint8_t> auto_status = {}) {
+    return [realtime, auto_status](const uint8_t* data, size_t size) {
+      std::vector<uint8_t> reply;
+      for (size_t i = 0; i + 2 < size; ++i) {
+        if (data[i] == 0x10 && data[i + 1] == 0x04 && data[i + 2] >= 1 &&
+            data[i + 2] <= 4) {
+          reply.push_back(realtime[data[i + 2] - 1]);
+        } else if (data[i] == 0x1D && data[i + 1] == 'a') {
+          reply.insert(reply.end(), auto_status.begin(), auto_status.end());
+        }
+      }
+      return reply;
+    };
+  }
+
+  explicit LoopbackPrinter(const char* address = "127.0.0.1",
+                           uint16_t port = 0) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, address, &addr.sin_addr);
+    ok_ = bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+          listen(listen_fd_, 64) == 0;
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { Serve(); });
+  }
+
+  ~LoopbackPrinter() { Stop(); }
+
+  void Stop() {
+    if (stop_.exchange(true)) return;
+    if (thread_.joinable()) thread_.join();
+    close(listen_fd_);
+    for (Connection& c : connections_) {
+      if (c.fd >= 0) close(c.fd);
+    }
+  }
+
+  bool ok() const { return ok_; }
+  uint16_t port() const { return port_; }
+
+  void set_responder(Responder responder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    responder_ = std::move(responder);
+  }
+
+  // Closes every accepted connection from the printer side.
+  void DropConnections() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    drop_requested_ = true;
+  }
+
+  size_t accepted() const { return accepted_.load(); }
+
+  // Stops keeping received bytes (they are still counted), for long runs
+  // such as benchmarks.
+  void set_recording(bool recording) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recording_ = recording;
+  }
+
+  // Bytes received so far, recorded or not.
+  size_t received_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_size_;
+  }
+
+  // All bytes received across every connection, in arrival order.
+  std::vector<uint8_t> received() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+  }
+
+  // Waits until at least |size| bytes have arrived.
+  bool WaitForBytes(size_t size, int timeout_ms = 2000) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                        [&] { return received_size_ >= size; });
+  }
+
+ private:
+  struct Connection {
+    int fd;
+  };
+
+  void Serve() {
+    while (!stop_.load()) {
+      std::vector<pollfd> fds;
+      fds.push_back({listen_fd_, POLLIN, 0});
+      for (const Connection& c : connections_) fds.push_back({c.fd, POLLIN, 0});
+      if (poll(fds.data(), fds.size(), 10) <= 0) {
+        MaybeDrop();
+        continue;
+      }
+      if (fds[0].revents & POLLIN) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd >= 0) {
+          connections_.push_back({fd});
+          ++accepted_;
+        }
+      }
+      for (size_t i = 1; i < fds.size(); ++i) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        Connection& c = connections_[i - 1];
+        uint8_t buf[4096];
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          close(c.fd);
+          c.fd = -1;
+          continue;
+        }
+        std::vector<uint8_t> reply;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (recording_) received_.insert(received_.end(), buf, buf + n);
+          received_size_ += static_cast<size_t>(n);
+          if (responder_) reply = responder_(buf, static_cast<size_t>(n));
+        }
+        cv_.notify_all();
+        if (!reply.empty()) send(c.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+      }
+      std::vector<Connection> open;
+      for (Connection& c : connections_) {
+        if (c.fd >= 0) open.push_back(std::move(c));
+      }
+      connections_.swap(open);
+      MaybeDrop();
+    }
+  }
+
+  void MaybeDrop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!drop_requested_) return;
+    drop_requested_ = false;
+    for (Connection& c : connections_) close(c.fd);
+    connections_.clear();
+  }
+
+  int listen_fd_ = -1;
+  uint16_t port_ = 0;
+  bool ok_ = false;
+  std::atomic<bool> stop_{false};
+  std::atomic<size_t> accepted_{0};
+  std::thread thread_;
+  std::vector<Connection> connections_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<uint8_t> received_;
+  size_t received_size_ = 0;
+  bool recording_ = true;
+  Responder responder_;
+  bool drop_requested_ = false;
+};
+
+}  // namespace testing
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_TEST_LOOPBACK_PRINTER_H_
@@ -0,0 +1,86 @@
+#include "network_scanner.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "loopback_printer.h"
+
+namespace printer_core {
+namespace {
+
+using testing::LoopbackPrinter;
+
+std::vector<std::string> Scan(const std::string& cidr, const ScanOptions& options) {
+  Ipv4Range range;
+  std::string error;
+  EXPECT_TRUE(ParseCidr(cidr, &range, &error)) << error;
+  std::vector<std::string> hits;
+  EXPECT_TRUE(ScanNetwork({range}, options, [&](const ScanHit& hit) {
+    hits.push_back(hit.host + ":" + std::to_string(hit.port));
+  }, &error)) << error;
+  std::sort(hits.begin(), hits.end());
+  return hits;
+}
+
+TEST(NetworkScannerTest, ParsesCidrRanges) {
+  Ipv4Range range;
+  ASSERT_TRUE(ParseCidr("192.168.1.77/24", &range, nullptr));
+  EXPECT_EQ(FormatIpv4(range.first), "192.168.1.1");
+  EXPECT_EQ(FormatIpv4(range.last), "192.168.1.254");
+  EXPECT_EQ(range.size(), 254u);
+
+  ASSERT_TRUE(ParseCidr("10.0.0.5", &range, nullptr));
+  EXPECT_EQ(range.size(), 1u);
+  ASSERT_TRUE(ParseCidr("10.0.0.4/31", &range, nullptr));
+  EXPECT_EQ(FormatIpv4(range.first), "10.0.0.4");
+  EXPECT_EQ(range.size(), 2u);
+
+  std::string error;
+  EXPECT_FALSE(ParseCidr("10.0.0/24", &range, &error));
+  EXPECT_FALSE(ParseCidr("10.0.0.0/8", &range, &error));
+  EXPECT_FALSE(ParseCidr("10.0.0.0/x", &range, &error));
+}
+
+TEST(NetworkScannerTest, FindsListenersOnLoopbackAliases) {
+  LoopbackPrinter first("127.0.0.2");
+  ASSERT_TRUE(first.ok());
+  LoopbackPrinter second("127.0.0.5", first.port());
+  ASSERT_TRUE(second.ok());
+
+  ScanOptions options;
+  options.ports = {first.port()};
+  const std::string port = std::to_string(first.port());
+  EXPECT_EQ(Scan("127.0.0.0/29", options),
+            (std::vector<std::string>{"127.0.0.2:" + port, "127.0.0.5:" + port}));
+}
+
+TEST(NetworkScannerTest, ScansWholeSubnetWithinTimeout) {
+  LoopbackPrinter printer("127.0.1.77");
+  ASSERT_TRUE(printer.ok());
+
+  // 254 hosts x 3 ports, all in flight at once; refused connects finish
+  // long before the per-connect timeout.
+  ScanOptions options;
+  options.ports = {9, printer.port(), 7};
+  options.timeout_ms = 1000;
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<std::string> hits = Scan("127.0.1.0/24", options);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(hits, std::vector<std::string>{"127.0.1.77:" + std::to_string(printer.port())});
+  EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+}
+
+TEST(NetworkScannerTest, CancelStopsTheScan) {
+  std::atomic<bool> cancel{true};
+  ScanOptions options;
+  options.cancel = &cancel;
+  EXPECT_TRUE(Scan("127.0.2.0/24", options).empty());
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,191 @@
+#include "nv_logo.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "loopback_printer.h"
+
+namespace printer_core {
+namespace {
+
+using testing::LoopbackPrinter;
+
+MonoBitmap Blank(int width, int height) {
+  MonoBitmap bitmap;
+  bitmap.width = width;
+  bitmap.height = height;
+  bitmap.bytes_per_row = (width + 7) / 8;
+  bitmap.bits.assign(static_cast<size_t>(bitmap.bytes_per_row) * height, 0);
+  return bitmap;
+}
+
+RasterLogo Logo(uint64_t hash) {
+  RasterLogo logo;
+  logo.key = LogoKey{hash, 16, DitherMode::kThreshold};
+  logo.bitmap = Blank(16, 2);
+  logo.raster = RasterBlock(logo.bitmap);
+  return logo;
+}
+
+bool StartsWith(const std::vector<uint8_t>& bytes, std::vector<uint8_t> prefix) {
+  return bytes.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), bytes.begin());
+}
+
+// A scratch directory holding the saved table, removed at the end of the
+// test.
+class TableDir {
+ public:
+  TableDir() {
+    char path[] = "/tmp/printer_core_XXXXXX";
+    dir_ = mkdtemp(path) ? path : "";
+    path_ = dir_ + "/nv_logos.txt";
+  }
+  ~TableDir() {
+    unlink(path_.c_str());
+    unlink((path_ + ".tmp").c_str());
+    rmdir(dir_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string dir_;
+  std::string path_;
+};
+
+TEST(NvLogoTest, ParsesLogoStorage) {
+  NvLogoSupport support = NvLogoSupport::kNone;
+  EXPECT_TRUE(ParseLogoStorage("auto", &support));
+  EXPECT_EQ(support, NvLogoSupport::kUnknown);
+  EXPECT_TRUE(ParseLogoStorage("nv_graphics", &support));
+  EXPECT_EQ(support, NvLogoSupport::kGraphics);
+  EXPECT_TRUE(ParseLogoStorage("nv_bit_image", &support));
+  EXPECT_EQ(support, NvLogoSupport::kBitImage);
+  EXPECT_TRUE(ParseLogoStorage("raster", &support));
+  EXPECT_EQ(support, NvLogoSupport::kNone);
+  EXPECT_FALSE(ParseLogoStorage("flash", &support));
+}
+
+TEST(NvLogoTest, DefinesAndPrintsNvGraphics) {
+  MonoBitmap bitmap = Blank(16, 2);
+  bitmap.bits = {0x80, 0x01, 0xFF, 0x00};
+  std::vector<uint8_t> out;
+  AppendNvLogoDefine(bitmap, NvLogoSupport::kGraphics, &out);
+  EXPECT_EQ(out, (std::vector<uint8_t>{0x1D, '(', 'L', 15, 0, 48, 67, 48, 'E', 'L', 1, 16, 0,
+                                       2, 0, 49, 0x80, 0x01, 0xFF, 0x00}));
+  EXPECT_EQ(NvLogoPrintBlock(NvLogoSupport::kGraphics),
+            (std::vector<uint8_t>{0x1B, 'a', 1, 0x1D, '(', 'L', 6, 0, 48, 69, 'E', 'L', 1, 1,
+                                  '\n', 0x1B, 'a', 0}));
+
+  // Too big for a 16-bit count: GS 8 L with a 32-bit one.
+  out.clear();
+  AppendNvLogoDefine(Blank(576, 1000), NvLogoSupport::kGraphics, &out);
+  EXPECT_TRUE(StartsWith(out, {0x1D, '8', 'L', 0x4B, 0x19, 0x01, 0x00, 48, 67}));
+  EXPECT_EQ(out.size(), 7 + 11 + 72 * 1000u);
+}
+
+TEST(NvLogoTest, BitImagesAreColumnMajor) {
+  // Dots at the top left and in row 8 of the last column.
+  MonoBitmap bitmap = Blank(8, 9);
+  bitmap.bits[0] = 0x80;
+  bitmap.bits[8] = 0x01;
+  std::vector<uint8_t> out;
+  AppendNvLogoDefine(bitmap, NvLogoSupport::kBitImage, &out);
+  // One byte wide, two bands tall; each column is two bytes.
+  ASSERT_EQ(out.size(), 7 + 16u);
+  EXPECT_TRUE(StartsWith(out, {0x1C, 'q', 1, 1, 0, 2, 0}));
+  EXPECT_EQ(out[7], 0x80);
+  EXPECT_EQ(out[7 + 7 * 2 + 1], 0x80);
+  EXPECT_EQ(NvLogoPrintBlock(NvLogoSupport::kBitImage),
+            (std::vector<uint8_t>{0x1B, 'a', 1, 0x1C, 'p', 1, 0, '\n', 0x1B, 'a', 0}));
+}
+
+TEST(NvLogoTest, UploadsOnceThenPrintsByKey) {
+  NvLogoStore store("", OpenDefaultTransport);
+  const RasterLogo logo = Logo(1);
+  bool upload = true;
+  // Nothing known about the printer: raster.
+  EXPECT_EQ(store.Block("10.0.0.1:9100", logo, &upload), logo.raster);
+  EXPECT_FALSE(upload);
+
+  store.SetSupport("10.0.0.1:9100", NvLogoSupport::kGraphics);
+  std::vector<uint8_t> first = store.Block("10.0.0.1:9100", logo, &upload);
+  EXPECT_TRUE(upload);
+  EXPECT_TRUE(StartsWith(first, {0x1D, '(', 'L'}));
+  // A second receipt before the upload has printed does not upload again.
+  EXPECT_EQ(store.Block("10.0.0.1:9100", logo, &upload), logo.raster);
+  EXPECT_FALSE(upload);
+
+  // A failed upload is retried.
+  store.FinishUpload("10.0.0.1:9100", logo.key, false);
+  store.Block("10.0.0.1:9100", logo, &upload);
+  EXPECT_TRUE(upload);
+  store.FinishUpload("10.0.0.1:9100", logo.key, true);
+  EXPECT_EQ(store.Block("10.0.0.1:9100", logo, &upload),
+            NvLogoPrintBlock(NvLogoSupport::kGraphics));
+  EXPECT_FALSE(upload);
+
+  // A new logo version replaces the stored one.
+  store.Block("10.0.0.1:9100", Logo(2), &upload);
+  EXPECT_TRUE(upload);
+}
+
+TEST(NvLogoTest, RemembersStoredLogosAcrossRestarts) {
+  TableDir dir;
+  const RasterLogo logo = Logo(0xFEEDFACECAFEBEEF);
+  {
+    NvLogoStore store(dir.path(), OpenDefaultTransport);
+    std::string error;
+    ASSERT_TRUE(store.Load(&error)) << error;
+    store.SetSupport("/dev/usb/lp0", NvLogoSupport::kBitImage);
+    store.SetSupport("10.0.0.2:9100", NvLogoSupport::kNone);
+    bool upload = false;
+    store.Block("/dev/usb/lp0", logo, &upload);
+    store.FinishUpload("/dev/usb/lp0", logo.key, true);
+  }
+  NvLogoStore store(dir.path(), OpenDefaultTransport);
+  std::string error;
+  ASSERT_TRUE(store.Load(&error)) << error;
+  EXPECT_EQ(store.support("10.0.0.2:9100"), NvLogoSupport::kNone);
+  bool upload = true;
+  EXPECT_EQ(store.Block("/dev/usb/lp0", logo, &upload),
+            NvLogoPrintBlock(NvLogoSupport::kBitImage));
+  EXPECT_FALSE(upload);
+}
+
+TEST(NvLogoTest, ProbesNvGraphicsCapacity) {
+  LoopbackPrinter capable;
+  capable.set_responder([](const uint8_t* data, size_t size) {
+    const std::vector<uint8_t> request = {0x1D, '(', 'L', 2, 0, 48, 48};
+    if (std::vector<uint8_t>(data, data + size) != request) return std::vector<uint8_t>();
+    return std::vector<uint8_t>{0x37, 0x30, '2', '5', '6', 0};
+  });
+  LoopbackPrinter silent;
+  uint16_t closed_port;
+  {
+    LoopbackPrinter gone;
+    closed_port = gone.port();
+  }
+
+  NvLogoStore store("", OpenDefaultTransport);
+  const PrinterTarget capable_target = PrinterTarget::Network("127.0.0.1", capable.port());
+  const PrinterTarget silent_target = PrinterTarget::Network("127.0.0.1", silent.port());
+  const PrinterTarget gone_target = PrinterTarget::Network("127.0.0.1", closed_port);
+  store.Probe(capable_target, 1000);
+  store.Probe(silent_target, 100);
+  store.Probe(gone_target, 100);
+  store.WaitForProbes();
+  EXPECT_EQ(store.support(capable_target.Key()), NvLogoSupport::kGraphics);
+  EXPECT_EQ(store.support(silent_target.Key()), NvLogoSupport::kNone);
+  // Unreachable printers are asked again later.
+  EXPECT_EQ(store.support(gone_target.Key()), NvLogoSupport::kUnknown);
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,426 @@
+#include "print_job_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test/loopback_printer.h"
+
+namespace printer_core {
+namespace {
+
+using testing::LoopbackPrinter;
+
+std::vector<uint8_t> Bytes(const std::string& s) {
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+TEST(PrintJobQueueTest, SubmitReturnsImmediatelyAndDeliversBytes) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  PrintJobQueue queue(2);
+
+  std::promise<PrintJobResult> done;
+  PrintJob job{PrinterTarget::Network("127.0.0.1", printer.port()),
+               Bytes("\x1B@Hello\n")};
+  const uint64_t id = queue.Submit(std::move(job), [&](const PrintJobResult& r) {
+    done.set_value(r);
+  });
+  EXPECT_NE(0u, id);
+
+  auto future = done.get_future();
+  ASSERT_EQ(std::future_status::ready,
+            future.wait_for(std::chrono::seconds(5)));
+  const PrintJobResult result = future.get();
+  EXPECT_EQ(id, result.job_id);
+  EXPECT_TRUE(result.success) << result.error;
+  EXPECT_EQ(8u, result.bytes_written);
+  ASSERT_TRUE(printer.WaitForBytes(8));
+  EXPECT_EQ(Bytes("\x1B@Hello\n"), printer.received());
+}
+
+TEST(PrintJobQueueTest, WritesBorrowedBytesInPlace) {
+  class PointerTransport : public PrinterTransport {
+   public:
+    explicit PointerTransport(const uint8_t** seen) : seen_(seen) {}
+    bool Write(const uint8_t* data, size_t, std::string*) override {
+      *seen_ = data;
+      return true;
+    }
+   private:
+    const uint8_t** seen_;
+  };
+  const uint8_t* seen = nullptr;
+  PrintJobQueue queue(1, [&](const PrinterTarget&, std::string*) {
+    return std::unique_ptr<PrinterTransport>(new PointerTransport(&seen));
+  });
+
+  auto owner = std::make_shared<std::vector<uint8_t>>(Bytes("\x1B@raw\n"));
+  const std::weak_ptr<std::vector<uint8_t>> watch = owner;
+  PrintJob job;
+  job.target = PrinterTarget::Custom("front");
+  job.borrowed_data = owner->data();
+  job.borrowed_size = owner->size();
+  job.borrowed_owner = std::move(owner);
+  const uint8_t* const expected = job.bytes();
+  std::promise<PrintJobResult> done;
+  queue.Submit(std::move(job), [&](const PrintJobResult& r) { done.set_value(r); });
+  const PrintJobResult result = done.get_future().get();
+  EXPECT_TRUE(result.success) << result.error;
+  EXPECT_EQ(6u, result.bytes_written);
+  EXPECT_EQ(expected, seen);
+  queue.Shutdown();
+  // Released with the job
+  EXPECT_TRUE(watch.expired());
+}
+
+TEST(PrintJobQueueTest, ReportsConnectFailure) {
+  // Grab a free port, then close the listener so connects are refused.
+  uint16_t port;
+  {
+    LoopbackPrinter closed;
+    port = closed.port();
+  }
+  PrintJobQueue queue(1);
+  std::promise<PrintJobResult> done;
+  PrintJob job{PrinterTarget::Network("127.0.0.1", port), Bytes("x")};
+  job.target.connect_timeout_ms = 500;
+  queue.Submit(std::move(job), [&](const PrintJobResult& r) { done.set_value(r); });
+  const PrintJobResult result = done.get_future().get();
+  EXPECT_FALSE(result.success);
+  EXPECT_FALSE(result.error.empty());
+}
+
+TEST(PrintJobQueueTest, KeepsSubmissionOrderPerPrinter) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  std::string expected;
+  {
+    PrintJobQueue queue(4);
+    for (int i = 0; i < 20; ++i) {
+      const std::string payload = "job" + std::to_string(i) + ";";
+      expected += payload;
+      queue.Submit(PrintJob{PrinterTarget::Network("127.0.0.1", printer.port()),
+                            Bytes(payload)},
+                   nullptr);
+    }
+    queue.Shutdown();  // drains the queue
+  }
+  ASSERT_TRUE(printer.WaitForBytes(expected.size()));
+  const std::vector<uint8_t> got = printer.received();
+  EXPECT_EQ(expected, std::string(got.begin(), got.end()));
+}
+
+TEST(PrintJobQueueTest, RunsDifferentPrintersInParallel) {
+  std::mutex mutex;
+  int running = 0;
+  int max_running = 0;
+  class SlowTransport : public PrinterTransport {
+   public:
+    explicit SlowTransport(std::function<void()> on_write) : on_write_(on_write) {}
+    bool Write(const uint8_t*, size_t, std::string*) override {
+      on_write_();
+      return true;
+    }
+   private:
+    std::function<void()> on_write_;
+  };
+  auto factory = [&](const PrinterTarget&, std::string*) {
+    return std::unique_ptr<PrinterTransport>(new SlowTransport([&] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_running = std::max(max_running, ++running);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      std::lock_guard<std::mutex> lock(mutex);
+      --running;
+    }));
+  };
+  PrintJobQueue queue(2, factory);
+  queue.Submit(PrintJob{PrinterTarget::Custom("front"), Bytes("a")}, nullptr);
+  queue.Submit(PrintJob{PrinterTarget::Custom("kitchen"), Bytes("b")}, nullptr);
+  queue.Shutdown();
+  EXPECT_EQ(2, max_running);
+}
+
+// Records every write in order; the first write blocks until Open() so tests
+// can line up jobs behind a busy printer.
+class GatedPrinter {
+ public:
+  TransportFactory factory() {
+    return [this](const PrinterTarget&, std::string*) {
+      return std::unique_ptr<PrinterTransport>(new Transport(this));
+    };
+  }
+
+  void Open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = true;
+    cv_.notify_all();
+  }
+
+  // Waits until the first write is blocked on the gate.
+  void WaitForFirstWrite() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return !writes_.empty(); });
+  }
+
+  std::vector<std::string> writes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writes_;
+  }
+
+ private:
+  class Transport : public PrinterTransport {
+   public:
+    explicit Transport(GatedPrinter* printer) : printer_(printer) {}
+    bool Write(const uint8_t* data, size_t size, std::string*) override {
+      std::unique_lock<std::mutex> lock(printer_->mutex_);
+      printer_->writes_.emplace_back(reinterpret_cast<const char*>(data), size);
+      printer_->cv_.notify_all();
+      printer_->cv_.wait(lock, [&] { return printer_->open_; });
+      return true;
+    }
+
+   private:
+    GatedPrinter* printer_;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool open_ = false;
+  std::vector<std::string> writes_;
+};
+
+PrintJob Job(const std::string& payload, JobPriority priority) {
+  PrintJob job{PrinterTarget::Custom("front"), Bytes(payload)};
+  job.priority = priority;
+  return job;
+}
+
+TEST(PrintJobQueueTest, ServesHigherClassesFirstOnBusyPrinter) {
+  GatedPrinter printer;
+  PrintJobQueue queue(2, printer.factory());
+  queue.Submit(Job("first", JobPriority::kReceipt), nullptr);
+  printer.WaitForFirstWrite();
+
+  queue.Submit(Job("report", JobPriority::kReport), nullptr);
+  queue.Submit(Job("kitchen", JobPriority::kKitchen), nullptr);
+  queue.Submit(Job("receipt1", JobPriority::kReceipt), nullptr);
+  queue.Submit(Job("drawer", JobPriority::kDrawer), nullptr);
+  queue.Submit(Job("receipt2", JobPriority::kReceipt), nullptr);
+  printer.Open();
+  queue.Shutdown();
+
+  const std::vector<std::string> expected = {
+      "first", "drawer", "receipt1", "receipt2", "kitchen", "report"};
+  EXPECT_EQ(expected, printer.writes());
+}
+
+TEST(PrintJobQueueTest, PreemptsLargeJobBetweenChunks) {
+  GatedPrinter printer;
+  PrintJobQueue queue(2, printer.factory());
+  PrintJob report = Job("line1\nline2\nline3\n", JobPriority::kReport);
+  report.break_points = {6, 12};
+
+  std::promise<PrintJobResult> report_done;
+  queue.Submit(std::move(report),
+               [&](const PrintJobResult& r) { report_done.set_value(r); });
+  printer.WaitForFirstWrite();
+  queue.Submit(Job("drawer", JobPriority::kDrawer), nullptr);
+  queue.Submit(Job("kitchen", JobPriority::kKitchen), nullptr);
+  printer.Open();
+  queue.Shutdown();
+
+  const std::vector<std::string> expected = {
+      "line1\n", "drawer", "kitchen", "line2\n", "line3\n"};
+  EXPECT_EQ(expected, printer.writes());
+  const PrintJobResult result = report_done.get_future().get();
+  EXPECT_TRUE(result.success);
+  EXPECT_EQ(18u, result.bytes_written);
+
+  const PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(1u, stats[static_cast<size_t>(JobPriority::kDrawer)].preemptions);
+  EXPECT_EQ(1u, stats[static_cast<size_t>(JobPriority::kKitchen)].preemptions);
+}
+
+TEST(PrintJobQueueTest, ReportsDepthAndWaitPerClass) {
+  GatedPrinter printer;
+  PrintJobQueue queue(1, printer.factory());
+  queue.Submit(Job("a", JobPriority::kReceipt), nullptr);
+  printer.WaitForFirstWrite();
+  queue.Submit(Job("b", JobPriority::kKitchen), nullptr);
+  queue.Submit(Job("c", JobPriority::kKitchen), nullptr);
+  queue.Submit(Job("d", JobPriority::kReport), nullptr);
+
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(0u, stats[static_cast<size_t>(JobPriority::kReceipt)].depth);
+  EXPECT_EQ(1u, stats[static_cast<size_t>(JobPriority::kReceipt)].started);
+  EXPECT_EQ(2u, stats[static_cast<size_t>(JobPriority::kKitchen)].depth);
+  EXPECT_EQ(1u, stats[static_cast<size_t>(JobPriority::kReport)].depth);
+  EXPECT_EQ(4u, queue.pending());
+  EXPECT_TRUE(queue.IsBusy(PrinterTarget::Custom("front")));
+  EXPECT_FALSE(queue.IsBusy(PrinterTarget::Custom("back")));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  printer.Open();
+  queue.Shutdown();
+  EXPECT_FALSE(queue.IsBusy(PrinterTarget::Custom("front")));
+  stats = queue.stats();
+  const PriorityClassStats& kitchen = stats[static_cast<size_t>(JobPriority::kKitchen)];
+  EXPECT_EQ(0u, kitchen.depth);
+  EXPECT_EQ(2u, kitchen.started);
+  EXPECT_GE(kitchen.max_wait, std::chrono::milliseconds(20));
+  EXPECT_GE(kitchen.total_wait, kitchen.max_wait);
+}
+
+TEST(PrintJobQueueTest, LineBreakPointsKeepMinimumChunk) {
+  const std::vector<uint8_t> data = Bytes("\x1B@ab\ncd\nefgh\nij\n");
+  EXPECT_EQ((std::vector<size_t>{5, 8, 13}), LineBreakPoints(data, 1));
+  EXPECT_EQ((std::vector<size_t>{5, 13}), LineBreakPoints(data, 5));
+  EXPECT_TRUE(LineBreakPoints(data, 100).empty());
+  // Without ESC @ the printer's state is unknown
+  EXPECT_TRUE(LineBreakPoints(Bytes("ab\ncd\nefgh\nij\n"), 1).empty());
+}
+
+TEST(PrintJobQueueTest, LineBreakPointsSkipLineFeedsInsideRasterData) {
+  // GS v 0: one byte wide, three rows, the middle row a 0x0A
+  const std::vector<uint8_t> data = {0x1B, '@', 0x1D, 'v', '0', 0, 1, 0, 3, 0,
+                                     0xFF, '\n', 0x00, '\n', 'a', 'b', '\n'};
+  EXPECT_EQ((std::vector<size_t>{14}), LineBreakPoints(data, 1));
+}
+
+TEST(PrintJobQueueTest, LineBreakPointsWaitForSettingsToBeUndone) {
+  const char kStream[] =
+      "\x1B@\x1B" "a\x01" "ab\n"  // centred
+      "\x1B" "a\x00" "cd\n"        // back to left
+      "\x1Bt\x13" "ef\n"           // code table holds until ESC @
+      "\x1B@gh\nij\n";
+  const std::vector<uint8_t> data(kStream, kStream + sizeof(kStream) - 1);
+  EXPECT_EQ((std::vector<size_t>{14, 25}), LineBreakPoints(data, 1));
+}
+
+TEST(PrintJobQueueTest, SetsPreemptPointsOnlyOnLargeJobs) {
+  PrintJob job{PrinterTarget::Custom("front"), Bytes("\x1B@ab\ncd\nefgh\nij\n")};
+  SetPreemptPoints(&job, 5);
+  EXPECT_EQ((std::vector<size_t>{5, 13}), job.break_points);
+  PrintJob small{PrinterTarget::Custom("front"), Bytes("\x1B@ab\ncd\n")};
+  SetPreemptPoints(&small);
+  EXPECT_TRUE(small.break_points.empty());
+}
+
+TEST(PrintJobQueueTest, SendsBatchOverOneConnectionPerPrinter) {
+  LoopbackPrinter front;
+  LoopbackPrinter kitchen;
+  ASSERT_TRUE(front.ok());
+  ASSERT_TRUE(kitchen.ok());
+  std::vector<PrintJob> jobs;
+  jobs.push_back(PrintJob{PrinterTarget::Network("127.0.0.1", front.port()), Bytes("merchant;")});
+  jobs.push_back(PrintJob{PrinterTarget::Network("127.0.0.1", kitchen.port()), Bytes("ticket;")});
+  jobs.push_back(PrintJob{PrinterTarget::Network("127.0.0.1", front.port()), Bytes("customer;")});
+  jobs.push_back(PrintJob{PrinterTarget::Network("127.0.0.1", front.port()), Bytes("summary;")});
+
+  std::mutex mutex;
+  std::vector<PrintJobResult> results;
+  std::vector<uint64_t> ids;
+  {
+    PrintJobQueue queue(2);
+    ids = queue.SubmitBatch(std::move(jobs), [&](const PrintJobResult& r) {
+      std::lock_guard<std::mutex> lock(mutex);
+      results.push_back(r);
+    });
+    queue.Shutdown();
+  }
+
+  ASSERT_EQ(4u, ids.size());
+  ASSERT_EQ(4u, results.size());
+  for (const PrintJobResult& r : results) {
+    EXPECT_TRUE(r.success) << r.error;
+    EXPECT_NE(ids.end(), std::find(ids.begin(), ids.end(), r.job_id));
+    if (r.job_id == ids[0]) EXPECT_EQ(9u, r.bytes_written);
+    if (r.job_id == ids[1]) EXPECT_EQ(7u, r.bytes_written);
+  }
+  ASSERT_TRUE(front.WaitForBytes(26));
+  ASSERT_TRUE(kitchen.WaitForBytes(7));
+  EXPECT_EQ(Bytes("merchant;customer;summary;"), front.received());
+  EXPECT_EQ(Bytes("ticket;"), kitchen.received());
+  EXPECT_EQ(1u, front.accepted());
+  EXPECT_EQ(1u, kitchen.accepted());
+}
+
+TEST(PrintJobQueueTest, FailsEveryJobOfBatchWhenPrinterIsDown) {
+  uint16_t port;
+  {
+    LoopbackPrinter closed;
+    port = closed.port();
+  }
+  std::vector<PrintJob> jobs;
+  for (int i = 0; i < 3; ++i) {
+    jobs.push_back(PrintJob{PrinterTarget::Network("127.0.0.1", port), Bytes("x")});
+  }
+  std::vector<PrintJobResult> results;
+  {
+    PrintJobQueue queue(1);
+    queue.SubmitBatch(std::move(jobs), [&](const PrintJobResult& r) { results.push_back(r); });
+    queue.Shutdown();
+  }
+  ASSERT_EQ(3u, results.size());
+  for (const PrintJobResult& r : results) {
+    EXPECT_FALSE(r.success);
+    EXPECT_FALSE(r.error.empty());
+  }
+}
+
+TEST(PrintJobQueueTest, TracesWaitConnectAndEachChunk) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  JobTracer tracer;
+  PrintJobQueue queue(1);
+  queue.set_tracer(&tracer);
+
+  PrintJob job{PrinterTarget::Network("127.0.0.1", printer.port()), Bytes("line 1\nsecond line\n")};
+  job.break_points = {7};
+  job.trace_id = tracer.BeginJob();
+  std::promise<PrintJobResult> done;
+  queue.Submit(std::move(job), [&](const PrintJobResult& r) { done.set_value(r); });
+  const PrintJobResult result = done.get_future().get();
+  ASSERT_TRUE(result.success) << result.error;
+  EXPECT_GE(tracer.FinishJob(result.trace_id), 0);
+
+  const std::string json = tracer.Export(result.trace_id);
+  auto count = [&json](const std::string& text) {
+    size_t n = 0;
+    for (size_t at = json.find(text); at != std::string::npos; at = json.find(text, at + 1)) ++n;
+    return n;
+  };
+  EXPECT_EQ(1u, count("\"name\":\"queue\""));
+  EXPECT_EQ(1u, count("\"name\":\"connect\""));
+  EXPECT_EQ(2u, count("\"name\":\"write\""));
+  EXPECT_EQ(1u, count("\"bytes\":7}"));
+  EXPECT_EQ(1u, count("\"bytes\":12}"));
+  EXPECT_EQ(1u, count("\"name\":\"job\""));
+  // Jobs without a trace id record nothing
+  std::promise<PrintJobResult> untraced;
+  queue.Submit(PrintJob{PrinterTarget::Network("127.0.0.1", printer.port()), Bytes("x")},
+               [&](const PrintJobResult& r) { untraced.set_value(r); });
+  EXPECT_EQ(0u, untraced.get_future().get().trace_id);
+  EXPECT_EQ(json, tracer.Export());
+}
+
+TEST(PrintJobQueueTest, RejectsJobsAfterShutdown) {
+  PrintJobQueue queue(1);
+  queue.Shutdown();
+  EXPECT_EQ(0u, queue.Submit(PrintJob{PrinterTarget::Custom("x"), {}}, nullptr));
+  EXPECT_EQ(0u, queue.pending());
+}
+
+}  // namespace
+}  // namespace printer_core
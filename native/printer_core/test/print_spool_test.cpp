@@ -0,0 +1,225 @@
+#include "print_spool.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+// A scratch directory holding one spool file, removed at the end of the test.
+class SpoolDir {
+ public:
+  SpoolDir() {
+    char path[] = "/tmp/printer_core_XXXXXX";
+    dir_ = mkdtemp(path) ? path : "";
+    path_ = dir_ + "/spool.bin";
+  }
+  ~SpoolDir() {
+    unlink(path_.c_str());
+    unlink((path_ + ".tmp").c_str());
+    rmdir(dir_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string dir_;
+  std::string path_;
+};
+
+PrintJob Job(const std::string& host, const std::string& text) {
+  PrintJob job{PrinterTarget::Network(host, 9100), std::vector<uint8_t>(text.begin(), text.end())};
+  return job;
+}
+
+std::unique_ptr<PrintSpool> OpenSpool(const std::string& path,
+                                      PrintSpoolOptions options = PrintSpoolOptions()) {
+  std::string error;
+  std::unique_ptr<PrintSpool> spool = PrintSpool::Open(path, options, &error);
+  EXPECT_TRUE(spool) << error;
+  return spool;
+}
+
+TEST(PrintSpoolTest, SpoolsOnlyJobsThatPrint) {
+  EXPECT_TRUE(ShouldSpool(Job("10.0.0.1", "receipt")));
+  EXPECT_FALSE(ShouldSpool(Job("10.0.0.1", "")));
+  PrintJob drawer = Job("10.0.0.1", "\x1Bp0\x19\xFA");
+  drawer.priority = JobPriority::kDrawer;
+  EXPECT_FALSE(ShouldSpool(drawer));
+}
+
+TEST(PrintSpoolTest, RecoversUnfinishedJobs) {
+  SpoolDir dir;
+  uint64_t receipt_id, ticket_id;
+  {
+    auto spool = OpenSpool(dir.path());
+    ASSERT_TRUE(spool);
+    EXPECT_TRUE(spool->TakeRecovered().empty());
+    PrintJob receipt = Job("192.168.1.50", "\x1B@Receipt\n");
+    receipt.break_points = {3, 11};
+    receipt.target.connect_timeout_ms = 1234;
+    receipt_id = spool->Append(receipt);
+    const uint64_t drawer_id = spool->Append(Job("192.168.1.50", "\x1Bp0\x19\xFA"));
+    PrintJob ticket{PrinterTarget::Device("/dev/usb/lp0"), {'K', '\n'}};
+    ticket.priority = JobPriority::kKitchen;
+    ticket_id = spool->Append(ticket);
+    EXPECT_NE(receipt_id, 0u);
+    EXPECT_NE(drawer_id, receipt_id);
+    spool->Complete(drawer_id);
+    spool->Flush();
+    EXPECT_EQ(spool->stats().live, 2u);
+  }
+
+  auto spool = OpenSpool(dir.path());
+  ASSERT_TRUE(spool);
+  std::vector<SpooledJob> recovered = spool->TakeRecovered();
+  ASSERT_EQ(recovered.size(), 2u);
+  EXPECT_EQ(recovered[0].id, receipt_id);
+  EXPECT_EQ(recovered[0].job.target.host, "192.168.1.50");
+  EXPECT_EQ(recovered[0].job.target.connect_timeout_ms, 1234);
+  EXPECT_EQ(recovered[0].job.data, Job("", "\x1B@Receipt\n").data);
+  EXPECT_EQ(recovered[0].job.break_points, (std::vector<size_t>{3, 11}));
+  EXPECT_EQ(recovered[1].id, ticket_id);
+  EXPECT_EQ(recovered[1].job.target.kind, PrinterTarget::Kind::kDevice);
+  EXPECT_EQ(recovered[1].job.target.device, "/dev/usb/lp0");
+  EXPECT_EQ(recovered[1].job.priority, JobPriority::kKitchen);
+  EXPECT_EQ(spool->stats().recovered, 2u);
+  EXPECT_TRUE(spool->TakeRecovered().empty());
+  // Ids keep growing so a recovered id is never reused.
+  EXPECT_GT(spool->Append(Job("10.0.0.1", "x")), ticket_id);
+}
+
+TEST(PrintSpoolTest, RecordsBorrowedBytes) {
+  SpoolDir dir;
+  const std::string raw = "\x1B@raw\n";
+  {
+    auto spool = OpenSpool(dir.path());
+    PrintJob job = Job("10.0.0.1", "");
+    job.borrowed_data = reinterpret_cast<const uint8_t*>(raw.data());
+    job.borrowed_size = raw.size();
+    ASSERT_TRUE(ShouldSpool(job));
+    EXPECT_NE(spool->Append(job), 0u);
+    spool->Flush();
+  }
+  auto reopened = OpenSpool(dir.path());
+  const std::vector<SpooledJob> recovered = reopened->TakeRecovered();
+  ASSERT_EQ(recovered.size(), 1u);
+  EXPECT_EQ(recovered[0].job.data, std::vector<uint8_t>(raw.begin(), raw.end()));
+}
+
+TEST(PrintSpoolTest, RecoveredJobsStayUntilCompleted) {
+  SpoolDir dir;
+  uint64_t id;
+  {
+    auto spool = OpenSpool(dir.path());
+    id = spool->Append(Job("10.0.0.1", "receipt"));
+  }
+  {
+    auto spool = OpenSpool(dir.path());
+    ASSERT_EQ(spool->TakeRecovered().size(), 1u);
+  }
+  {
+    // Crashed again before printing it: still there.
+    auto spool = OpenSpool(dir.path());
+    ASSERT_EQ(spool->TakeRecovered().size(), 1u);
+    spool->Complete(id);
+  }
+  auto spool = OpenSpool(dir.path());
+  EXPECT_TRUE(spool->TakeRecovered().empty());
+}
+
+TEST(PrintSpoolTest, StopsAtTornRecord) {
+  SpoolDir dir;
+  {
+    auto spool = OpenSpool(dir.path());
+    spool->Append(Job("10.0.0.1", "first"));
+    spool->Append(Job("10.0.0.1", "second"));
+  }
+  // Flip the last payload byte of the second record, as if power went out
+  // half way through writing it.
+  FILE* f = std::fopen(dir.path().c_str(), "r+b");
+  ASSERT_NE(f, nullptr);
+  // Header, first record (24 + 41 bytes, padded to 72), second record header
+  // and its 42-byte payload.
+  const long second_end = 64 + 72 + 24 + 42;
+  std::fseek(f, second_end - 1, SEEK_SET);
+  std::fputc('X', f);
+  std::fclose(f);
+
+  auto spool = OpenSpool(dir.path());
+  std::vector<SpooledJob> recovered = spool->TakeRecovered();
+  ASSERT_EQ(recovered.size(), 1u);
+  EXPECT_EQ(recovered[0].job.data, Job("", "first").data);
+}
+
+TEST(PrintSpoolTest, StartsOverWhenDrained) {
+  SpoolDir dir;
+  PrintSpoolOptions options;
+  options.compact_threshold = 512;
+  {
+    auto spool = OpenSpool(dir.path(), options);
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < 10; ++i) ids.push_back(spool->Append(Job("10.0.0.1", "line\n")));
+    const size_t used = spool->stats().bytes_used;
+    EXPECT_GT(used, options.compact_threshold);
+    for (uint64_t id : ids) spool->Complete(id);
+    EXPECT_EQ(spool->stats().bytes_used, 64u);
+    EXPECT_EQ(spool->stats().live, 0u);
+    spool->Append(Job("10.0.0.2", "after"));
+  }
+  auto spool = OpenSpool(dir.path(), options);
+  std::vector<SpooledJob> recovered = spool->TakeRecovered();
+  ASSERT_EQ(recovered.size(), 1u);
+  EXPECT_EQ(recovered[0].job.target.host, "10.0.0.2");
+}
+
+TEST(PrintSpoolTest, FullJournalRejectsAppend) {
+  SpoolDir dir;
+  PrintSpoolOptions options;
+  options.capacity = 4096;
+  auto spool = OpenSpool(dir.path(), options);
+  const std::string big(2500, 'x');
+  EXPECT_NE(spool->Append(Job("10.0.0.1", big)), 0u);
+  EXPECT_EQ(spool->Append(Job("10.0.0.1", big)), 0u);
+}
+
+TEST(PrintSpoolTest, FullJournalKeepsRoomForEveryDoneRecord) {
+  SpoolDir dir;
+  PrintSpoolOptions options;
+  // Five 160-byte job records fit after the header with one done record to
+  // spare, but not with five.
+  options.capacity = 960;
+  const std::string text(100, 'x');
+  std::vector<uint64_t> ids;
+  {
+    auto spool = OpenSpool(dir.path(), options);
+    for (uint64_t id; (id = spool->Append(Job("10.0.0.1", text))) != 0;) ids.push_back(id);
+    EXPECT_EQ(ids.size(), 4u);
+    for (uint64_t id : ids) spool->Complete(id);
+    spool->Flush();
+  }
+  auto reopened = OpenSpool(dir.path(), options);
+  EXPECT_TRUE(reopened->TakeRecovered().empty());
+}
+
+TEST(PrintSpoolTest, GroupCommitSharesFlushes) {
+  SpoolDir dir;
+  PrintSpoolOptions options;
+  options.commit_delay_ms = 50;
+  auto spool = OpenSpool(dir.path(), options);
+  for (int i = 0; i < 100; ++i) spool->Append(Job("10.0.0.1", "receipt line\n"));
+  spool->Flush();
+  const PrintSpoolStats stats = spool->stats();
+  EXPECT_EQ(stats.appended, 100u);
+  EXPECT_GE(stats.commits, 1u);
+  EXPECT_LT(stats.commits, 10u);
+}
+
+}  // namespace
+}  // namespace printer_core
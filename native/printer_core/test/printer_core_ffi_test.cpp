@@ -0,0 +1,142 @@
+#include "ffi/printer_core_ffi.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "logo_raster.h"
+#include "receipt_blob.h"
+
+namespace printer_core {
+namespace {
+
+ReceiptDocument SampleReceipt() {
+  ReceiptDocument doc;
+  doc.title = "EXTROPOS CAF\xC3\x89";
+  doc.items = {{"Nasi Lemak", 2, 8.5}, {"Teh Tarik", 1, 3.2}};
+  doc.subtotal = 20.2;
+  doc.total = 21.41;
+  doc.qr_data = "https://myinvois.hasil.gov.my/abc";
+  return doc;
+}
+
+std::string EncoderBytes(const pc_encoder* encoder) {
+  return std::string(reinterpret_cast<const char*>(pc_encoder_data(encoder)),
+                     pc_encoder_size(encoder));
+}
+
+std::string AsString(const std::vector<uint8_t>& bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(PrinterCoreFfiTest, EncodesLikeTheEncoder) {
+  EXPECT_EQ(PC_ABI_VERSION, pc_abi_version());
+  pc_encoder* encoder = pc_encoder_new(42);
+  ASSERT_NE(nullptr, encoder);
+  const pc_profile profile = {0, 1, 384, PC_CODE_PAGE_CP858, PC_CODE_PAGE_NONE};
+  ASSERT_EQ(PC_OK, pc_encoder_set_profile(encoder, &profile));
+  const std::string header = "Jalan Ampang\nTel 03-1234 5678";
+  ASSERT_EQ(PC_OK, pc_encoder_set_store(encoder, header.data(), header.size(), nullptr, 0));
+
+  const ReceiptDocument doc = SampleReceipt();
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(doc, &blob);
+  ASSERT_EQ(PC_OK, pc_encode_receipt(encoder, blob.data(), blob.size()));
+
+  EscPosEncoder expected(42);
+  PrinterProfile expected_profile;
+  expected_profile.native_qr = false;
+  expected_profile.dots_per_line = 384;
+  expected_profile.code_page = CodePage::kCp858;
+  expected.set_profile(expected_profile);
+  StoreSettings store;
+  store.header_lines = {"Jalan Ampang", "Tel 03-1234 5678"};
+  expected.set_store(store);
+  EXPECT_EQ(AsString(expected.EncodeReceipt(doc)), EncoderBytes(encoder));
+
+  const std::string text = "EXTROPOS\nTotal RM 12.00";
+  ASSERT_EQ(PC_OK, pc_encode_text(encoder, text.data(), text.size(),
+                                  PC_TEXT_ALIGN_BLANK_LINES | PC_TEXT_FEED_BEFORE_CUT));
+  EXPECT_EQ(AsString(expected.EncodeText(text)), EncoderBytes(encoder));
+
+  const pc_row rows[] = {
+      {"Nasi Lemak Ayam Goreng Berempah", 31, "RM 17.00", 8, PC_ALIGN_LEFT, 0, 0, 0},
+      {nullptr, 0, nullptr, 0, PC_ALIGN_LEFT, 0, '-', 0},
+  };
+  ASSERT_EQ(PC_OK, pc_encode_rows(encoder, rows, 2));
+  ReceiptRow divider;
+  divider.divider = '-';
+  EXPECT_EQ(AsString(expected.EncodeRows(
+                {{"Nasi Lemak Ayam Goreng Berempah", "RM 17.00"}, divider})),
+            EncoderBytes(encoder));
+  pc_encoder_free(encoder);
+}
+
+TEST(PrinterCoreFfiTest, TakeHandsOverTheOutput) {
+  pc_encoder* encoder = pc_encoder_new(48);
+  const std::string text = "Thank you";
+  ASSERT_EQ(PC_OK, pc_encode_text(encoder, text.data(), text.size(), 0));
+  const uint8_t* data = pc_encoder_data(encoder);
+  const size_t size = pc_encoder_size(encoder);
+
+  pc_buffer* buffer = pc_encoder_take(encoder);
+  ASSERT_NE(nullptr, buffer);
+  EXPECT_EQ(data, pc_buffer_data(buffer));
+  EXPECT_EQ(size, pc_buffer_size(buffer));
+  EXPECT_EQ(0u, pc_encoder_size(encoder));
+
+  // The buffer outlives the encoder
+  pc_encoder_free(encoder);
+  EXPECT_NE(nullptr, std::memchr(pc_buffer_data(buffer), 'T', pc_buffer_size(buffer)));
+  pc_buffer_free(buffer);
+}
+
+TEST(PrinterCoreFfiTest, RejectsInvalidArguments) {
+  EXPECT_EQ(nullptr, pc_encoder_new(0));
+  EXPECT_EQ(PC_INVALID_ARGUMENT, pc_encode_text(nullptr, "a", 1, 0));
+
+  pc_encoder* encoder = pc_encoder_new(48);
+  const pc_profile profile = {1, 1, 576, 9, PC_CODE_PAGE_NONE};
+  EXPECT_EQ(PC_INVALID_ARGUMENT, pc_encoder_set_profile(encoder, &profile));
+  EXPECT_EQ(PC_INVALID_ARGUMENT, pc_encode_text(encoder, nullptr, 4, 0));
+  const pc_row row = {"x", 1, nullptr, 0, 7, 0, 0, 0};
+  EXPECT_EQ(PC_INVALID_ARGUMENT, pc_encode_rows(encoder, &row, 1));
+
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(SampleReceipt(), &blob);
+  EXPECT_EQ(PC_MALFORMED_INPUT, pc_encode_receipt(encoder, blob.data(), blob.size() - 1));
+  EXPECT_EQ(PC_INVALID_ARGUMENT, pc_display_width("a", 1, 3));
+  EXPECT_EQ(nullptr, pc_rasterize_logo(nullptr, 4, 4, 16, PC_PIXELS_RGBA, 384,
+                                       PC_DITHER_THRESHOLD));
+  pc_encoder_free(encoder);
+}
+
+TEST(PrinterCoreFfiTest, MeasuresAndRasterizes) {
+  const std::string text = "Caf\xC3\xA9 \xE4\xB8\xAD";
+  EXPECT_EQ(7, pc_display_width(text.data(), text.size(), 2));
+  EXPECT_EQ(6, pc_display_width(text.data(), text.size(), 1));
+
+  // A black square on white, RGB
+  std::vector<uint8_t> pixels(64 * 32 * 3, 0xFF);
+  for (int y = 8; y < 24; ++y) {
+    for (int x = 16; x < 48; ++x) {
+      std::memset(&pixels[(y * 64 + x) * 3], 0, 3);
+    }
+  }
+  pc_buffer* raster = pc_rasterize_logo(pixels.data(), 64, 32, 64 * 3, PC_PIXELS_RGB, 256,
+                                        PC_DITHER_ORDERED);
+  ASSERT_NE(nullptr, raster);
+  const std::vector<uint8_t> expected = RasterizeLogo(
+      GrayFromPixels(pixels.data(), 64, 32, 64 * 3, PixelLayout::kRgb), 256,
+      DitherMode::kOrdered);
+  EXPECT_EQ(AsString(expected),
+            std::string(reinterpret_cast<const char*>(pc_buffer_data(raster)),
+                        pc_buffer_size(raster)));
+  pc_buffer_free(raster);
+}
+
+}  // namespace
+}  // namespace printer_core
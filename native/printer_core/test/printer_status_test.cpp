@@ -0,0 +1,264 @@
+#include "printer_status.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_pool.h"
+#include "loopback_printer.h"
+#include "status_monitor.h"
+
+namespace printer_core {
+namespace {
+
+using testing::LoopbackPrinter;
+
+TEST(PrinterStatusTest, DecodesRealtimeReplies) {
+  PrinterStatus status;
+  EXPECT_TRUE(DecodeRealtimeStatus(1, 0x1A, &status));  // offline
+  EXPECT_TRUE(DecodeRealtimeStatus(2, 0x16, &status));  // cover open
+  EXPECT_TRUE(DecodeRealtimeStatus(3, 0x1A, &status));  // auto-cutter error
+  EXPECT_TRUE(DecodeRealtimeStatus(4, 0x1E, &status));  // paper near end
+  EXPECT_TRUE(status.reported);
+  EXPECT_TRUE(status.offline);
+  EXPECT_TRUE(status.cover_open);
+  EXPECT_TRUE(status.error);
+  EXPECT_TRUE(status.paper_near_end);
+  EXPECT_FALSE(status.paper_out);
+
+  // Fixed bits must match.
+  EXPECT_FALSE(DecodeRealtimeStatus(1, 0x10, &status));
+  EXPECT_FALSE(DecodeRealtimeStatus(1, 0x92, &status));
+}
+
+TEST(PrinterStatusTest, DecodesAutoStatusBlock) {
+  PrinterStatus status;
+  const uint8_t block[] = {0x30, 0x00, 0x0C, 0x00};  // cover open, paper end
+  ASSERT_TRUE(DecodeAutoStatus(block, &status));
+  EXPECT_TRUE(status.cover_open);
+  EXPECT_TRUE(status.paper_out);
+  EXPECT_FALSE(status.error);
+  status.known = status.reachable = true;
+  EXPECT_STREQ(status.Summary(), "cover_open");
+
+  const uint8_t not_status[] = {0x12, 0x00, 0x00, 0x00};
+  EXPECT_FALSE(DecodeAutoStatus(not_status, &status));
+}
+
+TEST(PrinterStatusTest, ParserSeparatesRepliesFromAutoStatus) {
+  StatusParser parser;
+  parser.ExpectRealtime(1);
+  parser.ExpectRealtime(4);
+  PrinterStatus status;
+  // An automatic status block arrives between the two DLE EOT replies.
+  const uint8_t stream[] = {0x12, 0x10, 0x00, 0x00, 0x00, 0x1E};
+  parser.Feed(stream, 3, &status);
+  parser.Feed(stream + 3, 3, &status);
+  EXPECT_EQ(parser.pending_realtime(), 0u);
+  EXPECT_TRUE(parser.auto_status_seen());
+  EXPECT_TRUE(status.paper_near_end);
+}
+
+TEST(PrinterStatusTest, QueriesLoopbackPrinter) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  printer.set_responder(LoopbackPrinter::StatusResponder({0x12, 0x12, 0x12, 0x7E}));
+
+  std::string error;
+  auto transport =
+      OpenDefaultTransport(PrinterTarget::Network("127.0.0.1", printer.port()), &error);
+  ASSERT_TRUE(transport) << error;
+  PrinterStatus status;
+  QueryPrinterStatus(transport.get(), 1000, &status);
+  EXPECT_TRUE(status.reachable);
+  EXPECT_TRUE(status.reported);
+  EXPECT_TRUE(status.paper_out);
+  EXPECT_STREQ(status.Summary(), "paper_out");
+}
+
+TEST(StatusMonitorTest, ServesCachedStatus) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  printer.set_responder(LoopbackPrinter::StatusResponder({0x12, 0x12, 0x12, 0x1E}));
+
+  ConnectionPoolOptions pool_options;
+  pool_options.maintenance_interval_ms = 0;
+  ConnectionPool pool(pool_options);
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  StatusMonitor monitor([&](const PrinterTarget& t, std::string* e) { return pool.Acquire(t, e); },
+                        options);
+
+  const PrinterTarget target = PrinterTarget::Network("127.0.0.1", printer.port());
+  EXPECT_FALSE(monitor.Get(target).known);
+  monitor.PollNow();
+  PrinterStatus status = monitor.Get(target);
+  EXPECT_TRUE(status.known);
+  EXPECT_TRUE(status.paper_near_end);
+  EXPECT_STREQ(status.Summary(), "paper_near_end");
+
+  // The poll borrowed a pooled connection and gave it back.
+  EXPECT_EQ(pool.stats().idle, 1u);
+
+  monitor.ReportJobResult(target, false, "send failed");
+  EXPECT_STREQ(monitor.Get(target).Summary(), "offline");
+}
+
+TEST(StatusMonitorTest, UnreachablePrinterIsOffline) {
+  uint16_t closed_port;
+  {
+    LoopbackPrinter gone;
+    closed_port = gone.port();
+  }
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  StatusMonitor monitor(OpenDefaultTransport, options);
+  const PrinterTarget target = PrinterTarget::Network("127.0.0.1", closed_port);
+  monitor.Get(target);
+  monitor.PollNow();
+  const PrinterStatus status = monitor.Get(target);
+  EXPECT_TRUE(status.known);
+  EXPECT_FALSE(status.reachable);
+  EXPECT_FALSE(status.last_error.empty());
+}
+
+TEST(StatusMonitorTest, BackgroundPollerFillsCache) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  printer.set_responder(LoopbackPrinter::StatusResponder({0x12, 0x12, 0x12, 0x12}));
+
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 50;
+  StatusMonitor monitor(OpenDefaultTransport, options);
+  const PrinterTarget target = PrinterTarget::Network("127.0.0.1", printer.port());
+  monitor.Get(target);
+  PrinterStatus status;
+  for (int i = 0; i < 100 && !status.known; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    status = monitor.Get(target);
+  }
+  EXPECT_STREQ(status.Summary(), "online");
+  EXPECT_TRUE(status.reported);
+}
+
+TEST(StatusMonitorTest, ListenerHearsOnlyChanges) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  printer.set_responder(LoopbackPrinter::StatusResponder({0x12, 0x12, 0x12, 0x12}));
+
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  StatusMonitor monitor(OpenDefaultTransport, options);
+  std::vector<std::string> heard;
+  monitor.set_listener(
+      [&](const PrinterTarget&, const PrinterStatus& s) { heard.push_back(s.Summary()); });
+
+  const PrinterTarget target = PrinterTarget::Network("127.0.0.1", printer.port());
+  monitor.Watch(target);
+  monitor.PollNow();
+  monitor.PollNow();
+  monitor.ReportJobResult(target, true, "");
+  monitor.ReportJobResult(target, false, "send failed");
+  printer.set_responder(LoopbackPrinter::StatusResponder({0x12, 0x16, 0x12, 0x12}));
+  monitor.PollNow();
+  EXPECT_EQ(heard, (std::vector<std::string>{"online", "offline", "cover_open"}));
+}
+
+TEST(StatusMonitorTest, WatchedPrinterOutlivesWatchTimeout) {
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  options.watch_timeout_ms = 0;
+  int polls = 0;
+  StatusMonitor monitor(
+      [&](const PrinterTarget&, std::string* error) {
+        ++polls;
+        *error = "no printer";
+        return std::unique_ptr<PrinterTransport>();
+      },
+      options);
+
+  const PrinterTarget watched = PrinterTarget::Network("10.0.0.1", 9100);
+  const PrinterTarget asked = PrinterTarget::Network("10.0.0.2", 9100);
+  monitor.Watch(watched);
+  monitor.Get(asked);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  monitor.PollNow();
+  EXPECT_EQ(polls, 1);
+  EXPECT_TRUE(monitor.Get(watched).known);
+
+  monitor.Unwatch(watched);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  polls = 0;
+  monitor.PollNow();
+  EXPECT_EQ(polls, 0);
+}
+
+TEST(StatusMonitorTest, SkipsPrintersWithABusyLane) {
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  int polls = 0;
+  StatusMonitor monitor(
+      [&](const PrinterTarget&, std::string* error) {
+        ++polls;
+        *error = "no printer";
+        return std::unique_ptr<PrinterTransport>();
+      },
+      options);
+  bool printing = true;
+  monitor.set_busy_check([&](const PrinterTarget&) { return printing; });
+
+  const PrinterTarget target = PrinterTarget::Network("10.0.0.1", 9100);
+  monitor.Watch(target);
+  monitor.PollNow();
+  EXPECT_EQ(polls, 0);
+  EXPECT_FALSE(monitor.Get(target).known);
+
+  printing = false;
+  monitor.PollNow();
+  EXPECT_EQ(polls, 1);
+}
+
+TEST(StatusMonitorTest, DecodesAutoStatusFoundOnIdleSockets) {
+  LoopbackPrinter printer;
+  ASSERT_TRUE(printer.ok());
+  // The cover opens while the job prints; the printer says so on its own.
+  printer.set_responder([](const uint8_t*, size_t) {
+    return std::vector<uint8_t>{0x30, 0x00, 0x00, 0x00};
+  });
+
+  ConnectionPoolOptions pool_options;
+  pool_options.maintenance_interval_ms = 0;
+  ConnectionPool pool(pool_options);
+  StatusMonitorOptions options;
+  options.poll_interval_ms = 0;
+  StatusMonitor monitor([&](const PrinterTarget& t, std::string* e) { return pool.Acquire(t, e); },
+                        options);
+  pool.set_unsolicited_listener([&](const std::string& key, const uint8_t* data, size_t size) {
+    monitor.FeedUnsolicited(key, data, size);
+  });
+
+  const PrinterTarget target = PrinterTarget::Network("127.0.0.1", printer.port());
+  monitor.Watch(target);
+  {
+    std::string error;
+    std::unique_ptr<PrinterTransport> transport = pool.Acquire(target, &error);
+    ASSERT_TRUE(transport);
+    const uint8_t job[] = {'h', 'i', '\n'};
+    ASSERT_TRUE(transport->Write(job, sizeof(job), &error));
+  }
+  ASSERT_TRUE(printer.WaitForBytes(3));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  pool.RunMaintenance();
+
+  const PrinterStatus status = monitor.Get(target);
+  EXPECT_TRUE(status.reported);
+  EXPECT_TRUE(status.cover_open);
+  EXPECT_STREQ(status.Summary(), "cover_open");
+  pool.set_unsolicited_listener(nullptr);
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,114 @@
+#include "receipt_blob.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+ReceiptDocument SampleReceipt() {
+  ReceiptDocument doc;
+  doc.title = "EXTROPOS CAF\xC3\x89";
+  doc.items = {{"Nasi Lemak", 2, 8.5}, {"Teh Tarik", 1, 3.2}, {"Refund", -1, 4.0}};
+  doc.subtotal = 16.2;
+  doc.total = 17.17;
+  doc.barcode = "INV-000123";
+  doc.qr_data = "https://myinvois.hasil.gov.my/abc";
+  return doc;
+}
+
+std::string AsString(const std::vector<uint8_t>& bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(ReceiptBlobTest, RoundTripsADocument) {
+  const ReceiptDocument doc = SampleReceipt();
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(doc, &blob);
+  EXPECT_EQ(kReceiptBlobHeaderSize + 3 * kReceiptBlobItemSize + 84, blob.size());
+
+  ReceiptDocument read;
+  ASSERT_TRUE(ReadReceiptBlob(blob.data(), blob.size(), &read));
+  EXPECT_EQ("RM", read.currency);
+  EXPECT_EQ(*doc.title, *read.title);
+  ASSERT_EQ(3u, read.items.size());
+  EXPECT_EQ("Refund", read.items[2].name);
+  EXPECT_EQ(-1, read.items[2].quantity);
+  EXPECT_EQ(8.5, read.items[0].price);
+  EXPECT_EQ(16.2, *read.subtotal);
+  EXPECT_FALSE(read.tax.has_value());
+  EXPECT_FALSE(read.service_charge.has_value());
+  EXPECT_EQ(17.17, *read.total);
+  EXPECT_EQ(doc.qr_data, read.qr_data);
+
+  // Strings view the blob and the same receipt encodes the same.
+  EXPECT_EQ(reinterpret_cast<const char*>(blob.data()) + kReceiptBlobHeaderSize +
+                3 * kReceiptBlobItemSize,
+            read.currency.data());
+  EscPosEncoder encoder(48);
+  const std::string expected = AsString(encoder.EncodeReceipt(doc));
+  EXPECT_EQ(expected, AsString(encoder.EncodeReceipt(read)));
+}
+
+TEST(ReceiptBlobTest, ReusesItemStorage) {
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(SampleReceipt(), &blob);
+  ReceiptDocument read;
+  ASSERT_TRUE(ReadReceiptBlob(blob.data(), blob.size(), &read));
+  const ReceiptItem* items = read.items.data();
+  read.title.reset();
+  ASSERT_TRUE(ReadReceiptBlob(blob.data(), blob.size(), &read));
+  EXPECT_EQ(items, read.items.data());
+  EXPECT_TRUE(read.title.has_value());
+}
+
+TEST(ReceiptBlobTest, SkipsFieldsAddedLater) {
+  // A writer with 8 more header bytes and 8 more per item
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(SampleReceipt(), &blob);
+  std::vector<uint8_t> wider(blob.begin(), blob.begin() + kReceiptBlobHeaderSize);
+  wider.resize(wider.size() + 8, 0xEE);
+  wider[6] = kReceiptBlobHeaderSize + 8;
+  wider[16] = kReceiptBlobItemSize + 8;
+  for (size_t i = 0; i < 3; ++i) {
+    const auto record = blob.begin() + kReceiptBlobHeaderSize + i * kReceiptBlobItemSize;
+    wider.insert(wider.end(), record, record + kReceiptBlobItemSize);
+    wider.resize(wider.size() + 8, 0xEE);
+  }
+  wider.insert(wider.end(), blob.begin() + kReceiptBlobHeaderSize + 3 * kReceiptBlobItemSize,
+               blob.end());
+
+  ReceiptDocument read;
+  ASSERT_TRUE(ReadReceiptBlob(wider.data(), wider.size(), &read));
+  ASSERT_EQ(3u, read.items.size());
+  EXPECT_EQ("Teh Tarik", read.items[1].name);
+  EXPECT_EQ(3.2, read.items[1].price);
+}
+
+TEST(ReceiptBlobTest, RejectsMalformedBlobs) {
+  std::vector<uint8_t> blob;
+  WriteReceiptBlob(SampleReceipt(), &blob);
+  ReceiptDocument read;
+
+  EXPECT_FALSE(ReadReceiptBlob(blob.data(), kReceiptBlobHeaderSize - 1, &read));
+  EXPECT_FALSE(ReadReceiptBlob(blob.data(), blob.size() - 1, &read));
+
+  std::vector<uint8_t> bad = blob;
+  bad[0] = 'X';
+  EXPECT_FALSE(ReadReceiptBlob(bad.data(), bad.size(), &read));
+  bad = blob;
+  bad[4] = 2;  // version
+  EXPECT_FALSE(ReadReceiptBlob(bad.data(), bad.size(), &read));
+  bad = blob;
+  bad[12] = 0xFF;  // item count
+  bad[15] = 0xFF;
+  EXPECT_FALSE(ReadReceiptBlob(bad.data(), bad.size(), &read));
+  bad = blob;
+  bad[kReceiptBlobHeaderSize + 4] = 0xFF;  // first name's length
+  EXPECT_FALSE(ReadReceiptBlob(bad.data(), bad.size(), &read));
+}
+
+}  // namespace
+}  // namespace printer_core
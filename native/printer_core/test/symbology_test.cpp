@@ -0,0 +1,206 @@
+#include "symbology.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+// Reads the 15 format bits around the top left finder, unmasked.
+int ReadFormat(const QrCode& qr) {
+  int bits = 0;
+  auto push = [&](int x, int y) { bits = bits << 1 | (qr.dark(x, y) ? 1 : 0); };
+  for (int i = 14; i >= 9; --i) push(14 - i, 8);
+  push(7, 8);
+  push(8, 8);
+  push(8, 7);
+  for (int i = 5; i >= 0; --i) push(8, i);
+  return bits ^ 0x5412;
+}
+
+// Version 1 symbols only: reads the 26 codewords back in placement order,
+// undoing |mask|.
+std::vector<uint8_t> ReadVersion1Codewords(const QrCode& qr, int mask) {
+  auto is_function = [](int x, int y) {
+    return (x < 9 && y < 9) || (x >= 13 && y < 9) || (x < 9 && y >= 13) || x == 6 || y == 6;
+  };
+  std::vector<uint8_t> bytes(26, 0);
+  size_t i = 0;
+  for (int right = 20; right >= 1; right -= 2) {
+    if (right == 6) right = 5;
+    const bool upward = ((right + 1) & 2) == 0;
+    for (int vert = 0; vert < 21; ++vert) {
+      const int y = upward ? 20 - vert : vert;
+      for (int j = 0; j < 2; ++j) {
+        const int x = right - j;
+        if (is_function(x, y)) continue;
+        bool dark = qr.dark(x, y);
+        if (mask == 0 && (x + y) % 2 == 0) dark = !dark;
+        if (mask == 1 && y % 2 == 0) dark = !dark;
+        if (mask == 2 && x % 3 == 0) dark = !dark;
+        if (mask == 3 && (x + y) % 3 == 0) dark = !dark;
+        if (mask == 4 && (x / 3 + y / 2) % 2 == 0) dark = !dark;
+        if (mask == 5 && x * y % 2 + x * y % 3 == 0) dark = !dark;
+        if (mask == 6 && (x * y % 2 + x * y % 3) % 2 == 0) dark = !dark;
+        if (mask == 7 && ((x + y) % 2 + x * y % 3) % 2 == 0) dark = !dark;
+        if (dark) bytes[i >> 3] |= static_cast<uint8_t>(0x80 >> (i & 7));
+        ++i;
+      }
+    }
+  }
+  return bytes;
+}
+
+// Evaluates the codeword polynomial at the first |count| powers of the
+// generator; all zero for an undamaged Reed-Solomon block.
+bool SyndromesAreZero(const std::vector<uint8_t>& block, int count) {
+  auto multiply = [](int a, int b) {
+    int z = 0;
+    for (int i = 7; i >= 0; --i) {
+      z = (z << 1) ^ ((z >> 7) * 0x11D);
+      if ((b >> i) & 1) z ^= a;
+    }
+    return z;
+  };
+  int root = 1;
+  for (int k = 0; k < count; ++k) {
+    int value = 0;
+    for (uint8_t c : block) value = multiply(value, root) ^ c;
+    if (value != 0) return false;
+    root = multiply(root, 2);
+  }
+  return true;
+}
+
+std::string Bars(const MonoBitmap& bitmap, int row) {
+  std::string bars;
+  for (int x = 0; x < bitmap.width; ++x) {
+    const uint8_t byte = bitmap.bits[static_cast<size_t>(row) * bitmap.bytes_per_row + x / 8];
+    bars += (byte & (0x80 >> (x % 8))) ? '1' : '0';
+  }
+  return bars;
+}
+
+TEST(SymbologyTest, EncodesQrCodeThatReadsBack) {
+  QrCode qr;
+  ASSERT_TRUE(EncodeQrCode("extropos", QrErrorCorrection::kMedium, &qr));
+  ASSERT_EQ(qr.version, 1);
+  ASSERT_EQ(qr.size, 21);
+  // Finder corners, timing pattern and the dark module
+  EXPECT_TRUE(qr.dark(0, 0));
+  EXPECT_TRUE(qr.dark(20, 0));
+  EXPECT_TRUE(qr.dark(0, 20));
+  EXPECT_FALSE(qr.dark(7, 7));
+  EXPECT_TRUE(qr.dark(8, 6));
+  EXPECT_FALSE(qr.dark(9, 6));
+  EXPECT_TRUE(qr.dark(8, 13));
+
+  const int format = ReadFormat(qr);
+  EXPECT_EQ(format >> 13, 0);  // M
+  const std::vector<uint8_t> codewords = ReadVersion1Codewords(qr, (format >> 10) & 7);
+  EXPECT_TRUE(SyndromesAreZero(codewords, 10));
+  // Byte mode, length 8, then the text
+  EXPECT_EQ(codewords[0], 0x40);
+  EXPECT_EQ(codewords[1], 0x86);
+  std::string text;
+  for (int i = 1; i <= 8; ++i) {
+    text += static_cast<char>((codewords[i] & 0x0F) << 4 | codewords[i + 1] >> 4);
+  }
+  EXPECT_EQ(text, "extropos");
+  // Terminator then alternating pad bytes
+  EXPECT_EQ(codewords[9] & 0x0F, 0);
+  EXPECT_EQ(codewords[10], 0xEC);
+  EXPECT_EQ(codewords[11], 0x11);
+}
+
+TEST(SymbologyTest, PicksTheSmallestQrVersion) {
+  QrCode qr;
+  // 17 bytes fill version 1-L; 18 need version 2.
+  ASSERT_TRUE(EncodeQrCode(std::string(17, 'a'), QrErrorCorrection::kLow, &qr));
+  EXPECT_EQ(qr.version, 1);
+  ASSERT_TRUE(EncodeQrCode(std::string(18, 'a'), QrErrorCorrection::kLow, &qr));
+  EXPECT_EQ(qr.version, 2);
+  // Alignment pattern centre at (18, 18) on version 2
+  EXPECT_TRUE(qr.dark(18, 18));
+  EXPECT_FALSE(qr.dark(17, 18));
+  EXPECT_TRUE(qr.dark(16, 18));
+
+  // A MyInvois validation URL
+  const std::string url =
+      "https://myinvois.hasil.gov.my/" + std::string(270, 'x');
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(EncodeQrCode(url, QrErrorCorrection::kLow, &qr));
+  const MonoBitmap bitmap = QrBitmap(qr, 6);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(qr.version, 11);
+  EXPECT_EQ(bitmap.width, (61 + 8) * 6);
+  EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 50);
+
+  EXPECT_FALSE(EncodeQrCode(std::string(2954, 'a'), QrErrorCorrection::kLow, &qr));
+  EXPECT_TRUE(EncodeQrCode(std::string(2953, 'a'), QrErrorCorrection::kLow, &qr));
+  EXPECT_EQ(qr.version, 40);
+}
+
+TEST(SymbologyTest, ScalesQrModules) {
+  QrCode qr;
+  ASSERT_TRUE(EncodeQrCode("1", QrErrorCorrection::kLow, &qr));
+  const MonoBitmap bitmap = QrBitmap(qr, 3);
+  EXPECT_EQ(bitmap.width, 29 * 3);
+  EXPECT_EQ(bitmap.height, 29 * 3);
+  // Quiet zone, then the top left finder's outer ring three dots a module
+  EXPECT_EQ(Bars(bitmap, 0), std::string(87, '0'));
+  const std::string row = Bars(bitmap, 12);
+  EXPECT_EQ(row.substr(0, 12), std::string(12, '0'));
+  EXPECT_EQ(row.substr(12, 21), std::string(21, '1'));
+  EXPECT_EQ(Bars(bitmap, 14), row);
+}
+
+TEST(SymbologyTest, Code128SwitchesCodeSets) {
+  std::vector<uint8_t> symbols;
+  // All digits: start C, pairs
+  ASSERT_TRUE(EncodeCode128("123456", &symbols));
+  EXPECT_EQ(symbols, (std::vector<uint8_t>{105, 12, 34, 56,
+                                           (105 + 12 + 2 * 34 + 3 * 56) % 103, 106}));
+
+  // Text, then a long digit run switches to C
+  ASSERT_TRUE(EncodeCode128("INV000123", &symbols));
+  EXPECT_EQ(symbols[0], 104);
+  EXPECT_EQ(std::vector<uint8_t>(symbols.begin() + 1, symbols.end() - 2),
+            (std::vector<uint8_t>{'I' - 32, 'N' - 32, 'V' - 32, 99, 0, 1, 23}));
+
+  // An odd run leaves its last digit in B; short runs stay in B.
+  ASSERT_TRUE(EncodeCode128("12345a1", &symbols));
+  EXPECT_EQ(std::vector<uint8_t>(symbols.begin(), symbols.end() - 2),
+            (std::vector<uint8_t>{105, 12, 34, 100, '5' - 32, 'a' - 32, '1' - 32}));
+
+  // A lone control character is shifted; a run switches to A.
+  ASSERT_TRUE(EncodeCode128("a\tb", &symbols));
+  EXPECT_EQ(std::vector<uint8_t>(symbols.begin(), symbols.end() - 2),
+            (std::vector<uint8_t>{104, 'a' - 32, 98, '\t' + 64, 'b' - 32}));
+  ASSERT_TRUE(EncodeCode128("\t\tA", &symbols));
+  EXPECT_EQ(std::vector<uint8_t>(symbols.begin(), symbols.end() - 2),
+            (std::vector<uint8_t>{103, '\t' + 64, '\t' + 64, 'A' - 32}));
+
+  EXPECT_FALSE(EncodeCode128("", &symbols));
+  EXPECT_FALSE(EncodeCode128("caf\xC3\xA9", &symbols));
+}
+
+TEST(SymbologyTest, DrawsCode128Bars) {
+  std::vector<uint8_t> symbols;
+  ASSERT_TRUE(EncodeCode128("12", &symbols));
+  const MonoBitmap bitmap = Code128Bitmap(symbols, 1, 4);
+  EXPECT_EQ(Code128Modules(symbols), 4 * 11 + 2 + 20);
+  EXPECT_EQ(bitmap.width, 66);
+  const std::string quiet(10, '0');
+  // Start C, 12, checksum (105 + 12) % 103 = 14, stop
+  EXPECT_EQ(Bars(bitmap, 0), quiet + "11010011100" + "10110011100" + "10011001110" +
+                                 "1100011101011" + quiet);
+  EXPECT_EQ(Bars(bitmap, 3), Bars(bitmap, 0));
+  EXPECT_EQ(Code128Bitmap(symbols, 2, 1).width, 132);
+}
+
+}  // namespace
+}  // namespace printer_core
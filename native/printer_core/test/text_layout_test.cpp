@@ -0,0 +1,136 @@
+#include "text_layout.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace printer_core {
+namespace {
+
+// Renders laid-out lines as the printer would place them.
+std::vector<std::string> Render(const std::vector<LayoutLine>& lines) {
+  std::vector<std::string> out;
+  for (const LayoutLine& line : lines) {
+    out.push_back(std::string(line.indent, ' ') + std::string(line.text) +
+                  std::string(std::max(line.gap, 0), ' ') + std::string(line.right));
+  }
+  return out;
+}
+
+using Lines = std::vector<std::string>;
+
+TEST(TextLayoutTest, MeasuresDisplayWidth) {
+  EXPECT_EQ(DisplayWidth("Teh Tarik"), 9);
+  // Precomposed and combining accents are one column.
+  EXPECT_EQ(DisplayWidth("Cr\xC3\xA8me"), 5);
+  EXPECT_EQ(DisplayWidth("Cre\xCC\x80me"), 5);
+  // CJK ideographs, Hangul and fullwidth forms are two.
+  EXPECT_EQ(DisplayWidth("\xE4\xB8\xAD\xE6\x96\x87"), 4);
+  EXPECT_EQ(DisplayWidth("\xEA\xB9\x80\xEC\xB9\x98"), 4);
+  EXPECT_EQ(DisplayWidth("\xEF\xBC\xA1"), 2);
+  EXPECT_EQ(DisplayWidth("\xF0\x9F\x8D\x9C"), 2);
+  // One where they print as '?'
+  EXPECT_EQ(DisplayWidth("\xE4\xB8\xAD\xE6\x96\x87", 1), 2);
+  // Zero width joiner and a malformed byte
+  EXPECT_EQ(DisplayWidth("a\xE2\x80\x8D" "b"), 2);
+  EXPECT_EQ(DisplayWidth("a\xC3"), 2);
+
+  EXPECT_EQ(CodePointWidth(0x0301), 0);
+  EXPECT_EQ(CodePointWidth(0x00E9), 1);
+  EXPECT_EQ(CodePointWidth(0x3042), 2);
+  EXPECT_EQ(CodePointWidth(0x20B9F), 2);
+  EXPECT_EQ(CodePointWidth(0xFF61), 1);  // halfwidth katakana
+}
+
+TEST(TextLayoutTest, WrapsAtSpacesByColumns) {
+  RowLayout layout(16);
+  ReceiptRow row;
+  row.left = "Nasi Lemak Ayam Goreng Berempah";
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"Nasi Lemak Ayam", "Goreng Berempah"}));
+
+  // Words longer than a line break where they have to.
+  row.left = "Supercalifragilisticexpialidocious x";
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"Supercalifragili", "sticexpialidocio", "us x"}));
+
+  // Eight ideographs fill 16 columns; no space is needed to break them.
+  row.left = "\xE5\xA4\xA7\xE7\x9B\x98\xE9\xB8\xA1\xE5\x8A\xA0\xE9\xA5\xAD"
+             "\xE4\xB8\x8D\xE8\xBE\xA3\xE5\x92\x96\xE5\x95\xA1";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"\xE5\xA4\xA7\xE7\x9B\x98\xE9\xB8\xA1\xE5\x8A\xA0\xE9\xA5\xAD"
+                   "\xE4\xB8\x8D\xE8\xBE\xA3\xE5\x92\x96",
+                   "\xE5\x95\xA1"}));
+
+  // A wide character never straddles the margin.
+  row.left = "abcdefghijklmno\xE4\xB8\xAD";
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"abcdefghijklmno", "\xE4\xB8\xAD"}));
+
+  // The text's own newlines break, keeping indentation; wrapped lines drop
+  // the spaces they broke at.
+  row.left = "Add-ons:\n  extra egg,   sambal";
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"Add-ons:", "  extra egg,", "sambal"}));
+}
+
+TEST(TextLayoutTest, PlacesRightTextByColumns) {
+  RowLayout layout(20);
+  ReceiptRow row;
+  row.left = "Caf\xC3\xA9 cr\xC3\xA8me";
+  row.right = "RM 3.50";
+  // Ten columns of name, three of gap, seven of price: twenty in all even
+  // though the name is twelve bytes.
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"Caf\xC3\xA9 cr\xC3\xA8me   RM 3.50"}));
+
+  // The price moves to its own line when the last line is full.
+  row.left = "Teh tarik kurang manis";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"Teh tarik kurang", "manis        RM 3.50"}));
+  row.left = "Teh tarik kurang gula";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"Teh tarik kurang", "gula         RM 3.50"}));
+  row.left = "Teh tarik kurang gula ais";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"Teh tarik kurang", "gula ais     RM 3.50"}));
+  row.left = "Teh tarik kurang susu pekat manis";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"Teh tarik kurang", "susu pekat manis", "             RM 3.50"}));
+
+  // Cut rows keep to one line with the price.
+  row.truncate = true;
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"Teh tarik ku RM 3.50"}));
+  row.left = "\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6";
+  EXPECT_EQ(Render(layout.Layout(row)),
+            (Lines{"\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6\xE8\x8C\xB6 RM 3.50"}));
+
+  // Right text alone
+  row.left = "";
+  row.truncate = false;
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{"             RM 3.50"}));
+}
+
+TEST(TextLayoutTest, AlignsLinesWithoutRightText) {
+  RowLayout layout(32);
+  ReceiptRow row;
+  row.left = "\xE6\x94\xB6\xE6\x8D\xAE";
+  row.align = RowAlign::kCenter;
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{std::string(14, ' ') + std::string(row.left)}));
+  row.align = RowAlign::kRight;
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{std::string(28, ' ') + std::string(row.left)}));
+
+  for (int columns : {32, 42, 48, 64}) {
+    layout.set_columns(columns, 2);
+    row.left = "Thank you";
+    row.align = RowAlign::kCenter;
+    const std::vector<LayoutLine>& lines = layout.Layout(row);
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0].indent, (columns - 9) / 2);
+  }
+
+  // An empty row is a blank line.
+  row.left = "";
+  row.align = RowAlign::kLeft;
+  EXPECT_EQ(Render(layout.Layout(row)), (Lines{""}));
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,269 @@
+#include "virtual_printer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "escpos_encoder.h"
+#include "nv_logo.h"
+
+namespace printer_core {
+namespace {
+
+using namespace std::string_literals;
+
+Page Interpret(const std::string& stream, const VirtualPrinterOptions& options = {}) {
+  Page page;
+  EXPECT_TRUE(InterpretEscPos(reinterpret_cast<const uint8_t*>(stream.data()), stream.size(),
+                              options, &page));
+  return page;
+}
+
+Page Interpret(const std::vector<uint8_t>& stream, const VirtualPrinterOptions& options = {}) {
+  return Interpret(std::string(stream.begin(), stream.end()), options);
+}
+
+ReceiptDocument CafeReceipt() {
+  ReceiptDocument doc;
+  doc.title = "EXTROPOS CAFE";
+  doc.items = {{"Nasi Lemak", 2, 8.5}, {"Teh Tarik", 1, 3.2}, {"Roti Canai", 3, 1.8}};
+  doc.subtotal = 25.6;
+  doc.tax = 1.54;
+  doc.total = 27.14;
+  doc.barcode = "INV-000123";
+  doc.qr_data = "https://myinvois.hasil.gov.my/abc";
+  return doc;
+}
+
+TEST(VirtualPrinterTest, ReadsTextStylesAndFeeds) {
+  const Page page = Interpret(
+      "\x1B@" "\x1B\x61\x01" "Hi \x1B\x45\x01" "there\n"   // centred, bold from "there"
+      "\x1D!\x11" "Big\x1D!\x00\x1B\x45\x00\n"             // double size line
+      "\n\x1B" "d\x02" "\x1BJ\x0C"                          // three line feeds and 12 dots
+      "\x1B\x61\x02" "x\x1DVB\x00" "\x1Bp\x00\x19\xFA"s);
+  ASSERT_EQ(page.items.size(), 6u);
+
+  const PageItem& first = page.items[0];
+  EXPECT_EQ(first.type, PageItemType::kText);
+  EXPECT_EQ(first.align, RowAlign::kCenter);
+  ASSERT_EQ(first.runs.size(), 2u);
+  EXPECT_EQ(first.runs[0].text, "Hi ");
+  EXPECT_FALSE(first.runs[0].bold);
+  EXPECT_EQ(first.runs[1].text, "there");
+  EXPECT_TRUE(first.runs[1].bold);
+  EXPECT_EQ(first.runs[1].dots, 5 * 12);
+  EXPECT_EQ(first.dots, 30);
+
+  // Taller characters feed more.
+  const PageItem& big = page.items[1];
+  ASSERT_EQ(big.runs.size(), 1u);
+  EXPECT_EQ(big.runs[0].width, 2);
+  EXPECT_EQ(big.runs[0].height, 2);
+  EXPECT_EQ(big.dots, 48);
+
+  EXPECT_EQ(page.items[2].type, PageItemType::kFeed);
+  EXPECT_EQ(page.items[2].lines, 3);
+  EXPECT_EQ(page.items[2].dots, 3 * 30 + 12);
+
+  // The cut prints the line in the buffer first.
+  EXPECT_EQ(page.items[3].align, RowAlign::kRight);
+  EXPECT_EQ(page.items[4].type, PageItemType::kCut);
+  EXPECT_TRUE(page.items[4].partial);
+  EXPECT_EQ(page.items[5].type, PageItemType::kDrawerKick);
+  EXPECT_EQ(page.items[5].code, 2);
+
+  EXPECT_EQ(RenderPageText(page),
+            "                    Hi there  [bold \"there\"]\n"
+            "                     Big  [bold 2x2]\n"
+            "\n\n\n"
+            "                                               x\n"
+            "[partial cut]\n"
+            "[drawer kick pin 2]\n");
+}
+
+TEST(VirtualPrinterTest, RendersReceiptsAsText) {
+  EscPosEncoder encoder(48);
+  const Page page = Interpret(encoder.EncodeReceipt(CafeReceipt()));
+  EXPECT_EQ(RenderPageText(page),
+            "================================================\n"
+            "                 EXTROPOS CAFE\n"
+            "------------------------------------------------\n"
+            "Nasi Lemak x2                           RM 17.00\n"
+            "Teh Tarik                                RM 3.20\n"
+            "Roti Canai x3                            RM 5.40\n"
+            "------------------------------------------------\n"
+            "Subtotal:                               RM 25.60\n"
+            "Tax:                                     RM 1.54\n"
+            "TOTAL:                                  RM 27.14\n"
+            "================================================\n"
+            "              [CODE128 INV-000123]\n"
+            "                   INV-000123\n"
+            "\n"
+            "     [QR https://myinvois.hasil.gov.my/abc]\n"
+            "\n\n"
+            "[partial cut]\n");
+
+  // The native barcode renders with GS w / GS h.
+  const PageItem& barcode = page.items[11];
+  ASSERT_EQ(barcode.type, PageItemType::kBarcode);
+  EXPECT_EQ(barcode.bitmap.height, 80);
+}
+
+// The dark part of |bitmap|, one string a row.
+std::vector<std::string> Ink(const MonoBitmap& bitmap) {
+  auto dot = [&bitmap](int x, int y) {
+    return (bitmap.bits[static_cast<size_t>(y) * bitmap.bytes_per_row + x / 8] >> (7 - x % 8)) & 1;
+  };
+  int left = bitmap.width, right = -1, top = bitmap.height, bottom = -1;
+  for (int y = 0; y < bitmap.height; ++y) {
+    for (int x = 0; x < bitmap.width; ++x) {
+      if (!dot(x, y)) continue;
+      left = std::min(left, x);
+      right = std::max(right, x);
+      top = std::min(top, y);
+      bottom = std::max(bottom, y);
+    }
+  }
+  std::vector<std::string> rows;
+  for (int y = top; y <= bottom; ++y) {
+    std::string row;
+    for (int x = left; x <= right; ++x) row += dot(x, y) ? '#' : '.';
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+TEST(VirtualPrinterTest, PrintsSoftwareQrCodesLikeNativeOnes) {
+  ReceiptDocument doc = CafeReceipt();
+  doc.barcode = {};
+  for (int cpl : {32, 48}) {
+    EscPosEncoder native(cpl);
+    EscPosEncoder software(cpl);
+    PrinterProfile profile;
+    profile.native_qr = false;
+    profile.dots_per_line = cpl == 32 ? 384 : 576;
+    software.set_profile(profile);
+
+    VirtualPrinterOptions options;
+    options.dots_per_line = profile.dots_per_line;
+    const Page native_page = Interpret(native.EncodeReceipt(doc), options);
+    const Page software_page = Interpret(software.EncodeReceipt(doc), options);
+    SCOPED_TRACE(cpl);
+
+    // The raster bands, with the blank rows they feed over, against the
+    // printer's own symbol. Only the margins differ.
+    Page bands;
+    bands.dots_per_line = options.dots_per_line;
+    for (const PageItem& item : software_page.items) {
+      if (item.type == PageItemType::kImage ||
+          (item.type == PageItemType::kFeed && item.lines == 0)) {
+        bands.items.push_back(item);
+      }
+    }
+    ASSERT_GT(bands.items.size(), 1u);
+    const PageItem* qr = nullptr;
+    for (const PageItem& item : native_page.items) {
+      if (item.type == PageItemType::kQrCode) qr = &item;
+    }
+    ASSERT_NE(qr, nullptr);
+    EXPECT_EQ(qr->bitmap.width, 37 * 6);
+    EXPECT_EQ(Ink(RenderPageBitmap(bands)), Ink(qr->bitmap));
+  }
+}
+
+TEST(VirtualPrinterTest, DecodesCodePages) {
+  const std::string text = "Caf\xC3\xA9 \xE2\x82\xAC" "5 \xE4\xB8\xAD\xE6\x96\x87";
+  CodePageTranscoder transcoder(CodePage::kCp437, CodePage::kGb18030);
+  std::vector<uint8_t> stream = {0x1B, '@'};
+  transcoder.Append(text, &stream);
+  stream.push_back('\n');
+
+  VirtualPrinterOptions options;
+  options.double_byte = CodePage::kGb18030;
+  const Page page = Interpret(stream, options);
+  ASSERT_EQ(page.items.size(), 1u);
+  std::string printed;
+  for (const TextRun& run : page.items[0].runs) printed += run.text;
+  EXPECT_EQ(printed, text);
+  // Double-byte characters take two cells.
+  EXPECT_TRUE(page.items[0].runs.back().double_byte);
+  EXPECT_EQ(page.items[0].runs.back().dots, 2 * 24);
+
+  // Without a double-byte encoding the same bytes are single-byte ones.
+  const Page plain = Interpret(stream);
+  EXPECT_NE(plain.items[0].runs[0].text, text);
+}
+
+TEST(VirtualPrinterTest, WrapsLongLinesAndStopsAtUnknownCommands) {
+  const Page page = Interpret(std::string(50, 'a') + "\n");
+  ASSERT_EQ(page.items.size(), 2u);
+  EXPECT_EQ(page.items[0].runs[0].text, std::string(48, 'a'));
+  EXPECT_EQ(page.items[1].runs[0].text, "aa");
+
+  const std::string stream = "ok\n\x1B\xF0" "lost\n";
+  Page stopped;
+  EXPECT_FALSE(InterpretEscPos(reinterpret_cast<const uint8_t*>(stream.data()), stream.size(),
+                               VirtualPrinterOptions(), &stopped));
+  EXPECT_EQ(stopped.stopped_at, 3u);
+  EXPECT_EQ(RenderPageText(stopped), "ok\n");
+}
+
+TEST(VirtualPrinterTest, PrintsStoredImages) {
+  MonoBitmap logo;
+  logo.width = 16;
+  logo.height = 8;
+  logo.bytes_per_row = 2;
+  logo.bits = {0xFF, 0x00, 0x81, 0x01, 0x42, 0x02, 0x24, 0x04,
+               0x18, 0x08, 0x24, 0x10, 0x42, 0x20, 0x81, 0xC0};
+  for (NvLogoSupport support : {NvLogoSupport::kGraphics, NvLogoSupport::kBitImage}) {
+    std::vector<uint8_t> stream;
+    AppendNvLogoDefine(logo, support, &stream);
+    const std::vector<uint8_t> print = NvLogoPrintBlock(support);
+    stream.insert(stream.end(), print.begin(), print.end());
+
+    const Page page = Interpret(stream);
+    ASSERT_EQ(page.stored_images.size(), 1u);
+    ASSERT_FALSE(page.items.empty());
+    const PageItem& image = page.items[0];
+    EXPECT_EQ(image.type, PageItemType::kStoredImage);
+    EXPECT_EQ(image.align, RowAlign::kCenter);
+    EXPECT_EQ(image.bitmap.width, logo.width);
+    EXPECT_TRUE(image.bitmap.bits == logo.bits);
+  }
+}
+
+TEST(VirtualPrinterTest, EncodesPng) {
+  MonoBitmap bitmap;
+  bitmap.width = 10;
+  bitmap.height = 2;
+  bitmap.bytes_per_row = 2;
+  bitmap.bits = {0x80, 0x40, 0x00, 0x00};
+  const std::vector<uint8_t> png = EncodePng(bitmap);
+  const std::string bytes(png.begin(), png.end());
+
+  EXPECT_EQ(bytes.substr(0, 8), "\x89PNG\r\n\x1A\n");
+  EXPECT_EQ(bytes.substr(8, 25),
+            "\x00\x00\x00\x0DIHDR\x00\x00\x00\x0A\x00\x00\x00\x02\x01\x00\x00\x00\x00"
+            "\x49\x1A\x70\x7D"s);
+  // One stored block: filter byte and inverted dots, padding white
+  EXPECT_EQ(bytes.substr(33, 8 + 2 + 5 + 6),
+            "\x00\x00\x00\x11IDAT\x78\x01\x01\x06\x00\xF9\xFF"
+            "\x00\x7F\xBF\x00\xFF\xFF"s);
+  EXPECT_EQ(bytes.substr(bytes.size() - 12), "\x00\x00\x00\x00IEND\xAE\x42\x60\x82"s);
+
+  // The page's dots: an 'I' is a bar three font pixels down column 2.
+  const MonoBitmap page = RenderPageBitmap(Interpret("I\n"));
+  EXPECT_EQ(page.width, 576);
+  EXPECT_EQ(page.height, 30);
+  auto dot = [&page](int x, int y) {
+    return (page.bits[static_cast<size_t>(y) * page.bytes_per_row + x / 8] >> (7 - x % 8)) & 1;
+  };
+  EXPECT_EQ(dot(1 + 2 * 2, 2 + 3 * 3), 1);
+  EXPECT_EQ(dot(1 + 2 * 2, 1), 0);
+  EXPECT_TRUE(EncodePng(MonoBitmap()).empty());
+}
+
+}  // namespace
+}  // namespace printer_core
@@ -0,0 +1,77 @@
+#ifndef PRINTER_CORE_TEXT_LAYOUT_H_
+#define PRINTER_CORE_TEXT_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace printer_core {
+
+// Decodes the UTF-8 sequence at the start of |data| (first byte >= 0x80).
+// Returns its length, or 0 if it is malformed: a stray continuation byte,
+// a truncated or overlong sequence, a surrogate or a value past U+10FFFF.
+size_t DecodeUtf8(const uint8_t* data, size_t size, uint32_t* code_point);
+
+// Printer columns |code_point| takes: 0 for combining marks and format
+// characters, 2 for East Asian wide and fullwidth characters, 1 for the rest
+// (ambiguous-width characters print narrow from the single-byte tables).
+int CodePointWidth(uint32_t code_point);
+
+// Columns |utf8| takes when wide characters print |wide_columns| wide: 2 on
+// printers with a Chinese encoding, 1 where they print as '?'. Malformed
+// bytes take a column each, like the '?' they print as.
+int DisplayWidth(std::string_view utf8, int wide_columns = 2);
+
+enum class RowAlign { kLeft, kCenter, kRight };
+
+// A row of laid-out receipt text. |left| wraps at spaces (breaking words
+// longer than a line) or is cut to one line; |right|, when set, sits at the
+// right margin of the last line, or on its own line when it does not fit.
+// Strings are views that must outlive the encode call.
+struct ReceiptRow {
+  std::string_view left;
+  std::string_view right;
+  // For rows without |right|.
+  RowAlign align = RowAlign::kLeft;
+  // Cut |left| to what fits beside |right| on one line instead of wrapping.
+  bool truncate = false;
+  // When set, the row is a full-width line of this character.
+  char divider = 0;
+};
+
+// One printed line: |indent| spaces, |text|, |gap| spaces, |right|.
+struct LayoutLine {
+  int indent = 0;
+  std::string_view text;
+  int width = 0;
+  int gap = 0;
+  std::string_view right;
+};
+
+// Breaks rows into lines by display width. Keeps its line storage across
+// rows so steady-state layout does not allocate.
+class RowLayout {
+ public:
+  explicit RowLayout(int columns = 48, int wide_columns = 2);
+
+  void set_columns(int columns, int wide_columns);
+  int columns() const { return columns_; }
+
+  // Lays out the text of |row| (not a divider) in one pass over its UTF-8.
+  // The lines view into the row's strings and stay valid until the next call.
+  const std::vector<LayoutLine>& Layout(const ReceiptRow& row);
+
+ private:
+  // Appends the lines of |text| at most |budget| columns wide.
+  void Break(std::string_view text, int budget, bool truncate);
+  void Push(std::string_view text, size_t begin, size_t end, int width);
+
+  int columns_;
+  int wide_columns_;
+  std::vector<LayoutLine> lines_;
+};
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_TEXT_LAYOUT_H_
@@ -0,0 +1,168 @@
+// Times the native logo path stage by stage: gray conversion, scaling to the
+// print width, dithering, GS v 0 packing, and a cache hit, plus the raster
+// size in bytes plain and compacted. Compare with the Dart path timed by
+// tool/logo_raster_benchmark.dart.
+//
+//   printer_core_logo_bench [image.pnm] [iterations]
+//
+// Takes a binary PGM (P5) or PPM (P6); without one it uses a synthetic
+// 1024x512 gradient logo.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "logo_raster.h"
+
+namespace {
+
+using printer_core::DitherMode;
+using printer_core::GrayImage;
+
+struct Rgb {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Reads a binary PGM or PPM as RGB; empty on anything else.
+Rgb ReadPnm(const std::vector<uint8_t>& file) {
+  Rgb image;
+  size_t pos = 0;
+  auto token = [&]() {
+    std::string value;
+    while (pos < file.size()) {
+      const char c = static_cast<char>(file[pos]);
+      if (c == '#') {
+        while (pos < file.size() && file[pos] != '\n') ++pos;
+      } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        if (!value.empty()) break;
+        ++pos;
+      } else {
+        value += c;
+        ++pos;
+      }
+    }
+    return value;
+  };
+  const std::string magic = token();
+  if (magic != "P5" && magic != "P6") return image;
+  const int width = std::atoi(token().c_str());
+  const int height = std::atoi(token().c_str());
+  if (std::atoi(token().c_str()) != 255 || width <= 0 || height <= 0) return image;
+  ++pos;
+  const int channels = magic == "P6" ? 3 : 1;
+  if (file.size() - pos < static_cast<size_t>(width) * height * channels) return image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(static_cast<size_t>(width) * height * 3);
+  for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      image.pixels[i * 3 + c] = file[pos + i * channels + (channels == 3 ? c : 0)];
+    }
+  }
+  return image;
+}
+
+Rgb Gradient(int width, int height) {
+  Rgb image{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 3)};
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* p = &image.pixels[(static_cast<size_t>(y) * width + x) * 3];
+      p[0] = static_cast<uint8_t>(x * 255 / width);
+      p[1] = static_cast<uint8_t>(y * 255 / height);
+      p[2] = static_cast<uint8_t>((x ^ y) & 0xFF);
+    }
+  }
+  return image;
+}
+
+// Median microseconds of |iterations| runs of |fn|.
+template <typename Fn>
+double Time(int iterations, Fn fn) {
+  std::vector<double> samples;
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    samples.push_back(std::chrono::duration<double, std::micro>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<uint8_t> file;
+  Rgb rgb;
+  if (argc > 1) {
+    std::ifstream in(argv[1], std::ios::binary);
+    file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    rgb = ReadPnm(file);
+    if (rgb.pixels.empty()) {
+      std::fprintf(stderr, "%s: not a binary PGM/PPM with maxval 255\n", argv[1]);
+      return 1;
+    }
+  } else {
+    rgb = Gradient(1024, 512);
+    file = rgb.pixels;
+  }
+  const int iterations = std::max(1, argc > 2 ? std::atoi(argv[2]) : 50);
+  std::printf("source %dx%d, median of %d runs (us)\n", rgb.width, rgb.height, iterations);
+  std::printf("%-6s %-16s %8s %8s %8s %8s %8s %8s %8s\n", "width", "dither", "gray", "scale",
+              "dither", "total", "cached", "plain", "compact");
+
+  const struct {
+    DitherMode mode;
+    const char* name;
+  } modes[] = {{DitherMode::kThreshold, "threshold"},
+               {DitherMode::kOrdered, "ordered"},
+               {DitherMode::kFloydSteinberg, "floyd_steinberg"}};
+  const int widths[] = {printer_core::kLogoWidth58mm, printer_core::kLogoWidth80mm,
+                        printer_core::kLogoWidthFull80mm};
+  auto decode = [&](GrayImage* image) {
+    *image = printer_core::GrayFromPixels(rgb.pixels.data(), rgb.width, rgb.height,
+                                          static_cast<size_t>(rgb.width) * 3,
+                                          printer_core::PixelLayout::kRgb);
+    return true;
+  };
+
+  for (int width : widths) {
+    for (const auto& mode : modes) {
+      GrayImage gray;
+      GrayImage scaled;
+      const double gray_us = Time(iterations, [&] { decode(&gray); });
+      const double scale_us =
+          Time(iterations, [&] { scaled = printer_core::ScaleToWidth(gray, width); });
+      const double dither_us = Time(iterations, [&] {
+        std::vector<uint8_t> out;
+        printer_core::AppendRasterBands(printer_core::Dither(scaled, mode.mode), &out);
+      });
+      const double total_us = Time(iterations, [&] {
+        GrayImage image;
+        decode(&image);
+        printer_core::RasterizeLogo(image, width, mode.mode);
+      });
+      printer_core::LogoCache cache;
+      cache.Get(file.data(), file.size(), width, mode.mode, decode);
+      const double cached_us = Time(iterations, [&] {
+        cache.Get(file.data(), file.size(), width, mode.mode, decode);
+      });
+      const printer_core::MonoBitmap bitmap = printer_core::Dither(scaled, mode.mode);
+      printer_core::RasterOptions plain;
+      plain.compact = false;
+      std::printf("%-6d %-16s %8.1f %8.1f %8.1f %8.1f %8.1f %8zu %8zu\n", width, mode.name,
+                  gray_us, scale_us, dither_us, total_us, cached_us,
+                  printer_core::RasterBlock(bitmap, plain).size(),
+                  printer_core::RasterBlock(bitmap).size());
+    }
+  }
+  return 0;
+}
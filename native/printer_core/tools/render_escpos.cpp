@@ -0,0 +1,64 @@
+// Prints an ESC/POS capture on the virtual printer: the text rendering goes
+// to stdout and, with an output path, the page to a PNG.
+//
+//   printer_core_render receipt.bin [page.png] [dots_per_line] [double_byte]
+//
+// dots_per_line is 576 (80 mm, the default) or 384 (58 mm); double_byte is
+// gb18030 or big5 for Chinese models. Captures come from the stand-in
+// printer or a runner's hex log turned back into bytes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "virtual_printer.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s receipt.bin [page.png] [dots_per_line] [double_byte]\n",
+                 argv[0]);
+    return 2;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 1;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+
+  printer_core::VirtualPrinterOptions options;
+  if (argc > 3) options.dots_per_line = std::atoi(argv[3]);
+  if (argc > 4 && !printer_core::ParseCodePage(argv[4], &options.double_byte)) {
+    std::fprintf(stderr, "unknown code page %s\n", argv[4]);
+    return 2;
+  }
+  if (options.dots_per_line <= 0) {
+    std::fprintf(stderr, "bad dots_per_line %s\n", argv[3]);
+    return 2;
+  }
+
+  printer_core::Page page;
+  const bool complete = printer_core::InterpretEscPos(data.data(), data.size(), options, &page);
+  const std::string text = printer_core::RenderPageText(page);
+  std::fwrite(text.data(), 1, text.size(), stdout);
+  if (!complete) {
+    std::fprintf(stderr, "stopped at byte %zu of %zu: unknown or truncated command\n",
+                 page.stopped_at, data.size());
+  }
+
+  if (argc > 2) {
+    const std::vector<uint8_t> png =
+        printer_core::EncodePng(printer_core::RenderPageBitmap(page));
+    std::ofstream out(argv[2], std::ios::binary);
+    out.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!out) {
+      std::fprintf(stderr, "cannot write %s\n", argv[2]);
+      return 1;
+    }
+  }
+  return complete ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// Stand-in network receipt printer for trying the runner plugins without
+// hardware. Listens like a raw TCP (port 9100) printer and dumps every byte it
+// receives as hex plus printable text.
+//
+//   printer_core_standin [port] [bind-address]
+//
+// Point a network printer in the app at the printed address and port.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "test/loopback_printer.h"
+
+namespace {
+
+void Dump(const std::vector<uint8_t>& bytes, size_t begin) {
+  for (size_t row = begin; row < bytes.size(); row += 16) {
+    std::printf("%08zx  ", row);
+    for (size_t i = row; i < row + 16; ++i) {
+      if (i < bytes.size()) {
+        std::printf("%02x ", bytes[i]);
+      } else {
+        std::printf("   ");
+      }
+    }
+    std::printf(" |");
+    for (size_t i = row; i < row + 16 && i < bytes.size(); ++i) {
+      const uint8_t c = bytes[i];
+      std::putchar(c >= 0x20 && c < 0x7F ? c : '.');
+    }
+    std::printf("|\n");
+  }
+  std::fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint16_t port =
+      static_cast<uint16_t>(argc > 1 ? std::atoi(argv[1]) : 9100);
+  const char* address = argc > 2 ? argv[2] : "127.0.0.1";
+
+  printer_core::testing::LoopbackPrinter printer(address, port);
+  if (!printer.ok()) {
+    std::fprintf(stderr, "cannot listen on %s:%u\n", address, port);
+    return 1;
+  }
+  // Answer DLE EOT n and GS a with "online, no error, paper present".
+  printer.set_responder(printer_core::testing::LoopbackPrinter::StatusResponder(
+      {0x12, 0x12, 0x12, 0x12}, {0x10, 0x00, 0x00, 0x00}));
+  std::printf("stand-in printer listening on %s:%u\n", address, printer.port());
+  std::fflush(stdout);
+
+  size_t shown = 0;
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const std::vector<uint8_t> bytes = printer.received();
+    if (bytes.size() > shown) {
+      Dump(bytes, shown - shown % 16);
+      shown = bytes.size();
+    }
+  }
+}
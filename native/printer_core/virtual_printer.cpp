@@ -0,0 +1,960 @@
+#include "virtual_printer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "escpos_optimizer.h"
+#include "symbology.h"
+
+namespace printer_core {
+
+namespace {
+
+constexpr uint8_t kDle = 0x10;
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+constexpr uint8_t kGs = 0x1D;
+
+// Font A is 12 x 24 dots, font B 9 x 17.
+constexpr int kFontAWidth = 12;
+constexpr int kFontAHeight = 24;
+constexpr int kFontBWidth = 9;
+constexpr int kFontBHeight = 17;
+// ESC 2 line spacing, 3.75 mm
+constexpr int kDefaultLineSpacing = 30;
+constexpr int kTabColumns = 8;
+// Paper a cut takes up in the bitmap, with a dashed line across the middle
+constexpr int kCutRows = 9;
+
+// 5 x 7 glyphs for ASCII 0x20-0x7E, one byte a column, top row in bit 0.
+constexpr uint8_t kGlyphs[95][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+    {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x49, 0x49, 0x7A}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0x7C, 0x14, 0x14, 0x14, 0x08},
+    {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08},
+};
+
+size_t Uint16At(const uint8_t* data) {
+  return static_cast<size_t>(data[0]) | static_cast<size_t>(data[1]) << 8;
+}
+
+int CellWidth(bool font_b) { return font_b ? kFontBWidth : kFontAWidth; }
+int CellHeight(bool font_b) { return font_b ? kFontBHeight : kFontAHeight; }
+
+bool SameStyle(const TextRun& a, const TextRun& b) {
+  return a.bold == b.bold && a.underline == b.underline && a.width == b.width &&
+         a.height == b.height && a.font_b == b.font_b && a.double_byte == b.double_byte;
+}
+
+// Dots from the left margin to something |width| dots wide.
+int AlignOffset(RowAlign align, int width, int dots_per_line) {
+  const int space = std::max(dots_per_line - width, 0);
+  switch (align) {
+    case RowAlign::kCenter:
+      return space / 2;
+    case RowAlign::kRight:
+      return space;
+    case RowAlign::kLeft:
+      break;
+  }
+  return 0;
+}
+
+// Arguments that take n or '0' + n.
+int Digit(uint8_t n) { return n >= '0' && n <= '9' ? n - '0' : n; }
+
+// |bitmap| with each dot |x| wide and |y| tall.
+MonoBitmap Scale(const MonoBitmap& bitmap, int x, int y) {
+  if (x == 1 && y == 1) return bitmap;
+  MonoBitmap out;
+  out.width = bitmap.width * x;
+  out.height = bitmap.height * y;
+  out.bytes_per_row = (out.width + 7) / 8;
+  out.bits.assign(static_cast<size_t>(out.bytes_per_row) * out.height, 0);
+  for (int row = 0; row < out.height; ++row) {
+    const uint8_t* in = &bitmap.bits[static_cast<size_t>(row / y) * bitmap.bytes_per_row];
+    uint8_t* to = &out.bits[static_cast<size_t>(row) * out.bytes_per_row];
+    for (int dot = 0; dot < out.width; ++dot) {
+      const int from = dot / x;
+      if (in[from >> 3] & (0x80 >> (from & 7))) {
+        to[dot >> 3] |= static_cast<uint8_t>(0x80 >> (dot & 7));
+      }
+    }
+  }
+  return out;
+}
+
+// Column-format image data (ESC *, FS q): |columns| columns of |bands|
+// bytes, each byte eight dots down with the top dot in the high bit.
+MonoBitmap FromColumns(const uint8_t* data, int columns, int bands) {
+  MonoBitmap bitmap;
+  bitmap.width = columns;
+  bitmap.height = bands * 8;
+  bitmap.bytes_per_row = (columns + 7) / 8;
+  bitmap.bits.assign(static_cast<size_t>(bitmap.bytes_per_row) * bitmap.height, 0);
+  for (int x = 0; x < columns; ++x) {
+    for (int y = 0; y < bitmap.height; ++y) {
+      if (data[static_cast<size_t>(x) * bands + y / 8] & (0x80 >> (y % 8))) {
+        bitmap.bits[static_cast<size_t>(y) * bitmap.bytes_per_row + x / 8] |=
+            static_cast<uint8_t>(0x80 >> (x % 8));
+      }
+    }
+  }
+  return bitmap;
+}
+
+// Code128 data as GS k 73 takes it, without the "{A" / "{B" / "{C" code set
+// and "{1"-style function selections; "{{" is a brace.
+std::string Code128Text(const uint8_t* data, size_t size) {
+  std::string text;
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == '{' && i + 1 < size) {
+      ++i;
+      if (data[i] == '{') text.push_back('{');
+      continue;
+    }
+    text.push_back(static_cast<char>(data[i]));
+  }
+  return text;
+}
+
+// Reads a stream into a Page, holding the printer state ESC @ resets.
+class Interpreter {
+ public:
+  Interpreter(const VirtualPrinterOptions& options, Page* page)
+      : options_(options), page_(page), decoder_(options.double_byte) {
+    page_->dots_per_line = options.dots_per_line;
+    Reset();
+  }
+
+  bool Run(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+      const uint8_t b = data[i];
+      if (b == kEsc || b == kGs || b == kFs || b == kDle) {
+        const size_t length = EscPosCommandLength(data + i, size - i);
+        if (length == 0) return Stop(i);
+        Command(data + i, length);
+        i += length;
+      } else if (b == '\n') {
+        LineFeed();
+        ++i;
+      } else if (b == '\t') {
+        glyph_.assign(1, ' ');
+        const int column = line_dots_ / CellWidth(style_.font_b);
+        for (int n = kTabColumns - column % kTabColumns; n > 0; --n) Glyph(false);
+        ++i;
+      } else if (b < 0x20 || b == 0x7F) {
+        // CR and other control bytes print nothing.
+        ++i;
+      } else if (b >= 0x80 && kanji_ && decoder_.double_byte() != CodePage::kNone) {
+        const size_t length = decoder_.DoubleByteLength(data + i, size - i);
+        if (length == 0) return Stop(i);
+        glyph_.clear();
+        decoder_.AppendDoubleByte(
+            std::string_view(reinterpret_cast<const char*>(data + i), length), &glyph_);
+        Glyph(true);
+        i += length;
+      } else {
+        glyph_.clear();
+        CodePageDecoder::AppendSingleByte(table_, b, &glyph_);
+        Glyph(false);
+        ++i;
+      }
+    }
+    FlushLine();
+    page_->stopped_at = size;
+    return true;
+  }
+
+ private:
+  bool Stop(size_t offset) {
+    FlushLine();
+    page_->stopped_at = offset;
+    return false;
+  }
+
+  void Reset() {
+    line_.clear();
+    line_dots_ = 0;
+    style_ = TextRun();
+    align_ = RowAlign::kLeft;
+    table_ = options_.code_page;
+    kanji_ = false;
+    line_spacing_ = kDefaultLineSpacing;
+    motion_unit_ = 0;
+    bar_width_ = 3;
+    bar_height_ = 162;
+    hri_ = 0;
+    qr_module_ = 3;
+    qr_ec_ = QrErrorCorrection::kLow;
+    qr_data_.clear();
+  }
+
+  // Dots ESC J / ESC 3 |n| stand for under the GS P unit.
+  int MotionDots(int n) const {
+    return motion_unit_ > 0 ? n * options_.dots_per_inch / motion_unit_ : n;
+  }
+
+  // Feed after a line: the line spacing, or the tallest character.
+  int LineAdvance() const {
+    int tallest = CellHeight(style_.font_b) * style_.height;
+    if (!line_.empty()) {
+      tallest = 0;
+      for (const TextRun& run : line_) {
+        tallest = std::max(tallest, CellHeight(run.font_b) * run.height);
+      }
+    }
+    return std::max(line_spacing_, tallest);
+  }
+
+  // Adds glyph_ to the line, printing the line first if it is full.
+  void Glyph(bool double_byte) {
+    const int dots = CellWidth(style_.font_b) * (double_byte ? 2 : 1) * style_.width;
+    if (line_dots_ > 0 && line_dots_ + dots > options_.dots_per_line) PrintLine(LineAdvance());
+    style_.double_byte = double_byte;
+    if (line_.empty() || !SameStyle(line_.back(), style_)) line_.push_back(style_);
+    line_.back().text += glyph_;
+    line_.back().dots += dots;
+    line_dots_ += dots;
+  }
+
+  void Push(PageItem item) {
+    bit_image_height_ = 0;
+    page_->items.push_back(std::move(item));
+  }
+
+  void PrintLine(int advance) {
+    PageItem item;
+    item.type = PageItemType::kText;
+    item.align = align_;
+    item.runs = std::move(line_);
+    item.dots = advance;
+    Push(std::move(item));
+    line_.clear();
+    line_dots_ = 0;
+  }
+
+  // Printing commands print what is in the line buffer first.
+  void FlushLine() {
+    if (!line_.empty()) PrintLine(LineAdvance());
+  }
+
+  void Feed(int dots, int lines) {
+    std::vector<PageItem>& items = page_->items;
+    if (!items.empty() && items.back().type == PageItemType::kFeed) {
+      items.back().dots += dots;
+      items.back().lines += lines;
+      return;
+    }
+    PageItem item;
+    item.type = PageItemType::kFeed;
+    item.dots = dots;
+    item.lines = lines;
+    Push(std::move(item));
+  }
+
+  void LineFeed() {
+    if (!line_.empty()) {
+      PrintLine(LineAdvance());
+    } else if (bit_image_height_ > 0) {
+      // The LF ending an ESC * line feeds what is left of the line.
+      const int rest = std::max(LineAdvance() - bit_image_height_, 0);
+      bit_image_height_ = 0;
+      if (rest > 0) Feed(rest, 0);
+    } else {
+      Feed(LineAdvance(), 1);
+    }
+  }
+
+  void Print(PageItemType type, MonoBitmap bitmap, std::string data = std::string(),
+             int code = 0) {
+    FlushLine();
+    PageItem item;
+    item.type = type;
+    item.align = align_;
+    item.bitmap = std::move(bitmap);
+    item.data = std::move(data);
+    item.code = code;
+    Push(std::move(item));
+  }
+
+  // Human-readable text under or over a barcode, in plain font A.
+  void Hri(const std::string& text) {
+    PageItem item;
+    item.type = PageItemType::kText;
+    item.align = align_;
+    TextRun run;
+    run.text = text;
+    run.dots = kFontAWidth * DisplayWidth(text, 1);
+    item.runs.push_back(std::move(run));
+    item.dots = kFontAHeight;
+    Push(std::move(item));
+  }
+
+  void Command(const uint8_t* data, size_t length) {
+    const uint8_t prefix = data[0];
+    const uint8_t code = data[1];
+    const uint8_t n = length > 2 ? data[2] : 0;
+    if (prefix == kEsc) {
+      Esc(code, n, data);
+    } else if (prefix == kGs) {
+      Gs(code, n, data, length);
+    } else if (prefix == kFs) {
+      Fs(code, n, data);
+    }
+    // DLE real-time requests print nothing.
+  }
+
+  void Esc(uint8_t code, uint8_t n, const uint8_t* data) {
+    switch (code) {
+      case '@':
+        Reset();
+        break;
+      case '!':
+        style_.font_b = (n & 0x01) != 0;
+        style_.bold = (n & 0x08) != 0;
+        style_.height = n & 0x10 ? 2 : 1;
+        style_.width = n & 0x20 ? 2 : 1;
+        style_.underline = n & 0x80 ? 1 : 0;
+        break;
+      case 'E':
+        style_.bold = (n & 0x01) != 0;
+        break;
+      case '-':
+        style_.underline = std::min(Digit(n), 2);
+        break;
+      case 'M':
+        style_.font_b = Digit(n) == 1;
+        break;
+      case 'a':
+        // Justification only changes at the start of a line.
+        if (line_.empty() && Digit(n) <= 2) align_ = static_cast<RowAlign>(Digit(n));
+        break;
+      case 't':
+        table_ = CodePageForEscT(n);
+        break;
+      case '2':
+        line_spacing_ = kDefaultLineSpacing;
+        break;
+      case '3':
+        line_spacing_ = MotionDots(n);
+        break;
+      case 'J':
+        if (!line_.empty()) {
+          PrintLine(MotionDots(n));
+        } else {
+          Feed(MotionDots(n), 0);
+        }
+        break;
+      case 'd':
+        if (n == 0) {
+          if (!line_.empty()) PrintLine(0);
+        } else {
+          for (int i = 0; i < n; ++i) LineFeed();
+        }
+        break;
+      case 'p': {
+        PageItem item;
+        item.type = PageItemType::kDrawerKick;
+        item.code = Digit(n) == 1 ? 5 : 2;
+        Push(std::move(item));
+        break;
+      }
+      case '*': {
+        // ESC * m nL nH: 8- or 24-dot columns; single density doubles them.
+        const bool tall = (n & 0x20) != 0;
+        MonoBitmap bitmap = FromColumns(data + 5, static_cast<int>(Uint16At(data + 3)),
+                                        tall ? 3 : 1);
+        if (!(n & 0x01)) bitmap = Scale(bitmap, 2, 1);
+        const int height = bitmap.height;
+        Print(PageItemType::kImage, std::move(bitmap));
+        bit_image_height_ = height;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  void Gs(uint8_t code, uint8_t n, const uint8_t* data, size_t length) {
+    switch (code) {
+      case '!':
+        style_.width = ((n >> 4) & 0x07) + 1;
+        style_.height = (n & 0x07) + 1;
+        break;
+      case 'P':
+        motion_unit_ = data[3];
+        break;
+      case 'w':
+        bar_width_ = n;
+        break;
+      case 'h':
+        bar_height_ = n;
+        break;
+      case 'H':
+        hri_ = Digit(n);
+        break;
+      case 'V': {
+        if (n == 65 || n == 66 || n == 97 || n == 98 || n == 103 || n == 104) {
+          // Feed by n motion units, then cut
+          if (data[3] > 0) Feed(MotionDots(data[3]), 0);
+        }
+        FlushLine();
+        PageItem item;
+        item.type = PageItemType::kCut;
+        item.partial = n == 1 || n == 49 || n == 66 || n == 98 || n == 104;
+        Push(std::move(item));
+        break;
+      }
+      case 'v': {
+        // GS v 0 m xL xH yL yH: row-major raster; m doubles width and height
+        MonoBitmap bitmap;
+        bitmap.bytes_per_row = static_cast<int>(Uint16At(data + 4));
+        bitmap.width = bitmap.bytes_per_row * 8;
+        bitmap.height = static_cast<int>(Uint16At(data + 6));
+        bitmap.bits.assign(data + 8, data + length);
+        const int m = Digit(data[3]);
+        Print(PageItemType::kImage, Scale(bitmap, m & 1 ? 2 : 1, m & 2 ? 2 : 1));
+        break;
+      }
+      case 'k':
+        Barcode(n, data, length);
+        break;
+      case '(':
+        if (n == 'k') {
+          QrCommand(data, length);
+        } else if (n == 'L') {
+          Graphics(data + 5, length - 5);
+        }
+        break;
+      case '8':
+        Graphics(data + 7, length - 7);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void Fs(uint8_t code, uint8_t n, const uint8_t* data) {
+    switch (code) {
+      case '&':
+        kanji_ = true;
+        break;
+      case '.':
+        kanji_ = false;
+        break;
+      case 'q': {
+        // FS q n: n images of xL xH yL yH (bytes across, bands down) and
+        // column data. Replaces every image defined before.
+        for (auto it = page_->stored_images.begin(); it != page_->stored_images.end();) {
+          it = it->first.compare(0, 5, "FS p ") == 0 ? page_->stored_images.erase(it) : ++it;
+        }
+        size_t pos = 3;
+        for (int image = 1; image <= n; ++image) {
+          const int columns = static_cast<int>(Uint16At(data + pos)) * 8;
+          const int bands = static_cast<int>(Uint16At(data + pos + 2));
+          page_->stored_images["FS p " + std::to_string(image)] =
+              FromColumns(data + pos + 4, columns, bands);
+          pos += 4 + static_cast<size_t>(columns) * bands;
+        }
+        break;
+      }
+      case 'p': {
+        const std::string name = "FS p " + std::to_string(n);
+        const int m = Digit(data[3]);
+        Print(PageItemType::kStoredImage,
+              Scale(StoredImage(name), m & 1 ? 2 : 1, m & 2 ? 2 : 1), name);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  MonoBitmap StoredImage(const std::string& name) const {
+    const auto it = page_->stored_images.find(name);
+    return it != page_->stored_images.end() ? it->second : MonoBitmap();
+  }
+
+  // GS ( L / GS 8 L from the m byte on: function 67 stores raster graphics,
+  // 69 prints them.
+  void Graphics(const uint8_t* p, size_t size) {
+    if (size < 2 || p[0] != 48) return;
+    const uint8_t fn = p[1];
+    if (fn == 67 && size >= 11) {
+      // a kc1 kc2 b xL xH yL yH c data
+      const std::string name = "GS ( L " + std::string(reinterpret_cast<const char*>(p + 3), 2);
+      MonoBitmap bitmap;
+      bitmap.width = static_cast<int>(Uint16At(p + 6));
+      bitmap.height = static_cast<int>(Uint16At(p + 8));
+      bitmap.bytes_per_row = (bitmap.width + 7) / 8;
+      const size_t bytes = static_cast<size_t>(bitmap.bytes_per_row) * bitmap.height;
+      if (size - 11 < bytes) return;
+      bitmap.bits.assign(p + 11, p + 11 + bytes);
+      page_->stored_images[name] = std::move(bitmap);
+    } else if (fn == 69 && size >= 6) {
+      // kc1 kc2 x y
+      const std::string name = "GS ( L " + std::string(reinterpret_cast<const char*>(p + 2), 2);
+      Print(PageItemType::kStoredImage, Scale(StoredImage(name), p[4] == 2 ? 2 : 1,
+                                              p[5] == 2 ? 2 : 1),
+            name);
+    }
+  }
+
+  void Barcode(uint8_t m, const uint8_t* data, size_t length) {
+    std::string text;
+    if (m <= 6) {
+      // NUL-terminated
+      text.assign(reinterpret_cast<const char*>(data + 3), length - 4);
+    } else {
+      text.assign(reinterpret_cast<const char*>(data + 4), length - 4);
+    }
+    MonoBitmap bitmap;
+    if (m == 73) {
+      text = Code128Text(data + 4, length - 4);
+      std::vector<uint8_t> symbols;
+      if (EncodeCode128(text, &symbols)) {
+        bitmap = Code128Bitmap(symbols, std::max(bar_width_, 1), std::max(bar_height_, 1));
+      }
+    }
+    FlushLine();
+    if (hri_ == 1 || hri_ == 3) Hri(text);
+    Print(PageItemType::kBarcode, std::move(bitmap), text, m);
+    if (hri_ == 2 || hri_ == 3) Hri(text);
+  }
+
+  // GS ( k for QR codes (cn 49): size, error correction, store and print.
+  void QrCommand(const uint8_t* data, size_t length) {
+    if (length < 7 || data[5] != 49) return;
+    const uint8_t fn = data[6];
+    if (fn == 67 && length >= 8) {
+      qr_module_ = std::max<int>(data[7], 1);
+    } else if (fn == 69 && length >= 8 && data[7] >= 48 && data[7] <= 51) {
+      qr_ec_ = static_cast<QrErrorCorrection>(data[7] - 48);
+    } else if (fn == 80 && length >= 8) {
+      qr_data_.assign(reinterpret_cast<const char*>(data + 8), length - 8);
+    } else if (fn == 81) {
+      QrCode qr;
+      MonoBitmap bitmap;
+      if (EncodeQrCode(qr_data_, qr_ec_, &qr)) bitmap = QrBitmap(qr, qr_module_);
+      Print(PageItemType::kQrCode, std::move(bitmap), qr_data_);
+    }
+  }
+
+  const VirtualPrinterOptions& options_;
+  Page* page_;
+  CodePageDecoder decoder_;
+  // The line buffer and the style the next character prints in
+  std::vector<TextRun> line_;
+  int line_dots_ = 0;
+  TextRun style_;
+  std::string glyph_;
+  RowAlign align_ = RowAlign::kLeft;
+  CodePage table_ = CodePage::kCp437;
+  bool kanji_ = false;
+  int line_spacing_ = kDefaultLineSpacing;
+  // GS P vertical unit as 1/n inch; 0 for one dot
+  int motion_unit_ = 0;
+  // Height of an ESC * image on the current line
+  int bit_image_height_ = 0;
+  int bar_width_ = 3;
+  int bar_height_ = 162;
+  int hri_ = 0;
+  int qr_module_ = 3;
+  QrErrorCorrection qr_ec_ = QrErrorCorrection::kLow;
+  std::string qr_data_;
+};
+
+// "bold 2x2" and the like; empty for plain font A text.
+std::string StyleName(const TextRun& run) {
+  std::string name;
+  auto add = [&name](const std::string& part) {
+    if (!name.empty()) name += ' ';
+    name += part;
+  };
+  if (run.bold) add("bold");
+  if (run.underline > 0) add(run.underline == 2 ? "underline2" : "underline");
+  if (run.font_b) add("font B");
+  if (run.width != 1 || run.height != 1) {
+    add(std::to_string(run.width) + "x" + std::to_string(run.height));
+  }
+  return name;
+}
+
+std::string BarcodeName(int m) {
+  static const char* const kNames[] = {"UPC-A", "UPC-E", "EAN13", "EAN8", "CODE39",
+                                       "ITF",   "CODABAR", "CODE93", "CODE128"};
+  if (m <= 6) return kNames[m];
+  if (m >= 65 && m <= 73) return kNames[m - 65];
+  return "barcode " + std::to_string(m);
+}
+
+std::string TextLine(const PageItem& item, int dots_per_line) {
+  std::string text;
+  int dots = 0;
+  for (const TextRun& run : item.runs) {
+    text += run.text;
+    dots += run.dots;
+  }
+  std::string line(AlignOffset(item.align, dots, dots_per_line) / kFontAWidth, ' ');
+  line += text;
+  line.erase(line.find_last_not_of(' ') + 1);
+
+  // Styles: one for the line, or each styled run with its text
+  const std::string first = StyleName(item.runs.front());
+  bool uniform = true;
+  for (const TextRun& run : item.runs) uniform = uniform && StyleName(run) == first;
+  std::string styles;
+  if (uniform) {
+    styles = first;
+  } else {
+    for (const TextRun& run : item.runs) {
+      const std::string name = StyleName(run);
+      if (name.empty()) continue;
+      if (!styles.empty()) styles += "; ";
+      styles += name + " \"" + run.text + "\"";
+    }
+  }
+  if (!styles.empty()) line += "  [" + styles + "]";
+  return line;
+}
+
+// |text| aligned as |item| would print, in font A columns.
+std::string Placeholder(const PageItem& item, const std::string& text, int dots_per_line) {
+  const int dots = DisplayWidth(text, 1) * kFontAWidth;
+  return std::string(AlignOffset(item.align, dots, dots_per_line) / kFontAWidth, ' ') + text;
+}
+
+std::string Size(const MonoBitmap& bitmap) {
+  return std::to_string(bitmap.width) + "x" + std::to_string(bitmap.height);
+}
+
+// One-bit canvas the width of the paper; dots outside it are dropped.
+class Canvas {
+ public:
+  Canvas(int width, int height) {
+    bitmap_.width = width;
+    bitmap_.height = height;
+    bitmap_.bytes_per_row = (width + 7) / 8;
+    bitmap_.bits.assign(static_cast<size_t>(bitmap_.bytes_per_row) * height, 0);
+  }
+
+  void Fill(int x, int y, int width, int height) {
+    const int x0 = std::max(x, 0);
+    const int x1 = std::min(x + width, bitmap_.width);
+    const int y1 = std::min(y + height, bitmap_.height);
+    for (int row = std::max(y, 0); row < y1; ++row) {
+      uint8_t* bits = &bitmap_.bits[static_cast<size_t>(row) * bitmap_.bytes_per_row];
+      for (int dot = x0; dot < x1; ++dot) bits[dot >> 3] |= static_cast<uint8_t>(0x80 >> (dot & 7));
+    }
+  }
+
+  void Draw(const MonoBitmap& image, int x, int y) {
+    for (int row = 0; row < image.height; ++row) {
+      const uint8_t* bits = &image.bits[static_cast<size_t>(row) * image.bytes_per_row];
+      for (int dot = 0; dot < image.width; ++dot) {
+        if (bits[dot >> 3] & (0x80 >> (dot & 7))) Fill(x + dot, y + row, 1, 1);
+      }
+    }
+  }
+
+  MonoBitmap Take() { return std::move(bitmap_); }
+
+ private:
+  MonoBitmap bitmap_;
+};
+
+// Draws one character cell |width| dots wide with its top left at x, y.
+void DrawCharacter(uint32_t code_point, const TextRun& run, int width, int x, int y,
+                   Canvas* canvas) {
+  if (code_point == ' ') return;
+  // The 5 x 7 face fills font A at 2 x 3 dots a pixel, font B at 1 x 2.
+  const int scale_x = (run.font_b ? 1 : 2) * run.width;
+  const int scale_y = (run.font_b ? 2 : 3) * run.height;
+  const int left = x + (run.font_b ? 2 : 1) * run.width;
+  const int top = y + (run.font_b ? 1 : 2) * run.height;
+  if (code_point < 0x20 || code_point > 0x7E) {
+    // A box for characters the face lacks
+    const int box_width = width - 2 * (left - x);
+    const int box_height = 7 * scale_y;
+    canvas->Fill(left, top, box_width, 1);
+    canvas->Fill(left, top + box_height - 1, box_width, 1);
+    canvas->Fill(left, top, 1, box_height);
+    canvas->Fill(left + box_width - 1, top, 1, box_height);
+    return;
+  }
+  const uint8_t* glyph = kGlyphs[code_point - 0x20];
+  for (int column = 0; column < 5; ++column) {
+    for (int row = 0; row < 7; ++row) {
+      if (!(glyph[column] & (1 << row))) continue;
+      // Emphasis prints each dot twice, one dot apart
+      canvas->Fill(left + column * scale_x, top + row * scale_y, scale_x + (run.bold ? 1 : 0),
+                   scale_y);
+    }
+  }
+}
+
+void DrawLine(const PageItem& item, int dots_per_line, int y, Canvas* canvas) {
+  int dots = 0;
+  int height = 0;
+  for (const TextRun& run : item.runs) {
+    dots += run.dots;
+    height = std::max(height, CellHeight(run.font_b) * run.height);
+  }
+  int x = AlignOffset(item.align, dots, dots_per_line);
+  for (const TextRun& run : item.runs) {
+    // Characters of different heights share a baseline.
+    const int cell_height = CellHeight(run.font_b) * run.height;
+    const int top = y + height - cell_height;
+    const int cell_width = CellWidth(run.font_b) * run.width * (run.double_byte ? 2 : 1);
+    if (run.underline > 0) {
+      canvas->Fill(x, top + cell_height - run.underline, run.dots, run.underline);
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(run.text.data());
+    size_t i = 0;
+    while (i < run.text.size()) {
+      uint32_t code_point = data[i];
+      size_t length = 1;
+      if (code_point >= 0x80) {
+        length = DecodeUtf8(data + i, run.text.size() - i, &code_point);
+        if (length == 0) {
+          code_point = 0xFFFD;
+          length = 1;
+        }
+      }
+      DrawCharacter(code_point, run, cell_width, x, top, canvas);
+      x += cell_width;
+      i += length;
+    }
+  }
+}
+
+// Places every item down the paper, drawing when |canvas| is set. Returns
+// the length of paper used.
+int Place(const Page& page, Canvas* canvas) {
+  int y = 0;
+  int bottom = 0;
+  for (const PageItem& item : page.items) {
+    switch (item.type) {
+      case PageItemType::kText: {
+        int height = 0;
+        for (const TextRun& run : item.runs) {
+          height = std::max(height, CellHeight(run.font_b) * run.height);
+        }
+        if (canvas != nullptr) DrawLine(item, page.dots_per_line, y, canvas);
+        bottom = std::max(bottom, y + height);
+        y += item.dots;
+        break;
+      }
+      case PageItemType::kImage:
+      case PageItemType::kBarcode:
+      case PageItemType::kQrCode:
+      case PageItemType::kStoredImage:
+        if (canvas != nullptr) {
+          canvas->Draw(item.bitmap,
+                       AlignOffset(item.align, item.bitmap.width, page.dots_per_line), y);
+        }
+        y += item.bitmap.height;
+        break;
+      case PageItemType::kFeed:
+        y += item.dots;
+        break;
+      case PageItemType::kCut:
+        if (canvas != nullptr) {
+          for (int x = 0; x < page.dots_per_line; x += 8) canvas->Fill(x, y + kCutRows / 2, 4, 1);
+        }
+        y += kCutRows;
+        break;
+      case PageItemType::kDrawerKick:
+        break;
+    }
+    bottom = std::max(bottom, y);
+  }
+  return bottom;
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+  static const std::array<uint32_t, 256> kTable = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    return table;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) crc = kTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+void AppendUint32(uint32_t value, std::vector<uint8_t>* out) {
+  for (int shift = 24; shift >= 0; shift -= 8) out->push_back(static_cast<uint8_t>(value >> shift));
+}
+
+void AppendChunk(const char* type, const std::vector<uint8_t>& data, std::vector<uint8_t>* out) {
+  AppendUint32(static_cast<uint32_t>(data.size()), out);
+  const size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), data.begin(), data.end());
+  AppendUint32(Crc32(0, out->data() + start, out->size() - start), out);
+}
+
+}  // namespace
+
+bool InterpretEscPos(const uint8_t* data, size_t size, const VirtualPrinterOptions& options,
+                     Page* page) {
+  return Interpreter(options, page).Run(data, size);
+}
+
+std::string RenderPageText(const Page& page) {
+  std::string text;
+  const std::vector<PageItem>& items = page.items;
+  for (size_t i = 0; i < items.size(); ++i) {
+    const PageItem& item = items[i];
+    std::string line;
+    switch (item.type) {
+      case PageItemType::kText:
+        line = TextLine(item, page.dots_per_line);
+        break;
+      case PageItemType::kImage: {
+        // Raster bands, and the ESC J feeds between them, are one picture.
+        int width = item.bitmap.width;
+        int height = item.bitmap.height;
+        while (i + 1 < items.size()) {
+          const PageItem& next = items[i + 1];
+          if (next.type == PageItemType::kImage) {
+            width = std::max(width, next.bitmap.width);
+            height += next.bitmap.height;
+            ++i;
+          } else if (next.type == PageItemType::kFeed && next.lines == 0 && i + 2 < items.size() &&
+                     items[i + 2].type == PageItemType::kImage) {
+            height += next.dots;
+            ++i;
+          } else {
+            break;
+          }
+        }
+        line = Placeholder(item,
+                           "[image " + std::to_string(width) + "x" + std::to_string(height) + "]",
+                           page.dots_per_line);
+        break;
+      }
+      case PageItemType::kBarcode:
+        line = Placeholder(item, "[" + BarcodeName(item.code) + " " + item.data + "]",
+                           page.dots_per_line);
+        break;
+      case PageItemType::kQrCode:
+        line = Placeholder(item, "[QR " + item.data + "]", page.dots_per_line);
+        break;
+      case PageItemType::kStoredImage:
+        line = Placeholder(item,
+                           "[" + item.data +
+                               (item.bitmap.bits.empty() ? "" : " " + Size(item.bitmap)) + "]",
+                           page.dots_per_line);
+        break;
+      case PageItemType::kFeed:
+        text.append(static_cast<size_t>(item.lines), '\n');
+        continue;
+      case PageItemType::kCut:
+        line = item.partial ? "[partial cut]" : "[cut]";
+        break;
+      case PageItemType::kDrawerKick:
+        line = "[drawer kick pin " + std::to_string(item.code) + "]";
+        break;
+    }
+    text += line;
+    text += '\n';
+  }
+  return text;
+}
+
+MonoBitmap RenderPageBitmap(const Page& page) {
+  Canvas canvas(page.dots_per_line, Place(page, nullptr));
+  Place(page, &canvas);
+  return canvas.Take();
+}
+
+std::vector<uint8_t> EncodePng(const MonoBitmap& bitmap) {
+  std::vector<uint8_t> png;
+  if (bitmap.width <= 0 || bitmap.height <= 0) return png;
+  static const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  png.assign(kSignature, kSignature + sizeof(kSignature));
+
+  std::vector<uint8_t> header;
+  AppendUint32(static_cast<uint32_t>(bitmap.width), &header);
+  AppendUint32(static_cast<uint32_t>(bitmap.height), &header);
+  // One-bit grayscale, deflate, no filtering, no interlace
+  header.insert(header.end(), {1, 0, 0, 0, 0});
+  AppendChunk("IHDR", header, &png);
+
+  // Rows with filter byte 0, white where the bitmap has no dot
+  std::vector<uint8_t> rows;
+  const size_t stride = static_cast<size_t>(bitmap.bytes_per_row);
+  rows.reserve((stride + 1) * bitmap.height);
+  const int used = bitmap.width % 8;
+  const uint8_t padding = used == 0 ? 0 : static_cast<uint8_t>(0xFF >> used);
+  for (int y = 0; y < bitmap.height; ++y) {
+    rows.push_back(0);
+    const uint8_t* bits = &bitmap.bits[y * stride];
+    for (size_t i = 0; i < stride; ++i) rows.push_back(static_cast<uint8_t>(~bits[i]));
+    rows.back() |= padding;
+  }
+
+  // zlib stream of stored deflate blocks
+  constexpr size_t kMaxBlock = 65535;
+  std::vector<uint8_t> zlib = {0x78, 0x01};
+  zlib.reserve(rows.size() + rows.size() / kMaxBlock * 5 + 16);
+  for (size_t pos = 0; pos < rows.size(); pos += kMaxBlock) {
+    const size_t length = std::min(kMaxBlock, rows.size() - pos);
+    zlib.push_back(pos + length == rows.size() ? 1 : 0);
+    zlib.push_back(static_cast<uint8_t>(length));
+    zlib.push_back(static_cast<uint8_t>(length >> 8));
+    zlib.push_back(static_cast<uint8_t>(~length));
+    zlib.push_back(static_cast<uint8_t>(~length >> 8));
+    zlib.insert(zlib.end(), rows.begin() + pos, rows.begin() + pos + length);
+  }
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t byte : rows) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  AppendUint32(b << 16 | a, &zlib);
+  AppendChunk("IDAT", zlib, &png);
+  AppendChunk("IEND", {}, &png);
+  return png;
+}
+
+}  // namespace printer_core
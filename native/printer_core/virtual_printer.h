@@ -0,0 +1,118 @@
+#ifndef PRINTER_CORE_VIRTUAL_PRINTER_H_
+#define PRINTER_CORE_VIRTUAL_PRINTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "code_page.h"
+#include "logo_raster.h"
+#include "text_layout.h"
+
+namespace printer_core {
+
+// An ESC/POS interpreter that prints to memory instead of paper, so encoder
+// output can be checked against text or PNG goldens and benchmarked without
+// a printer.
+
+// Text printed with one set of styles.
+struct TextRun {
+  std::string text;  // UTF-8
+  bool bold = false;
+  // Underline thickness in dots: 0, 1 or 2.
+  int underline = 0;
+  // Character size multipliers, 1-8.
+  int width = 1;
+  int height = 1;
+  // Font B (9 x 17 dots) instead of font A (12 x 24).
+  bool font_b = false;
+  // Double-byte characters (FS &), each two cells wide.
+  bool double_byte = false;
+  // Dots the run takes across the paper.
+  int dots = 0;
+};
+
+enum class PageItemType {
+  kText,         // one printed line
+  kImage,        // GS v 0 raster or ESC * bit image
+  kBarcode,      // GS k
+  kQrCode,       // GS ( k print
+  kStoredImage,  // GS ( L / GS 8 L print or FS p
+  kFeed,         // paper fed with nothing printed
+  kCut,          // GS V
+  kDrawerKick,   // ESC p
+};
+
+struct PageItem {
+  PageItemType type = PageItemType::kText;
+  // Justification in effect for the item.
+  RowAlign align = RowAlign::kLeft;
+  // kText: the runs of the line.
+  std::vector<TextRun> runs;
+  // kImage, kBarcode, kQrCode, kStoredImage: the dots as printed. Empty for
+  // barcode symbologies other than Code128 and for images stored before
+  // the stream.
+  MonoBitmap bitmap;
+  // kBarcode, kQrCode: the encoded data. kStoredImage: which image, as
+  // "GS ( L " and the two key code bytes, or "FS p " and the number.
+  std::string data;
+  // kBarcode: GS k symbology number. kDrawerKick: the pin.
+  int code = 0;
+  // kText, kFeed: dots the paper moves after the item. kFeed: how many line
+  // feeds (LF, ESC d) it stands for; ESC J feeds add dots only.
+  int dots = 0;
+  int lines = 0;
+  // kCut: partial rather than full.
+  bool partial = false;
+};
+
+struct Page {
+  int dots_per_line = 576;
+  std::vector<PageItem> items;
+  // Images the stream stored in NV memory (GS ( L / GS 8 L function 67,
+  // FS q), by the name kStoredImage items use.
+  std::map<std::string, MonoBitmap> stored_images;
+  // Offset of the unknown or truncated command interpretation stopped at;
+  // the stream size when it read everything.
+  size_t stopped_at = 0;
+};
+
+struct VirtualPrinterOptions {
+  // Print width: 576 dots for 80 mm paper, 384 for 58 mm.
+  int dots_per_line = 576;
+  int dots_per_inch = 203;
+  // Table in effect before any ESC t, and what FS & selects (kGb18030 or
+  // kBig5 on Chinese models).
+  CodePage code_page = CodePage::kCp437;
+  CodePage double_byte = CodePage::kNone;
+};
+
+// Interprets |data| as a printer with |options| would and appends what it
+// prints to |page|. Lines wrap at the print width; text not ended by a
+// line feed or printing command is printed at the end, as a printer would
+// after its buffer timeout. Known commands it does not model (e.g. status
+// requests, GS B, NV definitions) are skipped. Returns false, with
+// |page->stopped_at| set, if it met an unknown or truncated command.
+bool InterpretEscPos(const uint8_t* data, size_t size, const VirtualPrinterOptions& options,
+                     Page* page);
+
+// The page as text, one line per printed line in font A columns: text is
+// placed where the printer puts it and followed by its styles ("[bold 2x2]");
+// images, symbols and cuts print as bracketed placeholders ("[image
+// 384x120]", "[CODE128 INV-1]", "[QR ...]", "[cut]"). ESC J feeds show
+// only in the bitmap.
+std::string RenderPageText(const Page& page);
+
+// The page as printed, one dot a pixel. Text uses a built-in 5 x 7 ASCII
+// face scaled into the font's cell; other characters print as boxes.
+MonoBitmap RenderPageBitmap(const Page& page);
+
+// |bitmap| as a 1-bit grayscale PNG (dots black), with stored deflate blocks
+// so it needs no compression library.
+std::vector<uint8_t> EncodePng(const MonoBitmap& bitmap);
+
+}  // namespace printer_core
+
+#endif  // PRINTER_CORE_VIRTUAL_PRINTER_H_
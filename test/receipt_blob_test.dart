@@ -0,0 +1,59 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:extropos/services/utils/receipt_blob.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+void main() {
+  group('ReceiptBlob.encode', () {
+    final data = {
+      'title': 'EXTROPOS CAFÉ',
+      'items': [
+        {'name': 'Nasi Lemak', 'quantity': 2, 'price': 8.5},
+        {'name': 'Refund', 'quantity': -1, 'price': 4},
+      ],
+      'subtotal': 13.0,
+      'total': 13.78,
+      'qr_data': 'https://myinvois.hasil.gov.my/abc',
+    };
+
+    String stringAt(ByteData blob, int ref, int stringsStart) {
+      final offset = blob.getUint32(ref, Endian.little);
+      final length = blob.getUint32(ref + 4, Endian.little);
+      return utf8.decode(blob.buffer.asUint8List(stringsStart + offset, length));
+    }
+
+    test('writes the header, item records and string table', () {
+      final bytes = ReceiptBlob.encode(data);
+      final blob = ByteData.sublistView(bytes);
+      expect(ascii.decode(bytes.sublist(0, 4)), 'EXRB');
+      expect(blob.getUint16(4, Endian.little), ReceiptBlob.version);
+      expect(blob.getUint16(6, Endian.little), ReceiptBlob.headerSize);
+      // Title, subtotal and total
+      expect(blob.getUint32(8, Endian.little), 0x13);
+      expect(blob.getUint32(12, Endian.little), 2);
+      expect(blob.getUint32(16, Endian.little), ReceiptBlob.itemSize);
+
+      const stringsStart = ReceiptBlob.headerSize + 2 * ReceiptBlob.itemSize;
+      expect(blob.getUint32(20, Endian.little), bytes.length - stringsStart);
+      expect(stringAt(blob, 24, stringsStart), 'RM');
+      expect(stringAt(blob, 32, stringsStart), 'EXTROPOS CAFÉ');
+      expect(stringAt(blob, 40, stringsStart), '');
+      expect(stringAt(blob, 48, stringsStart), 'https://myinvois.hasil.gov.my/abc');
+      expect(blob.getFloat64(80, Endian.little), 13.78);
+
+      const second = ReceiptBlob.headerSize + ReceiptBlob.itemSize;
+      expect(stringAt(blob, second, stringsStart), 'Refund');
+      expect(blob.getInt32(second + 8, Endian.little), -1);
+      expect(blob.getFloat64(second + 16, Endian.little), 4.0);
+    });
+
+    test('leaves absent optional fields unflagged', () {
+      final bytes = ReceiptBlob.encode({'items': []});
+      final blob = ByteData.sublistView(bytes);
+      expect(blob.getUint32(8, Endian.little), 0);
+      expect(blob.getUint32(12, Endian.little), 0);
+      expect(bytes.length, ReceiptBlob.headerSize + 2);
+    });
+  });
+}
@@ -43,4 +43,68 @@ void main() {
       expect(result.contains('Tax'), true, reason: 'Tax should be present when showTaxBreakdown is true');
     });
   });
+
+  group('structuredReceiptWithSettings', () {
+    final data = {
+      'store_name': 'Test Shop',
+      'address': ['Line 1'],
+      'date': '2025-11-18',
+      'bill_no': 'B123',
+      'items': [
+        {'name': 'Teh Tarik', 'qty': 2, 'amt': 5.0},
+      ],
+      'sub_total_amt': 5.0,
+      'taxes': [
+        {'name': 'Tax', 'amt': 0.3}
+      ],
+      'service_charge': 0.0,
+      'total': 5.3,
+      'currency': 'RM',
+    };
+
+    test('maps items, totals and header lines to the blob fields', () {
+      final result = structuredReceiptWithSettings(data: data, settings: ReceiptSettings())!;
+      expect(result['title'], 'CUSTOMER RECEIPT');
+      expect(result['items'], [
+        {'name': 'Teh Tarik', 'quantity': 2, 'price': 2.5},
+      ]);
+      expect(result['subtotal'], 5.0);
+      expect(result['total'], 5.3);
+      expect(result['headerLines'], contains('Test Shop'));
+      expect(result['headerLines'], isNot(contains('Line 1')));
+      expect(result['footerLines'], contains('Please Come Again'));
+    });
+
+    test('prints the same currency and totals as the text receipt', () {
+      final noCurrency = Map<String, dynamic>.from(data)
+        ..remove('currency')
+        ..['service_charge'] = 0.5
+        ..['total'] = 5.8;
+      for (final Map<String, dynamic> receipt in [data, noCurrency]) {
+        final settings = ReceiptSettings();
+        final text =
+            generateReceiptTextWithSettings(data: receipt, settings: settings, charWidth: 48);
+        final result = structuredReceiptWithSettings(data: receipt, settings: settings)!;
+        final total = (result['total'] as num).toStringAsFixed(2);
+        expect(text, contains('${result['currency']} $total'));
+        expect(text, contains((result['subtotal'] as num).toStringAsFixed(2)));
+        // Neither prints tax or service charge lines, only the total with them
+        expect(text, isNot(contains('Tax')));
+        expect(result.containsKey('tax'), false);
+        expect(result.containsKey('serviceCharge'), false);
+      }
+      expect(
+        structuredReceiptWithSettings(data: noCurrency, settings: ReceiptSettings())!['currency'],
+        'Rs',
+      );
+    });
+
+    test('leaves fractional quantities to the text receipt', () {
+      final weighed = Map<String, dynamic>.from(data)
+        ..['items'] = [
+          {'name': 'Prawns', 'qty': 0.5, 'amt': 20.0},
+        ];
+      expect(structuredReceiptWithSettings(data: weighed, settings: ReceiptSettings()), isNull);
+    });
+  });
 }
@@ -0,0 +1,44 @@
+// Times the Dart logo path (decode, resize, grayscale, GS v 0 packing) that
+// ThermalReceiptGenerator runs on every receipt, for comparison with the
+// native rasterizer timed by native/printer_core's printer_core_logo_bench.
+//
+//   dart run tool/logo_raster_benchmark.dart <logo.png> [iterations]
+//
+// The native runners decode a logo once and serve later receipts from their
+// logo cache, so compare this per-receipt time with the bench's "total"
+// column for the first receipt and its "cached" column for the rest.
+
+import 'dart:io';
+
+import 'package:extropos/services/thermal_receipt_generator.dart';
+
+void main(List<String> args) {
+  if (args.isEmpty) {
+    stderr.writeln('usage: dart run tool/logo_raster_benchmark.dart <logo.png> [iterations]');
+    exitCode = 64;
+    return;
+  }
+  final path = args.first;
+  final iterations = args.length > 1 ? int.tryParse(args[1]) ?? 20 : 20;
+
+  for (final paperSize in PaperSize.values) {
+    // Warm up once so the JIT has compiled the path being timed.
+    final bytes = ThermalReceiptGenerator.logoCommands(path, paperSize);
+    if (bytes.isEmpty) {
+      stderr.writeln('$path: could not decode logo');
+      exitCode = 1;
+      return;
+    }
+    final samples = <int>[];
+    for (var i = 0; i < iterations; i++) {
+      final watch = Stopwatch()..start();
+      ThermalReceiptGenerator.logoCommands(path, paperSize);
+      samples.add(watch.elapsedMicroseconds);
+    }
+    samples.sort();
+    stdout.writeln(
+      '${paperSize.name}: ${bytes.length} bytes, '
+      'median ${samples[samples.length ~/ 2]} us over $iterations runs',
+    );
+  }
+}
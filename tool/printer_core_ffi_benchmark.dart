@@ -0,0 +1,81 @@
+// Times encoding a receipt from Dart through libprinter_core_ffi, from the
+// receiptData map to bytes Dart can read, for comparison with the method
+// channel round trip timed by native/printer_core's printer_core_benchmarks
+// (BM_ChannelEncodeReceipt against BM_FfiEncodeReceipt).
+//
+//   dart run tool/printer_core_ffi_benchmark.dart <libprinter_core_ffi.so> [iterations]
+
+import 'dart:io';
+
+import 'package:extropos/services/utils/printer_core_ffi.dart';
+
+Map<String, dynamic> _buffetReceipt(int items) {
+  const dishes = [
+    'Nasi Lemak Ayam Goreng',
+    'Teh Tarik',
+    'Roti Canai Telur',
+    'Mee Goreng Mamak',
+    'Kopi O Ais',
+    'Char Kuey Teow Udang',
+    'Satay Ayam (10 cucuk)',
+    'Cendol Durian',
+  ];
+  var subtotal = 0.0;
+  final lines = [
+    for (var i = 0; i < items; i++)
+      {
+        'name': '${dishes[i % 8]} #${i + 1}',
+        'quantity': 1 + i % 3,
+        'price': 2.5 + (i % 17) * 0.85,
+      },
+  ];
+  for (final line in lines) {
+    subtotal += (line['price'] as double) * (line['quantity'] as int);
+  }
+  return {
+    'title': 'EXTROPOS BUFFET',
+    'items': lines,
+    'subtotal': subtotal,
+    'tax': subtotal * 0.06,
+    'serviceCharge': subtotal * 0.10,
+    'total': subtotal * 1.16,
+    'barcode': 'INV-000123',
+    'qr_data': 'https://myinvois.hasil.gov.my/abc',
+  };
+}
+
+void main(List<String> args) {
+  if (args.isEmpty) {
+    stderr.writeln(
+      'usage: dart run tool/printer_core_ffi_benchmark.dart <libprinter_core_ffi.so> [iterations]',
+    );
+    exitCode = 64;
+    return;
+  }
+  final ffi = PrinterCoreFfi.load(args.first);
+  if (ffi == null) {
+    stderr.writeln('${args.first}: no libprinter_core_ffi of ABI ${PrinterCoreFfi.abiVersion}');
+    exitCode = 1;
+    return;
+  }
+  final iterations = args.length > 1 ? int.tryParse(args[1]) ?? 200 : 200;
+  final encoder = NativeReceiptEncoder(ffi);
+
+  for (final items in const [1, 50, 500, 5000]) {
+    final receipt = _buffetReceipt(items);
+    // Warm up once so the JIT has compiled the path being timed.
+    final bytes = encoder.encodeReceipt(receipt).length;
+    final samples = <int>[];
+    for (var i = 0; i < iterations; i++) {
+      final watch = Stopwatch()..start();
+      encoder.encodeReceipt(receipt);
+      samples.add(watch.elapsedMicroseconds);
+    }
+    samples.sort();
+    stdout.writeln(
+      '$items items: $bytes bytes, '
+      'median ${samples[samples.length ~/ 2]} us over $iterations runs',
+    );
+  }
+  encoder.dispose();
+}
@@ -9,12 +9,14 @@
 #include <sstream>
 #include <windows.h>
 #include <winspool.h>
-#include <iostream>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <cstdio>
 
+#include "escpos_encoder.h"
+#include "logger.h"
+
 namespace {
 
 class WindowsPrinterPlugin : public flutter::Plugin {
@@ -35,7 +37,7 @@ class WindowsPrinterPlugin : public flutter::Plugin {
   bool IsThermalPrinter(const std::string& driver_name, const std::string& printer_name);
   bool PrintToWindowsPrinter(const std::string& printer_name, const std::string& content);
   std::string GetPrinterDriverName(const std::string& printer_name);
-  std::string ConvertToEscPos(const std::string& receipt_text);
+  const std::vector<uint8_t>& ConvertToEscPos(const std::string& receipt_text);
   std::string WideToUtf8(const wchar_t* wide_string);
 
  private:
@@ -43,21 +45,16 @@ class WindowsPrinterPlugin : public flutter::Plugin {
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
-  // Channel used to send logs back to Dart
+  // Reused output buffer for ESC/POS conversion
+  printer_core::EscPosEncoder encoder_;
+  // Channel the plugin answers on
   std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> log_channel_;
-  // Helper to send logs back to Dart as well as stdout
-  void PostLog(const std::string& message) {
-    try {
-      OutputDebugStringA(message.c_str());
-      std::cout << message << std::endl;
-      if (log_channel_) {
-        flutter::EncodableMap m;
-        m[flutter::EncodableValue("message")] = flutter::EncodableValue(message);
-        log_channel_->InvokeMethod("printerLog", std::make_unique<flutter::EncodableValue>(m));
-      }
-    } catch (...) {
-      // ignore logging failures
-    }
+  // Batches log lines to the debugger and a rotating file off the platform
+  // thread; the runner's PrinterPlugin is the one that forwards logs to Dart.
+  std::unique_ptr<printer_core::Logger> logger_;
+  void PostLog(const std::string& message,
+               printer_core::LogLevel level = printer_core::LogLevel::kInfo) {
+    logger_->Log(level, "WINDOWS", message);
   }
 };
 
@@ -83,7 +80,34 @@ void WindowsPrinterPlugin::RegisterWithRegistrar(
   try { plugin->PostLog("WindowsPrinterPlugin: Registered with registrar"); } catch(...){}
 }
 
-WindowsPrinterPlugin::WindowsPrinterPlugin() {}
+// One OutputDebugStringA call per batch instead of one (plus a flushed
+// std::cout line) per message.
+void WriteLogBatchToDebugger(const std::vector<printer_core::LogEntry>& batch) {
+  std::string text;
+  for (const printer_core::LogEntry& entry : batch) {
+    text += printer_core::LogLevelName(entry.level);
+    text += ' ';
+    text += entry.message;
+    text += '\n';
+  }
+  OutputDebugStringA(text.c_str());
+}
+
+printer_core::LoggerOptions PluginLoggerOptions() {
+  printer_core::LoggerOptions options;
+  char base[MAX_PATH];
+  const DWORD length = GetEnvironmentVariableA("LOCALAPPDATA", base, MAX_PATH);
+  if (length > 0 && length < MAX_PATH) {
+    const std::string dir = std::string(base) + "\\ExtroPOS";
+    CreateDirectoryA(dir.c_str(), nullptr);
+    options.file_path = dir + "\\windows_printer_plugin.log";
+  }
+  return options;
+}
+
+WindowsPrinterPlugin::WindowsPrinterPlugin()
+    : logger_(std::make_unique<printer_core::Logger>(PluginLoggerOptions(),
+                                                     WriteLogBatchToDebugger)) {}
 
 WindowsPrinterPlugin::~WindowsPrinterPlugin() {}
 
@@ -104,6 +128,8 @@ void WindowsPrinterPlugin::HandleMethodCall(
         const auto* enabled = std::get_if<bool>(&enabled_it->second);
         if (enabled) {
           debugEnabled_ = *enabled;
+          logger_->set_min_level(*enabled ? printer_core::LogLevel::kDebug
+                                          : printer_core::LogLevel::kInfo);
           PostLog(std::string("setDebugEnabled -> ") + (*enabled ? "true" : "false"));
           result->Success(flutter::EncodableValue(true));
           return;
@@ -444,36 +470,13 @@ std::string WindowsPrinterPlugin::GetPrinterDriverName(const std::string& printe
   return "";
 }
 
-std::string WindowsPrinterPlugin::ConvertToEscPos(const std::string& receipt_text) {
-  std::string esc_pos;
-  
-  // Initialize printer
-  esc_pos += "\x1B\x40";  // ESC @ - Initialize printer
-  
-  // Split text into lines and process each line
-  std::istringstream iss(receipt_text);
-  std::string line;
-  while (std::getline(iss, line)) {
-    if (line.empty()) {
-      esc_pos += "\x0A";  // Line feed
-      continue;
-    }
-    
-    // Center align lines that look like headers (no price info)
-    if (line.find('$') == std::string::npos && line.find("RM") == std::string::npos) {
-      esc_pos += "\x1B\x61\x01";  // ESC a 1 - Center alignment
-    } else {
-      esc_pos += "\x1B\x61\x00";  // ESC a 0 - Left alignment
-    }
-    
-    esc_pos += line;
-    esc_pos += "\x0A";  // Line feed
-  }
-  
-  // Cut paper
-  esc_pos += "\x1D\x56\x42\x00";  // GS V B 0 - Full cut
-  
-  return esc_pos;
+const std::vector<uint8_t>& WindowsPrinterPlugin::ConvertToEscPos(const std::string& receipt_text) {
+  // Initialize, centre header lines and left-align lines with prices, then
+  // full cut. Blank lines are plain line feeds.
+  printer_core::TextOptions options;
+  options.align_blank_lines = false;
+  options.feed_before_cut = false;
+  return encoder_.EncodeText(receipt_text, options);
 }
 
 bool WindowsPrinterPlugin::PrintToWindowsPrinter(const std::string& printer_name, const std::string& content) {
@@ -481,14 +484,10 @@ bool WindowsPrinterPlugin::PrintToWindowsPrinter(const std::string& printer_name
   std::string driver_name = GetPrinterDriverName(printer_name);
   bool isThermal = IsThermalPrinter(driver_name, printer_name);
   
-  std::string printData;
-  if (isThermal) {
-    // Convert receipt text to ESC/POS commands for thermal printers
-    printData = ConvertToEscPos(content);
-  } else {
-    // Use plain text for regular printers
-    printData = content;
-  }
+  // Convert receipt text to ESC/POS commands for thermal printers, plain text
+  // for regular printers
+  const std::vector<uint8_t>& printData =
+      isThermal ? ConvertToEscPos(content) : encoder_.EncodeRaw(content);
 
   HANDLE hPrinter = NULL;
   DOC_INFO_1 docInfo;
@@ -518,11 +517,12 @@ bool WindowsPrinterPlugin::PrintToWindowsPrinter(const std::string& printer_name
   }
 
   // Write the content
-  if (!WritePrinter(hPrinter, const_cast<char*>(printData.c_str()), static_cast<DWORD>(printData.length()), &bytesWritten)) {
+  if (!WritePrinter(hPrinter, const_cast<uint8_t*>(printData.data()), static_cast<DWORD>(printData.size()), &bytesWritten)) {
     EndPagePrinter(hPrinter);
     EndDocPrinter(hPrinter);
     ClosePrinter(hPrinter);
-    try { PostLog("Windows: WritePrinter failed while printing to " + printer_name); } catch(...) {}
+    try { PostLog("Windows: WritePrinter failed while printing to " + printer_name,
+                  printer_core::LogLevel::kError); } catch(...) {}
     return false;
   }
 
@@ -0,0 +1,72 @@
+#include "platform_task_runner.h"
+
+#include <utility>
+
+namespace {
+
+constexpr const wchar_t kWindowClassName[] = L"EXTROPOS_PLATFORM_TASK_RUNNER";
+constexpr UINT kRunTasksMessage = WM_APP + 0x50;
+
+}  // namespace
+
+PlatformTaskRunner::PlatformTaskRunner() {
+  HINSTANCE instance = GetModuleHandle(nullptr);
+  WNDCLASS window_class{};
+  window_class.lpfnWndProc = PlatformTaskRunner::WndProc;
+  window_class.hInstance = instance;
+  window_class.lpszClassName = kWindowClassName;
+  // Fails harmlessly with ERROR_CLASS_ALREADY_EXISTS for later instances.
+  RegisterClass(&window_class);
+
+  window_ = CreateWindowEx(0, kWindowClassName, L"", 0, 0, 0, 0, 0,
+                           HWND_MESSAGE, nullptr, instance, nullptr);
+  if (window_) {
+    SetWindowLongPtr(window_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+  }
+}
+
+PlatformTaskRunner::~PlatformTaskRunner() {
+  HWND window;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    window = window_;
+    window_ = nullptr;
+    tasks_.clear();
+  }
+  if (window) DestroyWindow(window);
+}
+
+void PlatformTaskRunner::PostTask(std::function<void()> task) {
+  HWND window;
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!window_) return;
+    window = window_;
+    // One message drains the whole queue, so only post when it was empty.
+    wake = tasks_.empty();
+    tasks_.push_back(std::move(task));
+  }
+  if (wake) PostMessage(window, kRunTasksMessage, 0, 0);
+}
+
+void PlatformTaskRunner::RunPendingTasks() {
+  std::deque<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks.swap(tasks_);
+  }
+  for (auto& task : tasks) task();
+}
+
+// static
+LRESULT CALLBACK PlatformTaskRunner::WndProc(HWND hwnd, UINT message,
+                                             WPARAM wparam, LPARAM lparam) {
+  if (message == kRunTasksMessage) {
+    auto* self = reinterpret_cast<PlatformTaskRunner*>(
+        GetWindowLongPtr(hwnd, GWLP_USERDATA));
+    if (self) self->RunPendingTasks();
+    return 0;
+  }
+  return DefWindowProc(hwnd, message, wparam, lparam);
+}
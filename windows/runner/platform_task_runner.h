@@ -0,0 +1,36 @@
+#ifndef RUNNER_PLATFORM_TASK_RUNNER_H_
+#define RUNNER_PLATFORM_TASK_RUNNER_H_
+
+#include <windows.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Runs closures on the platform (UI) thread. Worker threads call PostTask;
+// the closures run from the runner's message loop via a message-only window
+// created on the platform thread. Flutter channel APIs must only be used from
+// tasks posted here.
+class PlatformTaskRunner {
+ public:
+  // Must be constructed on the platform thread.
+  PlatformTaskRunner();
+  ~PlatformTaskRunner();
+
+  PlatformTaskRunner(const PlatformTaskRunner&) = delete;
+  PlatformTaskRunner& operator=(const PlatformTaskRunner&) = delete;
+
+  // Thread-safe. Tasks posted after destruction has started are dropped.
+  void PostTask(std::function<void()> task);
+
+ private:
+  static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam,
+                                  LPARAM lparam);
+  void RunPendingTasks();
+
+  HWND window_ = nullptr;
+  std::mutex mutex_;
+  std::deque<std::function<void()>> tasks_;
+};
+
+#endif  // RUNNER_PLATFORM_TASK_RUNNER_H_
@@ -1,17 +1,30 @@
 #include "printer_plugin.h"
 
+#include <flutter/byte_streams.h>
+#include <flutter/engine_method_result.h>
+#include <flutter/event_channel.h>
+#include <flutter/event_stream_handler_functions.h>
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
+#include <flutter/standard_codec_serializer.h>
 #include <flutter/standard_method_codec.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "utils.h"
+#include <wincodec.h>
+#include <wrl/client.h>
 #include <sstream>
 #include <iomanip>
 #include <cstdint>
+#include <string_view>
 
 void PrinterPlugin::RegisterWithRegistrar(
     flutter::PluginRegistrarWindows *registrar) {
@@ -30,15 +43,43 @@ void PrinterPlugin::RegisterWithRegistrar(
   // Add a second channel to support existing Windows flutter plugin API surface
   plugin->net_channel_ = std::move(netChannel);
 
-  plugin->channel_->SetMethodCallHandler(
-      [plugin_pointer = plugin.get()](const auto &call, auto result) {
-        plugin_pointer->HandleMethodCall(call, std::move(result));
+  // Decoded by the plugin rather than the channel so printRaw owns its bytes
+  registrar->messenger()->SetMessageHandler(
+      "com.extrotarget.extropos/printer",
+      [plugin_pointer = plugin.get()](const uint8_t* message, size_t size,
+                                      flutter::BinaryReply reply) {
+        plugin_pointer->HandleRunnerMessage(message, size, std::move(reply));
       });
   plugin->net_channel_->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto &call, auto result) {
         plugin_pointer->HandleMethodCall(call, std::move(result));
       });
 
+  plugin->event_channel_ = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+      registrar->messenger(), "com.extrotarget.extropos/printer_events",
+      &flutter::StandardMethodCodec::GetInstance());
+  plugin->event_channel_->SetStreamHandler(
+      std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+          [plugin_pointer = plugin.get()](
+              const flutter::EncodableValue*,
+              std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_pointer->eventSink_ = std::move(events);
+            return nullptr;
+          },
+          [plugin_pointer = plugin.get()](const flutter::EncodableValue*)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_pointer->eventSink_.reset();
+            return nullptr;
+          }));
+
+  plugin->OpenSpool();
+  std::string nvError;
+  if (!plugin->nvLogos_.Load(&nvError)) {
+    plugin->PostLog("LOGO", nvError + "; logos will be uploaded again",
+                    printer_core::LogLevel::kWarning);
+  }
+
   // Post a registration log before adding the plugin to the registrar so the message
   // can be observed in Dart logs if the channels are set up properly.
   try {
@@ -49,21 +90,394 @@ void PrinterPlugin::RegisterWithRegistrar(
   registrar->AddPlugin(std::move(plugin));
 }
 
-PrinterPlugin::PrinterPlugin() : usbHandle_(NULL), isPrinterConnected_(false), 
-                               networkSocket_(INVALID_SOCKET), isNetworkPrinterConnected_(false) {}
+namespace {
+
+// Writes jobs for the "usb" target through the vendor DLL handle opened by
+// discoverPrinters. The queue serializes jobs per target, so the handle is
+// never written from two workers at once.
+class PosmacUsbTransport : public printer_core::PrinterTransport {
+ public:
+  explicit PosmacUsbTransport(HANDLE handle) : handle_(handle) {}
+
+  bool Write(const uint8_t* data, size_t size, std::string* error) override {
+    DWORD bytesWritten = 0;
+    if (WriteUsb(handle_, reinterpret_cast<char*>(const_cast<uint8_t*>(data)),
+                 static_cast<DWORD>(size), &bytesWritten) != TRUE) {
+      if (error) *error = "USB write failed";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  HANDLE handle_;
+};
+
+// Reads a platform message in place for StandardCodecSerializer. Reads past
+// the end give zeros instead of running off the buffer.
+class MessageReader : public flutter::ByteStreamReader {
+ public:
+  MessageReader(const uint8_t* data, size_t size) : data_(data), size_(data ? size : 0) {}
+
+  uint8_t ReadByte() override { return offset_ < size_ ? data_[offset_++] : 0; }
+
+  void ReadBytes(uint8_t* buffer, size_t length) override {
+    const size_t n = std::min(length, size_ - offset_);
+    if (n > 0) std::memcpy(buffer, data_ + offset_, n);
+    if (length > n) std::memset(buffer + n, 0, length - n);
+    offset_ += n;
+  }
+
+  void ReadAlignment(uint8_t alignment) override {
+    const size_t mod = offset_ % alignment;
+    if (mod != 0) offset_ = std::min(size_, offset_ + alignment - mod);
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+// Optional "priority" argument: drawer, receipt, kitchen or report.
+printer_core::JobPriority PriorityFromArguments(const flutter::EncodableMap& arguments,
+                                                printer_core::JobPriority fallback) {
+  auto it = arguments.find(flutter::EncodableValue("priority"));
+  if (it == arguments.end()) return fallback;
+  const auto* name = std::get_if<std::string>(&it->second);
+  if (!name) return fallback;
+  if (*name == "drawer" || *name == "beeper") return printer_core::JobPriority::kDrawer;
+  if (*name == "receipt") return printer_core::JobPriority::kReceipt;
+  if (*name == "kitchen") return printer_core::JobPriority::kKitchen;
+  if (*name == "report") return printer_core::JobPriority::kReport;
+  return fallback;
+}
+
+// Explicit "charsPerLine" (32, 42, 48 or 64), else approximate chars per line
+// from paper size if available (default 48)
+int CharsPerLineFromArguments(const flutter::EncodableMap& arguments) {
+  auto columns_it = arguments.find(flutter::EncodableValue("charsPerLine"));
+  if (columns_it != arguments.end()) {
+    const auto* columns = std::get_if<int32_t>(&columns_it->second);
+    if (columns && (*columns == 32 || *columns == 42 || *columns == 48 || *columns == 64)) {
+      return *columns;
+    }
+  }
+  int charsPerLine = 48;
+  auto paperSize_it = arguments.find(flutter::EncodableValue("paperSize"));
+  if (paperSize_it != arguments.end()) {
+    const auto* paperSize = std::get_if<std::string>(&paperSize_it->second);
+    if (paperSize) {
+      if (*paperSize == "mm58") charsPerLine = 32;
+      else if (*paperSize == "mm80") charsPerLine = 48;
+    }
+  }
+  return charsPerLine;
+}
+
+// Shape of a job outcome as seen by Dart (printJobCompleted and printBatch)
+flutter::EncodableMap JobResultToMap(const printer_core::PrintJobResult& r) {
+  flutter::EncodableMap m;
+  m[flutter::EncodableValue("jobId")] = flutter::EncodableValue(static_cast<int64_t>(r.job_id));
+  m[flutter::EncodableValue("success")] = flutter::EncodableValue(r.success);
+  m[flutter::EncodableValue("bytesWritten")] =
+      flutter::EncodableValue(static_cast<int64_t>(r.bytes_written));
+  m[flutter::EncodableValue("error")] = flutter::EncodableValue(r.error);
+  // For exportPrintTrace
+  if (r.trace_id != 0) {
+    m[flutter::EncodableValue("traceId")] = flutter::EncodableValue(static_cast<int64_t>(r.trace_id));
+  }
+  return m;
+}
+
+// Shape of a cached printer status as seen by Dart (getPrinterStatus)
+flutter::EncodableMap StatusToMap(const printer_core::PrinterStatus& status) {
+  flutter::EncodableMap m;
+  m[flutter::EncodableValue("status")] = flutter::EncodableValue(status.Summary());
+  m[flutter::EncodableValue("reachable")] = flutter::EncodableValue(status.reachable);
+  m[flutter::EncodableValue("reported")] = flutter::EncodableValue(status.reported);
+  m[flutter::EncodableValue("offline")] = flutter::EncodableValue(status.offline);
+  m[flutter::EncodableValue("coverOpen")] = flutter::EncodableValue(status.cover_open);
+  m[flutter::EncodableValue("paperNearEnd")] = flutter::EncodableValue(status.paper_near_end);
+  m[flutter::EncodableValue("paperOut")] = flutter::EncodableValue(status.paper_out);
+  m[flutter::EncodableValue("error")] = flutter::EncodableValue(status.error);
+  m[flutter::EncodableValue("lastError")] = flutter::EncodableValue(status.last_error);
+  const auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - status.updated);
+  m[flutter::EncodableValue("ageMs")] =
+      flutter::EncodableValue(static_cast<int64_t>(status.known ? age.count() : -1));
+  return m;
+}
+
+// Printer entry for a port that answered a network scan
+flutter::EncodableMap NetworkPrinterToMap(const printer_core::ScanHit& hit) {
+  const std::string endpoint = hit.host + ":" + std::to_string(hit.port);
+  const char* protocol = hit.port == 515 ? "LPD" : hit.port == 631 ? "IPP" : "Raw TCP";
+  flutter::EncodableMap printer;
+  printer[flutter::EncodableValue("id")] = flutter::EncodableValue("net_" + endpoint);
+  printer[flutter::EncodableValue("name")] = flutter::EncodableValue("Network Printer (" + endpoint + ")");
+  printer[flutter::EncodableValue("connectionType")] = flutter::EncodableValue("network");
+  printer[flutter::EncodableValue("ipAddress")] = flutter::EncodableValue(hit.host);
+  printer[flutter::EncodableValue("port")] = flutter::EncodableValue(static_cast<int32_t>(hit.port));
+  printer[flutter::EncodableValue("printerType")] = flutter::EncodableValue("receipt");
+  printer[flutter::EncodableValue("status")] = flutter::EncodableValue("online");
+  printer[flutter::EncodableValue("modelName")] =
+      flutter::EncodableValue(std::string(protocol) + " printer");
+  return printer;
+}
+
+// Status poll settings for the runners: a printer that runs out of paper or
+// drops off the network shows up in Dart within about a second.
+printer_core::StatusMonitorOptions RunnerStatusOptions() {
+  printer_core::StatusMonitorOptions options;
+  options.poll_interval_ms = 1000;
+  return options;
+}
+
+// %LOCALAPPDATA%\ExtroPOS\<name> (UTF-8), creating the folder; empty when
+// there is no local app data folder.
+std::string AppDataFile(const wchar_t* name) {
+  wchar_t base[MAX_PATH];
+  const DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) return std::string();
+  std::wstring dir = std::wstring(base) + L"\\ExtroPOS";
+  CreateDirectoryW(dir.c_str(), nullptr);
+  return Utf8FromUtf16((dir + L"\\" + name).c_str());
+}
+
+// Log batches go to Dart four times a second and into
+// %LOCALAPPDATA%\ExtroPOS\printer.log.
+printer_core::LoggerOptions RunnerLoggerOptions() {
+  printer_core::LoggerOptions options;
+  options.file_path = AppDataFile(L"printer.log");
+  options.default_max_per_second = 50;
+  return options;
+}
+
+// [{"time": us since the epoch, "level", "category", "message"}, ...]
+flutter::EncodableList LogBatchToList(const std::vector<printer_core::LogEntry>& batch) {
+  flutter::EncodableList entries;
+  entries.reserve(batch.size());
+  for (const printer_core::LogEntry& entry : batch) {
+    flutter::EncodableMap m;
+    m[flutter::EncodableValue("time")] = flutter::EncodableValue(entry.time_us);
+    m[flutter::EncodableValue("level")] =
+        flutter::EncodableValue(printer_core::LogLevelName(entry.level));
+    m[flutter::EncodableValue("category")] = flutter::EncodableValue(entry.category);
+    m[flutter::EncodableValue("message")] = flutter::EncodableValue(entry.message);
+    entries.emplace_back(std::move(m));
+  }
+  return entries;
+}
+
+// Replaces the file named by a UTF-8 path with |bytes|.
+bool WriteFileBytes(const std::string& path, const std::string& bytes) {
+  const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  if (length <= 0) return false;
+  std::wstring wide(length, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+  HANDLE file = CreateFileW(wide.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  DWORD written = 0;
+  const bool ok = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written,
+                            nullptr) && written == bytes.size();
+  CloseHandle(file);
+  return ok;
+}
+
+// Reads a whole file named by a UTF-8 path; false if it cannot be opened.
+bool ReadFileBytes(const std::string& path, std::vector<uint8_t>* bytes) {
+  const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  if (length <= 0) return false;
+  std::wstring wide(length, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+  HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  bool ok = GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < (64 << 20);
+  if (ok) {
+    bytes->resize(static_cast<size_t>(size.QuadPart));
+    DWORD read = 0;
+    ok = ReadFile(file, bytes->data(), static_cast<DWORD>(bytes->size()), &read, nullptr) &&
+         read == bytes->size();
+  }
+  CloseHandle(file);
+  return ok;
+}
+
+// Decodes an image file held in memory with WIC, as 32-bit BGRA.
+bool DecodeImage(const std::vector<uint8_t>& file, printer_core::GrayImage* image) {
+  using Microsoft::WRL::ComPtr;
+  ComPtr<IWICImagingFactory> factory;
+  ComPtr<IWICStream> stream;
+  ComPtr<IWICBitmapDecoder> decoder;
+  ComPtr<IWICBitmapFrameDecode> frame;
+  ComPtr<IWICBitmapSource> bgra;
+  if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                              IID_PPV_ARGS(&factory))) ||
+      FAILED(factory->CreateStream(&stream)) ||
+      FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(file.data()),
+                                          static_cast<DWORD>(file.size()))) ||
+      FAILED(factory->CreateDecoderFromStream(stream.Get(), nullptr,
+                                              WICDecodeMetadataCacheOnDemand, &decoder)) ||
+      FAILED(decoder->GetFrame(0, &frame)) ||
+      FAILED(WICConvertBitmapSource(GUID_WICPixelFormat32bppBGRA, frame.Get(), &bgra))) {
+    return false;
+  }
+  UINT width = 0;
+  UINT height = 0;
+  if (FAILED(bgra->GetSize(&width, &height)) || width == 0 || height == 0) return false;
+  const UINT stride = width * 4;
+  std::vector<uint8_t> pixels(static_cast<size_t>(stride) * height);
+  if (FAILED(bgra->CopyPixels(nullptr, stride, static_cast<UINT>(pixels.size()),
+                              pixels.data()))) {
+    return false;
+  }
+  *image = printer_core::GrayFromPixels(pixels.data(), static_cast<int>(width),
+                                        static_cast<int>(height), stride,
+                                        printer_core::PixelLayout::kBgra);
+  return !image->pixels.empty();
+}
+
+// Calls carrying "async": true get their job id back immediately.
+bool IsAsyncCall(const flutter::EncodableMap& arguments) {
+  auto it = arguments.find(flutter::EncodableValue("async"));
+  if (it == arguments.end()) return false;
+  const auto* async = std::get_if<bool>(&it->second);
+  return async && *async;
+}
+
+}  // namespace
+
+PrinterPlugin::PrinterPlugin() : usbHandle_(NULL), isPrinterConnected_(false),
+                               isNetworkPrinterConnected_(false),
+                               statusMonitor_([this](const printer_core::PrinterTarget& target, std::string* error) {
+                                 return connectionPool_.Acquire(target, error);
+                               }, RunnerStatusOptions()),
+                               nvLogos_(AppDataFile(L"nv_logos.txt"),
+                                        [this](const printer_core::PrinterTarget& target, std::string* error) {
+                                          return connectionPool_.Acquire(target, error);
+                                        }),
+                               tracer_(std::make_unique<printer_core::JobTracer>(RunnerTraceOptions(this))),
+                               taskRunner_(std::make_unique<PlatformTaskRunner>()),
+                               jobQueue_(std::make_unique<printer_core::PrintJobQueue>(
+                                   2, [this](const printer_core::PrinterTarget& target, std::string* error) {
+                                     return OpenTransport(target, error);
+                                   })),
+                               logger_(std::make_unique<printer_core::Logger>(
+                                   RunnerLoggerOptions(),
+                                   [this](const std::vector<printer_core::LogEntry>& batch) {
+                                     // On the flusher thread
+                                     taskRunner_->PostTask([this, entries = LogBatchToList(batch)]() {
+                                       PublishLogBatch(entries);
+                                     });
+                                   })) {
+  // Called on the poller or a job worker; the event goes out on the platform thread
+  statusMonitor_.set_listener([this](const printer_core::PrinterTarget& target,
+                                     const printer_core::PrinterStatus& status) {
+    flutter::EncodableMap event = StatusToMap(status);
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("status");
+    event[flutter::EncodableValue("printer")] = flutter::EncodableValue(target.Key());
+    event[flutter::EncodableValue("host")] = flutter::EncodableValue(target.host);
+    event[flutter::EncodableValue("port")] = flutter::EncodableValue(static_cast<int32_t>(target.port));
+    taskRunner_->PostTask([this, event]() { PublishEvent(event); });
+  });
+  // No second connection while a job holds the printer's; GS a blocks the
+  // printer pushes between polls reach the cache
+  statusMonitor_.set_busy_check([this](const printer_core::PrinterTarget& target) {
+    return jobQueue_->IsBusy(target);
+  });
+  connectionPool_.set_unsolicited_listener(
+      [this](const std::string& key, const uint8_t* data, size_t size) {
+        statusMonitor_.FeedUnsolicited(key, data, size);
+      });
+  jobQueue_->set_tracer(tracer_.get());
+}
+
+// A receipt that takes more than two seconds from the method call to the
+// reply leaves its timeline in %LOCALAPPDATA%\ExtroPOS\slow_print_trace.json
+// for chrome://tracing or Perfetto. FinishJob, and so the callback, runs on
+// the platform thread.
+printer_core::JobTracerOptions PrinterPlugin::RunnerTraceOptions(PrinterPlugin* plugin) {
+  printer_core::JobTracerOptions options;
+  options.slow_job_us = 2000000;
+  options.on_slow_job = [plugin](uint64_t traceId, int64_t durationUs, const std::string& json) {
+    const std::string path = AppDataFile(L"slow_print_trace.json");
+    if (path.empty() || !WriteFileBytes(path, json)) return;
+    plugin->PostLog("TRACE", "Job trace " + std::to_string(traceId) + " took " +
+                                 std::to_string(durationUs / 1000) + " ms; timeline saved to " + path,
+                    printer_core::LogLevel::kWarning);
+  };
+  return options;
+}
 
 PrinterPlugin::~PrinterPlugin() {
+  scanCancel_ = true;
+  if (scanThread_.joinable()) scanThread_.join();
+
+  // Finish queued jobs before the USB handle they may use goes away
+  jobQueue_->Shutdown();
+  // No listener calls after this; jobs and the poller are both stopped
+  statusMonitor_.Shutdown();
+  statusMonitor_.set_listener(nullptr);
+  // The pool's maintenance thread outlives the monitor
+  connectionPool_.set_unsolicited_listener(nullptr);
+  // Writes out what is still queued
+  logger_->Shutdown();
+
   if (usbHandle_ != NULL) {
     CloseUsb(usbHandle_);
     usbHandle_ = NULL;
   }
-  
-  if (networkSocket_ != INVALID_SOCKET) {
-    CloseNetPor(&networkSocket_);
-    networkSocket_ = INVALID_SOCKET;
+}
+
+void PrinterPlugin::HandleRunnerMessage(const uint8_t* message, size_t size,
+                                        flutter::BinaryReply reply) {
+  auto result = std::make_unique<flutter::EngineMethodResult<flutter::EncodableValue>>(
+      std::move(reply), &flutter::StandardMethodCodec::GetInstance());
+  // The standard method call encoding, as StandardMethodCodec reads it: the
+  // method name, then the arguments
+  MessageReader reader(message, size);
+  const flutter::StandardCodecSerializer& serializer =
+      flutter::StandardCodecSerializer::GetInstance();
+  const flutter::EncodableValue name = serializer.ReadValue(&reader);
+  const auto* method = std::get_if<std::string>(&name);
+  if (!method) {
+    result->NotImplemented();
+    return;
+  }
+  flutter::EncodableValue arguments = serializer.ReadValue(&reader);
+  if (*method == "printRaw") {
+    PrintRaw(&arguments, std::move(result));
+    return;
+  }
+  HandleMethodCall(flutter::MethodCall<flutter::EncodableValue>(
+                       *method, std::make_unique<flutter::EncodableValue>(std::move(arguments))),
+                   std::move(result));
+}
+
+void PrinterPlugin::PrintRaw(flutter::EncodableValue* arguments,
+                             std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  auto* argumentMap = std::get_if<flutter::EncodableMap>(arguments);
+  printer_core::PrinterTarget target;
+  std::string tag;
+  if (!argumentMap || !ResolvePrinterTarget(*argumentMap, &target, &tag)) {
+    result->Success(flutter::EncodableValue(false));
+    return;
+  }
+  auto data_it = argumentMap->find(flutter::EncodableValue("data"));
+  auto* data = data_it != argumentMap->end()
+      ? std::get_if<std::vector<uint8_t>>(&data_it->second) : nullptr;
+  if (!data) {
+    result->Success(flutter::EncodableValue(false));
+    return;
   }
-  
-  CloseNetServ();
+  // The buffer the codec decoded the Uint8List into moves into the job
+  printer_core::PrintJob job{std::move(target), std::move(*data)};
+  job.priority = PriorityFromArguments(*argumentMap, printer_core::JobPriority::kReceipt);
+  SubmitPrintJob(std::move(job), IsAsyncCall(*argumentMap), tag, std::move(result));
 }
 
 void PrinterPlugin::HandleMethodCall(
@@ -106,19 +520,9 @@ void PrinterPlugin::HandleMethodCall(
       return;
     }
 
-    // Check printer type and connection details
-    auto printerType_it = arguments->find(flutter::EncodableValue("printerType"));
-    auto connectionDetails_it = arguments->find(flutter::EncodableValue("connectionDetails"));
-    
-    if (printerType_it == arguments->end() || connectionDetails_it == arguments->end()) {
-      result->Success(flutter::EncodableValue(false));
-      return;
-    }
-
-    const auto* printerType = std::get_if<std::string>(&printerType_it->second);
-    const auto* connectionDetails = std::get_if<flutter::EncodableMap>(&connectionDetails_it->second);
-    
-    if (!printerType || !connectionDetails) {
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*arguments, &target, &tag)) {
       result->Success(flutter::EncodableValue(false));
       return;
     }
@@ -148,148 +552,23 @@ void PrinterPlugin::HandleMethodCall(
       return;
     }
 
-    bool success = false;
-    // Determine approximate chars per line from paper size if available (default 48)
-    int charsPerLine = 48;
-    auto paperSize_it = arguments->find(flutter::EncodableValue("paperSize"));
-    if (paperSize_it != arguments->end()) {
-      const auto* paperSize = std::get_if<std::string>(&paperSize_it->second);
-      if (paperSize) {
-        if (*paperSize == "mm58") charsPerLine = 32;
-        else if (*paperSize == "mm80") charsPerLine = 48;
-      }
-    }
-
-    // Handle different printer types
-    if (*printerType == "network") {
-      // Network printer
-      auto ip_it = connectionDetails->find(flutter::EncodableValue("ipAddress"));
-      auto port_it = connectionDetails->find(flutter::EncodableValue("port"));
-      
-      if (ip_it != connectionDetails->end() && port_it != connectionDetails->end()) {
-        const auto* ipAddress = std::get_if<std::string>(&ip_it->second);
-        const auto* port = std::get_if<int32_t>(&port_it->second);
-        
-        if (ipAddress && port) {
-          // Initialize network service if not already done
-          if (!InitNetSev()) {
-            result->Success(flutter::EncodableValue(false));
-            return;
-          }
-          
-          // Set up network address
-          memset(&networkAddr_, 0, sizeof(networkAddr_));
-          networkAddr_.sin_family = AF_INET;
-          networkAddr_.sin_port = htons(static_cast<u_short>(*port));
-          networkAddr_.sin_addr.s_addr = inet_addr(ipAddress->c_str());
-          
-          // Set timeout
-          timeval timeout;
-          timeout.tv_sec = 5;  // 5 second timeout
-          timeout.tv_usec = 0;
-          
-          // Connect to network printer
-          int connectResult = ConnectNetPort(&networkSocket_, &networkAddr_, &timeout);
-            if (connectResult == 0) {  // Success
-            isNetworkPrinterConnected_ = true;
-            
-            // If structured data present, try to build ESC/POS bytes; fallback to raw content
-            std::vector<uint8_t> bytesToSend;
-            try {
-              auto itemsIt = receipt_data_map->find(flutter::EncodableValue("items"));
-              if (itemsIt != receipt_data_map->end()) {
-                // Build structured ESC/POS text (or fallback to content)
-                std::vector<uint8_t> structured = BuildStructuredEscPosBytes(*receipt_data_map, charsPerLine);
-                if (structured.empty()) {
-                  PostLog("NETWORK", "buildStructured receipt returned empty; falling back to content");
-                  for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-                } else {
-                  PostLog("NETWORK", "Using structured receipt content for printing (preview) ");
-                  bytesToSend = structured;
-                }
-              } else {
-                for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-              }
-            } catch (const std::exception& e) {
-              PostLog("NETWORK", std::string("Structured build failed: ") + e.what() + ". Falling back to content.");
-              for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-            } catch (...) {
-              PostLog("NETWORK", "Structured build failed with unknown exception; falling back to content.");
-              for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-            }
-
-            int writeResult = WriteToNetPort(&networkSocket_, 
-                                           reinterpret_cast<char*>(bytesToSend.data()), 
-                                           static_cast<DWORD>(bytesToSend.size()));
-            success = (writeResult == 0);  // 0 = success
-            if (success) {
-              PostLog("NETWORK", "Printed to network printer successfully");
-              if (debugEnabled_) {
-                PostLog("NETWORK", "ESC/POS bytes (hex): " + HexPreview(bytesToSend, 128));
-              }
-            } else {
-              PostLog("NETWORK", std::string("Failed to write to network printer, code: ") + std::to_string(writeResult));
-              if (debugEnabled_) PostLog("NETWORK", "ESC/POS bytes (hex): " + HexPreview(bytesToSend, 128));
-            }
-            
-            // Close connection
-            CloseNetPor(&networkSocket_);
-            networkSocket_ = INVALID_SOCKET;
-            isNetworkPrinterConnected_ = false;
-          }
-        }
-      }
-    } else if (*printerType == "usb" || *printerType == "posmac") {
-      // USB or POSMAC printer
-      if (!isPrinterConnected_ || usbHandle_ == NULL) {
-        result->Success(flutter::EncodableValue(false));
-        return;
-      }
+    const int charsPerLine = CharsPerLineFromArguments(*arguments);
+    const uint64_t traceId = tracer_->BeginJob();
+    printer_core::ScopedTraceSpan receive(tracer_.get(), traceId, "receive");
 
-      // Send data to USB printer; attempt structured ESC/POS bytes when available
-      std::vector<uint8_t> bytesToSend;
-      try {
-        auto itemsIt = receipt_data_map->find(flutter::EncodableValue("items"));
-        if (itemsIt != receipt_data_map->end()) {
-          bytesToSend = BuildStructuredEscPosBytes(*receipt_data_map, charsPerLine);
-          if (bytesToSend.empty()) {
-            PostLog("USB", "Structured build returned empty; using content text");
-            for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-          } else {
-            PostLog("USB", "Using structured receipt content for USB printing");
-          }
-        } else {
-          for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-        }
-      } catch (const std::exception& e) {
-        PostLog("USB", std::string("Structured build failed: ") + e.what() + ", falling back to content");
-        for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-      } catch (...) {
-        PostLog("USB", "Structured build failed with unknown exception; falling back to content");
-        for (char c: *receipt_content) bytesToSend.push_back(static_cast<uint8_t>(c));
-      }
-      // Send bytes
-      DWORD bytesWritten = 0;
-      BOOL usbSuccess = WriteUsb(usbHandle_, 
-               reinterpret_cast<char*>(bytesToSend.data()), 
-               static_cast<DWORD>(bytesToSend.size()), 
-               &bytesWritten);
-      success = (usbSuccess == TRUE);
-      if (success) {
-        PostLog("USB", std::string("Printed to USB device, bytes: ") + std::to_string(bytesWritten));
-        if (debugEnabled_) PostLog("USB", std::string("ESC/POS bytes (hex): ") + HexPreview(bytesToSend, 128));
-      } else {
-        PostLog("USB", "USB write failed");
-        if (debugEnabled_) PostLog("USB", std::string("ESC/POS bytes (hex): ") + HexPreview(bytesToSend, 128));
-      }
-    } else {
-      // For other printer types (like local Windows printers), return false for now
-      // TODO: Implement Windows API printing for local printers
-      result->Success(flutter::EncodableValue(false));
-      return;
+    // Encode on the platform thread (cheap), then hand the bytes to the queue
+    EncodeReceiptForPrint(*receipt_data_map, charsPerLine, tag, traceId);
+    if (debugEnabled_) {
+      PostLog(tag, "ESC/POS bytes (hex): " + HexPreview(encoder_.buffer(), 128),
+              printer_core::LogLevel::kDebug);
     }
-
-    result->Success(flutter::EncodableValue(success));
+    printer_core::PrintJob job{std::move(target), encoder_.TakeBuffer()};
+    job.priority = PriorityFromArguments(*arguments, printer_core::JobPriority::kReceipt);
+    job.trace_id = traceId;
+    printer_core::PrintJobCallback onDone =
+        FinishReceiptJob(*receipt_data_map, charsPerLine, tag, &job);
+    SubmitPrintJob(std::move(job), IsAsyncCall(*arguments), tag, std::move(result), nullptr,
+                   std::move(onDone));
   } else if (method_call.method_name().compare("printOrder") == 0) {
     // Get the arguments
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
@@ -298,19 +577,9 @@ void PrinterPlugin::HandleMethodCall(
       return;
     }
 
-    // Check printer type and connection details
-    auto printerType_it = arguments->find(flutter::EncodableValue("printerType"));
-    auto connectionDetails_it = arguments->find(flutter::EncodableValue("connectionDetails"));
-    
-    if (printerType_it == arguments->end() || connectionDetails_it == arguments->end()) {
-      result->Success(flutter::EncodableValue(false));
-      return;
-    }
-
-    const auto* printerType = std::get_if<std::string>(&printerType_it->second);
-    const auto* connectionDetails = std::get_if<flutter::EncodableMap>(&connectionDetails_it->second);
-    
-    if (!printerType || !connectionDetails) {
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*arguments, &target, &tag)) {
       result->Success(flutter::EncodableValue(false));
       return;
     }
@@ -328,234 +597,176 @@ void PrinterPlugin::HandleMethodCall(
       return;
     }
 
-    bool success = false;
-
-    // Handle different printer types
-    if (*printerType == "network") {
-      // Network printer
-      auto ip_it = connectionDetails->find(flutter::EncodableValue("ipAddress"));
-      auto port_it = connectionDetails->find(flutter::EncodableValue("port"));
-      
-      if (ip_it != connectionDetails->end() && port_it != connectionDetails->end()) {
-        const auto* ipAddress = std::get_if<std::string>(&ip_it->second);
-        const auto* port = std::get_if<int32_t>(&port_it->second);
-        
-        if (ipAddress && port) {
-          // Initialize network service if not already done
-          if (!InitNetSev()) {
-            result->Success(flutter::EncodableValue(false));
-            return;
-          }
-          
-          // Set up network address
-          memset(&networkAddr_, 0, sizeof(networkAddr_));
-          networkAddr_.sin_family = AF_INET;
-          networkAddr_.sin_port = htons(static_cast<u_short>(*port));
-          networkAddr_.sin_addr.s_addr = inet_addr(ipAddress->c_str());
-          
-          // Set timeout
-          timeval timeout;
-          timeout.tv_sec = 5;  // 5 second timeout
-          timeout.tv_usec = 0;
-          
-          // Connect to network printer
-          int connectResult = ConnectNetPort(&networkSocket_, &networkAddr_, &timeout);
-          if (connectResult == 0) {  // Success
-            isNetworkPrinterConnected_ = true;
-            
-            // Send order data
-            int writeResult = WriteToNetPort(&networkSocket_, 
-                                           const_cast<char*>(order_data->c_str()), 
-                                           static_cast<DWORD>(order_data->length()));
-            success = (writeResult == 0);  // 0 = success
-            
-            // Close connection
-            CloseNetPor(&networkSocket_);
-            networkSocket_ = INVALID_SOCKET;
-            isNetworkPrinterConnected_ = false;
-          }
-        }
-      }
-    } else if (*printerType == "usb" || *printerType == "posmac") {
-      // USB or POSMAC printer
-      if (!isPrinterConnected_ || usbHandle_ == NULL) {
-        result->Success(flutter::EncodableValue(false));
-        return;
-      }
+    printer_core::PrintJob job{std::move(target),
+                               std::vector<uint8_t>(order_data->begin(), order_data->end())};
+    job.priority = PriorityFromArguments(*arguments, printer_core::JobPriority::kKitchen);
+    printer_core::SetPreemptPoints(&job);
+    SubmitPrintJob(std::move(job), IsAsyncCall(*arguments), tag, std::move(result));
+  } else if (method_call.method_name().compare("testPrint") == 0) {
+    // Get the arguments
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
 
-      DWORD bytesWritten = 0;
-      success = (WriteUsb(usbHandle_, 
-                         const_cast<char*>(order_data->c_str()), 
-                         static_cast<DWORD>(order_data->length()), 
-                         &bytesWritten) == TRUE);
-    } else {
-      // For other printer types (like local Windows printers), return false for now
-      // TODO: Implement Windows API printing for local printers
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*arguments, &target, &tag)) {
       result->Success(flutter::EncodableValue(false));
       return;
     }
 
-    result->Success(flutter::EncodableValue(success));
-  } else if (method_call.method_name().compare("testPrint") == 0) {
+    // Initialize, center, print text, feed paper
+    static const char kTestData[] = "\x1B\x40\x1B\x61\x01Hello POSMAC Printer\x0A\x0A\x1B\x64\x03";
+    printer_core::PrintJob job{std::move(target),
+                               std::vector<uint8_t>(kTestData, kTestData + sizeof(kTestData) - 1)};
+    SubmitPrintJob(std::move(job), IsAsyncCall(*arguments), tag, std::move(result));
+  } else if (method_call.method_name().compare("checkPrinterStatus") == 0) {
     // Get the arguments
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (!arguments) {
-      result->Success(flutter::EncodableValue(false));
+      result->Success(flutter::EncodableValue("unknown"));
       return;
     }
 
-    // Check printer type and connection details
     auto printerType_it = arguments->find(flutter::EncodableValue("printerType"));
-    auto connectionDetails_it = arguments->find(flutter::EncodableValue("connectionDetails"));
-    
-    if (printerType_it == arguments->end() || connectionDetails_it == arguments->end()) {
-      result->Success(flutter::EncodableValue(false));
+    const auto* printerType = printerType_it != arguments->end()
+        ? std::get_if<std::string>(&printerType_it->second) : nullptr;
+    if (!printerType) {
+      result->Success(flutter::EncodableValue("unknown"));
       return;
     }
 
-    const auto* printerType = std::get_if<std::string>(&printerType_it->second);
-    const auto* connectionDetails = std::get_if<flutter::EncodableMap>(&connectionDetails_it->second);
-    
-    if (!printerType || !connectionDetails) {
-      result->Success(flutter::EncodableValue(false));
+    if (*printerType != "network") {
+      // USB printer (existing logic)
+      result->Success(flutter::EncodableValue(isPrinterConnected_ ? "online" : "offline"));
       return;
     }
 
-    bool success = false;
-
-    // Handle different printer types
-    if (*printerType == "network") {
-      // Network printer
-      auto ip_it = connectionDetails->find(flutter::EncodableValue("ipAddress"));
-      auto port_it = connectionDetails->find(flutter::EncodableValue("port"));
-      
-      if (ip_it != connectionDetails->end() && port_it != connectionDetails->end()) {
-        const auto* ipAddress = std::get_if<std::string>(&ip_it->second);
-        const auto* port = std::get_if<int32_t>(&port_it->second);
-        
-        if (ipAddress && port) {
-          // Initialize network service if not already done
-          if (!InitNetSev()) {
-            result->Success(flutter::EncodableValue(false));
-            return;
-          }
-          
-          // Set up network address
-          memset(&networkAddr_, 0, sizeof(networkAddr_));
-          networkAddr_.sin_family = AF_INET;
-          networkAddr_.sin_port = htons(static_cast<u_short>(*port));
-          networkAddr_.sin_addr.s_addr = inet_addr(ipAddress->c_str());
-          
-          // Set timeout
-          timeval timeout;
-          timeout.tv_sec = 5;  // 5 second timeout
-          timeout.tv_usec = 0;
-          
-          // Connect to network printer
-          int connectResult = ConnectNetPort(&networkSocket_, &networkAddr_, &timeout);
-          if (connectResult == 0) {  // Success
-            isNetworkPrinterConnected_ = true;
-            
-            // Send test print data
-            const char* testData = "\x1B\x40\x1B\x61\x01Hello POSMAC Printer\x0A\x0A\x1B\x64\x03"; // Initialize, center, print text, feed paper
-            int writeResult = WriteToNetPort(&networkSocket_, 
-                                           const_cast<char*>(testData), 
-                                           static_cast<DWORD>(strlen(testData)));
-            success = (writeResult == 0);  // 0 = success
-            
-            // Close connection
-            CloseNetPor(&networkSocket_);
-            networkSocket_ = INVALID_SOCKET;
-            isNetworkPrinterConnected_ = false;
-          }
-        }
-      }
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*arguments, &target, &tag)) {
+      result->Success(flutter::EncodableValue("offline"));
+      return;
+    }
+    // Cached answer from the status poller when it has reached this printer
+    const printer_core::PrinterStatus status = statusMonitor_.Get(target);
+    if (status.known) {
+      result->Success(flutter::EncodableValue(status.Summary()));
+      return;
+    }
+    // First ask for this printer: a job without data only connects, with a
+    // short timeout for status checks
+    target.connect_timeout_ms = 2000;
+    printer_core::PrintJob probe{std::move(target), {}};
+    // Status checks are as latency-sensitive as drawer kicks
+    probe.priority = printer_core::JobPriority::kDrawer;
+    SubmitPrintJob(std::move(probe), false, tag, std::move(result),
+                   [](const printer_core::PrintJobResult& r) {
+                     return flutter::EncodableValue(r.success ? "online" : "offline");
+                   });
+  } else if (method_call.method_name().compare("getPrinterStatus") == 0) {
+    // Detailed cached status (paper, cover, error bits) of a network printer
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!arguments || !ResolvePrinterTarget(*arguments, &target, &tag) ||
+        target.kind != printer_core::PrinterTarget::Kind::kNetwork) {
+      result->Success(flutter::EncodableValue(StatusToMap(printer_core::PrinterStatus())));
+      return;
+    }
+    result->Success(flutter::EncodableValue(StatusToMap(statusMonitor_.Get(target))));
+  } else if (method_call.method_name().compare("watchPrinterStatus") == 0 ||
+             method_call.method_name().compare("unwatchPrinterStatus") == 0) {
+    // Keeps a network printer polled (or stops) so its 'status' events keep
+    // coming while nothing prints to it
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!arguments || !ResolvePrinterTarget(*arguments, &target, &tag) ||
+        target.kind != printer_core::PrinterTarget::Kind::kNetwork) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    if (method_call.method_name().compare("watchPrinterStatus") == 0) {
+      statusMonitor_.Watch(target);
     } else {
-      // USB printer (existing logic)
-      if (!isPrinterConnected_ || usbHandle_ == NULL) {
-        result->Success(flutter::EncodableValue(false));
-        return;
-      }
-
-      // Send a simple test print command (ESC/POS test print)
-      const char* testData = "\x1B\x40\x1B\x61\x01Hello POSMAC Printer\x0A\x0A\x1B\x64\x03"; // Initialize, center, print text, feed paper
-      DWORD bytesWritten = 0;
-      DWORD dataLength = static_cast<DWORD>(strlen(testData));
-      success = (WriteUsb(usbHandle_,
-                         const_cast<char*>(testData),
-                         dataLength,
-                         &bytesWritten) == TRUE);
+      statusMonitor_.Unwatch(target);
     }
-
-    result->Success(flutter::EncodableValue(success));
-  } else if (method_call.method_name().compare("checkPrinterStatus") == 0) {
-    // Get the arguments
+    result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name().compare("printBatch") == 0) {
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (!arguments) {
-      result->Success(flutter::EncodableValue("unknown"));
+      result->Success(flutter::EncodableValue(flutter::EncodableList()));
       return;
     }
-
-    // Check printer type and connection details
-    auto printerType_it = arguments->find(flutter::EncodableValue("printerType"));
-    auto connectionDetails_it = arguments->find(flutter::EncodableValue("connectionDetails"));
-    
-    if (printerType_it == arguments->end() || connectionDetails_it == arguments->end()) {
-      result->Success(flutter::EncodableValue("unknown"));
+    PrintBatch(*arguments, std::move(result));
+  } else if (method_call.method_name().compare("openCashDrawer") == 0) {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Success(flutter::EncodableValue(false));
       return;
     }
 
-    const auto* printerType = std::get_if<std::string>(&printerType_it->second);
-    const auto* connectionDetails = std::get_if<flutter::EncodableMap>(&connectionDetails_it->second);
-    
-    if (!printerType || !connectionDetails) {
-      result->Success(flutter::EncodableValue("unknown"));
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*arguments, &target, &tag)) {
+      result->Success(flutter::EncodableValue(false));
       return;
     }
 
-    std::string status = "offline";
-
-    // Handle different printer types
-    if (*printerType == "network") {
-      // Network printer - try a quick connection test
-      auto ip_it = connectionDetails->find(flutter::EncodableValue("ipAddress"));
-      auto port_it = connectionDetails->find(flutter::EncodableValue("port"));
-      
-      if (ip_it != connectionDetails->end() && port_it != connectionDetails->end()) {
-        const auto* ipAddress = std::get_if<std::string>(&ip_it->second);
-        const auto* port = std::get_if<int32_t>(&port_it->second);
-        
-        if (ipAddress && port) {
-          // Initialize network service if not already done
-          if (InitNetSev()) {
-            // Set up network address
-            memset(&networkAddr_, 0, sizeof(networkAddr_));
-            networkAddr_.sin_family = AF_INET;
-            networkAddr_.sin_port = htons(static_cast<u_short>(*port));
-            networkAddr_.sin_addr.s_addr = inet_addr(ipAddress->c_str());
-            
-            // Set short timeout for status check
-            timeval timeout;
-            timeout.tv_sec = 2;  // 2 second timeout
-            timeout.tv_usec = 0;
-            
-            // Try to connect
-            int connectResult = ConnectNetPort(&networkSocket_, &networkAddr_, &timeout);
-            if (connectResult == 0) {  // Success
-              status = "online";
-              // Close connection immediately
-              CloseNetPor(&networkSocket_);
-              networkSocket_ = INVALID_SOCKET;
-            }
-          }
-        }
+    // ESC p m t1 t2: pulse drawer pin 2 (m=0) or pin 5 (m=1) for 50ms on / 500ms off
+    int pin = 0;
+    auto pin_it = arguments->find(flutter::EncodableValue("pin"));
+    if (pin_it != arguments->end()) {
+      const auto* value = std::get_if<int32_t>(&pin_it->second);
+      if (value && *value == 5) pin = 1;
+    }
+    printer_core::PrintJob job{std::move(target),
+                               {0x1B, 0x70, static_cast<uint8_t>(pin), 25, 250}};
+    job.priority = printer_core::JobPriority::kDrawer;
+    SubmitPrintJob(std::move(job), IsAsyncCall(*arguments), tag, std::move(result));
+  } else if (method_call.method_name().compare("getPrintQueueStats") == 0) {
+    static const char* const kClassNames[printer_core::kJobPriorityCount] = {
+        "drawer", "receipt", "kitchen", "report"};
+    const printer_core::PrintQueueStats stats = jobQueue_->stats();
+    flutter::EncodableMap classes;
+    for (size_t i = 0; i < printer_core::kJobPriorityCount; ++i) {
+      const printer_core::PriorityClassStats& c = stats[i];
+      flutter::EncodableMap m;
+      m[flutter::EncodableValue("depth")] = flutter::EncodableValue(static_cast<int64_t>(c.depth));
+      m[flutter::EncodableValue("started")] = flutter::EncodableValue(static_cast<int64_t>(c.started));
+      m[flutter::EncodableValue("avgWaitUs")] = flutter::EncodableValue(
+          static_cast<int64_t>(c.started ? c.total_wait.count() / static_cast<int64_t>(c.started) : 0));
+      m[flutter::EncodableValue("maxWaitUs")] = flutter::EncodableValue(static_cast<int64_t>(c.max_wait.count()));
+      m[flutter::EncodableValue("preemptions")] = flutter::EncodableValue(static_cast<int64_t>(c.preemptions));
+      classes[flutter::EncodableValue(kClassNames[i])] = flutter::EncodableValue(m);
+    }
+    result->Success(flutter::EncodableValue(classes));
+  } else if (method_call.method_name().compare("getConnectionPoolStats") == 0) {
+    const printer_core::ConnectionPoolStats stats = connectionPool_.stats();
+    flutter::EncodableMap m;
+    m[flutter::EncodableValue("hits")] = flutter::EncodableValue(static_cast<int64_t>(stats.hits));
+    m[flutter::EncodableValue("misses")] = flutter::EncodableValue(static_cast<int64_t>(stats.misses));
+    m[flutter::EncodableValue("reconnects")] = flutter::EncodableValue(static_cast<int64_t>(stats.reconnects));
+    m[flutter::EncodableValue("reaped")] = flutter::EncodableValue(static_cast<int64_t>(stats.reaped));
+    m[flutter::EncodableValue("healthFailures")] =
+        flutter::EncodableValue(static_cast<int64_t>(stats.health_failures));
+    m[flutter::EncodableValue("idle")] = flutter::EncodableValue(static_cast<int64_t>(stats.idle));
+    result->Success(flutter::EncodableValue(m));
+  } else if (method_call.method_name().compare("exportPrintTrace") == 0) {
+    // Chrome trace JSON for the job result's "traceId", or every job still
+    // held when it is absent
+    uint64_t traceId = 0;
+    if (const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      auto it = arguments->find(flutter::EncodableValue("traceId"));
+      if (it != arguments->end()) {
+        if (const auto* id = std::get_if<int64_t>(&it->second)) traceId = static_cast<uint64_t>(*id);
+        if (const auto* id = std::get_if<int32_t>(&it->second)) traceId = static_cast<uint64_t>(*id);
       }
-    } else {
-      // USB printer (existing logic)
-      status = isPrinterConnected_ ? "online" : "offline";
     }
-
-    result->Success(flutter::EncodableValue(status));
+    result->Success(flutter::EncodableValue(tracer_->Export(traceId)));
   } else if (method_call.method_name().compare("setDebugEnabled") == 0) {
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (arguments) {
@@ -563,7 +774,7 @@ void PrinterPlugin::HandleMethodCall(
       if (enabled_it != arguments->end()) {
         const auto* enabled = std::get_if<bool>(&enabled_it->second);
         if (enabled) {
-          debugEnabled_ = *enabled;
+          SetDebugEnabled(*enabled);
           PostLog("DEBUG", std::string("Set debugEnabled to ") + (*enabled ? "true" : "false"));
           result->Success(flutter::EncodableValue(true));
           return;
@@ -588,18 +799,18 @@ void PrinterPlugin::HandleMethodCall(
       return;
     }
 
-    // Very basic online check: for network printers, attempt a quick connect, for USB check cached state
-    bool online = false;
-    // Network printers: look for 'ipAddress' and 'port'
-    // If any printer name includes ip:port we can attempt a quick check
-    try {
-      // If network socket is connected or we have isNetworkPrinterConnected_ true, return true
-      if (isNetworkPrinterConnected_) {
-        online = true;
-      } else if (isPrinterConnected_) {
-        online = true;
-      }
-    } catch (...) { online = false; }
+    // Network printers named "ip" or "ip:port" are answered from the status
+    // cache; anything else falls back to the last job's outcome
+    bool online = isNetworkPrinterConnected_ || isPrinterConnected_;
+    const size_t colon = printerName->find(':');
+    const std::string host = printerName->substr(0, colon);
+    const int port = colon == std::string::npos ? 9100 : std::atoi(printerName->c_str() + colon + 1);
+    printer_core::Ipv4Range single;
+    if (port > 0 && port <= 65535 && printer_core::ParseCidr(host, &single, nullptr)) {
+      const printer_core::PrinterStatus status = statusMonitor_.Get(
+          printer_core::PrinterTarget::Network(host, static_cast<uint16_t>(port)));
+      if (status.known) online = status.reachable && !status.offline;
+    }
 
     result->Success(flutter::EncodableValue(online));
   } else if (method_call.method_name().compare("discoverUsbPrinters") == 0) {
@@ -623,13 +834,8 @@ void PrinterPlugin::HandleMethodCall(
 
     result->Success(flutter::EncodableValue(printers));
   } else if (method_call.method_name().compare("discoverNetworkPrinters") == 0) {
-    // Discover network printers
-    flutter::EncodableList printers;
-
-    // For now, return empty list - network printer discovery
-    // can be implemented later with proper network scanning
-
-    result->Success(flutter::EncodableValue(printers));
+    DiscoverNetworkPrinters(std::get_if<flutter::EncodableMap>(method_call.arguments()),
+                            std::move(result));
   } else if (method_call.method_name().compare("discoverLocalPrinters") == 0) {
     // Discover local Windows printers
     flutter::EncodableList printers;
@@ -679,22 +885,37 @@ void PrinterPluginRegisterWithRegistrar(
           ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar));
 }
 
-// Helper to post logs to the Flutter side via the stored channel
-void PrinterPlugin::PostLog(const std::string& level, const std::string& message) {
+void PrinterPlugin::PostLog(const std::string& category, const std::string& message,
+                            printer_core::LogLevel level) {
+  logger_->Log(level, category, message);
+}
+
+// One call per batch on channel_ only; net_channel_ shares its Dart handler,
+// so sending on both logged every line twice.
+void PrinterPlugin::PublishLogBatch(const flutter::EncodableList& entries) {
+  if (!channel_) return;
   try {
     flutter::EncodableMap m;
-    m[flutter::EncodableValue("message")] = flutter::EncodableValue(level + ": " + message);
-    if (channel_) {
-      channel_->InvokeMethod("printerLog", std::make_unique<flutter::EncodableValue>(m));
-    }
-    if (net_channel_) {
-      net_channel_->InvokeMethod("printerLog", std::make_unique<flutter::EncodableValue>(m));
-    }
+    m[flutter::EncodableValue("entries")] = flutter::EncodableValue(entries);
+    channel_->InvokeMethod("printerLogBatch", std::make_unique<flutter::EncodableValue>(m));
   } catch (...) {
     // suppress errors
   }
 }
 
+void PrinterPlugin::PublishEvent(flutter::EncodableMap event) {
+  if (eventSink_) eventSink_->Success(flutter::EncodableValue(std::move(event)));
+}
+
+void PrinterPlugin::PublishJobEvent(const printer_core::PrintJobResult& r,
+                                    const std::string& printer) {
+  flutter::EncodableMap event = JobResultToMap(r);
+  event[flutter::EncodableValue("type")] =
+      flutter::EncodableValue(r.success ? "jobFinished" : "jobFailed");
+  event[flutter::EncodableValue("printer")] = flutter::EncodableValue(printer);
+  PublishEvent(std::move(event));
+}
+
 static double getDoubleFromEncodable(const flutter::EncodableValue& v) {
   if (const double* d = std::get_if<double>(&v)) return *d;
   if (const int64_t* i64 = std::get_if<int64_t>(&v)) return static_cast<double>(*i64);
@@ -702,11 +923,6 @@ static double getDoubleFromEncodable(const flutter::EncodableValue& v) {
   return 0.0;
 }
 
-static std::string getStringFromEncodable(const flutter::EncodableValue& v) {
-  if (const std::string* s = std::get_if<std::string>(&v)) return *s;
-  return std::string();
-}
-
 // Convert byte vector to hex preview limited to n bytes
 static std::string HexPreview(const std::vector<uint8_t>& bytes, size_t maxBytes=64) {
   std::ostringstream oss;
@@ -720,306 +936,706 @@ static std::string HexPreview(const std::vector<uint8_t>& bytes, size_t maxBytes
   return oss.str();
 }
 
-// Build a simple structured ESC/POS text for receipts. This will be a best-effort plain-text
-// representation, and not raw ESC/POS binary. For Windows runner/raw socket printing, plain
-// text is usually sufficient to print via network/USB if the printer accepts raw text.
-std::string PrinterPlugin::BuildStructuredEscPosString(const flutter::EncodableMap& receipt_map, int charsPerLine) {
-  try {
-    // If the content is already present, we will convert it to ESC/POS formatted bytes
-    auto content_it = receipt_map.find(flutter::EncodableValue("content"));
-    // Note: convert content into ESC/POS bytes if provided
-    if (content_it != receipt_map.end()) {
-      const auto* content = std::get_if<std::string>(&content_it->second);
-      if (content) {
-        std::ostringstream csb;
-        csb << "\x1B\x40";
-        std::istringstream iss(*content);
-        std::string line;
-        while (std::getline(iss, line)) {
-          if (line.find("RM") == std::string::npos && line.find("$") == std::string::npos) {
-            csb << "\x1B\x61\x01"; // center
-          } else {
-            csb << "\x1B\x61\x00"; // left
-          }
-          csb << line << "\n";
+// Decode the receipt map into |doc|. String fields are views into the map, so
+// the document is only valid while receipt_map is alive.
+static void DecodeReceiptDocument(const flutter::EncodableMap& receipt_map,
+                                  printer_core::ReceiptDocument* doc) {
+  doc->currency = "RM";
+  doc->title.reset();
+  doc->items.clear();
+  doc->subtotal.reset();
+  doc->tax.reset();
+  doc->service_charge.reset();
+  doc->total.reset();
+  doc->barcode = std::string_view();
+  doc->qr_data = std::string_view();
+
+  auto currency_it = receipt_map.find(flutter::EncodableValue("currency"));
+  if (currency_it != receipt_map.end()) {
+    const auto* cs = std::get_if<std::string>(&currency_it->second);
+    if (cs) doc->currency = *cs;
+  }
+  auto title_it = receipt_map.find(flutter::EncodableValue("title"));
+  if (title_it != receipt_map.end()) {
+    const auto* title = std::get_if<std::string>(&title_it->second);
+    doc->title = title ? std::string_view(*title) : std::string_view();
+  }
+  auto items_it = receipt_map.find(flutter::EncodableValue("items"));
+  if (items_it != receipt_map.end()) {
+    const auto* items = std::get_if<flutter::EncodableList>(&items_it->second);
+    if (items) {
+      doc->items.reserve(items->size());
+      for (const auto& iv : *items) {
+        const auto* itemMap = std::get_if<flutter::EncodableMap>(&iv);
+        if (!itemMap) continue;
+        printer_core::ReceiptItem item;
+        auto nIt = itemMap->find(flutter::EncodableValue("name"));
+        if (nIt != itemMap->end()) {
+          const auto* name = std::get_if<std::string>(&nIt->second);
+          if (name) item.name = *name;
         }
-        csb << "\x0A\x1D\x56\x42\x00";
-        return csb.str();
+        auto qIt = itemMap->find(flutter::EncodableValue("quantity"));
+        if (qIt != itemMap->end()) item.quantity = static_cast<int>(getDoubleFromEncodable(qIt->second));
+        auto pIt = itemMap->find(flutter::EncodableValue("price"));
+        if (pIt != itemMap->end()) item.price = getDoubleFromEncodable(pIt->second);
+        doc->items.push_back(item);
       }
     }
+  }
+  auto subtotal_it = receipt_map.find(flutter::EncodableValue("subtotal"));
+  if (subtotal_it != receipt_map.end()) doc->subtotal = getDoubleFromEncodable(subtotal_it->second);
+  auto tax_it = receipt_map.find(flutter::EncodableValue("tax"));
+  if (tax_it != receipt_map.end()) doc->tax = getDoubleFromEncodable(tax_it->second);
+  auto service_it = receipt_map.find(flutter::EncodableValue("serviceCharge"));
+  if (service_it != receipt_map.end()) doc->service_charge = getDoubleFromEncodable(service_it->second);
+  auto total_it = receipt_map.find(flutter::EncodableValue("total"));
+  if (total_it != receipt_map.end()) doc->total = getDoubleFromEncodable(total_it->second);
+  auto barcode_it = receipt_map.find(flutter::EncodableValue("barcode"));
+  if (barcode_it != receipt_map.end()) {
+    const auto* barcode = std::get_if<std::string>(&barcode_it->second);
+    if (barcode) doc->barcode = *barcode;
+  }
+  auto qr_it = receipt_map.find(flutter::EncodableValue("qr_data"));
+  if (qr_it != receipt_map.end()) {
+    const auto* qrData = std::get_if<std::string>(&qr_it->second);
+    if (qrData) doc->qr_data = *qrData;
+  }
+}
 
-    std::ostringstream sb;
-    // Begin ESC/POS initialize sequence
-    sb << "\x1B\x40";
-    std::string currency = "RM";
-    auto currency_it = receipt_map.find(flutter::EncodableValue("currency"));
-    if (currency_it != receipt_map.end()) {
-      const auto* cs = std::get_if<std::string>(&currency_it->second);
-      if (cs) currency = *cs;
+// Rows laid out natively by display width: maps with "left", "right",
+// "align" ("left", "center" or "right"), "truncate" and "divider" (a
+// one-character string).
+static void DecodeReceiptRows(const flutter::EncodableList& list,
+                              std::vector<printer_core::ReceiptRow>* rows) {
+  rows->clear();
+  rows->reserve(list.size());
+  for (const auto& entry : list) {
+    const auto* rowMap = std::get_if<flutter::EncodableMap>(&entry);
+    if (!rowMap) continue;
+    auto text = [&](const char* key) -> const std::string* {
+      auto it = rowMap->find(flutter::EncodableValue(key));
+      return it == rowMap->end() ? nullptr : std::get_if<std::string>(&it->second);
+    };
+    printer_core::ReceiptRow row;
+    if (const std::string* left = text("left")) row.left = *left;
+    if (const std::string* right = text("right")) row.right = *right;
+    if (const std::string* align = text("align")) {
+      if (*align == "center") row.align = printer_core::RowAlign::kCenter;
+      if (*align == "right") row.align = printer_core::RowAlign::kRight;
     }
+    auto truncateIt = rowMap->find(flutter::EncodableValue("truncate"));
+    if (truncateIt != rowMap->end()) {
+      const auto* truncate = std::get_if<bool>(&truncateIt->second);
+      row.truncate = truncate && *truncate;
+    }
+    if (const std::string* divider = text("divider")) {
+      if (!divider->empty()) row.divider = (*divider)[0];
+    }
+    rows->push_back(row);
+  }
+}
 
-    // Header
-    sb << "\x1B\x61\x01"; // center align
-    sb << std::string(charsPerLine, '=') << "\n";
-    auto title_it = receipt_map.find(flutter::EncodableValue("title"));
-    if (title_it != receipt_map.end()) {
-      const auto* title = std::get_if<std::string>(&title_it->second);
-      if (title) {
-        sb << *title << "\n";
-      }
+// What the printer prints natively, from receiptData "nativeQr" and
+// "nativeBarcode" (both true when absent). Printers that ignore GS ( k or
+// GS k get the symbol as raster instead.
+static printer_core::PrinterProfile DecodePrinterProfile(const flutter::EncodableMap& receipt_map,
+                                                         int charsPerLine) {
+  printer_core::PrinterProfile profile;
+  auto flag = [&](const char* key, bool fallback) {
+    auto it = receipt_map.find(flutter::EncodableValue(key));
+    if (it == receipt_map.end()) return fallback;
+    const auto* value = std::get_if<bool>(&it->second);
+    return value ? *value : fallback;
+  };
+  profile.native_qr = flag("nativeQr", true);
+  profile.native_code128 = flag("nativeBarcode", true);
+  profile.dots_per_line = charsPerLine >= 42 ? 576 : 384;
+  // Unknown names keep the default (CP437, no Chinese encoding).
+  auto code_page = [&](const char* key, printer_core::CodePage* page) {
+    auto it = receipt_map.find(flutter::EncodableValue(key));
+    if (it == receipt_map.end()) return;
+    const auto* value = std::get_if<std::string>(&it->second);
+    if (value) printer_core::ParseCodePage(*value, page);
+  };
+  code_page("codePage", &profile.code_page);
+  code_page("chineseCodePage", &profile.chinese_code_page);
+  return profile;
+}
+
+// Reads receiptData "receiptBlob" (see receipt_blob.h) into |doc|; false if
+// it is absent or malformed, in which case the map fields apply.
+static bool DecodeReceiptBlob(const flutter::EncodableMap& receipt_map,
+                              printer_core::ReceiptDocument* doc) {
+  auto it = receipt_map.find(flutter::EncodableValue("receiptBlob"));
+  if (it == receipt_map.end()) return false;
+  const auto* blob = std::get_if<std::vector<uint8_t>>(&it->second);
+  return blob && printer_core::ReadReceiptBlob(blob->data(), blob->size(), doc);
+}
+
+// Store lines from receiptData "headerLines" and "footerLines" (lists of
+// strings, empty when absent). The encoder only recompiles its receipt
+// template when they change.
+static printer_core::StoreSettings DecodeStoreSettings(const flutter::EncodableMap& receipt_map) {
+  printer_core::StoreSettings store;
+  auto lines = [&](const char* key, std::vector<std::string>* out) {
+    auto it = receipt_map.find(flutter::EncodableValue(key));
+    if (it == receipt_map.end()) return;
+    const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+    if (!list) return;
+    for (const auto& value : *list) {
+      if (const auto* line = std::get_if<std::string>(&value)) out->push_back(*line);
     }
-    sb << std::string(charsPerLine, '-') << "\n";
-
-    // Items
-    auto items_it = receipt_map.find(flutter::EncodableValue("items"));
-    if (items_it != receipt_map.end()) {
-      const auto* items = std::get_if<flutter::EncodableList>(&items_it->second);
-      if (items) {
-        for (const auto& iv : *items) {
-          const auto* itemMap = std::get_if<flutter::EncodableMap>(&iv);
-          if (!itemMap) continue;
-          std::string name;
-          int qty = 1;
-          double price = 0.0;
-          auto nIt = itemMap->find(flutter::EncodableValue("name"));
-          if (nIt != itemMap->end()) {
-            name = getStringFromEncodable(nIt->second);
-          }
-          auto qIt = itemMap->find(flutter::EncodableValue("quantity"));
-          if (qIt != itemMap->end()) {
-            qty = static_cast<int>(getDoubleFromEncodable(qIt->second));
-          }
-          auto pIt = itemMap->find(flutter::EncodableValue("price"));
-          if (pIt != itemMap->end()) {
-            price = getDoubleFromEncodable(pIt->second);
-          }
-          std::ostringstream priceStr;
-          priceStr << currency << " " << std::fixed << std::setprecision(2) << (price * qty);
+  };
+  lines("headerLines", &store.header_lines);
+  lines("footerLines", &store.footer_lines);
+  return store;
+}
 
-          std::string leftPart = name;
-          if (qty != 1) {
-            leftPart += " x" + std::to_string(qty);
-          }
-          if (charsPerLine >= 48) {
-            // Put name + qty left, price right
-            if ((int)leftPart.length() + (int)priceStr.str().length() + 1 > charsPerLine) {
-              sb << leftPart << "\n" << std::string(charsPerLine - (int)priceStr.str().length(), ' ') << priceStr.str() << "\n";
-            } else {
-              sb << "\x1B\x61\x00"; // left align for items
-              sb << leftPart << std::string(charsPerLine - (int)leftPart.length() - (int)priceStr.str().length(), ' ') << priceStr.str() << "\n";
-            }
-          } else {
-            sb << "\x1B\x61\x00";
-            sb << leftPart << "\n" << std::string(charsPerLine - (int)priceStr.str().length(), ' ') << priceStr.str() << "\n";
-          }
-        }
-      }
+// Decodes receiptData into what printReceipt and printBatch encode: the
+// structured receipt (the flat blob first, the items map when the sender has
+// none) with the store lines, laid-out rows, or the preformatted "content".
+// |receipt| and |rows| back the pointers in |document| and, like its text,
+// borrow from receipt_map. False when there is nothing to print.
+static bool DecodeReceiptForPrint(const flutter::EncodableMap& receipt_map, int charsPerLine,
+                                  printer_core::ReceiptDocument* receipt,
+                                  std::vector<printer_core::ReceiptRow>* rows,
+                                  printer_core::BatchDocument* document) {
+  *document = printer_core::BatchDocument();
+  document->chars_per_line = charsPerLine;
+  document->profile = DecodePrinterProfile(receipt_map, charsPerLine);
+  auto content_it = receipt_map.find(flutter::EncodableValue("content"));
+  const auto* content = content_it != receipt_map.end()
+      ? std::get_if<std::string>(&content_it->second) : nullptr;
+  const bool items = receipt_map.find(flutter::EncodableValue("items")) != receipt_map.end();
+  if (items || receipt_map.find(flutter::EncodableValue("receiptBlob")) != receipt_map.end()) {
+    const bool blob = DecodeReceiptBlob(receipt_map, receipt);
+    if (!blob && !items && content) {
+      // An unreadable blob and no items: the content as receipt text
+      document->text = *content;
+      return true;
+    }
+    if (!blob) DecodeReceiptDocument(receipt_map, receipt);
+    document->receipt = receipt;
+    document->store = DecodeStoreSettings(receipt_map);
+    return true;
+  }
+  auto rows_it = receipt_map.find(flutter::EncodableValue("rows"));
+  if (rows_it != receipt_map.end()) {
+    if (const auto* list = std::get_if<flutter::EncodableList>(&rows_it->second)) {
+      DecodeReceiptRows(*list, rows);
+      document->rows = rows;
+      return true;
+    }
+  }
+  if (!content) return false;
+  document->text = *content;
+  document->text_mode = printer_core::BatchText::kPreformatted;
+  return true;
+}
+
+const std::vector<uint8_t>& PrinterPlugin::EncodeReceiptForPrint(const flutter::EncodableMap& receipt_map,
+                                                                 int charsPerLine,
+                                                                 const std::string& tag,
+                                                                 uint64_t traceId) {
+  printer_core::BatchDocument document;
+  {
+    printer_core::ScopedTraceSpan decode(tracer_.get(), traceId, "decode");
+    DecodeReceiptForPrint(receipt_map, charsPerLine, &receipt_doc_, &receipt_rows_, &document);
+  }
+  if (document.receipt) PostLog(tag, "Using structured receipt content for printing");
+  printer_core::ScopedTraceSpan encode(tracer_.get(), traceId, "encode");
+  return printer_core::EncodeDocument(&encoder_, document);
+}
+
+printer_core::PrintJobCallback PrinterPlugin::FinishReceiptJob(const flutter::EncodableMap& receipt_map,
+                                                               int charsPerLine,
+                                                               const std::string& tag,
+                                                               printer_core::PrintJob* job) {
+  printer_core::PrintJobCallback onDone;
+  {
+    printer_core::ScopedTraceSpan logo(tracer_.get(), job->trace_id, "logo");
+    onDone = AddLogo(receipt_map, charsPerLine, job->target, tag, &job->data);
+  }
+  {
+    // Drop repeated alignment and settings, merge feeds
+    printer_core::ScopedTraceSpan optimize(tracer_.get(), job->trace_id, "optimize");
+    printer_core::OptimizeEscPos(&job->data);
+    optimize.set_arg("bytes", static_cast<int64_t>(job->data.size()));
+  }
+  printer_core::SetPreemptPoints(job);
+  return onDone;
+}
+
+printer_core::PrintJobCallback PrinterPlugin::AddLogo(const flutter::EncodableMap& receipt_map,
+                                                      int charsPerLine,
+                                                      const printer_core::PrinterTarget& target,
+                                                      const std::string& tag,
+                                                      std::vector<uint8_t>* data) {
+  auto path_it = receipt_map.find(flutter::EncodableValue("logoPath"));
+  const auto* path = path_it != receipt_map.end() ? std::get_if<std::string>(&path_it->second)
+                                                  : nullptr;
+  if (!path || path->empty()) return nullptr;
+  printer_core::DitherMode mode = printer_core::DitherMode::kThreshold;
+  auto dither_it = receipt_map.find(flutter::EncodableValue("logoDither"));
+  if (dither_it != receipt_map.end()) {
+    const auto* dither = std::get_if<std::string>(&dither_it->second);
+    if (dither && !printer_core::ParseDitherMode(*dither, &mode)) {
+      PostLog(tag, "Unknown logo dither mode " + *dither + ", using threshold", printer_core::LogLevel::kWarning);
+    }
+  }
+  int width = charsPerLine >= 42 ? printer_core::kLogoWidth80mm : printer_core::kLogoWidth58mm;
+  auto width_it = receipt_map.find(flutter::EncodableValue("logoWidth"));
+  if (width_it != receipt_map.end()) {
+    const auto* requested = std::get_if<int32_t>(&width_it->second);
+    if (requested && *requested > 0 && *requested <= printer_core::kLogoWidthFull80mm) {
+      width = *requested;
+    }
+  }
+
+  std::vector<uint8_t> file;
+  if (!ReadFileBytes(*path, &file)) {
+    PostLog(tag, "Cannot read logo " + *path, printer_core::LogLevel::kWarning);
+    return nullptr;
+  }
+  auto logo = logos_.Get(file.data(), file.size(), width, mode,
+                         [&file](printer_core::GrayImage* image) {
+                           return DecodeImage(file, image);
+                         });
+  if (!logo) {
+    PostLog(tag, "Cannot decode logo " + *path, printer_core::LogLevel::kWarning);
+    return nullptr;
+  }
+
+  const std::string printer = target.Key();
+  printer_core::NvLogoSupport storage = printer_core::NvLogoSupport::kUnknown;
+  auto storage_it = receipt_map.find(flutter::EncodableValue("logoStorage"));
+  if (storage_it != receipt_map.end()) {
+    const auto* storage_name = std::get_if<std::string>(&storage_it->second);
+    if (storage_name && !printer_core::ParseLogoStorage(*storage_name, &storage)) {
+      PostLog(tag, "Unknown logo storage " + *storage_name, printer_core::LogLevel::kWarning);
+    }
+  }
+  if (storage != printer_core::NvLogoSupport::kUnknown) {
+    nvLogos_.SetSupport(printer, storage);
+  } else if (target.kind == printer_core::PrinterTarget::Kind::kNetwork) {
+    // Raster this time; later receipts use what the probe finds
+    nvLogos_.Probe(target, 1000);
+  }
+  bool upload = false;
+  printer_core::PrependLogo(nvLogos_.Block(printer, *logo, &upload), data);
+  if (!upload) return nullptr;
+  PostLog(tag, "Storing logo in printer NV memory");
+  const printer_core::LogoKey key = logo->key;
+  return [this, printer, key](const printer_core::PrintJobResult& r) {
+    nvLogos_.FinishUpload(printer, key, r.success);
+  };
+}
+
+void PrinterPlugin::SetDebugEnabled(bool enabled) {
+  debugEnabled_ = enabled;
+  logger_->set_min_level(enabled ? printer_core::LogLevel::kDebug : printer_core::LogLevel::kInfo);
+}
+
+void PrinterPlugin::OpenSpool() {
+  const std::string path = AppDataFile(L"print_spool.bin");
+  if (path.empty()) {
+    PostLog("SPOOL", "No local app data folder; jobs are not journaled", printer_core::LogLevel::kWarning);
+    return;
+  }
+  std::string error;
+  spool_ = printer_core::PrintSpool::Open(path, printer_core::PrintSpoolOptions(), &error);
+  if (!spool_) {
+    PostLog("SPOOL", "Cannot open " + path + ": " + error, printer_core::LogLevel::kError);
+    return;
+  }
+  std::vector<printer_core::SpooledJob> recovered = spool_->TakeRecovered();
+  if (recovered.empty()) return;
+  PostLog("SPOOL", "Reprinting " + std::to_string(recovered.size()) +
+                       " job(s) left unprinted by the last run");
+  for (printer_core::SpooledJob& spooled : recovered) {
+    // The USB handle is normally opened by discoverPrinters, which has not run yet
+    if (spooled.job.target.kind == printer_core::PrinterTarget::Kind::kCustom &&
+        usbHandle_ == NULL) {
+      usbHandle_ = OpenUsb();
+      isPrinterConnected_ = usbHandle_ != NULL && usbHandle_ != INVALID_HANDLE_VALUE;
+    }
+    const uint64_t spoolId = spooled.id;
+    const std::string printer = spooled.job.target.Key();
+    const uint64_t jobId = jobQueue_->Submit(
+        std::move(spooled.job), [this, spoolId, printer](const printer_core::PrintJobResult& r) {
+          spool_->Complete(spoolId);
+          taskRunner_->PostTask([this, printer, r]() {
+            PostLog("SPOOL", "Replayed job " + std::to_string(r.job_id) + " on " + printer +
+                                 (r.success ? " printed" : " failed: " + r.error),
+                    r.success ? printer_core::LogLevel::kInfo : printer_core::LogLevel::kError);
+            PublishJobEvent(r, printer);
+          });
+        });
+    if (jobId == 0) spool_->Complete(spoolId);
+  }
+}
+
+std::unique_ptr<printer_core::PrinterTransport> PrinterPlugin::OpenTransport(
+    const printer_core::PrinterTarget& target, std::string* error) {
+  if (target.kind == printer_core::PrinterTarget::Kind::kCustom && target.device == "usb") {
+    if (usbHandle_ == NULL || usbHandle_ == INVALID_HANDLE_VALUE) {
+      if (error) *error = "USB printer is not connected";
+      return nullptr;
     }
+    return std::make_unique<PosmacUsbTransport>(usbHandle_);
+  }
+  return connectionPool_.Acquire(target, error);
+}
 
-    sb << std::string(charsPerLine, '-') << "\n";
+bool PrinterPlugin::ResolvePrinterTarget(const flutter::EncodableMap& arguments,
+                                         printer_core::PrinterTarget* target,
+                                         std::string* tag) {
+  // Check printer type and connection details
+  auto printerType_it = arguments.find(flutter::EncodableValue("printerType"));
+  auto connectionDetails_it = arguments.find(flutter::EncodableValue("connectionDetails"));
+  if (printerType_it == arguments.end() || connectionDetails_it == arguments.end()) {
+    return false;
+  }
 
-    // Totals (subtotal, tax, serviceCharge, total) if available
-    auto printTotal = [&](const std::string& label, const flutter::EncodableValue& v) {
-      double val = getDoubleFromEncodable(v);
-      std::ostringstream s;
-      s << currency << " " << std::fixed << std::setprecision(2) << val;
-      const std::string valStr = s.str();
-      if ((int)label.length() + (int)valStr.length() + 1 > charsPerLine) {
-        sb << label << "\n" << std::string(charsPerLine - (int)valStr.length(), ' ') << valStr << "\n";
+  const auto* printerType = std::get_if<std::string>(&printerType_it->second);
+  const auto* connectionDetails = std::get_if<flutter::EncodableMap>(&connectionDetails_it->second);
+  if (!printerType || !connectionDetails) {
+    return false;
+  }
+
+  if (*printerType == "network") {
+    auto ip_it = connectionDetails->find(flutter::EncodableValue("ipAddress"));
+    auto port_it = connectionDetails->find(flutter::EncodableValue("port"));
+    if (ip_it == connectionDetails->end() || port_it == connectionDetails->end()) {
+      return false;
+    }
+    const auto* ipAddress = std::get_if<std::string>(&ip_it->second);
+    const auto* port = std::get_if<int32_t>(&port_it->second);
+    if (!ipAddress || !port || *port <= 0 || *port > 65535) {
+      return false;
+    }
+    *target = printer_core::PrinterTarget::Network(*ipAddress, static_cast<uint16_t>(*port));
+    *tag = "NETWORK";
+    return true;
+  }
+
+  if (*printerType == "usb" || *printerType == "posmac") {
+    if (!isPrinterConnected_ || usbHandle_ == NULL) {
+      return false;
+    }
+    *target = printer_core::PrinterTarget::Custom("usb");
+    *tag = "USB";
+    return true;
+  }
+
+  // For other printer types (like local Windows printers), return false for now
+  // TODO: Implement Windows API printing for local printers
+  return false;
+}
+
+void PrinterPlugin::SubmitPrintJob(
+    printer_core::PrintJob job, bool async, const std::string& tag,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+    JobResultMapper mapper, printer_core::PrintJobCallback onDone) {
+  const bool isNetwork = job.target.kind == printer_core::PrinterTarget::Kind::kNetwork;
+  // std::function needs a copyable callable, so share the pending result
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending;
+  if (!async) pending = std::move(result);
+
+  // Every network job doubles as a reachability sample for the status cache
+  printer_core::PrinterTarget statusTarget;
+  if (isNetwork) statusTarget = job.target;
+  const std::string printer = job.target.Key();
+  // Jobs not started by the printReceipt handler are timed from here
+  if (job.trace_id == 0) job.trace_id = tracer_->BeginJob();
+  const uint64_t traceId = job.trace_id;
+  // Journaled before it is queued so a crash from here on cannot lose it
+  const uint64_t spoolId =
+      spool_ && printer_core::ShouldSpool(job) ? spool_->Append(job) : 0;
+
+  auto onComplete = [this, tag, isNetwork, statusTarget, printer, spoolId, pending, mapper, onDone](const printer_core::PrintJobResult& r) {
+    if (spoolId != 0) spool_->Complete(spoolId);
+    if (onDone) onDone(r);
+    if (isNetwork) {
+      printer_core::ScopedTraceSpan status(tracer_.get(), r.trace_id, "status");
+      statusMonitor_.ReportJobResult(statusTarget, r.success, r.error);
+    }
+    const int64_t postedUs = printer_core::TraceNow();
+    // Runs on a worker thread; everything below must happen on the platform thread
+    taskRunner_->PostTask([this, tag, isNetwork, printer, pending, mapper, r, postedUs]() {
+      tracer_->Record(r.trace_id, "deliver", postedUs, printer_core::TraceNow());
+      if (isNetwork) isNetworkPrinterConnected_ = r.success;
+      if (r.success) {
+        PostLog(tag, "Job " + std::to_string(r.job_id) + " printed, bytes: " + std::to_string(r.bytes_written));
       } else {
-        sb << label << std::string(charsPerLine - (int)label.length() - (int)valStr.length(), ' ') << valStr << "\n";
+        PostLog(tag, "Job " + std::to_string(r.job_id) + " failed: " + r.error, printer_core::LogLevel::kError);
       }
-    };
+      PublishJobEvent(r, printer);
 
-    auto subtotal_it = receipt_map.find(flutter::EncodableValue("subtotal"));
-    if (subtotal_it != receipt_map.end()) printTotal("Subtotal:", subtotal_it->second);
-    auto tax_it = receipt_map.find(flutter::EncodableValue("tax"));
-    if (tax_it != receipt_map.end()) printTotal("Tax:", tax_it->second);
-    auto service_it = receipt_map.find(flutter::EncodableValue("serviceCharge"));
-    if (service_it != receipt_map.end()) printTotal("Service:", service_it->second);
-    auto total_it = receipt_map.find(flutter::EncodableValue("total"));
-    if (total_it != receipt_map.end()) printTotal("TOTAL:", total_it->second);
-
-    // Feed and cut paper
-    sb << "\x0A\x1D\x56\x42\x00"; // line feed + full cut
-    return sb.str();
-  } catch (...) {
-    return std::string();
+      if (pending) {
+        pending->Success(mapper ? mapper(r) : flutter::EncodableValue(r.success));
+      } else if (channel_) {
+        channel_->InvokeMethod("printJobCompleted",
+                               std::make_unique<flutter::EncodableValue>(JobResultToMap(r)));
+      }
+      // The reply is out; a slow job's timeline is saved from here
+      tracer_->FinishJob(r.trace_id);
+    });
+  };
+
+  const uint64_t jobId = jobQueue_->Submit(std::move(job), std::move(onComplete));
+  if (jobId == 0) {
+    if (spoolId != 0) spool_->Complete(spoolId);
+    if (onDone) onDone(printer_core::PrintJobResult{});
+    tracer_->FinishJob(traceId);
+    PostLog(tag, "Print queue is shut down; job rejected", printer_core::LogLevel::kError);
+    if (pending) pending->Success(mapper ? mapper(printer_core::PrintJobResult{}) : flutter::EncodableValue(false));
+    else result->Success(flutter::EncodableValue(false));
+    return;
   }
+  if (async) result->Success(flutter::EncodableValue(static_cast<int64_t>(jobId)));
 }
 
-// New: Build structured ESC/POS as raw bytes vector
-std::vector<uint8_t> PrinterPlugin::BuildStructuredEscPosBytes(const flutter::EncodableMap& receipt_map, int charsPerLine) {
-  std::vector<uint8_t> out;
-  try {
-    auto items_it = receipt_map.find(flutter::EncodableValue("items"));
-    bool hasItems = (items_it != receipt_map.end());
-    auto content_it = receipt_map.find(flutter::EncodableValue("content"));
-    if (!hasItems && content_it != receipt_map.end()) {
-      const auto* content = std::get_if<std::string>(&content_it->second);
-      if (content) {
-        // Initialize
-        out.push_back(0x1B); out.push_back(0x40);
-        std::istringstream iss(*content);
-        std::string line;
-        while (std::getline(iss, line)) {
-          if (line.find("RM") == std::string::npos && line.find("$") == std::string::npos) {
-            out.push_back(0x1B); out.push_back(0x61); out.push_back(0x01); // center
-          } else {
-            out.push_back(0x1B); out.push_back(0x61); out.push_back(0x00); // left
+void PrinterPlugin::DiscoverNetworkPrinters(
+    const flutter::EncodableMap* arguments,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  if (scanRunning_) {
+    result->Error("SCAN_IN_PROGRESS", "A network scan is already running");
+    return;
+  }
+
+  std::vector<printer_core::Ipv4Range> ranges;
+  printer_core::ScanOptions options;
+  if (arguments) {
+    auto cidr_it = arguments->find(flutter::EncodableValue("cidr"));
+    if (cidr_it != arguments->end()) {
+      const auto* cidr = std::get_if<std::string>(&cidr_it->second);
+      printer_core::Ipv4Range range;
+      std::string error;
+      if (!cidr || !printer_core::ParseCidr(*cidr, &range, &error)) {
+        result->Error("INVALID_ARGUMENTS", cidr ? error : "cidr must be a string");
+        return;
+      }
+      ranges.push_back(range);
+    }
+    auto ports_it = arguments->find(flutter::EncodableValue("ports"));
+    if (ports_it != arguments->end()) {
+      if (const auto* ports = std::get_if<flutter::EncodableList>(&ports_it->second)) {
+        options.ports.clear();
+        for (const auto& value : *ports) {
+          const auto* port = std::get_if<int32_t>(&value);
+          if (port && *port > 0 && *port <= 65535) {
+            options.ports.push_back(static_cast<uint16_t>(*port));
           }
-          for (char c: line) out.push_back(static_cast<uint8_t>(c));
-          out.push_back('\n');
         }
-        out.push_back(0x0A);
-        out.push_back(0x1D); out.push_back(0x56); out.push_back(0x42); out.push_back(0x00);
-        return out;
       }
     }
+    auto timeout_it = arguments->find(flutter::EncodableValue("timeoutMs"));
+    if (timeout_it != arguments->end()) {
+      const auto* timeout = std::get_if<int32_t>(&timeout_it->second);
+      if (timeout && *timeout > 0) options.timeout_ms = *timeout;
+    }
+  }
+  if (ranges.empty()) ranges = printer_core::LocalSubnets();
+
+  if (scanThread_.joinable()) scanThread_.join();
+  scanRunning_ = true;
+  scanCancel_ = false;
+  options.cancel = &scanCancel_;
+  PostLog("NETWORK", "Scanning " + std::to_string(ranges.size()) + " subnet(s) for printers");
+
+  auto found = std::make_shared<flutter::EncodableList>();
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+  scanThread_ = std::thread([this, ranges, options, found, pending]() {
+    std::string error;
+    const bool ok = printer_core::ScanNetwork(
+        ranges, options,
+        [this, found](const printer_core::ScanHit& hit) {
+          taskRunner_->PostTask([this, found, hit]() {
+            flutter::EncodableMap printer = NetworkPrinterToMap(hit);
+            found->push_back(flutter::EncodableValue(printer));
+            if (channel_) {
+              channel_->InvokeMethod("networkPrinterFound",
+                                     std::make_unique<flutter::EncodableValue>(printer));
+            }
+          });
+        },
+        &error);
+    // Posted after every hit, so |found| is complete when this runs
+    taskRunner_->PostTask([this, found, pending, ok, error]() {
+      scanRunning_ = false;
+      PostLog("NETWORK", ok ? "Network scan found " + std::to_string(found->size()) + " printer port(s)"
+                            : "Network scan failed: " + error,
+              ok ? printer_core::LogLevel::kInfo : printer_core::LogLevel::kWarning);
+      pending->Success(flutter::EncodableValue(*found));
+    });
+  });
+}
 
-    auto pushBytes = [&](std::initializer_list<uint8_t> bytes) {
-      out.insert(out.end(), bytes.begin(), bytes.end());
-    };
-    auto pushString = [&](const std::string& value) {
-      for (char c: value) out.push_back(static_cast<uint8_t>(c));
-    };
-    // Initialize
-    out.push_back(0x1B); out.push_back(0x40);
-    std::string currency = "RM";
-    auto currency_it = receipt_map.find(flutter::EncodableValue("currency"));
-    if (currency_it != receipt_map.end()) {
-      const auto* cs = std::get_if<std::string>(&currency_it->second);
-      if (cs) currency = *cs;
+void PrinterPlugin::PrintBatch(const flutter::EncodableMap& arguments,
+                               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  auto jobs_it = arguments.find(flutter::EncodableValue("jobs"));
+  const auto* jobList = jobs_it != arguments.end()
+      ? std::get_if<flutter::EncodableList>(&jobs_it->second) : nullptr;
+  if (!jobList) {
+    result->Success(flutter::EncodableValue(flutter::EncodableList()));
+    return;
+  }
+  const size_t count = jobList->size();
+
+  // Decode every job on the platform thread the way printReceipt and
+  // printOrder do; the documents borrow strings from the method arguments,
+  // which only live for this call.
+  std::vector<printer_core::ReceiptDocument> receipts(count);
+  std::vector<std::vector<printer_core::ReceiptRow>> rows(count);
+  std::vector<printer_core::BatchDocument> documents;
+  std::vector<printer_core::PrintJob> jobs;
+  std::vector<size_t> jobIndex;  // input position of jobs[i]
+  std::vector<std::string> printers;  // printer key of jobs[i]
+  std::vector<std::string> tags;  // log tag of jobs[i]
+  std::vector<const flutter::EncodableMap*> receiptOfJob;  // null for orders
+  documents.reserve(count);
+  jobs.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const auto* job = std::get_if<flutter::EncodableMap>(&(*jobList)[i]);
+    if (!job) continue;
+    printer_core::PrinterTarget target;
+    std::string tag;
+    if (!ResolvePrinterTarget(*job, &target, &tag)) continue;
+
+    printer_core::BatchDocument document;
+    const int charsPerLine = CharsPerLineFromArguments(*job);
+    printer_core::JobPriority fallback = printer_core::JobPriority::kReceipt;
+    auto receipt_it = job->find(flutter::EncodableValue("receiptData"));
+    auto order_it = job->find(flutter::EncodableValue("orderData"));
+    const auto* receiptData = receipt_it != job->end()
+        ? std::get_if<flutter::EncodableMap>(&receipt_it->second) : nullptr;
+    const auto* orderData = order_it != job->end()
+        ? std::get_if<std::string>(&order_it->second) : nullptr;
+    if (receiptData) {
+      if (!DecodeReceiptForPrint(*receiptData, charsPerLine, &receipts[i], &rows[i], &document)) {
+        continue;
+      }
+    } else if (orderData) {
+      // Sent as-is, like printOrder
+      document.chars_per_line = charsPerLine;
+      document.text = *orderData;
+      document.text_mode = printer_core::BatchText::kRaw;
+      fallback = printer_core::JobPriority::kKitchen;
+    } else {
+      continue;
     }
-    // Header
-    out.push_back(0x1B); out.push_back(0x61); out.push_back(0x01);
-    for (int i = 0; i < charsPerLine; ++i) out.push_back('=');
-    out.push_back('\n');
-    auto title_it = receipt_map.find(flutter::EncodableValue("title"));
-    if (title_it != receipt_map.end()) {
-      const auto* title = std::get_if<std::string>(&title_it->second);
-      if (title) for (char c: *title) out.push_back(static_cast<uint8_t>(c));
-      out.push_back('\n');
+
+    printer_core::PrintJob printJob{std::move(target), {}};
+    printJob.priority = PriorityFromArguments(*job, fallback);
+    printers.push_back(printJob.target.Key());
+    jobs.push_back(std::move(printJob));
+    documents.push_back(document);
+    jobIndex.push_back(i);
+    tags.push_back(std::move(tag));
+    receiptOfJob.push_back(receiptData);
+  }
+
+  // Encode across cores; logo, optimizer and break points as printReceipt
+  // and printOrder add them. Then each printer's jobs go over one connection.
+  std::vector<std::vector<uint8_t>> encoded = printer_core::EncodeBatch(documents);
+  std::vector<printer_core::PrintJobCallback> onDone(jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    jobs[i].data = std::move(encoded[i]);
+    if (receiptOfJob[i]) {
+      onDone[i] = FinishReceiptJob(*receiptOfJob[i], documents[i].chars_per_line, tags[i],
+                                   &jobs[i]);
+    } else {
+      printer_core::SetPreemptPoints(&jobs[i]);
     }
-    for (int i = 0; i < charsPerLine; ++i) out.push_back('-');
-    out.push_back('\n');
-    // Items
-    if (items_it != receipt_map.end()) {
-      const auto* items = std::get_if<flutter::EncodableList>(&items_it->second);
-      if (items) {
-        for (const auto& iv : *items) {
-          const auto* itemMap = std::get_if<flutter::EncodableMap>(&iv);
-          if (!itemMap) continue;
-          std::string name;
-          int qty = 1;
-          double price = 0.0;
-          auto nIt = itemMap->find(flutter::EncodableValue("name"));
-          if (nIt != itemMap->end()) name = getStringFromEncodable(nIt->second);
-          auto qIt = itemMap->find(flutter::EncodableValue("quantity"));
-          if (qIt != itemMap->end()) qty = static_cast<int>(getDoubleFromEncodable(qIt->second));
-          auto pIt = itemMap->find(flutter::EncodableValue("price"));
-          if (pIt != itemMap->end()) price = getDoubleFromEncodable(pIt->second);
-          std::ostringstream priceStr;
-          priceStr << currency << " " << std::fixed << std::setprecision(2) << (price * qty);
-          std::string leftPart = name;
-          if (qty != 1) leftPart += " x" + std::to_string(qty);
-          if (charsPerLine >= 48) {
-            if ((int)leftPart.length() + (int)priceStr.str().length() + 1 > charsPerLine) {
-              for (char c: leftPart) out.push_back(static_cast<uint8_t>(c));
-              out.push_back('\n');
-              for (int k = 0; k < charsPerLine - (int)priceStr.str().length(); ++k) out.push_back(' ');
-              for (char c: priceStr.str()) out.push_back(static_cast<uint8_t>(c));
-              out.push_back('\n');
-            } else {
-              out.push_back(0x1B); out.push_back(0x61); out.push_back(0x00);
-              for (char c: leftPart) out.push_back(static_cast<uint8_t>(c));
-              for (int k = 0; k < charsPerLine - (int)leftPart.length() - (int)priceStr.str().length(); ++k) out.push_back(' ');
-              for (char c: priceStr.str()) out.push_back(static_cast<uint8_t>(c));
-              out.push_back('\n');
-            }
-          } else {
-            out.push_back(0x1B); out.push_back(0x61); out.push_back(0x00);
-            for (char c: leftPart) out.push_back(static_cast<uint8_t>(c));
-            out.push_back('\n');
-            for (int k = 0; k < charsPerLine - (int)priceStr.str().length(); ++k) out.push_back(' ');
-            for (char c: priceStr.str()) out.push_back(static_cast<uint8_t>(c));
-            out.push_back('\n');
-          }
+  }
+  PostLog("BATCH", "Submitting " + std::to_string(jobs.size()) + " of " +
+                       std::to_string(count) + " jobs");
+
+  // Jobs that could not be decoded report failure without being queued
+  flutter::EncodableList results(count);
+  for (size_t i = 0; i < count; ++i) {
+    printer_core::PrintJobResult rejected;
+    rejected.error = "invalid job";
+    results[i] = flutter::EncodableValue(JobResultToMap(rejected));
+  }
+
+  const bool async = IsAsyncCall(arguments);
+  struct BatchState {
+    flutter::EncodableList results;
+    std::map<uint64_t, size_t> indexOfJob;
+    std::map<uint64_t, std::string> printerOfJob;
+    std::map<uint64_t, uint64_t> spoolOfJob;
+    std::map<uint64_t, printer_core::PrintJobCallback> doneOfJob;
+    size_t remaining = 0;
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> reply;
+  };
+  auto state = std::make_shared<BatchState>();
+  state->results = std::move(results);
+  state->remaining = jobs.size();
+  if (!async) state->reply = std::move(result);
+
+  auto onComplete = [this, state, async](const printer_core::PrintJobResult& r) {
+    // Completions are gathered on the platform thread, so state needs no lock
+    taskRunner_->PostTask([this, state, async, r]() {
+      if (!r.success) {
+        PostLog("BATCH", "Job " + std::to_string(r.job_id) + " failed: " + r.error,
+                printer_core::LogLevel::kError);
+      }
+      PublishJobEvent(r, state->printerOfJob[r.job_id]);
+      auto spooled = state->spoolOfJob.find(r.job_id);
+      if (spooled != state->spoolOfJob.end() && spooled->second != 0) spool_->Complete(spooled->second);
+      auto done = state->doneOfJob.find(r.job_id);
+      if (done != state->doneOfJob.end() && done->second) done->second(r);
+      if (async) {
+        if (channel_) {
+          channel_->InvokeMethod("printJobCompleted",
+                                 std::make_unique<flutter::EncodableValue>(JobResultToMap(r)));
         }
+        return;
       }
-    }
-    for (int i = 0; i < charsPerLine; ++i) out.push_back('-');
-    out.push_back('\n');
-    auto printTotal = [&](const std::string& label, const flutter::EncodableValue& v) {
-      double val = getDoubleFromEncodable(v);
-      std::ostringstream s;
-      s << currency << " " << std::fixed << std::setprecision(2) << val;
-      const std::string valStr = s.str();
-      if ((int)label.length() + (int)valStr.length() + 1 > charsPerLine) {
-        for (char c: label) out.push_back(static_cast<uint8_t>(c));
-        out.push_back('\n');
-        for (int k = 0; k < charsPerLine - (int)valStr.length(); ++k) out.push_back(' ');
-        for (char c: valStr) out.push_back(static_cast<uint8_t>(c));
-        out.push_back('\n');
-      } else {
-        for (char c: label) out.push_back(static_cast<uint8_t>(c));
-        for (int k = 0; k < charsPerLine - (int)label.length() - (int)valStr.length(); ++k) out.push_back(' ');
-        for (char c: valStr) out.push_back(static_cast<uint8_t>(c));
-        out.push_back('\n');
+      auto it = state->indexOfJob.find(r.job_id);
+      if (it != state->indexOfJob.end()) {
+        state->results[it->second] = flutter::EncodableValue(JobResultToMap(r));
       }
-    };
-    auto subtotal_it = receipt_map.find(flutter::EncodableValue("subtotal"));
-    if (subtotal_it != receipt_map.end()) printTotal("Subtotal:", subtotal_it->second);
-    auto tax_it = receipt_map.find(flutter::EncodableValue("tax"));
-    if (tax_it != receipt_map.end()) printTotal("Tax:", tax_it->second);
-    auto service_it = receipt_map.find(flutter::EncodableValue("serviceCharge"));
-    if (service_it != receipt_map.end()) printTotal("Service:", service_it->second);
-    auto total_it = receipt_map.find(flutter::EncodableValue("total"));
-    if (total_it != receipt_map.end()) printTotal("TOTAL:", total_it->second);
-    for (int i = 0; i < charsPerLine; ++i) out.push_back('=');
-    out.push_back('\n');
-
-    auto barcode_it = receipt_map.find(flutter::EncodableValue("barcode"));
-    if (barcode_it != receipt_map.end()) {
-      std::string barcode = getStringFromEncodable(barcode_it->second);
-      if (!barcode.empty()) {
-        if (barcode.size() > 255) barcode = barcode.substr(0, 255);
-        pushBytes({0x1B, 0x61, 0x01}); // center
-        pushBytes({0x1D, 0x48, 0x02}); // HRI below
-        pushBytes({0x1D, 0x68, 0x50}); // Height
-        pushBytes({0x1D, 0x77, 0x02}); // Module width
-        pushBytes({0x1D, 0x6B, 0x49, static_cast<uint8_t>(barcode.size())}); // Code128
-        pushString(barcode);
-        out.push_back('\n');
+      if (--state->remaining == 0 && state->reply) {
+        state->reply->Success(flutter::EncodableValue(state->results));
+        state->reply.reset();
       }
-    }
+    });
+  };
 
-    auto qr_it = receipt_map.find(flutter::EncodableValue("qr_data"));
-    if (qr_it != receipt_map.end()) {
-      std::string qrData = getStringFromEncodable(qr_it->second);
-      if (!qrData.empty()) {
-        pushBytes({0x1B, 0x61, 0x01}); // center
-        pushBytes({0x1D, 0x28, 0x6B, 0x04, 0x00, 0x31, 0x41, 0x32, 0x00}); // Model 2
-        pushBytes({0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x43, 0x06}); // Size 6
-        pushBytes({0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x45, 0x30}); // Error correction L
-        int len = static_cast<int>(qrData.size()) + 3;
-        uint8_t pL = static_cast<uint8_t>(len & 0xFF);
-        uint8_t pH = static_cast<uint8_t>((len >> 8) & 0xFF);
-        pushBytes({0x1D, 0x28, 0x6B, pL, pH, 0x31, 0x50, 0x30});
-        pushString(qrData);
-        pushBytes({0x1D, 0x28, 0x6B, 0x03, 0x00, 0x31, 0x51, 0x30});
-        out.push_back('\n');
-      }
-    }
+  std::vector<uint64_t> spoolIds;
+  for (const printer_core::PrintJob& job : jobs) {
+    spoolIds.push_back(spool_ && printer_core::ShouldSpool(job) ? spool_->Append(job) : 0);
+  }
+  const std::vector<uint64_t> ids =
+      jobs.empty() ? std::vector<uint64_t>() : jobQueue_->SubmitBatch(std::move(jobs), onComplete);
+  // Posted completions run after this call returns, so the map is complete
+  // before any of them looks at it.
+  for (size_t i = 0; i < ids.size(); ++i) {
+    state->indexOfJob[ids[i]] = jobIndex[i];
+    state->printerOfJob[ids[i]] = printers[i];
+    state->spoolOfJob[ids[i]] = spoolIds[i];
+    state->doneOfJob[ids[i]] = std::move(onDone[i]);
+  }
+  // Rejected by a shut-down queue: nothing to replay
+  for (size_t i = ids.size(); i < spoolIds.size(); ++i) {
+    if (spoolIds[i] != 0) spool_->Complete(spoolIds[i]);
+    if (onDone[i]) onDone[i](printer_core::PrintJobResult{});
+  }
 
-    out.push_back(0x0A);
-    out.push_back(0x1D); out.push_back(0x56); out.push_back(0x42); out.push_back(0x00);
-    return out;
-  } catch (...) {
-    return std::vector<uint8_t>();
+  if (async) {
+    flutter::EncodableList idList(count, flutter::EncodableValue(static_cast<int64_t>(0)));
+    for (size_t i = 0; i < ids.size(); ++i) {
+      idList[jobIndex[i]] = flutter::EncodableValue(static_cast<int64_t>(ids[i]));
+    }
+    result->Success(flutter::EncodableValue(idList));
+    return;
+  }
+  if (ids.empty()) {
+    // Nothing queued (all invalid, or the queue is shut down)
+    state->reply->Success(flutter::EncodableValue(state->results));
+    state->reply.reset();
   }
 }
-
-void PrinterPlugin::SetDebugEnabled(bool enabled) {
-  debugEnabled_ = enabled;
-}
\ No newline at end of file
@@ -1,8 +1,14 @@
+#include <flutter/event_channel.h>
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 // Include JsPrinterDll.h first (which includes winsock2.h and windows.h)
 #include "JsPrinterDll.h"
 
@@ -10,6 +16,21 @@
 #include <winspool.h>
 #include <stringapiset.h>
 
+#include "batch_encoder.h"
+#include "connection_pool.h"
+#include "escpos_encoder.h"
+#include "escpos_optimizer.h"
+#include "job_trace.h"
+#include "logger.h"
+#include "logo_raster.h"
+#include "network_scanner.h"
+#include "nv_logo.h"
+#include "platform_task_runner.h"
+#include "print_job_queue.h"
+#include "print_spool.h"
+#include "receipt_blob.h"
+#include "status_monitor.h"
+
 namespace {
 
 class PrinterPlugin : public flutter::Plugin {
@@ -24,8 +45,19 @@ class PrinterPlugin : public flutter::Plugin {
   std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
     // Additional channel to support the 'net.nfet.printing' API surface for parity with web plugin
     std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> net_channel_;
+  // Pushes printer status changes and job outcomes to Dart as they happen
+  std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> event_channel_;
 
  private:
+  // Handler for channel_'s messages: decodes the method call itself so the
+  // handler owns the arguments, runs printRaw and passes every other call
+  // to HandleMethodCall.
+  void HandleRunnerMessage(const uint8_t* message, size_t size, flutter::BinaryReply reply);
+  // printRaw: pre-encoded ESC/POS ("data", a Uint8List) queued exactly as
+  // given, with no optimizer pass and no logo. The bytes move out of
+  // |arguments| into the job.
+  void PrintRaw(flutter::EncodableValue* arguments,
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   // Called when a method is called on this plugin's channel from Dart.
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
@@ -35,16 +67,121 @@ class PrinterPlugin : public flutter::Plugin {
   HANDLE usbHandle_;
   bool isPrinterConnected_;
   
-  // Network printer socket
-  SOCKET networkSocket_;
+  // Result of the last network job; updated on the platform thread
   bool isNetworkPrinterConnected_;
-  SOCKADDR_IN networkAddr_;
 
-    // Store the MethodChannel so we can post logs back to Dart
-    // Post a log to the dart side using the stored channel
-    void PostLog(const std::string& level, const std::string& message);
-    // Build a structured ESC/POS bytes vector from the given receipt map
-    std::vector<uint8_t> BuildStructuredEscPosBytes(const flutter::EncodableMap& receipt_map, int charsPerLine);
+  // Keeps network printer sockets open between jobs; declared before
+  // jobQueue_ so it outlives every transport the workers hold.
+  printer_core::ConnectionPool connectionPool_;
+  // Background DLE EOT / GS a poller over pooled connections; status calls
+  // from Dart read its cache.
+  printer_core::StatusMonitor statusMonitor_;
+  // Which printers keep the logo in NV memory and which version they hold.
+  // Job callbacks report uploads to it, so it is declared before jobQueue_.
+  printer_core::NvLogoStore nvLogos_;
+  // Journal of jobs not yet printed, replayed after a crash or power cut;
+  // null if the file could not be opened. Declared before jobQueue_ so it
+  // outlives the workers that complete its entries.
+  std::unique_ptr<printer_core::PrintSpool> spool_;
+  // Per-job span timelines; the queue's workers record into it, so it is
+  // declared before jobQueue_.
+  std::unique_ptr<printer_core::JobTracer> tracer_;
+
+  // Print jobs run on jobQueue_ workers; their completions are marshalled back
+  // to the platform thread through taskRunner_ before touching any channel.
+  std::unique_ptr<PlatformTaskRunner> taskRunner_;
+  std::unique_ptr<printer_core::PrintJobQueue> jobQueue_;
+  // Collects PostLog lines from any thread and sends them to Dart as one
+  // 'printerLogBatch' call per flush, also keeping them in a rotating file.
+  // Declared after taskRunner_ so its last batch can still be posted.
+  std::unique_ptr<printer_core::Logger> logger_;
+
+  // Maps a finished job to the value returned to Dart (defaults to success bool)
+  using JobResultMapper =
+      std::function<flutter::EncodableValue(const printer_core::PrintJobResult&)>;
+  // Reads printerType/connectionDetails from the call arguments. Returns false
+  // for unsupported types or when the USB printer is not open.
+  bool ResolvePrinterTarget(const flutter::EncodableMap& arguments,
+                            printer_core::PrinterTarget* target,
+                            std::string* tag);
+  // Queues |job|. When |async| is set the job id is returned immediately and
+  // the outcome is delivered later as a 'printJobCompleted' call on channel_;
+  // otherwise |result| is answered once the job finishes. |onDone| runs on the
+  // worker thread with the outcome.
+  void SubmitPrintJob(printer_core::PrintJob job, bool async, const std::string& tag,
+                      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+                      JobResultMapper mapper = nullptr,
+                      printer_core::PrintJobCallback onDone = nullptr);
+  // printBatch: encodes N jobs in parallel and sends each printer's jobs over
+  // one connection; replies with one result map per job, in input order.
+  void PrintBatch(const flutter::EncodableMap& arguments,
+                  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Opens the spool under %LOCALAPPDATA%\ExtroPOS and requeues the jobs the
+  // last run left unprinted. Called once channel_ is set so the replay shows
+  // up in the Dart log.
+  void OpenSpool();
+  std::unique_ptr<printer_core::PrinterTransport> OpenTransport(
+      const printer_core::PrinterTarget& target, std::string* error);
+  // discoverNetworkPrinters: scans the "cidr" argument (default: the local
+  // /24s) on a background thread. Each printer found is sent right away as a
+  // 'networkPrinterFound' call; |result| gets the full list at the end.
+  void DiscoverNetworkPrinters(const flutter::EncodableMap* arguments,
+                               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Slow-job reporting for tracer_: the timeline goes to a file and the log.
+  static printer_core::JobTracerOptions RunnerTraceOptions(PrinterPlugin* plugin);
+
+  // Sends |event| on event_channel_ if Dart is listening; platform thread only.
+  void PublishEvent(flutter::EncodableMap event);
+  // 'jobFinished' / 'jobFailed' event for a job sent to the printer |printer|.
+  void PublishJobEvent(const printer_core::PrintJobResult& r, const std::string& printer);
+  // Set while Dart listens on event_channel_; platform thread only.
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> eventSink_;
+
+  // At most one scan at a time; scanRunning_ is only touched on the platform
+  // thread, scanCancel_ stops the scan early on shutdown.
+  std::thread scanThread_;
+  std::atomic<bool> scanCancel_{false};
+  bool scanRunning_ = false;
+
+    // Queues a log line for the next batch to Dart; callable from any thread
+    // and never waits.
+    void PostLog(const std::string& category, const std::string& message,
+                 printer_core::LogLevel level = printer_core::LogLevel::kInfo);
+    // Sends a batch from logger_ on channel_; platform thread only.
+    void PublishLogBatch(const flutter::EncodableList& entries);
+    // Encodes a printReceipt payload into encoder_'s buffer, which is reused
+    // by the next encode: the structured receipt when there is one, else the
+    // laid-out rows or the content text. |traceId| gets its decode and
+    // encode spans.
+    const std::vector<uint8_t>& EncodeReceiptForPrint(const flutter::EncodableMap& receipt_map,
+                                                      int charsPerLine,
+                                                      const std::string& tag,
+                                                      uint64_t traceId = 0);
+    // What every encoded receipt gets before it is queued, in printReceipt
+    // and printBatch alike: the logo (AddLogo), the optimizer pass and break
+    // points. Returns AddLogo's callback.
+    printer_core::PrintJobCallback FinishReceiptJob(const flutter::EncodableMap& receipt_map,
+                                                    int charsPerLine,
+                                                    const std::string& tag,
+                                                    printer_core::PrintJob* job);
+    // Puts the image at receiptData "logoPath" on top of |data|, dithered per
+    // "logoDither" at "logoWidth" dots. "logoStorage" says how |target| keeps
+    // logos; by default network printers are probed for NV graphics and then
+    // sent the logo once. A logo that cannot be read is logged and left off
+    // so the receipt still prints. Returns the callback that records an NV
+    // upload when the job is done, or null when the job carries none.
+    printer_core::PrintJobCallback AddLogo(const flutter::EncodableMap& receipt_map,
+                                           int charsPerLine,
+                                           const printer_core::PrinterTarget& target,
+                                           const std::string& tag,
+                                           std::vector<uint8_t>* data);
+    // Reused across receipts so steady-state encoding does not allocate
+    printer_core::EscPosEncoder encoder_;
+    printer_core::ReceiptDocument receipt_doc_;
+    std::vector<printer_core::ReceiptRow> receipt_rows_;
+    // Rasterized receipt logos, so only the first receipt pays for decoding
+    printer_core::LogoCache logos_;
     // Debug toggle to enable hex previews in logs
     void SetDebugEnabled(bool enabled);
     bool debugEnabled_ = false;